@@ -63,6 +63,14 @@ void CLIParser::setupCommands() {
     auto* nlp_cmd = app_->add_subcommand("nlp", "Natural Language Processing utilities");
     setupNLPCommand(nlp_cmd);
 
+    // Usage command
+    auto* usage_cmd = app_->add_subcommand("usage", "Show token usage and cost from the request ledger");
+    setupUsageCommand(usage_cmd);
+
+    // Maintain command
+    auto* maintain_cmd = app_->add_subcommand("maintain", "Clean up, compact and compress stored sessions in the background");
+    setupMaintainCommand(maintain_cmd);
+
     // Don't require subcommands - allow help/version to work without subcommands
     app_->require_subcommand(0, 1);
 }
@@ -129,6 +137,42 @@ void CLIParser::setupNLPCommand(CLI::App* nlp_cmd) {
     generate_cmd->callback([&]() { options_.command = "nlp"; options_.nlp_action = "generate"; });
 }
 
+void CLIParser::setupUsageCommand(CLI::App* usage_cmd) {
+    usage_cmd->add_option("--by", options_.usage_group_by, "Group by session, model, day or project")
+        ->default_val("model")
+        ->check(CLI::IsMember({"session", "model", "day", "project"}));
+    usage_cmd->add_option("--session", options_.usage_session, "Only this session");
+    usage_cmd->add_option("--model", options_.usage_model, "Only this model");
+    usage_cmd->add_option("--project", options_.usage_project, "Only this project directory (. for the current one)");
+    usage_cmd->add_option("--since", options_.usage_since, "Only requests on or after this day (YYYY-MM-DD)");
+    usage_cmd->add_flag("--json", options_.usage_json, "Print the summary as JSON");
+
+    usage_cmd->callback([&]() {
+        options_.command = "usage";
+    });
+}
+
+void CLIParser::setupMaintainCommand(CLI::App* maintain_cmd) {
+    maintain_cmd->add_option("--max-age-days", options_.maintain_max_age_days,
+                             "Delete sessions untouched this many days (0 keeps them)")
+        ->default_val(30);
+    maintain_cmd->add_option("--rate-mb", options_.maintain_rate_mb,
+                             "Session data read and written per second, in MB (0 for no limit)")
+        ->default_val(4.0)
+        ->check(CLI::NonNegativeNumber);
+    maintain_cmd->add_flag("--no-compress", options_.maintain_no_compress, "Leave uncompressed sessions as they are");
+    maintain_cmd->add_flag("--train-dictionary", options_.maintain_train_dictionary,
+                           "Retrain the compression dictionary before compressing");
+    maintain_cmd->add_flag("--daemon", options_.maintain_daemon, "Keep running, one pass per interval, until Ctrl-C");
+    maintain_cmd->add_option("--interval-hours", options_.maintain_interval_hours, "Hours between passes with --daemon")
+        ->default_val(24)
+        ->check(CLI::PositiveNumber);
+
+    maintain_cmd->callback([&]() {
+        options_.command = "maintain";
+    });
+}
+
 void CLIParser::setupGlobalOptions() {
     app_->add_flag("-v,--verbose", options_.verbose, "Enable verbose output")
         ->default_val(false);
@@ -142,6 +186,9 @@ void CLIParser::setupGlobalOptions() {
     
     app_->add_flag("--version", options_.version, "Show version information")
         ->default_val(false);
+    
+    app_->add_option("--telemetry", options_.telemetry_output,
+                     "Write per-request timing telemetry as JSON lines to a file (- for stderr)");
 }
 
 void CLIParser::setupReviewCommand(CLI::App* review_cmd) {
@@ -18,6 +18,7 @@ struct CLIOptions {
     bool version = false;
     bool help = false;
     bool non_interactive = false;
+    std::string telemetry_output;   // Request telemetry JSON lines: file path or "-" for stderr
 
     // General prompt option for @file syntax support
     std::string prompt_text;
@@ -44,6 +45,22 @@ struct CLIOptions {
 
     // Scaffold Command Options
     std::string scaffold_prompt;
+
+    // Usage Command Options
+    std::string usage_group_by = "model";
+    std::string usage_session;
+    std::string usage_model;
+    std::string usage_project;
+    std::string usage_since;
+    bool usage_json = false;
+
+    // Maintain Command Options
+    size_t maintain_max_age_days = 30;
+    double maintain_rate_mb = 4.0;
+    bool maintain_no_compress = false;
+    bool maintain_train_dictionary = false;
+    bool maintain_daemon = false;
+    size_t maintain_interval_hours = 24;
 };
 
 class CLIParser {
@@ -68,6 +85,8 @@ private:
     void setupTransformCommand(CLI::App* transform_cmd);
     void setupScaffoldCommand(CLI::App* scaffold_cmd);
     void setupNLPCommand(CLI::App* nlp_cmd);
+    void setupUsageCommand(CLI::App* usage_cmd);
+    void setupMaintainCommand(CLI::App* maintain_cmd);
     void setupGlobalOptions();
 };
 
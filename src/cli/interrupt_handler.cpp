@@ -0,0 +1,87 @@
+#include "interrupt_handler.h"
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#include <signal.h>
+#endif
+
+namespace clion {
+namespace cli {
+
+namespace {
+    // Lock-free, so safe to set from a signal handler, and from the console
+    // control thread on Windows
+    std::atomic<bool> interrupt_pending{false};
+    // Nested captures share one handler; the outermost one restores the
+    // previous handler
+    int install_depth = 0;
+
+#ifdef _WIN32
+    BOOL WINAPI handleConsoleControl(DWORD control_type) {
+        if (control_type == CTRL_C_EVENT || control_type == CTRL_BREAK_EVENT) {
+            interrupt_pending = true;
+            return TRUE;
+        }
+        return FALSE;
+    }
+#else
+    struct sigaction previous_action;
+
+    void handleInterrupt(int /* signal */) {
+        interrupt_pending = true;
+    }
+#endif
+}
+
+bool InterruptHandler::install() {
+    if (install_depth > 0) {
+        ++install_depth;
+        return true;
+    }
+    interrupt_pending = false;
+
+#ifdef _WIN32
+    if (!SetConsoleCtrlHandler(handleConsoleControl, TRUE)) {
+        return false;
+    }
+#else
+    struct sigaction action {};
+    action.sa_handler = handleInterrupt;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;  // No SA_RESTART: let a blocking read see EINTR
+    if (sigaction(SIGINT, &action, &previous_action) != 0) {
+        return false;
+    }
+#endif
+
+    install_depth = 1;
+    return true;
+}
+
+void InterruptHandler::uninstall() {
+    if (install_depth == 0 || --install_depth > 0) {
+        return;
+    }
+
+#ifdef _WIN32
+    SetConsoleCtrlHandler(handleConsoleControl, FALSE);
+#else
+    sigaction(SIGINT, &previous_action, nullptr);
+#endif
+
+    interrupt_pending = false;
+}
+
+bool InterruptHandler::isInstalled() {
+    return install_depth > 0;
+}
+
+bool InterruptHandler::consumeInterrupt() {
+    return interrupt_pending.exchange(false);
+}
+
+} // namespace cli
+} // namespace clion
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "clion/common.h"
+
+namespace clion {
+namespace cli {
+
+// Captures SIGINT (Ctrl-C) while a long-running operation is in flight, so
+// the operation can be cancelled instead of the whole process exiting.
+// Outside a capture Ctrl-C keeps its default behaviour.
+class InterruptHandler {
+public:
+    // Installs the capturing handler; returns false if it could not be
+    // installed. Calls nest: each successful install() needs one uninstall().
+    static bool install();
+    // Restores the handler that was active before the outermost install()
+    static void uninstall();
+
+    static bool isInstalled();
+
+    // True if Ctrl-C was pressed since the last call; clears the flag
+    static bool consumeInterrupt();
+};
+
+// Captures Ctrl-C for the lifetime of the object
+class ScopedInterruptCapture {
+public:
+    ScopedInterruptCapture() : installed_(InterruptHandler::install()) {}
+    ~ScopedInterruptCapture() {
+        if (installed_) {
+            InterruptHandler::uninstall();
+        }
+    }
+
+    ScopedInterruptCapture(const ScopedInterruptCapture&) = delete;
+    ScopedInterruptCapture& operator=(const ScopedInterruptCapture&) = delete;
+
+private:
+    bool installed_;
+};
+
+} // namespace cli
+} // namespace clion
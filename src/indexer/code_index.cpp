@@ -2,10 +2,25 @@
 #include "clion/common.h"
 #include "../utils/file_utils.h"
 #include <regex>
+#include <mutex>
 
 namespace clion {
 namespace indexer {
 
+namespace {
+    struct CachedFileInfo {
+        uintmax_t file_size;
+        std::filesystem::file_time_type modified;
+        FileInfo info;
+    };
+
+    // Bounds memory when a large tree is indexed; the cache is simply rebuilt
+    constexpr size_t MAX_CACHED_FILES = 8192;
+
+    std::mutex cache_mutex;
+    std::unordered_map<std::string, CachedFileInfo> index_cache;
+}
+
 CodeIndex CodeIndexer::buildIndex(const std::vector<path>& files) {
     CodeIndex index;
     for (const auto& file : files) {
@@ -67,5 +82,46 @@ FileInfo CodeIndexer::indexFile(const path& file_path) {
     return file_info;
 }
 
+FileInfo CodeIndexer::indexFileCached(const path& file_path) {
+    std::error_code ec;
+    uintmax_t file_size = std::filesystem::file_size(file_path, ec);
+    if (ec) {
+        return indexFile(file_path);
+    }
+    auto modified = std::filesystem::last_write_time(file_path, ec);
+    if (ec) {
+        return indexFile(file_path);
+    }
+
+    std::string key = file_path.lexically_normal().string();
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = index_cache.find(key);
+        if (it != index_cache.end() && it->second.file_size == file_size && it->second.modified == modified) {
+            return it->second.info;
+        }
+    }
+
+    // Parse outside the lock so concurrent callers index different files in parallel
+    FileInfo file_info = indexFile(file_path);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (index_cache.size() >= MAX_CACHED_FILES) {
+        index_cache.clear();
+    }
+    index_cache[key] = CachedFileInfo{file_size, modified, file_info};
+    return file_info;
+}
+
+void CodeIndexer::clearCache() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    index_cache.clear();
+}
+
+size_t CodeIndexer::getCacheSize() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return index_cache.size();
+}
+
 } // namespace indexer
 } // namespace clion
@@ -35,6 +35,12 @@ class CodeIndexer {
 public:
     static CodeIndex buildIndex(const std::vector<path>& files);
     static FileInfo indexFile(const path& file_path);
+
+    // Like indexFile, but reuses the previous result while the file's size and
+    // modification time are unchanged. Safe to call from several threads.
+    static FileInfo indexFileCached(const path& file_path);
+    static void clearCache();
+    static size_t getCacheSize();
 };
 
 } // namespace indexer
@@ -18,7 +18,7 @@ bool PromptAnalyzer::shouldIncludeFullFile(const std::string& prompt, const std:
 
 std::string PromptAnalyzer::generateSummary(const std::string& file_path) {
     try {
-        FileInfo file_info = CodeIndexer::indexFile(file_path);
+        FileInfo file_info = CodeIndexer::indexFileCached(file_path);
         return generateFileSummary(file_info);
     } catch (const std::exception& e) {
         return "// Error generating summary for " + file_path + ": " + e.what();
@@ -41,7 +41,7 @@ RelevanceScore PromptAnalyzer::analyzeRelevance(const std::string& prompt,
         }
         
         // Get file information
-        FileInfo file_info = CodeIndexer::indexFile(file_path);
+        FileInfo file_info = CodeIndexer::indexFileCached(file_path);
         std::vector<std::string> file_terms = extractSearchableTerms(file_info, options);
         if (file_terms.empty()) {
             score.reason = "No searchable terms found in file";
@@ -1,16 +1,40 @@
 #include "context_builder.h"
+#include "telemetry.h"
+#include "session.h"
 #include "clion/common.h"
 #include "clion/memory_manager.h"
 #include "../utils/file_utils.h"
+#include "../utils/text_kernels.h"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <filesystem>
 #include <iomanip>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace clion {
 namespace llm {
 
+namespace {
+    // Formatted file contents, reused while the file is unchanged
+    struct FormattedFile {
+        uintmax_t file_size;
+        std::filesystem::file_time_type modified;
+        bool include_line_numbers;
+        std::string header_format;
+        std::string formatted;
+    };
+
+    constexpr size_t MAX_CACHED_FILES = 256;
+
+    std::mutex file_cache_mutex;
+    std::unordered_map<std::string, FormattedFile> file_cache;
+}
+
 // Regex pattern for matching @file <path> syntax
 const std::regex ContextBuilder::INCLUSION_PATTERN(R"(@file\s+([^\s\n]+))");
 
@@ -18,11 +42,13 @@ std::string ContextBuilder::buildContext(const std::string& base_prompt,
                                        const std::string& project_root,
                                        const ContextOptions& options) {
     try {
-        if (options.enable_intelligent_selection) {
-            return processInclusionsWithIntelligence(base_prompt, project_root, options);
-        } else {
-            return processInclusions(base_prompt, project_root, options);
-        }
+        auto started = std::chrono::steady_clock::now();
+        std::string context = options.enable_intelligent_selection
+            ? processInclusionsWithIntelligence(base_prompt, project_root, options)
+            : processInclusions(base_prompt, project_root, options);
+        Telemetry::recordContextBuild(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - started).count());
+        return context;
     } catch (const std::exception& e) {
         throw CLionException("Failed to build context: " + std::string(e.what()));
     }
@@ -117,6 +143,59 @@ std::string ContextBuilder::resolvePath(const std::string& path, const std::stri
 
 std::string ContextBuilder::readFileWithFormatting(const std::string& path,
                                                  const ContextOptions& options) {
+    std::error_code ec;
+    uintmax_t file_size = std::filesystem::file_size(path, ec);
+    auto modified = ec ? std::filesystem::file_time_type{} : std::filesystem::last_write_time(path, ec);
+    bool cacheable = !ec;
+    
+    if (cacheable) {
+        std::lock_guard<std::mutex> lock(file_cache_mutex);
+        auto it = file_cache.find(path);
+        if (it != file_cache.end() && it->second.file_size == file_size && it->second.modified == modified &&
+            it->second.include_line_numbers == options.include_line_numbers &&
+            it->second.header_format == options.file_header_format) {
+            return it->second.formatted;
+        }
+    }
+    
+    std::string result = formatFile(path, options);
+    
+    if (cacheable) {
+        std::lock_guard<std::mutex> lock(file_cache_mutex);
+        if (file_cache.size() >= MAX_CACHED_FILES) {
+            file_cache.clear();
+        }
+        file_cache[path] = FormattedFile{file_size, modified, options.include_line_numbers,
+                                         options.file_header_format, result};
+    }
+    return result;
+}
+
+bool ContextBuilder::warmFileCache(const std::string& file_path,
+                                   const std::string& project_root,
+                                   const ContextOptions& options) {
+    try {
+        std::string resolved_path = resolvePath(file_path, project_root);
+        if (!isPathAllowed(resolved_path, project_root) || shouldExcludeFile(resolved_path, options)) {
+            return false;
+        }
+        readFileWithFormatting(resolved_path, options);
+        if (options.enable_intelligent_selection) {
+            clion::indexer::CodeIndexer::indexFileCached(resolved_path);
+        }
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+void ContextBuilder::clearFileCache() {
+    std::lock_guard<std::mutex> lock(file_cache_mutex);
+    file_cache.clear();
+}
+
+std::string ContextBuilder::formatFile(const std::string& path,
+                                       const ContextOptions& options) {
     auto content_opt = utils::FileUtils::readFile(path);
     if (!content_opt) {
         throw FileException("Cannot read file: " + path);
@@ -135,14 +214,15 @@ std::string ContextBuilder::readFileWithFormatting(const std::string& path,
     
     // Add line numbers if requested
     if (options.include_line_numbers) {
-        std::istringstream iss(content);
-        std::string line;
         int line_num = 1;
-        
-        while (std::getline(iss, line)) {
-            result += std::to_string(line_num) + " | " + line + "\n";
+        result.reserve(result.size() + content.size() + utils::TextKernels::countByte(content, '\n') * 8);
+        utils::TextKernels::forEachLine(content, [&](std::string_view line) {
+            result += std::to_string(line_num);
+            result += " | ";
+            result.append(line.data(), line.size());
+            result += '\n';
             line_num++;
-        }
+        });
     } else {
         result += content;
         if (!content.empty() && content.back() != '\n') {
@@ -156,13 +236,7 @@ std::string ContextBuilder::readFileWithFormatting(const std::string& path,
 std::string ContextBuilder::truncateFile(const std::string& content,
                                        size_t max_size,
                                        const std::string& file_path) {
-    std::istringstream iss(content);
-    std::vector<std::string> lines;
-    std::string line;
-    
-    while (std::getline(iss, line)) {
-        lines.push_back(line);
-    }
+    std::vector<std::string_view> lines = utils::TextKernels::splitLines(content);
     
     size_t total_lines = lines.size();
     size_t keep_lines = max_size / 50; // Rough estimate: 50 chars per line
@@ -181,14 +255,18 @@ std::string ContextBuilder::truncateFile(const std::string& content,
     size_t end_lines = keep_lines - start_lines;
     
     for (size_t i = 0; i < start_lines && i < total_lines; ++i) {
-        result += std::to_string(i + 1) + " | " + lines[i] + "\n";
+        result += std::to_string(i + 1) + " | ";
+        result.append(lines[i].data(), lines[i].size());
+        result += '\n';
     }
     
     result += "\n// ... " + std::to_string(total_lines - keep_lines) +
               " lines omitted ...\n\n";
     
     for (size_t i = total_lines - end_lines; i < total_lines; ++i) {
-        result += std::to_string(i + 1) + " | " + lines[i] + "\n";
+        result += std::to_string(i + 1) + " | ";
+        result.append(lines[i].data(), lines[i].size());
+        result += '\n';
     }
     
     return result;
@@ -440,30 +518,60 @@ std::vector<std::string> ContextBuilder::findRelevantMemoryNodes(const std::stri
                                                               const ContextOptions& options,
                                                               size_t max_nodes) {
     std::vector<std::string> relevant_nodes;
+    auto addNode = [&](const std::string& node_id) {
+        if (relevant_nodes.size() < max_nodes &&
+            std::find(relevant_nodes.begin(), relevant_nodes.end(), node_id) == relevant_nodes.end()) {
+            relevant_nodes.push_back(node_id);
+        }
+    };
 
     try {
-        // Extract keywords from prompt for memory search
-        std::vector<std::string> keywords = ContextBuilder::extractKeywordsFromPrompt(prompt);
-
-        // Search for memory nodes matching keywords
-        for (const auto& keyword : keywords) {
-            auto search_results = clion::llm::MemoryManager::searchMemoryNodes(keyword, {}, max_nodes * 2);
-
-            for (const auto& node_id : search_results) {
-                if (shouldIncludeMemoryInContext(prompt, node_id, options)) {
-                    // Check if node is already in results
-                    if (std::find(relevant_nodes.begin(), relevant_nodes.end(), node_id) == relevant_nodes.end()) {
-                        relevant_nodes.push_back(node_id);
-
-                        if (relevant_nodes.size() >= max_nodes) {
-                            break;
-                        }
-                    }
+        // One nearest-neighbour query over memory nodes and session turns;
+        // a turn stands for the memory nodes made from its session
+        const int min_importance = static_cast<int>(options.min_memory_importance);
+        auto hits = SessionManager::searchSimilar(prompt, max_nodes * 4, options.min_memory_similarity);
+        std::unordered_set<std::string> sessions_seen;
+        for (const auto& hit : hits) {
+            if (relevant_nodes.size() >= max_nodes) {
+                break;
+            }
+            if (hit.source == SemanticSource::MEMORY_NODE) {
+                if (hit.importance >= min_importance) {
+                    addNode(hit.id);
                 }
+                continue;
+            }
+            if (!sessions_seen.insert(hit.id).second) {
+                continue;
             }
+            for (const auto& node_id : SessionManager::getSessionMemoryNodes(hit.id)) {
+                auto importance = SemanticIndex::memoryNodeImportance(node_id);
+                if (!importance && SessionManager::indexMemoryNode(node_id)) {
+                    importance = SemanticIndex::memoryNodeImportance(node_id);
+                }
+                if (importance && *importance >= min_importance) {
+                    addNode(node_id);
+                }
+            }
+        }
 
-            if (relevant_nodes.size() >= max_nodes) {
-                break;
+        // Until memory nodes are in the index, search them by keyword and
+        // index each one found, so later prompts find them by meaning. Nodes
+        // are otherwise indexed when created or associated with a session,
+        // and by rebuildSemanticIndex, never per prompt
+        if (relevant_nodes.empty() && SemanticIndex::size(SemanticSource::MEMORY_NODE) == 0) {
+            std::vector<std::string> keywords = ContextBuilder::extractKeywordsFromPrompt(prompt);
+            for (const auto& keyword : keywords) {
+                auto search_results = clion::llm::MemoryManager::searchMemoryNodes(keyword, {}, max_nodes * 2);
+                for (const auto& node_id : search_results) {
+                    SessionManager::indexMemoryNode(node_id);
+                    if (shouldIncludeMemoryInContext(prompt, node_id, options)) {
+                        addNode(node_id);
+                    }
+                }
+                if (relevant_nodes.size() >= max_nodes) {
+                    break;
+                }
             }
         }
 
@@ -472,9 +580,7 @@ std::vector<std::string> ContextBuilder::findRelevantMemoryNodes(const std::stri
             auto recent_nodes = clion::llm::MemoryManager::getRecentlyAccessed(max_nodes - relevant_nodes.size());
             for (const auto& node_id : recent_nodes) {
                 if (shouldIncludeMemoryInContext(prompt, node_id, options)) {
-                    if (std::find(relevant_nodes.begin(), relevant_nodes.end(), node_id) == relevant_nodes.end()) {
-                        relevant_nodes.push_back(node_id);
-                    }
+                    addNode(node_id);
                 }
             }
         }
@@ -537,7 +643,7 @@ bool ContextBuilder::shouldIncludeMemoryInContext(const std::string& prompt,
     const auto& node = *node_opt;
 
     // Check importance threshold
-    if (node.importance_score < 30) { // Minimum importance threshold
+    if (node.importance_score < static_cast<int>(options.min_memory_importance)) {
         return false;
     }
 
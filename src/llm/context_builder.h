@@ -35,6 +35,7 @@ struct ContextOptions {
     size_t max_memory_nodes = 5;
     size_t max_memory_context_size = 2000;
     size_t min_memory_importance = 30;
+    float min_memory_similarity = 0.2f;        ///< Vector index matches below this are not relevant
 };
 
 class ContextBuilder {
@@ -47,6 +48,14 @@ public:
                                         const std::string& project_root = ".",
                                         const ContextOptions& options = {});
 
+    // Reads, formats and indexes a file ahead of time so a later @file
+    // inclusion of it is served from cache. Returns false if the file would
+    // not be included (outside the project, excluded or unreadable).
+    static bool warmFileCache(const std::string& file_path,
+                              const std::string& project_root = ".",
+                              const ContextOptions& options = {});
+    static void clearFileCache();
+
 private:
     static std::string processInclusions(const std::string& prompt,
                                        const std::string& project_root,
@@ -54,6 +63,8 @@ private:
     static std::string resolvePath(const std::string& path, const std::string& project_root);
     static std::string readFileWithFormatting(const std::string& path,
                                             const ContextOptions& options);
+    static std::string formatFile(const std::string& path,
+                                  const ContextOptions& options);
     static std::string truncateFile(const std::string& content,
                                   size_t max_size,
                                   const std::string& file_path);
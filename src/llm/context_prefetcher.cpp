@@ -0,0 +1,191 @@
+#include "context_prefetcher.h"
+#include "../indexer/code_index.h"
+#include "../indexer/project_scanner.h"
+#include <algorithm>
+#include <cctype>
+#include <unordered_set>
+
+namespace clion {
+namespace llm {
+
+namespace {
+    // Upper bounds so a huge tree or a long answer cannot keep the worker busy
+    constexpr size_t MAX_PROJECT_FILES = 2000;
+    constexpr size_t MAX_CANDIDATES_PER_TEXT = 32;
+
+    bool looksLikeFilePath(const std::string& token) {
+        static const std::vector<std::string> extensions = {
+            ".cpp", ".cc", ".cxx", ".c", ".h", ".hpp", ".hh", ".hxx", ".inl",
+            ".txt", ".cmake", ".yaml", ".yml", ".json", ".md"
+        };
+        size_t dot = token.rfind('.');
+        if (dot == std::string::npos || dot == 0) {
+            return false;
+        }
+        std::string extension = token.substr(dot);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return std::find(extensions.begin(), extensions.end(), extension) != extensions.end();
+    }
+}
+
+ContextPrefetcher::ContextPrefetcher(const std::string& project_root, const ContextOptions& options)
+    : project_root_(project_root), options_(options) {
+    worker_ = std::thread(&ContextPrefetcher::run, this);
+}
+
+ContextPrefetcher::~ContextPrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        queue_.clear();
+    }
+    work_available_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void ContextPrefetcher::warmProject() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Job job;
+    job.warm_project = true;
+    queue_.push_back(job);
+    work_available_.notify_one();
+}
+
+void ContextPrefetcher::prefetch(const std::string& text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Only the newest text matters; drop older text that has not started yet
+    queue_.erase(std::remove_if(queue_.begin(), queue_.end(),
+                                [](const Job& job) { return !job.warm_project; }),
+                 queue_.end());
+    Job job;
+    job.text = text;
+    queue_.push_back(std::move(job));
+    work_available_.notify_one();
+}
+
+void ContextPrefetcher::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return queue_.empty() && !busy_; });
+}
+
+PrefetchStats ContextPrefetcher::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::vector<std::string> ContextPrefetcher::extractCandidateFiles(const std::string& text) {
+    std::vector<std::string> candidates;
+    std::unordered_set<std::string> seen;
+
+    auto add = [&](const std::string& candidate) {
+        if (candidates.size() < MAX_CANDIDATES_PER_TEXT && seen.insert(candidate).second) {
+            candidates.push_back(candidate);
+        }
+    };
+
+    // Explicit @file inclusions first, then anything that looks like a file name
+    for (const auto& inclusion : ContextBuilder::extractFileInclusions(text)) {
+        add(inclusion.file_path);
+    }
+
+    std::string token;
+    auto flush = [&]() {
+        // Trailing sentence punctuation and compiler-style :line[:col]
+        // positions are not part of the name
+        while (!token.empty()) {
+            if (token.back() == '.' || token.back() == ':') {
+                token.pop_back();
+                continue;
+            }
+            size_t colon = token.rfind(':');
+            if (colon == std::string::npos || colon + 1 == token.size() ||
+                !std::all_of(token.begin() + colon + 1, token.end(),
+                             [](char d) { return std::isdigit(static_cast<unsigned char>(d)); })) {
+                break;
+            }
+            token.erase(colon);
+        }
+        if (looksLikeFilePath(token)) {
+            add(token);
+        }
+        token.clear();
+    };
+    for (char c : text) {
+        bool path_char = std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-' ||
+                         c == '.' || c == '/' || c == ':';
+        if (path_char) {
+            token += c;
+        } else {
+            flush();
+        }
+    }
+    flush();
+
+    return candidates;
+}
+
+void ContextPrefetcher::run() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_available_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (stopping_) {
+                break;
+            }
+            job = std::move(queue_.front());
+            queue_.pop_front();
+            busy_ = true;
+        }
+
+        if (job.warm_project) {
+            indexProject();
+        } else {
+            warmText(job.text);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        busy_ = false;
+        stats_.jobs_completed++;
+        if (queue_.empty()) {
+            idle_.notify_all();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    busy_ = false;
+    idle_.notify_all();
+}
+
+void ContextPrefetcher::indexProject() {
+    std::vector<path> files;
+    try {
+        files = clion::indexer::ProjectScanner::scanProject(project_root_);
+    } catch (const std::exception&) {
+        return;  // Unreadable directories: nothing to warm
+    }
+
+    size_t limit = std::min(files.size(), MAX_PROJECT_FILES);
+    for (size_t i = 0; i < limit && !stopping_; ++i) {
+        clion::indexer::CodeIndexer::indexFileCached(files[i]);
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.project_files_indexed++;
+    }
+}
+
+void ContextPrefetcher::warmText(const std::string& text) {
+    for (const auto& candidate : extractCandidateFiles(text)) {
+        if (stopping_) {
+            return;
+        }
+        if (ContextBuilder::warmFileCache(candidate, project_root_, options_)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.files_warmed++;
+        }
+    }
+}
+
+} // namespace llm
+} // namespace clion
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "clion/common.h"
+#include "context_builder.h"
+
+namespace clion {
+namespace llm {
+
+struct PrefetchStats {
+    size_t project_files_indexed = 0;   // Files indexed by warmProject()
+    size_t files_warmed = 0;            // Files read and formatted ahead of an @file inclusion
+    size_t jobs_completed = 0;
+};
+
+// Warms ContextBuilder's file cache and the code index on a background thread
+// so that building context for the next interactive turn finds the files it
+// needs already read, formatted and indexed.
+class ContextPrefetcher {
+public:
+    explicit ContextPrefetcher(const std::string& project_root = ".",
+                               const ContextOptions& options = {});
+    ~ContextPrefetcher();
+
+    ContextPrefetcher(const ContextPrefetcher&) = delete;
+    ContextPrefetcher& operator=(const ContextPrefetcher&) = delete;
+
+    // Indexes the project's source files
+    void warmProject();
+
+    // Warms files referenced by `text`, e.g. the last prompt and its answer:
+    // @file inclusions and bare tokens naming files in the project. A newer
+    // call replaces text still waiting in the queue.
+    void prefetch(const std::string& text);
+
+    // Blocks until queued work is done; mainly for tests and benchmarks
+    void waitIdle();
+
+    PrefetchStats getStats() const;
+
+    // Candidate file paths mentioned in `text`, in order of appearance
+    static std::vector<std::string> extractCandidateFiles(const std::string& text);
+
+private:
+    struct Job {
+        bool warm_project = false;
+        std::string text;
+    };
+
+    std::string project_root_;
+    ContextOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable idle_;
+    std::deque<Job> queue_;
+    bool busy_ = false;
+    std::atomic<bool> stopping_{false};
+    PrefetchStats stats_;
+    std::thread worker_;
+
+    void run();
+    void indexProject();
+    void warmText(const std::string& text);
+};
+
+} // namespace llm
+} // namespace clion
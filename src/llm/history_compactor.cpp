@@ -0,0 +1,187 @@
+#include "history_compactor.h"
+#include "utils/token_counter.h"
+#include <algorithm>
+#include <cctype>
+
+namespace clion {
+namespace llm {
+
+namespace {
+    constexpr int MESSAGE_OVERHEAD_TOKENS = 4;     // Role and framing of one message
+    constexpr int MIN_BUDGET_TOKENS = 1024;
+    constexpr int MAX_SUMMARY_TOKENS = 2048;
+    constexpr size_t MAX_LINE_CHARS = 240;
+
+    constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+    constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+    uint64_t hashBytes(uint64_t hash, const std::string& bytes) {
+        for (unsigned char c : bytes) {
+            hash = (hash ^ c) * FNV_PRIME;
+        }
+        return (hash ^ 0xff) * FNV_PRIME;  // Separator, so "ab"+"c" differs from "a"+"bc"
+    }
+
+    uint64_t hashEntry(uint64_t hash, const HistoryEntry& entry) {
+        return hashBytes(hashBytes(hash, entry.role), entry.content);
+    }
+
+    // First sentence or two of `content` on one line, code blocks left out
+    std::string condense(const std::string& content) {
+        std::string text;
+        bool in_code = false;
+        bool pending_space = false;
+        size_t line_start = 0;
+        while (line_start < content.size() && text.size() < MAX_LINE_CHARS * 2) {
+            size_t line_end = content.find('\n', line_start);
+            if (line_end == std::string::npos) {
+                line_end = content.size();
+            }
+            size_t first = content.find_first_not_of(" \t", line_start);
+            if (first != std::string::npos && first < line_end && content.compare(first, 3, "```") == 0) {
+                if (!in_code) {
+                    text += text.empty() ? "[code]" : " [code]";
+                    pending_space = true;
+                }
+                in_code = !in_code;
+            } else if (!in_code) {
+                for (size_t i = line_start; i < line_end; ++i) {
+                    unsigned char c = static_cast<unsigned char>(content[i]);
+                    if (std::isspace(c)) {
+                        pending_space = !text.empty();
+                        continue;
+                    }
+                    if (pending_space) {
+                        text += ' ';
+                        pending_space = false;
+                    }
+                    text += static_cast<char>(c);
+                }
+                pending_space = !text.empty();
+            }
+            line_start = line_end + 1;
+        }
+
+        // Stop after the second sentence, or at a word boundary
+        size_t sentences = 0;
+        for (size_t i = 0; i < text.size() && i < MAX_LINE_CHARS; ++i) {
+            if ((text[i] == '.' || text[i] == '?' || text[i] == '!') &&
+                (i + 1 == text.size() || text[i + 1] == ' ') && ++sentences == 2) {
+                return text.substr(0, i + 1);
+            }
+        }
+        if (text.size() <= MAX_LINE_CHARS) {
+            return text;
+        }
+        size_t cut = text.rfind(' ', MAX_LINE_CHARS);
+        return text.substr(0, cut == std::string::npos || cut == 0 ? MAX_LINE_CHARS : cut) + " ...";
+    }
+}
+
+CompactionPolicy HistoryCompactor::policyFor(const std::string& model, int max_output_tokens, int budget_tokens) {
+    CompactionPolicy policy;
+    if (budget_tokens > 0) {
+        policy.budget_tokens = budget_tokens;
+    } else {
+        // Half of what the reply leaves, the rest going to the system
+        // instruction, project context and the prompt itself
+        int window = utils::TokenCounter::getContextWindow(model);
+        policy.budget_tokens = std::max(MIN_BUDGET_TOKENS, (window - max_output_tokens) / 2);
+    }
+    // Compacting a quarter below the budget leaves room for several turns
+    // before the next compaction
+    policy.target_tokens = policy.budget_tokens * 3 / 4;
+    policy.summary_tokens = std::min(MAX_SUMMARY_TOKENS, policy.budget_tokens / 8);
+    return policy;
+}
+
+size_t HistoryCompactor::chooseCut(const Session& session, size_t summarized,
+                                   const CompactionPolicy& policy, const std::string& model) {
+    const auto& entries = session.entries;
+    if (entries.size() <= policy.recent_entries || entries.size() - policy.recent_entries <= summarized) {
+        return summarized;
+    }
+
+    size_t keep_from = entries.size() - policy.recent_entries;
+    int available = policy.target_tokens - policy.summary_tokens;
+    int used = 0;
+    for (size_t i = keep_from; i < entries.size(); ++i) {
+        used += entryTokens(session, entries[i], model);
+    }
+
+    // Walk back from the newest entries while they fit; older ones are condensed
+    size_t cut = keep_from;
+    while (cut > summarized) {
+        int tokens = entryTokens(session, entries[cut - 1], model);
+        if (used + tokens > available) {
+            break;
+        }
+        used += tokens;
+        --cut;
+    }
+    while (cut < keep_from && entries[cut].role != "user") {
+        ++cut;
+    }
+    return std::max(cut, summarized);
+}
+
+void HistoryCompactor::extend(HistorySummary& summary, const Session& session, size_t cut,
+                              const CompactionPolicy& policy, const std::string& model) {
+    cut = std::min(cut, session.entries.size());
+    if (cut <= summary.entries) {
+        return;
+    }
+
+    uint64_t hash = summary.entries == 0 ? FNV_OFFSET : summary.hash;
+    for (size_t i = summary.entries; i < cut; ++i) {
+        const HistoryEntry& entry = session.entries[i];
+        hash = hashEntry(hash, entry);
+        if (entry.role == "system") {
+            continue;
+        }
+        if (!summary.text.empty()) {
+            summary.text += '\n';
+        }
+        summary.text += entry.role + ": " + condense(entry.content);
+    }
+    summary.entries = cut;
+    summary.hash = hash;
+
+    // Oldest lines give way to newer ones
+    int tokens = utils::TokenCounter::countTokensForModel(summary.text, model);
+    size_t start = 0;
+    while (tokens > policy.summary_tokens) {
+        size_t end = summary.text.find('\n', start);
+        if (end == std::string::npos) {
+            break;
+        }
+        tokens -= utils::TokenCounter::countTokensForModel(summary.text.substr(start, end - start), model);
+        start = end + 1;
+    }
+    summary.text.erase(0, start);
+}
+
+bool HistoryCompactor::matches(const HistorySummary& summary, const Session& session) {
+    if (summary.entries > session.entries.size()) {
+        return false;
+    }
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < summary.entries; ++i) {
+        hash = hashEntry(hash, session.entries[i]);
+    }
+    return summary.entries == 0 || hash == summary.hash;
+}
+
+int HistoryCompactor::messageTokens(const std::string& content, const std::string& model) {
+    return utils::TokenCounter::countTokensForModel(content, model) + MESSAGE_OVERHEAD_TOKENS;
+}
+
+int HistoryCompactor::entryTokens(const Session& session, const HistoryEntry& entry, const std::string& model) {
+    if (entry.token_count > 0 && session.token_encoding == utils::TokenCounter::getTokenizerName(model)) {
+        return static_cast<int>(entry.token_count) + MESSAGE_OVERHEAD_TOKENS;
+    }
+    return messageTokens(entry.content, model);
+}
+
+} // namespace llm
+} // namespace clion
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "clion/common.h"
+#include "session.h"
+
+namespace clion {
+namespace llm {
+
+struct CompactionPolicy {
+    int budget_tokens = 0;                     ///< History is compacted once it grows past this
+    int target_tokens = 0;                     ///< ...down to about this, summary included
+    int summary_tokens = 0;                    ///< Longest summary kept; its oldest lines go first
+    size_t recent_entries = 4;                 ///< Newest entries always sent verbatim
+};
+
+// Keeps the history sent with each session request within a token budget:
+// once it grows past the budget, the oldest entries are condensed into a
+// summary and only the recent ones are sent verbatim. The summary is built
+// locally, one line per entry, and extended rather than rebuilt as the
+// session grows, so a long session costs about the same per turn as a
+// short one.
+class HistoryCompactor {
+public:
+    // Budget from the model's context window less its output allowance, or
+    // `budget_tokens` when positive
+    static CompactionPolicy policyFor(const std::string& model, int max_output_tokens, int budget_tokens = 0);
+
+    // First entry to keep verbatim for the recent entries to fit the target
+    // next to the summary; `summarized` when nothing more can be condensed.
+    // Verbatim history starts at a user entry.
+    static size_t chooseCut(const Session& session, size_t summarized,
+                            const CompactionPolicy& policy, const std::string& model);
+
+    // Condenses entries [summary.entries, cut) into `summary`
+    static void extend(HistorySummary& summary, const Session& session, size_t cut,
+                       const CompactionPolicy& policy, const std::string& model);
+
+    // Whether `summary` still describes the session's oldest entries
+    static bool matches(const HistorySummary& summary, const Session& session);
+
+    // Tokens one history message adds to a request, framing included
+    static int messageTokens(const std::string& content, const std::string& model);
+    // Same for a session entry, reusing its stored count where the tokenizer matches
+    static int entryTokens(const Session& session, const HistoryEntry& entry, const std::string& model);
+};
+
+} // namespace llm
+} // namespace clion
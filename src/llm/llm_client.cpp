@@ -1,20 +1,182 @@
 #include "llm_client.h"
 #include "session.h"
+#include "telemetry.h"
+#include "usage_ledger.h"
 #include "clion/common.h"
 #include <nlohmann/json.hpp>
 #include <sstream>
 #include <iostream>
 #include <iomanip>
 #include <map>
+#include <chrono>
+#include <algorithm>
+#include <charconv>
+#include <string_view>
 
 using json = nlohmann::json;
 
 namespace clion {
 namespace llm {
 
-LLMClient::LLMClient() : curl_(nullptr), initialized_(false) {
+namespace {
+    using Clock = std::chrono::steady_clock;
+    
+    double elapsedMs(Clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+    
+    // Appends `value` as a quoted JSON string
+    void appendJsonString(std::string& out, std::string_view value) {
+        static const char hex[] = "0123456789abcdef";
+        out += '"';
+        size_t run_start = 0;
+        for (size_t i = 0; i < value.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(value[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;  // Copied in bulk with the rest of the run
+            }
+            out.append(value.data() + run_start, i - run_start);
+            run_start = i + 1;
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                default:
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 0xF];
+                    break;
+            }
+        }
+        out.append(value.data() + run_start, value.size() - run_start);
+        out += '"';
+    }
+    
+    void appendJsonNumber(std::string& out, float value) {
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, result.ptr);
+    }
+    
+    // SAX handler that pulls the reply text, token usage and error message out
+    // of a provider response without materializing a DOM
+    class ResponseExtractor {
+    public:
+        explicit ResponseExtractor(bool gemini)
+            : content_path_(gemini ? "/candidates/0/content/parts/0/text" : "/choices/0/message/content"),
+              total_tokens_path_(gemini ? "/usageMetadata/totalTokenCount" : "/usage/total_tokens"),
+              prompt_tokens_path_(gemini ? "/usageMetadata/promptTokenCount" : "/usage/prompt_tokens"),
+              completion_tokens_path_(gemini ? "/usageMetadata/candidatesTokenCount" : "/usage/completion_tokens"),
+              cached_tokens_path_(gemini ? "/usageMetadata/cachedContentTokenCount"
+                                         : "/usage/prompt_tokens_details/cached_tokens") {}
+        
+        std::string content;
+        uint64_t total_tokens = 0;
+        uint64_t prompt_tokens = 0;
+        uint64_t completion_tokens = 0;
+        uint64_t cached_tokens = 0;
+        bool has_error = false;
+        std::string error_message;
+        std::string parse_failure;
+        
+        bool null() { enterValue(); return true; }
+        bool boolean(bool) { enterValue(); return true; }
+        bool number_integer(json::number_integer_t value) {
+            enterValue();
+            if (value > 0) count(static_cast<uint64_t>(value));
+            return true;
+        }
+        bool number_unsigned(json::number_unsigned_t value) {
+            enterValue();
+            count(value);
+            return true;
+        }
+        bool number_float(json::number_float_t, const json::string_t&) { enterValue(); return true; }
+        bool string(json::string_t& value) {
+            enterValue();
+            if (path_ == content_path_) {
+                content = std::move(value);
+            } else if (path_ == "/error/message" || path_ == "/error") {
+                has_error = true;
+                error_message = std::move(value);
+            }
+            return true;
+        }
+        bool binary(json::binary_t&) { enterValue(); return true; }
+        
+        bool start_object(std::size_t) {
+            enterValue();
+            if (path_ == "/error") has_error = true;
+            frames_.push_back({false, 0, path_.size()});
+            return true;
+        }
+        bool key(json::string_t& name) {
+            path_.resize(frames_.back().base_length);
+            path_ += '/';
+            path_ += name;
+            return true;
+        }
+        bool end_object() { leave(); return true; }
+        bool start_array(std::size_t) {
+            enterValue();
+            frames_.push_back({true, 0, path_.size()});
+            return true;
+        }
+        bool end_array() { leave(); return true; }
+        
+        bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) {
+            parse_failure = e.what();
+            return false;
+        }
+        
+    private:
+        struct Frame {
+            bool is_array;
+            size_t next_index;
+            size_t base_length;  // Length of path_ for the container itself
+        };
+        
+        std::string path_;
+        std::vector<Frame> frames_;
+        std::string content_path_;
+        std::string total_tokens_path_;
+        std::string prompt_tokens_path_;
+        std::string completion_tokens_path_;
+        std::string cached_tokens_path_;
+        
+        void count(uint64_t value) {
+            if (path_ == total_tokens_path_) total_tokens = value;
+            else if (path_ == prompt_tokens_path_) prompt_tokens = value;
+            else if (path_ == completion_tokens_path_) completion_tokens = value;
+            else if (path_ == cached_tokens_path_) cached_tokens = value;
+        }
+        
+        // Array elements get their index appended before the value is handled
+        void enterValue() {
+            if (!frames_.empty() && frames_.back().is_array) {
+                Frame& frame = frames_.back();
+                path_.resize(frame.base_length);
+                path_ += '/';
+                path_ += std::to_string(frame.next_index++);
+            }
+        }
+        
+        void leave() {
+            path_.resize(frames_.back().base_length);
+            frames_.pop_back();
+        }
+    };
+}
+
+
+LLMClient::LLMClient() : curl_(nullptr), multi_(nullptr), initialized_(false) {
     // Initialize CURL
     curl_ = curl_easy_init();
+    multi_ = curl_multi_init();
     if (curl_) {
         setProviderDefaults();
     }
@@ -25,6 +187,9 @@ LLMClient::~LLMClient() {
     if (curl_) {
         curl_easy_cleanup(curl_);
     }
+    if (multi_) {
+        curl_multi_cleanup(multi_);
+    }
 }
 
 bool LLMClient::initialize(const LLMConfig& config) {
@@ -56,119 +221,66 @@ bool LLMClient::initialize(const std::string& api_key) {
 
 LLMResponse LLMClient::sendRequest(const std::string& prompt,
                                    const std::string& system_instruction,
-                                   float temperature) {
+                                   float temperature,
+                                   const CancellationToken& cancel_token) {
     logInfo("=== LLMClient::sendRequest START ===");
     logInfo("Request size: " + std::to_string(prompt.length()) + " chars");
     logInfo("System instruction size: " + std::to_string(system_instruction.length()) + " chars");
 
+    beginTiming();
+    RequestAnalysis analysis;
+    LLMResponse refusal;
+    if (!prepareRequest(prompt, system_instruction, analysis, refusal)) {
+        return refusal;
+    }
+    return transmitRequest(prompt, system_instruction, temperature, analysis, cancel_token);
+}
+
+bool LLMClient::prepareRequest(const std::string& prompt,
+                               const std::string& system_instruction,
+                               RequestAnalysis& analysis,
+                               LLMResponse& refusal) {
     // Analyze request before sending
-    RequestAnalysis analysis = analyzeRequest(prompt, system_instruction);
+    auto phase_start = Clock::now();
+    analysis = analyzeRequest(prompt, system_instruction);
+    timing_.tokenize_ms = elapsedMs(phase_start);
 
     logInfo("Request analysis - Input tokens: " + std::to_string(analysis.input_tokens) +
             ", Estimated output: " + std::to_string(analysis.estimated_output_tokens));
     
     // Display token usage and cost to user
-    displayTokenUsage(analysis);
-    
-    // Check if user wants to proceed
-    if (!analysis.within_limits && !userConfirmsRequest(analysis)) {
-        LLMResponse response;
-        response.error_message = "Request cancelled by user due to cost/size concerns";
-        response.success = false;
-        return response;
+    if (config_.show_token_usage) {
+        displayTokenUsage(analysis);
     }
     
-    // Proceed with original implementation
-    LLMResponse response;
-    
-    if (!initialized_) {
-        response.error_message = "LLMClient not initialized";
-        response.http_status_code = 0;
-        logError("LLMClient not initialized");
-        return response;
-    }
-    
-    if (!curl_) {
-        response.error_message = "CURL not initialized";
-        response.http_status_code = 0;
-        logError("CURL not initialized");
-        return response;
+    // Check if user wants to proceed
+    if (!analysis.within_limits && config_.confirm_over_limit && !userConfirmsRequest(analysis)) {
+        refusal.error_message = "Request cancelled by user due to cost/size concerns";
+        refusal.success = false;
+        return false;
     }
-    
+    return true;
+}
+
+LLMResponse LLMClient::transmitRequest(const std::string& prompt,
+                                       const std::string& system_instruction,
+                                       float temperature,
+                                       const RequestAnalysis& analysis,
+                                       const CancellationToken& cancel_token) {
     // Use config temperature if not specified
     float actual_temp = (temperature < 0.0f) ? config_.temperature : temperature;
     
-    // Build JSON payload
-    std::string json_payload = buildPayloadForProvider(prompt, system_instruction, actual_temp);
+    // Serialize straight into the reusable request buffer
+    auto phase_start = Clock::now();
+    buildPayloadForProvider(request_buffer_, system_instruction, nullptr, prompt, actual_temp);
+    timing_.serialize_ms = elapsedMs(phase_start);
     
-    if (config_.verbose) {
-        logInfo("Sending request to: " + getEndpoint());
-        logInfo("Payload: " + json_payload);
+    LLMResponse response = performRequest(request_buffer_, cancel_token);
+    finishTiming(response);
+    recordUsage(analysis, response, "");
+    if (config_.show_token_usage) {
+        displayActualUsage(analysis, response);
     }
-    
-    // Set up CURL options
-    std::string read_buffer;
-    std::string header_buffer;
-    curl_easy_setopt(curl_, CURLOPT_URL, getEndpoint().c_str());
-    curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, json_payload.c_str());
-    curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &read_buffer);
-    curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION, HeaderCallback);
-    curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &header_buffer);
-    
-    // Set headers
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, getAuthHeader().c_str());
-    
-    // Add OpenRouter-specific headers
-    if (config_.provider == LLMProvider::OPENROUTER) {
-        headers = curl_slist_append(headers, "HTTP-Referer: https://github.com/Shawn5cents/CLion");
-        headers = curl_slist_append(headers, "X-Title: CLion-CPP-Tool");
-    }
-    
-    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers);
-    
-    // Set timeout and other options
-    curl_easy_setopt(curl_, CURLOPT_TIMEOUT, config_.timeout_seconds);
-    curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYHOST, 2L);
-    
-    // Perform request
-    CURLcode res = curl_easy_perform(curl_);
-    
-    // Clean up headers
-    curl_slist_free_all(headers);
-    
-    if (res != CURLE_OK) {
-        response.error_message = "CURL error: " + std::string(curl_easy_strerror(res));
-        response.http_status_code = 0;
-        logError(response.error_message);
-        return response;
-    }
-    
-    // Check HTTP response code
-    long http_code = 0;
-    curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &http_code);
-    response.http_status_code = static_cast<int>(http_code);
-    
-    if (config_.verbose) {
-        logInfo("HTTP Status: " + std::to_string(http_code));
-        logInfo("Response: " + read_buffer);
-    }
-    
-    if (http_code != 200) {
-        response.error_message = "HTTP error: " + std::to_string(http_code) + " - " + read_buffer;
-        logError(response.error_message);
-        return response;
-    }
-    
-    // Store raw response
-    response.raw_response = read_buffer;
-    
-    // Parse response
-    response = parseResponseForProvider(read_buffer);
 
     logInfo("=== LLMClient::sendRequest END ===");
     logInfo("Response success: " + std::string(response.success ? "true" : "false"));
@@ -181,10 +293,32 @@ LLMResponse LLMClient::sendRequest(const std::string& prompt,
     return response;
 }
 
+std::future<LLMResponse> LLMClient::sendRequestAsync(const std::string& prompt,
+                                                     const std::string& system_instruction,
+                                                     float temperature,
+                                                     const CancellationToken& cancel_token) {
+    // Token analysis and the over-limit confirmation run here, so only the
+    // calling thread ever reads stdin
+    beginTiming();
+    RequestAnalysis analysis;
+    LLMResponse refusal;
+    if (!prepareRequest(prompt, system_instruction, analysis, refusal)) {
+        std::promise<LLMResponse> refused;
+        refused.set_value(std::move(refusal));
+        return refused.get_future();
+    }
+
+    // Arguments are copied so callers may release them while the request runs
+    return std::async(std::launch::async, [this, prompt, system_instruction, temperature, analysis, cancel_token]() {
+        return transmitRequest(prompt, system_instruction, temperature, analysis, cancel_token);
+    });
+}
+
 LLMResponse LLMClient::sendRequestWithSession(const std::string& prompt,
                                               const std::string& session_id,
                                               const std::string& system_instruction,
-                                              float temperature) {
+                                              float temperature,
+                                              const CancellationToken& cancel_token) {
     logInfo("=== LLMClient::sendRequestWithSession START ===");
     logInfo("Input session_id: '" + session_id + "', current_session_id_: '" + current_session_id_ + "'");
 
@@ -206,91 +340,70 @@ LLMResponse LLMClient::sendRequestWithSession(const std::string& prompt,
         }
     }
     
-    // Load session history
-    auto session_opt = SessionManager::loadSession(target_session_id);
-    if (!session_opt) {
+    // Bring the serialized history up to date; only entries added since the
+    // cache was written are serialized, and the session file is not parsed at all
+    // when the cache is current. Past its token budget the oldest turns are
+    // replaced by a summary.
+    beginTiming();
+    auto phase_start = Clock::now();
+    if (!refreshHistoryCache(target_session_id)) {
         LLMResponse response;
         response.error_message = "Failed to load session: " + target_session_id;
         response.success = false;
         return response;
     }
     
-    const Session& session = *session_opt;
-    
-    // Build conversation context
-    std::string enhanced_prompt;
-    json messages = json::array();
+    float actual_temp = (temperature < 0.0f) ? config_.temperature : temperature;
     
-    // Add system instruction if provided
-    if (!system_instruction.empty()) {
-        messages.push_back({
-            {"role", "system"},
-            {"content", system_instruction}
-        });
-    }
+    buildPayloadForProvider(request_buffer_, system_instruction, &history_cache_.messages, prompt, actual_temp);
+    timing_.serialize_ms = elapsedMs(phase_start);
     
-    // Add conversation history
-    for (const auto& entry : session.entries) {
-        messages.push_back({
-            {"role", entry.role},
-            {"content", entry.content}
-        });
+    // Estimated only for the usage ledger; history tokens are kept with the cache
+    RequestAnalysis analysis{};
+    if (UsageLedger::isEnabled()) {
+        phase_start = Clock::now();
+        analysis = analyzeRequest(prompt, system_instruction, 0, history_cache_.tokens);
+        timing_.tokenize_ms = elapsedMs(phase_start);
     }
     
-    // Add current user message
-    messages.push_back({
-        {"role", "user"},
-        {"content", prompt}
-    });
+    // Send request with conversation context
+    LLMResponse response = performRequest(request_buffer_, cancel_token);
     
-    // Save user message to session
-    SessionManager::addEntryToSession(target_session_id, "user", prompt);
-    
-    // Build JSON payload with conversation history
-    json payload;
-    if (config_.provider == LLMProvider::OPENROUTER ||
-        config_.provider == LLMProvider::REQUESTY_AI ||
-        config_.provider == LLMProvider::OPENAI ||
-        config_.provider == LLMProvider::CUSTOM) {
-        payload["model"] = config_.model;
-        payload["messages"] = messages;
-        payload["temperature"] = (temperature < 0.0f) ? config_.temperature : temperature;
-        payload["max_tokens"] = config_.max_tokens;
-        payload["stream"] = false;
-    } else if (config_.provider == LLMProvider::GEMINI) {
-        // Convert messages to Gemini format
-        if (!system_instruction.empty()) {
-            payload["systemInstruction"] = {
-                {"parts", {{"text", system_instruction}}}
-            };
+    // The turn is written only once it has an answer, so a cancelled or
+    // failed request leaves nothing behind for the next request to resend
+    if (response.success) {
+        logInfo("Saving turn to session: " + target_session_id);
+        // The cache only stays valid if each append went on top of the
+        // version it reflects; another writer's entry in between drops it
+        std::optional<SessionAppend> append;
+        bool cache_in_sync = SessionManager::addEntryToSession(target_session_id, "user", prompt, config_.model, &append) &&
+                             append && append->before == history_cache_.stamp;
+        if (cache_in_sync) {
+            appendHistoryMessage(history_cache_.messages, "user", prompt);
+            history_cache_.entry_count++;
+            history_cache_.tokens += HistoryCompactor::messageTokens(prompt, config_.model);
+            history_cache_.stamp = append->after;
         }
-        
-        json contents = json::array();
-        for (const auto& message : messages) {
-            if (message["role"] == "system") continue; // Skip system messages for Gemini
-            
-            contents.push_back({
-                {"parts", {{"text", message["content"]}}}
-            });
+        if (!response.content.empty()) {
+            bool saved = SessionManager::addEntryToSession(target_session_id, "assistant", response.content,
+                                                           config_.model, &append);
+            cache_in_sync = cache_in_sync && saved && append && append->before == history_cache_.stamp;
+            if (cache_in_sync) {
+                appendHistoryMessage(history_cache_.messages, "assistant", response.content);
+                history_cache_.entry_count++;
+                history_cache_.tokens += HistoryCompactor::messageTokens(response.content, config_.model);
+                history_cache_.stamp = append->after;
+            }
         }
-        payload["contents"] = contents;
         
-        payload["generationConfig"] = {
-            {"temperature", (temperature < 0.0f) ? config_.temperature : temperature},
-            {"topK", 40},
-            {"topP", 0.95},
-            {"maxOutputTokens", config_.max_tokens}
-        };
-    }
-    
-    // Send request with conversation context
-    LLMResponse response = sendJsonPayload(payload.dump());
-    
-    // Save assistant response to session if successful
-    if (response.success && !response.content.empty()) {
-        logInfo("Saving assistant response to session: " + target_session_id);
-        SessionManager::addEntryToSession(target_session_id, "assistant", response.content);
+        if (cache_in_sync) {
+            SessionManager::savePayloadCache(history_cache_);
+        } else {
+            history_cache_ = SessionPayloadCache{};
+        }
     }
+    finishTiming(response);
+    recordUsage(analysis, response, target_session_id);
 
     logInfo("=== LLMClient::sendRequestWithSession END ===");
     logInfo("Final session_id: '" + target_session_id + "', current_session_id_: '" + current_session_id_ + "'");
@@ -298,7 +411,129 @@ LLMResponse LLMClient::sendRequestWithSession(const std::string& prompt,
     return response;
 }
 
-LLMResponse LLMClient::sendJsonPayload(const std::string& json_payload) {
+bool LLMClient::refreshHistoryCache(const std::string& session_id) {
+    std::string format = config_.provider == LLMProvider::GEMINI ? "gemini" : "openai";
+    auto stamp = SessionManager::getSessionStamp(session_id);
+    if (!stamp) {
+        return false;
+    }
+    
+    auto is_current = [&](const SessionPayloadCache& cache) {
+        return cache.session_id == session_id && cache.format == format && cache.stamp == *stamp;
+    };
+    
+    bool current = is_current(history_cache_);
+    if (!current) {
+        SessionPayloadCache disk_cache;
+        if (SessionManager::loadPayloadCache(session_id, format, disk_cache) && is_current(disk_cache)) {
+            history_cache_ = std::move(disk_cache);
+            logInfo("Using cached history for session " + session_id);
+            current = true;
+        }
+    }
+    
+    // Session changed outside this client, or no cache yet: rebuild from the file
+    std::optional<Session> session_opt;
+    HistorySummary summary;
+    if (!current) {
+        session_opt = SessionManager::loadSession(session_id);
+        if (!session_opt) {
+            return false;
+        }
+        if (!SessionManager::loadHistorySummary(session_id, summary) ||
+            !HistoryCompactor::matches(summary, *session_opt)) {
+            summary = HistorySummary{};
+        }
+        history_cache_ = SessionPayloadCache{};
+        history_cache_.session_id = session_id;
+        history_cache_.format = format;
+        history_cache_.stamp = *stamp;
+        serializeHistory(*session_opt, summary);
+    }
+    
+    auto policy = HistoryCompactor::policyFor(config_.model, config_.max_tokens, config_.history_token_budget);
+    if (history_cache_.tokens <= policy.budget_tokens) {
+        return true;
+    }
+    if (!session_opt) {
+        session_opt = SessionManager::loadSession(session_id);
+        if (!session_opt) {
+            return true;  // Sent uncompacted
+        }
+        // The summary the cache was built from; without it condensing starts over
+        if (!SessionManager::loadHistorySummary(session_id, summary) ||
+            summary.entries != history_cache_.summarized_entries) {
+            summary = HistorySummary{};
+        }
+    }
+    compactHistory(*session_opt, std::move(summary), policy);
+    return true;
+}
+
+void LLMClient::serializeHistory(const Session& session, const HistorySummary& summary) {
+    history_cache_.messages.clear();
+    history_cache_.entry_count = session.entries.size();
+    history_cache_.summarized_entries = summary.entries;
+    history_cache_.tokens = 0;
+    if (summary.entries > 0) {
+        appendSummaryMessage(history_cache_.messages, summary.text);
+        history_cache_.tokens += HistoryCompactor::messageTokens(summary.text, config_.model);
+    }
+    for (size_t i = summary.entries; i < session.entries.size(); ++i) {
+        const auto& entry = session.entries[i];
+        appendHistoryMessage(history_cache_.messages, entry.role, entry.content);
+        history_cache_.tokens += HistoryCompactor::entryTokens(session, entry, config_.model);
+    }
+}
+
+void LLMClient::compactHistory(const Session& session, HistorySummary summary, const CompactionPolicy& policy) {
+    size_t cut = HistoryCompactor::chooseCut(session, summary.entries, policy, config_.model);
+    if (cut <= summary.entries) {
+        serializeHistory(session, summary);
+        return;
+    }
+    HistoryCompactor::extend(summary, session, cut, policy, config_.model);
+    SessionManager::saveHistorySummary(session.id, summary);
+    serializeHistory(session, summary);
+    logInfo("Summarized " + std::to_string(summary.entries) + " of " + std::to_string(session.entries.size()) +
+            " history entries; history now " + std::to_string(history_cache_.tokens) + " tokens");
+}
+
+void LLMClient::appendSummaryMessage(std::string& out, const std::string& summary) const {
+    std::string content = "Summary of the earlier conversation:\n" + summary;
+    if (config_.provider == LLMProvider::GEMINI) {
+        // Gemini has no system turns in contents; the acknowledgement keeps
+        // user and model turns alternating
+        appendHistoryMessage(out, "user", content);
+        appendHistoryMessage(out, "assistant", "Understood.");
+        return;
+    }
+    appendHistoryMessage(out, "system", content);
+}
+
+void LLMClient::appendHistoryMessage(std::string& out, const std::string& role, const std::string& content) const {
+    if (config_.provider == LLMProvider::GEMINI) {
+        if (role == "system") {
+            return;  // Carried by systemInstruction
+        }
+        if (!out.empty()) out += ',';
+        out += "{\"role\":";
+        appendJsonString(out, role == "assistant" ? "model" : "user");
+        out += ",\"parts\":[{\"text\":";
+        appendJsonString(out, content);
+        out += "}]}";
+        return;
+    }
+    
+    if (!out.empty()) out += ',';
+    out += "{\"role\":";
+    appendJsonString(out, role);
+    out += ",\"content\":";
+    appendJsonString(out, content);
+    out += '}';
+}
+
+LLMResponse LLMClient::performRequest(const std::string& json_payload, const CancellationToken& cancel_token) {
     LLMResponse response;
     
     if (!initialized_) {
@@ -320,17 +555,18 @@ LLMResponse LLMClient::sendJsonPayload(const std::string& json_payload) {
         logInfo("Payload: " + json_payload);
     }
     
-    // Set up CURL options
-    std::string read_buffer;
-    std::string header_buffer;
-    logInfo("Setting up CURL buffers - read_buffer capacity: " + std::to_string(read_buffer.capacity()) +
-            ", header_buffer capacity: " + std::to_string(header_buffer.capacity()));
-    curl_easy_setopt(curl_, CURLOPT_URL, getEndpoint().c_str());
-    curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, json_payload.c_str());
+    // Reuse the response buffers; clear() keeps their capacity across requests
+    response_buffer_.clear();
+    header_buffer_.clear();
+    
+    std::string endpoint = getEndpoint();
+    curl_easy_setopt(curl_, CURLOPT_URL, endpoint.c_str());
+    curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, json_payload.data());
+    curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(json_payload.size()));
     curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &read_buffer);
+    curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &response_buffer_);
     curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION, HeaderCallback);
-    curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &header_buffer);
+    curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &header_buffer_);
     
     // Set headers
     struct curl_slist* headers = nullptr;
@@ -350,15 +586,36 @@ LLMResponse LLMClient::sendJsonPayload(const std::string& json_payload) {
     curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1L);
     curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYPEER, 1L);
     curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYHOST, 2L);
+    curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
+    
+    // Progress callback stops the transfer once the token is cancelled
+    curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl_, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
+    curl_easy_setopt(curl_, CURLOPT_XFERINFODATA, &cancel_token);
+    {
+        std::lock_guard<std::mutex> lock(active_token_mutex_);
+        active_token_ = cancel_token;
+    }
     
     // Perform request
     logInfo("Performing CURL request...");
-    CURLcode res = curl_easy_perform(curl_);
+    CURLcode res = runTransfer(cancel_token);
+    captureTransferTimings();
+    timing_.request_bytes = json_payload.size();
+    timing_.response_bytes = response_buffer_.size();
 
     // Clean up headers
-    logInfo(std::string("Cleaning up headers, headers pointer: ") + (headers ? "valid" : "nullptr"));
     curl_slist_free_all(headers);
+    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, nullptr);
 
+    if (res == CURLE_ABORTED_BY_CALLBACK) {
+        response.cancelled = true;
+        response.error_message = "Request cancelled";
+        response.http_status_code = 0;
+        logInfo(response.error_message);
+        return response;
+    }
+    
     if (res != CURLE_OK) {
         response.error_message = "CURL error: " + std::string(curl_easy_strerror(res));
         response.http_status_code = 0;
@@ -369,30 +626,97 @@ LLMResponse LLMClient::sendJsonPayload(const std::string& json_payload) {
     // Check HTTP response code
     long http_code = 0;
     curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &http_code);
-    response.http_status_code = static_cast<int>(http_code);
     
     if (config_.verbose) {
         logInfo("HTTP Status: " + std::to_string(http_code));
-        logInfo("Response: " + read_buffer);
+        logInfo("Response: " + response_buffer_);
     }
     
     if (http_code != 200) {
-        response.error_message = "HTTP error: " + std::to_string(http_code) + " - " + read_buffer;
+        response.http_status_code = static_cast<int>(http_code);
+        response.error_message = "HTTP error: " + std::to_string(http_code) + " - " + response_buffer_;
+        response.raw_response = response_buffer_;
         logError(response.error_message);
         return response;
     }
     
-    // Store raw response
-    response.raw_response = read_buffer;
-    logInfo("Raw response size: " + std::to_string(read_buffer.length()) + " bytes");
-    logInfo("Response buffer capacity: " + std::to_string(read_buffer.capacity()));
+    logInfo("Raw response size: " + std::to_string(response_buffer_.length()) + " bytes");
 
     // Parse response
     logInfo("Parsing response for provider: " + getProviderName(config_.provider));
-    response = parseResponseForProvider(read_buffer);
+    auto parse_start = Clock::now();
+    response = parseResponseForProvider(response_buffer_);
+    timing_.parse_ms = elapsedMs(parse_start);
+    response.http_status_code = static_cast<int>(http_code);
+    recordCacheUsage(response);
     return response;
 }
 
+void LLMClient::beginTiming() {
+    timing_ = RequestTiming{};
+    request_started_ = Clock::now();
+}
+
+void LLMClient::captureTransferTimings() {
+    curl_off_t name_lookup = 0, connect = 0, app_connect = 0, start_transfer = 0, total = 0;
+    curl_easy_getinfo(curl_, CURLINFO_NAMELOOKUP_TIME_T, &name_lookup);
+    curl_easy_getinfo(curl_, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl_, CURLINFO_APPCONNECT_TIME_T, &app_connect);
+    curl_easy_getinfo(curl_, CURLINFO_STARTTRANSFER_TIME_T, &start_transfer);
+    curl_easy_getinfo(curl_, CURLINFO_TOTAL_TIME_T, &total);
+    
+    // libcurl reports cumulative microseconds since the transfer started;
+    // convert to disjoint phases. Reused connections report zero for setup.
+    auto ms = [](curl_off_t microseconds) { return std::max<curl_off_t>(microseconds, 0) / 1000.0; };
+    curl_off_t connected = app_connect > 0 ? app_connect : connect;
+    timing_.dns_ms = ms(name_lookup);
+    timing_.connect_ms = ms(connect - name_lookup);
+    timing_.tls_ms = app_connect > 0 ? ms(app_connect - connect) : 0.0;
+    timing_.ttfb_ms = start_transfer > 0 ? ms(start_transfer - connected) : 0.0;
+    timing_.transfer_ms = start_transfer > 0 ? ms(total - start_transfer) : 0.0;
+}
+
+void LLMClient::finishTiming(const LLMResponse& response) {
+    if (!Telemetry::isEnabled()) {
+        return;
+    }
+    timing_.total_ms = elapsedMs(request_started_);
+    timing_.context_build_ms = Telemetry::takePendingContextBuild();
+    timing_.provider = getProviderName(config_.provider);
+    timing_.model = config_.model;
+    timing_.success = response.success;
+    timing_.http_status = response.http_status_code;
+    timing_.prompt_tokens = response.prompt_tokens;
+    timing_.completion_tokens = response.completion_tokens;
+    timing_.cached_tokens = response.cached_tokens;
+    Telemetry::record(timing_);
+}
+
+bool LLMClient::needsExplicitCacheControl() const {
+    // Anthropic models only cache prefixes marked with cache_control; OpenAI,
+    // DeepSeek and Gemini cache repeated prefixes automatically
+    if (!config_.enable_prompt_caching || config_.provider == LLMProvider::GEMINI) {
+        return false;
+    }
+    std::string model = config_.model;
+    std::transform(model.begin(), model.end(), model.begin(), ::tolower);
+    return model.find("claude") != std::string::npos || model.find("anthropic") != std::string::npos;
+}
+
+void LLMClient::recordCacheUsage(const LLMResponse& response) {
+    if (!response.success) {
+        return;
+    }
+    cache_stats_.requests++;
+    cache_stats_.prompt_tokens += static_cast<uint64_t>(response.prompt_tokens);
+    cache_stats_.cached_tokens += static_cast<uint64_t>(response.cached_tokens);
+    if (response.cached_tokens > 0) {
+        cache_stats_.cache_hits++;
+        logInfo("Prompt cache hit: " + std::to_string(response.cached_tokens) + " of " +
+                std::to_string(response.prompt_tokens) + " prompt tokens cached");
+    }
+}
+
 size_t LLMClient::WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
     size_t total_size = size * nmemb;
     std::string* response = static_cast<std::string*>(userp);
@@ -407,6 +731,63 @@ size_t LLMClient::HeaderCallback(void* contents, size_t size, size_t nmemb, void
     return total_size;
 }
 
+CURLcode LLMClient::runTransfer(const CancellationToken& cancel_token) {
+    if (cancel_token.isCancelled()) {
+        return CURLE_ABORTED_BY_CALLBACK;
+    }
+    if (!multi_) {
+        return curl_easy_perform(curl_);
+    }
+    
+    // Drive the transfer through the multi interface so cancellation is seen
+    // within one poll interval; the progress callback only runs about once a
+    // second while waiting on a slow server
+    const int CANCEL_POLL_MS = 50;
+    curl_multi_add_handle(multi_, curl_);
+    
+    CURLcode result = CURLE_OK;
+    int running = 1;
+    while (running > 0) {
+        if (curl_multi_perform(multi_, &running) != CURLM_OK) {
+            result = CURLE_FAILED_INIT;
+            break;
+        }
+        if (running == 0) {
+            break;
+        }
+        if (cancel_token.isCancelled()) {
+            result = CURLE_ABORTED_BY_CALLBACK;
+            break;
+        }
+        curl_multi_poll(multi_, nullptr, 0, CANCEL_POLL_MS, nullptr);
+    }
+    
+    if (running == 0) {
+        int queued = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi_, &queued)) {
+            if (message->msg == CURLMSG_DONE && message->easy_handle == curl_) {
+                result = message->data.result;
+            }
+        }
+    }
+    
+    curl_multi_remove_handle(multi_, curl_);
+    return result;
+}
+
+int LLMClient::ProgressCallback(void* clientp, curl_off_t /* dltotal */, curl_off_t /* dlnow */,
+                                curl_off_t /* ultotal */, curl_off_t /* ulnow */) {
+    auto* token = static_cast<const CancellationToken*>(clientp);
+    // Any non-zero return makes libcurl abort with CURLE_ABORTED_BY_CALLBACK
+    return token->isCancelled() ? 1 : 0;
+}
+
+void LLMClient::abortRequest() {
+    // Cancelling a finished request's token is harmless; each request gets its own
+    std::lock_guard<std::mutex> lock(active_token_mutex_);
+    active_token_.cancel();
+}
+
 void LLMClient::setProvider(LLMProvider provider) {
     config_.provider = provider;
     setProviderDefaults();
@@ -514,6 +895,12 @@ void LLMClient::setProviderDefaults() {
 }
 
 std::string LLMClient::getEndpoint() const {
+    // An explicit endpoint overrides the provider default, which lets any
+    // provider's wire format be pointed at a proxy or a local mock server
+    if (!config_.custom_endpoint.empty()) {
+        return config_.custom_endpoint;
+    }
+    
     switch (config_.provider) {
         case LLMProvider::OPENROUTER:
             return "https://openrouter.ai/api/v1/chat/completions";
@@ -551,157 +938,108 @@ std::string LLMClient::getAuthHeader() const {
     return header;
 }
 
-std::string LLMClient::buildPayloadForProvider(const std::string& prompt,
-                                              const std::string& system_instruction,
-                                              float temperature) const {
-    json payload;
-    
-    if (config_.provider == LLMProvider::OPENROUTER ||
-        config_.provider == LLMProvider::REQUESTY_AI ||
-        config_.provider == LLMProvider::OPENAI) {
-        // OpenAI-compatible format
-        payload["model"] = config_.model;
-        
-        // Add messages array
-        json messages = json::array();
-        
-        // Add system instruction if provided
-        if (!system_instruction.empty()) {
-            messages.push_back({
-                {"role", "system"},
-                {"content", system_instruction}
-            });
-        }
-        
-        // Add user message
-        messages.push_back({
-            {"role", "user"},
-            {"content", prompt}
-        });
-        
-        payload["messages"] = messages;
-        payload["temperature"] = temperature;
-        payload["max_tokens"] = config_.max_tokens;
-        payload["stream"] = false;
-    }
-    else if (config_.provider == LLMProvider::GEMINI) {
+void LLMClient::buildPayloadForProvider(std::string& out,
+                                        const std::string& system_instruction,
+                                        const std::string* history_messages,
+                                        const std::string& prompt,
+                                        float temperature) const {
+    out.clear();
+    size_t history_bytes = history_messages ? history_messages->size() : 0;
+    out.reserve(system_instruction.size() + history_bytes + prompt.size() + 256);
+    
+    // appendHistoryMessage() comma-separates non-empty output, so single
+    // messages are built in `turn` and then spliced in
+    std::string turn;
+    
+    if (config_.provider == LLMProvider::GEMINI) {
         // Gemini format
+        out += '{';
         if (!system_instruction.empty()) {
-            payload["systemInstruction"] = {
-                {"parts", {{"text", system_instruction}}}
-            };
+            out += "\"systemInstruction\":{\"parts\":[{\"text\":";
+            appendJsonString(out, system_instruction);
+            out += "}]},";
         }
         
-        payload["contents"] = json::array({
-            {
-                {"parts", {{"text", prompt}}}
-            }
-        });
-        
-        payload["generationConfig"] = {
-            {"temperature", temperature},
-            {"topK", 40},
-            {"topP", 0.95},
-            {"maxOutputTokens", config_.max_tokens}
-        };
-    }
-    else if (config_.provider == LLMProvider::CUSTOM) {
-        // Default to OpenAI format for custom providers
-        payload["model"] = config_.model;
-        
-        json messages = json::array();
-        if (!system_instruction.empty()) {
-            messages.push_back({
-                {"role", "system"},
-                {"content", system_instruction}
-            });
+        out += "\"contents\":[";
+        if (history_bytes > 0) {
+            out += *history_messages;
+            out += ',';
         }
-        messages.push_back({
-            {"role", "user"},
-            {"content", prompt}
-        });
-        payload["messages"] = messages;
+        appendHistoryMessage(turn, "user", prompt);
+        out += turn;
+        out += "],";
         
-        payload["temperature"] = temperature;
-        payload["max_tokens"] = config_.max_tokens;
-        payload["stream"] = false;
+        out += "\"generationConfig\":{\"temperature\":";
+        appendJsonNumber(out, temperature);
+        out += ",\"topK\":40,\"topP\":0.95,\"maxOutputTokens\":";
+        out += std::to_string(config_.max_tokens);
+        out += "}}";
+        return;
     }
     
-    return payload.dump();
+    // OpenAI-compatible format (OpenRouter, Requesty AI, OpenAI and custom providers)
+    out += "{\"model\":";
+    appendJsonString(out, config_.model);
+    out += ",\"messages\":[";
+    if (!system_instruction.empty()) {
+        if (needsExplicitCacheControl()) {
+            // Content-part form lets the stable system prefix carry a cache breakpoint
+            out += "{\"role\":\"system\",\"content\":[{\"type\":\"text\",\"text\":";
+            appendJsonString(out, system_instruction);
+            out += ",\"cache_control\":{\"type\":\"ephemeral\"}}]},";
+        } else {
+            appendHistoryMessage(turn, "system", system_instruction);
+            out += turn;
+            out += ',';
+            turn.clear();
+        }
+    }
+    if (history_bytes > 0) {
+        out += *history_messages;
+        out += ',';
+    }
+    appendHistoryMessage(turn, "user", prompt);
+    out += turn;
+    out += "],\"temperature\":";
+    appendJsonNumber(out, temperature);
+    out += ",\"max_tokens\":";
+    out += std::to_string(config_.max_tokens);
+    out += ",\"stream\":false}";
 }
 
 LLMResponse LLMClient::parseResponseForProvider(const std::string& json_response) const {
     LLMResponse response;
     
-    try {
-        json j = json::parse(json_response);
-        
-        // Check for errors (common across providers)
-        if (j.contains("error")) {
-            if (j["error"].contains("message")) {
-                response.error_message = j["error"]["message"];
-            } else {
-                response.error_message = j["error"].dump();
-            }
-            logError("API Error: " + response.error_message);
-            return response;
-        }
-        
-        switch (config_.provider) {
-            case LLMProvider::OPENROUTER:
-            case LLMProvider::REQUESTY_AI:
-            case LLMProvider::OPENAI:
-            case LLMProvider::CUSTOM:
-                // OpenAI-compatible format
-                if (j.contains("choices") && !j["choices"].empty()) {
-                    const auto& choice = j["choices"][0];
-                    if (choice.contains("message") && choice["message"].contains("content")) {
-                        response.content = choice["message"]["content"];
-                        response.success = true;
-                    }
-                }
-                
-                // Extract usage metadata
-                if (j.contains("usage")) {
-                    if (j["usage"].contains("total_tokens")) {
-                        response.tokens_used = j["usage"]["total_tokens"];
-                    }
-                }
-                break;
-                
-            case LLMProvider::GEMINI:
-                // Gemini format
-                if (j.contains("candidates") && !j["candidates"].empty()) {
-                    const auto& candidate = j["candidates"][0];
-                    if (candidate.contains("content") &&
-                        candidate["content"].contains("parts") &&
-                        !candidate["content"]["parts"].empty()) {
-                        response.content = candidate["content"]["parts"][0]["text"];
-                        response.success = true;
-                    }
-                }
-                
-                // Extract usage metadata
-                if (j.contains("usageMetadata")) {
-                    if (j["usageMetadata"].contains("totalTokenCount")) {
-                        response.tokens_used = j["usageMetadata"]["totalTokenCount"];
-                    }
-                }
-                break;
-        }
-        
-        if (response.content.empty()) {
-            response.error_message = "No content found in response";
-            response.success = false;
-            logError("No content found in response: " + json_response);
-        } else {
-            logInfo("Successfully parsed response, tokens used: " + std::to_string(response.tokens_used));
-        }
-        
-    } catch (const json::exception& e) {
-        response.error_message = "JSON parsing error: " + std::string(e.what());
-        response.success = false;
+    ResponseExtractor extractor(config_.provider == LLMProvider::GEMINI);
+    bool parsed = json::sax_parse(json_response, &extractor);
+    
+    if (!parsed) {
+        response.error_message = "JSON parsing error: " + extractor.parse_failure;
+        response.raw_response = json_response;
         logError(response.error_message);
+        return response;
+    }
+    
+    // Check for errors (common across providers)
+    if (extractor.has_error) {
+        response.error_message = extractor.error_message.empty() ? json_response : extractor.error_message;
+        logError("API Error: " + response.error_message);
+        return response;
+    }
+    
+    response.content = std::move(extractor.content);
+    response.tokens_used = static_cast<int>(extractor.total_tokens);
+    response.prompt_tokens = static_cast<int>(extractor.prompt_tokens);
+    response.completion_tokens = static_cast<int>(extractor.completion_tokens);
+    response.cached_tokens = static_cast<int>(extractor.cached_tokens);
+    response.success = !response.content.empty();
+    
+    if (response.content.empty()) {
+        response.error_message = "No content found in response";
+        response.raw_response = json_response;
+        logError("No content found in response: " + json_response);
+    } else {
+        logInfo("Successfully parsed response, tokens used: " + std::to_string(response.tokens_used));
     }
     
     return response;
@@ -722,7 +1060,8 @@ void LLMClient::logInfo(const std::string& message) const {
 // Token analysis methods implementation
 LLMClient::RequestAnalysis LLMClient::analyzeRequest(const std::string& prompt,
                                                     const std::string& system_instruction,
-                                                    int max_output_tokens) {
+                                                    int max_output_tokens,
+                                                    int context_tokens) {
     RequestAnalysis analysis;
     
     // Calculate input tokens
@@ -731,21 +1070,20 @@ LLMClient::RequestAnalysis LLMClient::analyzeRequest(const std::string& prompt,
         full_input = system_instruction + "\n\n" + prompt;
     }
     
-    analysis.input_tokens = utils::TokenCounter::countTokens(full_input);
+    analysis.input_tokens = utils::TokenCounter::countTokensForModel(full_input, config_.model) + context_tokens;
     analysis.estimated_output_tokens = max_output_tokens > 0 ?
                                      max_output_tokens :
                                      std::min(analysis.input_tokens / 2, config_.max_tokens);
     analysis.model = config_.model;
     
-    // Calculate costs
+    // Calculate costs from the count above rather than tokenizing again
     analysis.usage_details = utils::TokenCounter::calculateUsage(
-        full_input, config_.model, analysis.estimated_output_tokens);
+        analysis.input_tokens, config_.model, analysis.estimated_output_tokens);
     analysis.estimated_cost = analysis.usage_details.total_cost;
     
     // Check limits
-    utils::ModelPricing pricing = utils::TokenCounter::getModelPricing(config_.model);
     int total_tokens = analysis.input_tokens + analysis.estimated_output_tokens;
-    analysis.within_limits = total_tokens <= pricing.max_context_tokens;
+    analysis.within_limits = total_tokens <= utils::TokenCounter::getContextWindow(config_.model);
     
     return analysis;
 }
@@ -768,6 +1106,40 @@ void LLMClient::displayTokenUsage(const RequestAnalysis& analysis) {
     std::cout << "=============================" << std::endl;
 }
 
+void LLMClient::displayActualUsage(const RequestAnalysis& analysis, const LLMResponse& response) {
+    if (!response.success || response.prompt_tokens <= 0) {
+        return;
+    }
+    double actual_cost = utils::TokenCounter::estimateCost(response.prompt_tokens, response.completion_tokens, config_.model);
+    double error = analysis.input_tokens > 0 ?
+                   100.0 * (analysis.input_tokens - response.prompt_tokens) / response.prompt_tokens : 0.0;
+    std::cout << "Actual tokens: " << response.prompt_tokens << " input (estimate "
+              << std::showpos << std::fixed << std::setprecision(1) << error << std::noshowpos << "%), "
+              << response.completion_tokens << " output, cost $" << std::setprecision(6) << actual_cost << std::endl;
+}
+
+void LLMClient::recordUsage(const RequestAnalysis& analysis, const LLMResponse& response, const std::string& session_id) {
+    if (!UsageLedger::isEnabled()) {
+        return;
+    }
+    UsageRecord record;
+    record.session_id = session_id;
+    record.provider = getProviderName(config_.provider);
+    record.model = config_.model;
+    record.success = response.success;
+    record.estimated_input_tokens = analysis.input_tokens;
+    record.estimated_output_tokens = analysis.estimated_output_tokens;
+    record.prompt_tokens = response.prompt_tokens;
+    record.completion_tokens = response.completion_tokens;
+    record.cached_tokens = response.cached_tokens;
+    record.estimated_cost = analysis.estimated_cost;
+    record.actual_cost = utils::TokenCounter::estimateCost(response.prompt_tokens, response.completion_tokens, config_.model);
+    record.latency_ms = elapsedMs(request_started_);
+    if (!UsageLedger::record(record)) {
+        logError("Failed to write usage ledger: " + UsageLedger::getPath());
+    }
+}
+
 bool LLMClient::userConfirmsRequest(const RequestAnalysis& analysis) {
     (void)analysis; // Mark as unused for now, could be used for more detailed prompts
     if (config_.verbose) {
@@ -3,9 +3,17 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <mutex>
 #include <curl/curl.h>
 #include "clion/common.h"
 #include "../utils/token_counter.h"
+#include "session.h"
+#include "history_compactor.h"
+#include "telemetry.h"
 
 namespace clion {
 namespace llm {
@@ -27,17 +35,53 @@ struct LLMResponse {
     std::string error_message;
     int http_status_code = 0;
     std::string raw_response;
+    std::string provider_name;  // Provider that produced this response
+    int prompt_tokens = 0;
+    int completion_tokens = 0;
+    int cached_tokens = 0;      // Prompt tokens served from the provider's prompt cache
+    bool cancelled = false;     // Stopped through a CancellationToken
+};
+
+// Cancels one request. Copies share the same flag, so the caller keeps a copy
+// and passes another to the request; a cancelled request returns within
+// about 50 ms with LLMResponse::cancelled set.
+class CancellationToken {
+public:
+    CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { cancelled_->store(true); }
+    bool isCancelled() const { return cancelled_->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// Cumulative prompt-cache usage for one client
+struct PromptCacheStats {
+    size_t requests = 0;
+    size_t cache_hits = 0;          // Requests where any prompt tokens were cached
+    uint64_t prompt_tokens = 0;
+    uint64_t cached_tokens = 0;
+
+    // Share of prompt tokens served from the provider's cache
+    double cachedTokenFraction() const {
+        return prompt_tokens > 0 ? static_cast<double>(cached_tokens) / prompt_tokens : 0.0;
+    }
 };
 
 struct LLMConfig {
     LLMProvider provider = LLMProvider::OPENROUTER;
     std::string api_key;
     std::string model = "gpt-3.5-turbo";
-    std::string custom_endpoint;
+    std::string custom_endpoint;      // Overrides the provider's default endpoint when set
     int timeout_seconds = 30;
     int max_tokens = 4096;
     float temperature = 0.1f;
     bool verbose = false;
+    bool show_token_usage = true;     // Print the token/cost analysis before sending
+    bool confirm_over_limit = true;   // Ask before sending requests that exceed the context window
+    bool enable_prompt_caching = true; // Mark the system instruction cacheable where the provider needs it
+    int history_token_budget = 0;     // Session history sent per request before older turns are summarized; 0 derives it from the context window
 };
 
 class LLMClient {
@@ -52,13 +96,24 @@ public:
     // Send request to LLM
     LLMResponse sendRequest(const std::string& prompt,
                            const std::string& system_instruction = "",
-                           float temperature = -1.0f);  // Use config temp if -1.0
+                           float temperature = -1.0f,  // Use config temp if -1.0
+                           const CancellationToken& cancel_token = CancellationToken());
+    
+    // Runs sendRequest on a background thread. Token analysis and any
+    // over-limit confirmation happen on the calling thread first. The client
+    // handles one request at a time, so wait for the future before using the
+    // client again.
+    std::future<LLMResponse> sendRequestAsync(const std::string& prompt,
+                                              const std::string& system_instruction = "",
+                                              float temperature = -1.0f,
+                                              const CancellationToken& cancel_token = CancellationToken());
     
     // Session-aware request methods
     LLMResponse sendRequestWithSession(const std::string& prompt,
                                       const std::string& session_id = "",
                                       const std::string& system_instruction = "",
-                                      float temperature = -1.0f);
+                                      float temperature = -1.0f,
+                                      const CancellationToken& cancel_token = CancellationToken());
     
     // Session management methods
     std::string createNewSession();
@@ -75,9 +130,14 @@ public:
     void setTimeout(int seconds);
     void setVerbose(bool verbose);
     
+    // Cancel the in-flight request from another thread; no effect when idle
+    void abortRequest();
+    
     // Status methods
     bool isInitialized() const { return initialized_; }
     const LLMConfig& getConfig() const { return config_; }
+    const PromptCacheStats& getCacheStats() const { return cache_stats_; }
+    void resetCacheStats() { cache_stats_ = PromptCacheStats{}; }
     
     // Static helper methods
     static std::vector<LLMProvider> getSupportedProviders();
@@ -86,9 +146,21 @@ public:
 
 private:
     CURL* curl_;
+    CURLM* multi_;                       // Drives curl_ so cancellation is prompt
     LLMConfig config_;
     bool initialized_;
     std::string current_session_id_;
+    std::mutex active_token_mutex_;
+    CancellationToken active_token_;     // Token of the current or last request
+    
+    // Reused across requests so steady-state sends do not reallocate
+    std::string request_buffer_;
+    std::string response_buffer_;
+    std::string header_buffer_;
+    SessionPayloadCache history_cache_;  // Serialized history of the last session used
+    PromptCacheStats cache_stats_;
+    RequestTiming timing_;               // Phases of the request in progress
+    std::chrono::steady_clock::time_point request_started_;
     
     // Token analysis structures
     struct RequestAnalysis {
@@ -103,28 +175,59 @@ private:
     // CURL callback for writing response
     static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
     static size_t HeaderCallback(void* contents, size_t size, size_t nmemb, void* userp);
+    static int ProgressCallback(void* clientp, curl_off_t dltotal, curl_off_t dlnow,
+                                curl_off_t ultotal, curl_off_t ulnow);
     
     // Helper methods
-    std::string buildJsonPayload(const std::string& prompt,
+    // Analyzes the request, shows its token usage and asks before sending one
+    // over the context window; false with `refusal` set if the user declines
+    bool prepareRequest(const std::string& prompt,
+                        const std::string& system_instruction,
+                        RequestAnalysis& analysis,
+                        LLMResponse& refusal);
+    // Sends a request prepareRequest() accepted
+    LLMResponse transmitRequest(const std::string& prompt,
                                 const std::string& system_instruction,
-                                float temperature) const;
-    LLMResponse parseResponse(const std::string& json_response) const;
-    LLMResponse sendJsonPayload(const std::string& json_payload);
+                                float temperature,
+                                const RequestAnalysis& analysis,
+                                const CancellationToken& cancel_token);
+    LLMResponse performRequest(const std::string& json_payload, const CancellationToken& cancel_token);
+    CURLcode runTransfer(const CancellationToken& cancel_token);
     
     // Provider-specific methods
     void setProviderDefaults();
     std::string getEndpoint() const;
     std::string getAuthHeader() const;
-    std::string buildPayloadForProvider(const std::string& prompt,
-                                       const std::string& system_instruction,
-                                       float temperature) const;
+    // Serializes the request into `out`; `history_messages` may be null
+    void buildPayloadForProvider(std::string& out,
+                                 const std::string& system_instruction,
+                                 const std::string* history_messages,
+                                 const std::string& prompt,
+                                 float temperature) const;
     LLMResponse parseResponseForProvider(const std::string& json_response) const;
+    void appendHistoryMessage(std::string& out, const std::string& role, const std::string& content) const;
+    bool needsExplicitCacheControl() const;
+    
+    // Telemetry
+    void beginTiming();
+    void captureTransferTimings();
+    void finishTiming(const LLMResponse& response);
+    void recordCacheUsage(const LLMResponse& response);
+    bool refreshHistoryCache(const std::string& session_id);
+    // Rewrites the history cache as `summary` followed by the entries it does not cover
+    void serializeHistory(const Session& session, const HistorySummary& summary);
+    void compactHistory(const Session& session, HistorySummary summary, const CompactionPolicy& policy);
+    void appendSummaryMessage(std::string& out, const std::string& summary) const;
     
     // Token analysis methods
+    // `context_tokens` counts input sent besides the prompt (session history)
     RequestAnalysis analyzeRequest(const std::string& prompt,
                                  const std::string& system_instruction = "",
-                                 int max_output_tokens = 0);
+                                 int max_output_tokens = 0,
+                                 int context_tokens = 0);
     void displayTokenUsage(const RequestAnalysis& analysis);
+    void displayActualUsage(const RequestAnalysis& analysis, const LLMResponse& response);
+    void recordUsage(const RequestAnalysis& analysis, const LLMResponse& response, const std::string& session_id);
     bool userConfirmsRequest(const RequestAnalysis& analysis);
     
     // Error handling
@@ -0,0 +1,188 @@
+#include "llm_router.h"
+#include "clion/common.h"
+#include "../utils/token_counter.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <thread>
+
+namespace clion {
+namespace llm {
+
+LLMRouter::~LLMRouter() {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        if (workers_[i].joinable()) {
+            clients_[i]->abortRequest();
+            workers_[i].join();
+        }
+    }
+}
+
+bool LLMRouter::initialize(const RouterConfig& config) {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        reclaimWorker(i);
+    }
+    config_ = config;
+    clients_.clear();
+    stats_ = RouterStats{};
+
+    // The pricing table is lazily built on first use; build it here so
+    // concurrent hedged requests never race on initialization.
+    utils::TokenCounter::initializePricingDatabase();
+
+    for (LLMConfig provider_config : config.providers) {
+        provider_config.show_token_usage = false;
+        provider_config.confirm_over_limit = false;
+
+        auto client = std::make_unique<LLMClient>();
+        if (!client->initialize(provider_config)) {
+            continue;  // Skip providers without credentials
+        }
+        clients_.push_back(std::move(client));
+    }
+    workers_.clear();
+    workers_.resize(clients_.size());
+
+    return !clients_.empty();
+}
+
+LLMResponse LLMRouter::sendRequest(const std::string& prompt,
+                                   const std::string& system_instruction,
+                                   float temperature) {
+    stats_.requests++;
+
+    LLMResponse response;
+    if (clients_.empty()) {
+        response.error_message = "LLMRouter not initialized";
+        stats_.failures++;
+        return response;
+    }
+
+    size_t next = 0;
+    while (next < clients_.size()) {
+        bool can_hedge = config_.enable_hedging && next + 1 < clients_.size();
+
+        if (can_hedge) {
+            bool backup_used = false;
+            response = sendHedged(next, next + 1, prompt, system_instruction, temperature, backup_used);
+            next += backup_used ? 2 : 1;
+        } else {
+            response = sendSingle(next, prompt, system_instruction, temperature);
+            next += 1;
+        }
+
+        if (response.success || !config_.enable_failover) {
+            break;
+        }
+        if (next < clients_.size()) {
+            stats_.failovers++;
+        }
+    }
+
+    if (!response.success) {
+        stats_.failures++;
+    }
+    return response;
+}
+
+LLMResponse LLMRouter::sendSingle(size_t index,
+                                  const std::string& prompt,
+                                  const std::string& system_instruction,
+                                  float temperature) {
+    reclaimWorker(index);
+    LLMClient& client = *clients_[index];
+    LLMResponse response = client.sendRequest(prompt, system_instruction, temperature);
+    response.provider_name = LLMClient::getProviderName(client.getConfig().provider);
+    return response;
+}
+
+LLMResponse LLMRouter::sendHedged(size_t primary, size_t backup,
+                                  const std::string& prompt,
+                                  const std::string& system_instruction,
+                                  float temperature,
+                                  bool& backup_used) {
+    // Shared with the worker threads; a cancelled loser may outlive this call
+    struct HedgeState {
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::optional<LLMResponse> results[2];
+        int first_success = -1;         // Slot that succeeded first, by completion order
+        int last_finished = -1;
+    };
+    auto state = std::make_shared<HedgeState>();
+    size_t indices[2] = {primary, backup};
+    CancellationToken tokens[2];
+
+    auto launch = [&](int slot) {
+        size_t index = indices[slot];
+        reclaimWorker(index);
+        LLMClient* client = clients_[index].get();
+        CancellationToken token = tokens[slot];
+        workers_[index] = std::thread([state, slot, client, prompt, system_instruction, temperature, token]() {
+            LLMResponse response = client->sendRequest(prompt, system_instruction, temperature, token);
+            response.provider_name = LLMClient::getProviderName(client->getConfig().provider);
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (response.success && state->first_success < 0) {
+                state->first_success = slot;
+            }
+            state->last_finished = slot;
+            state->results[slot] = std::move(response);
+            state->finished.notify_all();
+        });
+    };
+
+    launch(0);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    bool primary_done = state->finished.wait_for(lock, std::chrono::milliseconds(config_.hedge_delay_ms),
+                                                 [&]() { return state->results[0].has_value(); });
+
+    backup_used = !primary_done;
+    int winner = 0;
+
+    if (backup_used) {
+        stats_.hedged_requests++;
+        lock.unlock();
+        launch(1);
+        lock.lock();
+
+        // Take the first success; if one attempt fails keep waiting for the other
+        auto& results = state->results;
+        state->finished.wait(lock, [&]() {
+            return state->first_success >= 0 || (results[0] && results[1]);
+        });
+
+        // Both failed: report the error that came last
+        winner = state->first_success >= 0 ? state->first_success : state->last_finished;
+        if (state->first_success == 1) {
+            stats_.hedge_wins++;
+        }
+
+        // Cancel the attempt still running; its worker is joined before the
+        // client is used again so the caller does not wait for the abort
+        for (int slot = 0; slot < 2; ++slot) {
+            if (!results[slot]) {
+                tokens[slot].cancel();
+            }
+        }
+    }
+
+    LLMResponse response = std::move(*state->results[winner]);
+    lock.unlock();
+
+    if (!backup_used) {
+        reclaimWorker(primary);
+    }
+    return response;
+}
+
+void LLMRouter::reclaimWorker(size_t index) {
+    if (workers_[index].joinable()) {
+        workers_[index].join();
+    }
+}
+
+} // namespace llm
+} // namespace clion
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include "clion/common.h"
+#include "llm_client.h"
+
+namespace clion {
+namespace llm {
+
+struct RouterConfig {
+    std::vector<LLMConfig> providers;   // Priority order; the first entry is the primary
+    bool enable_hedging = true;         // Race a backup provider when the primary is slow
+    int hedge_delay_ms = 2000;          // Wait this long for the primary before hedging
+    bool enable_failover = true;        // Try the next provider when a request fails
+};
+
+struct RouterStats {
+    size_t requests = 0;
+    size_t hedged_requests = 0;         // Requests where a backup was launched
+    size_t hedge_wins = 0;              // Requests answered first by the backup
+    size_t failovers = 0;               // Times a failed provider was skipped
+    size_t failures = 0;                // Requests no provider could answer
+};
+
+// Routes requests across several configured providers. Each provider gets its
+// own LLMClient, so hedged requests run on independent CURL handles. Member
+// clients never print token analysis or prompt for confirmation, since hedged
+// requests run off the calling thread.
+class LLMRouter {
+public:
+    LLMRouter() = default;
+    ~LLMRouter();
+
+    bool initialize(const RouterConfig& config);
+
+    LLMResponse sendRequest(const std::string& prompt,
+                            const std::string& system_instruction = "",
+                            float temperature = -1.0f);
+
+    // Configuration methods
+    void setHedging(bool enabled) { config_.enable_hedging = enabled; }
+    void setHedgeDelay(int milliseconds) { config_.hedge_delay_ms = milliseconds; }
+    void setFailover(bool enabled) { config_.enable_failover = enabled; }
+
+    // Status methods
+    bool isInitialized() const { return !clients_.empty(); }
+    size_t getProviderCount() const { return clients_.size(); }
+    LLMClient& getClient(size_t index) { return *clients_.at(index); }
+    const RouterStats& getStats() const { return stats_; }
+    void resetStats() { stats_ = RouterStats{}; }
+
+private:
+    RouterConfig config_;
+    std::vector<std::unique_ptr<LLMClient>> clients_;
+    RouterStats stats_;
+    std::vector<std::thread> workers_;  // Per-client hedge worker, joined before reuse
+
+    // Sends to `primary`, launching `backup` if the primary has not answered
+    // within the hedge delay. Sets `backup_used` when the backup was launched.
+    LLMResponse sendHedged(size_t primary, size_t backup,
+                           const std::string& prompt,
+                           const std::string& system_instruction,
+                           float temperature,
+                           bool& backup_used);
+    void reclaimWorker(size_t index);
+    LLMResponse sendSingle(size_t index,
+                           const std::string& prompt,
+                           const std::string& system_instruction,
+                           float temperature);
+};
+
+} // namespace llm
+} // namespace clion
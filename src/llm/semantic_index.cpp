@@ -0,0 +1,778 @@
+#include "semantic_index.h"
+#include "session_index.h"
+#include "../utils/file_lock.h"
+#include "../utils/token_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace clion {
+namespace llm {
+
+namespace {
+    constexpr char INDEX_MAGIC[8] = {'C', 'L', 'S', 'E', 'M', '0', '0', '1'};
+    constexpr uint32_t NO_DOCUMENT = UINT32_MAX;
+    constexpr size_t DIMENSIONS = SemanticIndex::DIMENSIONS;
+    // The start of a long turn places it well enough
+    constexpr size_t MAX_EMBEDDED_BYTES = 32 * 1024;
+    constexpr size_t KMEANS_ITERATIONS = 6;
+    constexpr size_t KMEANS_SAMPLES_PER_LIST = 32;
+    constexpr uint32_t KMEANS_SEED = 0x5eed;
+    // The log is rewritten once superseded records are most of it
+    constexpr uintmax_t MIN_REWRITE_BYTES = 1024 * 1024;
+
+    // Words carry the meaning, word pairs some of the order, and trigrams
+    // match inflections and parts of identifiers
+    constexpr float WORD_WEIGHT = 1.0f;
+    constexpr float PAIR_WEIGHT = 0.5f;
+    constexpr float TRIGRAM_WEIGHT = 0.25f;
+
+    enum RecordType : uint8_t {
+        ADD = 1,
+        REMOVE_NODE = 2,
+        REMOVE_SESSION = 3,
+        REMOVE_TURNS = 4
+    };
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t dimensions;
+        uint32_t reserved;
+        uint64_t generation;            // New with each rewrite, so readers reload
+    };
+
+    struct RecordHeader {
+        uint32_t size;                  // Whole record: header, id, then DIMENSIONS values for ADD
+        uint8_t type;
+        uint8_t source;
+        uint16_t reserved;
+        uint32_t turn;
+        int32_t importance;
+        uint64_t content_hash;
+        float scale;
+        uint32_t id_size;
+    };
+
+    struct Document {
+        std::string id;
+        SemanticSource source;
+        uint32_t turn;
+        int32_t importance;
+        uint64_t content_hash;
+        float scale;
+        bool live;
+    };
+
+    struct IndexState {
+        std::mutex mutex;
+        std::string directory;
+        bool loaded = false;
+        uint64_t generation = 0;
+        uintmax_t log_bytes = 0;        // Log prefix already applied
+        int64_t log_modified = 0;
+        uintmax_t live_bytes = 0;       // Records a rewrite would keep
+
+        std::vector<Document> docs;
+        std::vector<int8_t> values;     // DIMENSIONS per document
+        size_t live_nodes = 0;
+        size_t live_turns = 0;
+        std::unordered_map<std::string, uint32_t> nodes;                    // Memory node id -> document
+        std::unordered_map<std::string, std::vector<uint32_t>> sessions;    // Session id -> document per turn
+
+        // IVF lists: documents by nearest centroid
+        std::vector<float> centroids;   // DIMENSIONS per list
+        std::vector<std::vector<uint32_t>> lists;
+        size_t trained_count = 0;       // Live documents when the lists were built
+    };
+
+    IndexState& state() {
+        static IndexState instance;
+        return instance;
+    }
+
+    std::filesystem::path logPath(const IndexState& s) {
+        return std::filesystem::path(s.directory) / "semantic_index.log";
+    }
+
+    // Held while appending to the log or rewriting it; searching needs no lock
+    utils::FileLock lockIndexFiles(const IndexState& s) {
+        return utils::FileLock((std::filesystem::path(s.directory) / "semantic_index.lock").string(),
+                               utils::FileLock::Mode::EXCLUSIVE);
+    }
+
+    int64_t modifiedTime(const std::filesystem::path& path, std::error_code& ec) {
+        return static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    }
+
+    bool isStopWord(std::string_view term) {
+        static const std::unordered_set<std::string_view> stop_words = {
+            "a", "an", "and", "are", "as", "at", "be", "but", "by", "can", "do", "does", "for", "from",
+            "how", "i", "if", "in", "into", "is", "it", "its", "me", "my", "of", "on", "or", "please",
+            "so", "that", "the", "then", "there", "this", "to", "was", "we", "what", "when", "which",
+            "why", "will", "with", "you", "your"
+        };
+        return stop_words.count(term) > 0;
+    }
+
+    uint64_t mixHash(uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    // FNV-1a, the same in every process, mixed so the low bits pick buckets evenly
+    uint64_t hashFeature(std::string_view text, uint64_t kind) {
+        uint64_t hash = 0xcbf29ce484222325ULL ^ kind;
+        for (unsigned char c : text) {
+            hash = (hash ^ c) * 0x100000001b3ULL;
+        }
+        return mixHash(hash);
+    }
+
+    int32_t dotValues(const int8_t* a, const int8_t* b) {
+        int32_t dot = 0;
+        for (size_t i = 0; i < DIMENSIONS; ++i) {
+            dot += int32_t(a[i]) * int32_t(b[i]);
+        }
+        return dot;
+    }
+
+    float dotCentroid(const float* centroid, const int8_t* values) {
+        float dot = 0.0f;
+        for (size_t i = 0; i < DIMENSIONS; ++i) {
+            dot += centroid[i] * values[i];
+        }
+        return dot;
+    }
+
+    const int8_t* valuesOf(const IndexState& s, uint32_t doc) {
+        return s.values.data() + size_t(doc) * DIMENSIONS;
+    }
+
+    size_t recordBytes(const Document& doc) {
+        return sizeof(RecordHeader) + doc.id.size() + DIMENSIONS;
+    }
+
+    void appendRecord(std::string& out, RecordType type, SemanticSource source, std::string_view id,
+                      uint32_t turn = 0, int32_t importance = 0, uint64_t content_hash = 0,
+                      const int8_t* values = nullptr, float scale = 0.0f) {
+        RecordHeader header{};
+        header.size = static_cast<uint32_t>(sizeof(RecordHeader) + id.size() + (values ? DIMENSIONS : 0));
+        header.type = type;
+        header.source = static_cast<uint8_t>(source);
+        header.turn = turn;
+        header.importance = importance;
+        header.content_hash = content_hash;
+        header.scale = scale;
+        header.id_size = static_cast<uint32_t>(id.size());
+        out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.append(id);
+        if (values) {
+            out.append(reinterpret_cast<const char*>(values), DIMENSIONS);
+        }
+    }
+
+    // Nearest centroid; vectors only differ in scale, which does not change the order
+    size_t nearestList(const IndexState& s, const int8_t* values) {
+        size_t best = 0;
+        float best_dot = -std::numeric_limits<float>::infinity();
+        for (size_t c = 0; c < s.lists.size(); ++c) {
+            float dot = dotCentroid(s.centroids.data() + c * DIMENSIONS, values);
+            if (dot > best_dot) {
+                best_dot = dot;
+                best = c;
+            }
+        }
+        return best;
+    }
+
+    void resetLocked(IndexState& s) {
+        s.loaded = false;
+        s.generation = 0;
+        s.log_bytes = 0;
+        s.log_modified = 0;
+        s.live_bytes = 0;
+        s.docs.clear();
+        s.values.clear();
+        s.live_nodes = 0;
+        s.live_turns = 0;
+        s.nodes.clear();
+        s.sessions.clear();
+        s.centroids.clear();
+        s.lists.clear();
+        s.trained_count = 0;
+    }
+
+    void killLocked(IndexState& s, uint32_t doc) {
+        Document& document = s.docs[doc];
+        if (!document.live) {
+            return;
+        }
+        document.live = false;
+        (document.source == SemanticSource::MEMORY_NODE ? s.live_nodes : s.live_turns)--;
+        s.live_bytes -= recordBytes(document);
+    }
+
+    void addLocked(IndexState& s, const RecordHeader& header, std::string id, const int8_t* values) {
+        uint32_t doc = static_cast<uint32_t>(s.docs.size());
+        auto source = static_cast<SemanticSource>(header.source);
+        if (source == SemanticSource::MEMORY_NODE) {
+            auto [it, inserted] = s.nodes.try_emplace(id, doc);
+            if (!inserted) {
+                killLocked(s, it->second);
+                it->second = doc;
+            }
+            s.live_nodes++;
+        } else {
+            auto& turns = s.sessions[id];
+            if (header.turn >= turns.size()) {
+                turns.resize(size_t(header.turn) + 1, NO_DOCUMENT);
+            }
+            if (turns[header.turn] != NO_DOCUMENT) {
+                killLocked(s, turns[header.turn]);
+            }
+            turns[header.turn] = doc;
+            s.live_turns++;
+        }
+        s.docs.push_back(Document{std::move(id), source, header.turn, header.importance, header.content_hash,
+                                  header.scale, true});
+        s.values.insert(s.values.end(), values, values + DIMENSIONS);
+        s.live_bytes += recordBytes(s.docs.back());
+        if (!s.lists.empty()) {
+            s.lists[nearestList(s, values)].push_back(doc);
+        }
+    }
+
+    void removeSessionLocked(IndexState& s, const std::string& session_id) {
+        auto it = s.sessions.find(session_id);
+        if (it == s.sessions.end()) {
+            return;
+        }
+        for (uint32_t doc : it->second) {
+            if (doc != NO_DOCUMENT) {
+                killLocked(s, doc);
+            }
+        }
+        s.sessions.erase(it);
+    }
+
+    void applyRecordLocked(IndexState& s, const RecordHeader& header, const char* record) {
+        uint64_t values_size = header.type == ADD ? DIMENSIONS : 0;
+        if (sizeof(RecordHeader) + uint64_t(header.id_size) + values_size > header.size) {
+            return;
+        }
+        std::string id(record + sizeof(RecordHeader), header.id_size);
+        switch (header.type) {
+        case ADD:
+            if (header.source == uint8_t(SemanticSource::MEMORY_NODE) ||
+                header.source == uint8_t(SemanticSource::SESSION_TURN)) {
+                addLocked(s, header, std::move(id),
+                          reinterpret_cast<const int8_t*>(record + sizeof(RecordHeader) + header.id_size));
+            }
+            break;
+        case REMOVE_NODE: {
+            auto it = s.nodes.find(id);
+            if (it != s.nodes.end()) {
+                killLocked(s, it->second);
+                s.nodes.erase(it);
+            }
+            break;
+        }
+        case REMOVE_SESSION:
+            removeSessionLocked(s, id);
+            break;
+        case REMOVE_TURNS:
+            while (!s.sessions.empty()) {
+                removeSessionLocked(s, s.sessions.begin()->first);
+            }
+            break;
+        default:
+            break;  // Written by a newer version
+        }
+    }
+
+    // Spherical k-means over a sample of the live vectors, then every live
+    // vector into the list of its nearest centroid. The sample is drawn with
+    // a fixed seed, so every process builds the same lists.
+    void trainLocked(IndexState& s) {
+        std::vector<uint32_t> live;
+        live.reserve(s.live_nodes + s.live_turns);
+        for (uint32_t doc = 0; doc < s.docs.size(); ++doc) {
+            if (s.docs[doc].live) {
+                live.push_back(doc);
+            }
+        }
+        size_t list_count = std::max<size_t>(1, static_cast<size_t>(std::sqrt(double(live.size()))));
+        size_t sample_count = std::min(live.size(), list_count * KMEANS_SAMPLES_PER_LIST);
+        // Evenly spaced picks would follow any period in the order things
+        // were added; a partial shuffle does not
+        std::vector<uint32_t> sample = live;
+        std::mt19937 rng(KMEANS_SEED);
+        for (size_t i = 0; i < sample_count; ++i) {
+            std::swap(sample[i], sample[i + rng() % (sample.size() - i)]);
+        }
+        sample.resize(sample_count);
+
+        s.lists.assign(list_count, {});
+        s.centroids.assign(list_count * DIMENSIONS, 0.0f);
+        for (size_t c = 0; c < list_count; ++c) {
+            const int8_t* values = valuesOf(s, sample[c]);
+            std::copy(values, values + DIMENSIONS, s.centroids.begin() + c * DIMENSIONS);
+        }
+
+        std::vector<float> sums(list_count * DIMENSIONS);
+        std::vector<size_t> counts(list_count);
+        for (size_t iteration = 0; iteration < KMEANS_ITERATIONS; ++iteration) {
+            std::fill(sums.begin(), sums.end(), 0.0f);
+            std::fill(counts.begin(), counts.end(), 0);
+            for (uint32_t doc : sample) {
+                const int8_t* values = valuesOf(s, doc);
+                size_t c = nearestList(s, values);
+                float scale = s.docs[doc].scale;
+                for (size_t i = 0; i < DIMENSIONS; ++i) {
+                    sums[c * DIMENSIONS + i] += values[i] * scale;
+                }
+                counts[c]++;
+            }
+            for (size_t c = 0; c < list_count; ++c) {
+                float norm = 0.0f;
+                for (size_t i = 0; i < DIMENSIONS; ++i) {
+                    norm += sums[c * DIMENSIONS + i] * sums[c * DIMENSIONS + i];
+                }
+                if (counts[c] == 0 || norm == 0.0f) {
+                    continue;  // Keeps its place
+                }
+                norm = std::sqrt(norm);
+                for (size_t i = 0; i < DIMENSIONS; ++i) {
+                    s.centroids[c * DIMENSIONS + i] = sums[c * DIMENSIONS + i] / norm;
+                }
+            }
+        }
+
+        for (uint32_t doc : live) {
+            s.lists[nearestList(s, valuesOf(s, doc))].push_back(doc);
+        }
+        s.trained_count = live.size();
+    }
+
+    // Lists once the index is large enough, rebuilt when it has doubled or
+    // halved, as new vectors only join the list nearest to them
+    void updateListsLocked(IndexState& s) {
+        size_t live = s.live_nodes + s.live_turns;
+        if (live < SemanticIndex::IVF_MIN_VECTORS) {
+            s.lists.clear();
+            s.centroids.clear();
+            s.trained_count = 0;
+        } else if (s.lists.empty() || live > 2 * s.trained_count || 2 * live < s.trained_count) {
+            trainLocked(s);
+        }
+    }
+
+    // Applies what was appended to the log since the last read, or reloads
+    // everything after a rewrite. False if there is no usable index.
+    bool refreshLocked(IndexState& s) {
+        std::error_code ec;
+        auto path = logPath(s);
+        uintmax_t size = std::filesystem::file_size(path, ec);
+        if (ec) {
+            resetLocked(s);
+            return false;
+        }
+        int64_t modified = modifiedTime(path, ec);
+        if (s.loaded && size == s.log_bytes && modified == s.log_modified) {
+            return true;
+        }
+
+        std::ifstream file(path, std::ios::binary);
+        FileHeader header{};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.dimensions != DIMENSIONS) {
+            resetLocked(s);
+            return false;
+        }
+        if (!s.loaded || header.generation != s.generation || size < s.log_bytes) {
+            resetLocked(s);
+            s.generation = header.generation;
+            s.log_bytes = sizeof(FileHeader);
+            s.loaded = true;
+        }
+
+        // Only whole records; one still being appended is read next time
+        std::string data(static_cast<size_t>(size - std::min(size, s.log_bytes)), '\0');
+        file.seekg(static_cast<std::streamoff>(s.log_bytes));
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        data.resize(static_cast<size_t>(file.gcount()));
+        size_t offset = 0;
+        while (data.size() - offset >= sizeof(RecordHeader)) {
+            RecordHeader record;
+            std::memcpy(&record, data.data() + offset, sizeof(record));
+            if (record.size < sizeof(RecordHeader) || record.size > data.size() - offset) {
+                break;
+            }
+            applyRecordLocked(s, record, data.data() + offset);
+            offset += record.size;
+        }
+        s.log_bytes += offset;
+        s.log_modified = modified;
+        updateListsLocked(s);
+        return true;
+    }
+
+    bool writeLogLocked(IndexState& s, const std::string& records) {
+        std::random_device rd;
+        FileHeader header{};
+        std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        header.dimensions = DIMENSIONS;
+        header.generation = ((uint64_t(rd()) << 32) | rd()) | 1;
+
+        auto path = logPath(s);
+        auto temp_path = path;
+        temp_path += ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(records.data(), static_cast<std::streamsize>(records.size()));
+            if (!file.good()) {
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp_path, path, ec);
+        if (ec) {
+            return false;
+        }
+        resetLocked(s);
+        return refreshLocked(s);
+    }
+
+    // Only the live vectors, in the order they were added
+    bool rewriteLocked(IndexState& s) {
+        std::string records;
+        records.reserve(static_cast<size_t>(s.live_bytes));
+        for (uint32_t doc = 0; doc < s.docs.size(); ++doc) {
+            const Document& document = s.docs[doc];
+            if (document.live) {
+                appendRecord(records, ADD, document.source, document.id, document.turn, document.importance,
+                             document.content_hash, valuesOf(s, doc), document.scale);
+            }
+        }
+        return writeLogLocked(s, records);
+    }
+
+    // Called with the index files locked
+    bool appendLocked(IndexState& s, const std::string& records) {
+        if (!refreshLocked(s)) {
+            return false;
+        }
+        {
+            std::ofstream file(logPath(s), std::ios::binary | std::ios::app);
+            file.write(records.data(), static_cast<std::streamsize>(records.size()));
+            if (!file.good()) {
+                return false;
+            }
+        }
+        if (!refreshLocked(s)) {
+            return false;
+        }
+        if (s.log_bytes > MIN_REWRITE_BYTES && s.live_bytes * 2 < s.log_bytes) {
+            return rewriteLocked(s);
+        }
+        return true;
+    }
+}
+
+SemanticIndex::Embedding SemanticIndex::embed(std::string_view text) {
+    text = text.substr(0, MAX_EMBEDDED_BYTES);
+    std::array<float, DIMENSIONS> sums{};
+    auto addFeature = [&](uint64_t hash, float weight) {
+        // The top bit picks the sign, so features sharing a bucket cancel out on average
+        sums[hash % DIMENSIONS] += (hash >> 63) ? -weight : weight;
+    };
+
+    uint64_t previous = 0;
+    SessionIndex::forEachTerm(text, [&](std::string_view term) {
+        if (isStopWord(term)) {
+            previous = 0;
+            return;
+        }
+        uint64_t word = hashFeature(term, 1);
+        addFeature(word, WORD_WEIGHT);
+        if (previous != 0) {
+            addFeature(mixHash(previous * 31 + word), PAIR_WEIGHT);
+        }
+        previous = word;
+
+        if (term.size() > 3) {
+            char padded[SessionIndex::MAX_TERM_LENGTH + 2];
+            padded[0] = '^';
+            std::memcpy(padded + 1, term.data(), term.size());
+            padded[term.size() + 1] = '$';
+            for (size_t i = 0; i + 3 <= term.size() + 2; ++i) {
+                addFeature(hashFeature(std::string_view(padded + i, 3), 2), TRIGRAM_WEIGHT);
+            }
+        }
+    });
+
+    // Square roots damp words repeated all through a long text
+    float norm = 0.0f;
+    float largest = 0.0f;
+    for (float& sum : sums) {
+        sum = std::copysign(std::sqrt(std::fabs(sum)), sum);
+        norm += sum * sum;
+        largest = std::max(largest, std::fabs(sum));
+    }
+    Embedding embedding;
+    if (norm == 0.0f) {
+        return embedding;
+    }
+    norm = std::sqrt(norm);
+    embedding.scale = largest / norm / 127.0f;
+    for (size_t i = 0; i < DIMENSIONS; ++i) {
+        embedding.values[i] = static_cast<int8_t>(std::lround(sums[i] / norm / embedding.scale));
+    }
+    return embedding;
+}
+
+float SemanticIndex::similarity(const Embedding& a, const Embedding& b) {
+    return static_cast<float>(dotValues(a.values.data(), b.values.data())) * a.scale * b.scale;
+}
+
+bool SemanticIndex::open(const std::string& directory) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.directory != directory) {
+        resetLocked(s);
+        s.directory = directory;
+    }
+    return refreshLocked(s);
+}
+
+bool SemanticIndex::clear() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    std::error_code ec;
+    std::filesystem::create_directories(s.directory, ec);
+    return writeLogLocked(s, "");
+}
+
+bool SemanticIndex::addMemoryNode(const std::string& node_id, std::string_view text, int importance) {
+    uint64_t hash = utils::TokenCache::hashContent(text);
+    Embedding embedding = embed(text);
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    if (!refreshLocked(s)) {
+        return false;
+    }
+    auto it = s.nodes.find(node_id);
+    if (it != s.nodes.end() && s.docs[it->second].content_hash == hash &&
+        s.docs[it->second].importance == importance) {
+        return true;
+    }
+    std::string records;
+    appendRecord(records, ADD, SemanticSource::MEMORY_NODE, node_id, 0, importance, hash,
+                 embedding.values.data(), embedding.scale);
+    return appendLocked(s, records);
+}
+
+bool SemanticIndex::removeMemoryNode(const std::string& node_id) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    if (!refreshLocked(s) || s.nodes.find(node_id) == s.nodes.end()) {
+        return false;
+    }
+    std::string records;
+    appendRecord(records, REMOVE_NODE, SemanticSource::MEMORY_NODE, node_id);
+    return appendLocked(s, records);
+}
+
+std::optional<int> SemanticIndex::memoryNodeImportance(const std::string& node_id) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!refreshLocked(s)) {
+        return std::nullopt;
+    }
+    auto it = s.nodes.find(node_id);
+    if (it == s.nodes.end()) {
+        return std::nullopt;
+    }
+    return s.docs[it->second].importance;
+}
+
+bool SemanticIndex::indexSession(const std::string& session_id, const std::vector<std::string_view>& contents) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(contents.size());
+    for (const auto& content : contents) {
+        hashes.push_back(utils::TokenCache::hashContent(content));
+    }
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    if (!refreshLocked(s)) {
+        return false;
+    }
+    std::string records;
+    std::vector<uint32_t> indexed;
+    auto it = s.sessions.find(session_id);
+    if (it != s.sessions.end()) {
+        if (it->second.size() > contents.size()) {
+            // History was cut short: start the session over
+            appendRecord(records, REMOVE_SESSION, SemanticSource::SESSION_TURN, session_id);
+        } else {
+            indexed = it->second;
+        }
+    }
+    for (size_t i = 0; i < contents.size(); ++i) {
+        if (i < indexed.size() && indexed[i] != NO_DOCUMENT && s.docs[indexed[i]].content_hash == hashes[i]) {
+            continue;
+        }
+        Embedding embedding = embed(contents[i]);
+        appendRecord(records, ADD, SemanticSource::SESSION_TURN, session_id, static_cast<uint32_t>(i), 0,
+                     hashes[i], embedding.values.data(), embedding.scale);
+    }
+    return records.empty() || appendLocked(s, records);
+}
+
+bool SemanticIndex::addTurn(const std::string& session_id, size_t turn, std::string_view content) {
+    Embedding embedding = embed(content);
+    std::string records;
+    appendRecord(records, ADD, SemanticSource::SESSION_TURN, session_id, static_cast<uint32_t>(turn), 0,
+                 utils::TokenCache::hashContent(content), embedding.values.data(), embedding.scale);
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    return appendLocked(s, records);
+}
+
+bool SemanticIndex::removeSession(const std::string& session_id) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    if (!refreshLocked(s) || s.sessions.find(session_id) == s.sessions.end()) {
+        return false;
+    }
+    std::string records;
+    appendRecord(records, REMOVE_SESSION, SemanticSource::SESSION_TURN, session_id);
+    return appendLocked(s, records);
+}
+
+bool SemanticIndex::removeAllTurns() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    if (!refreshLocked(s)) {
+        return false;
+    }
+    if (s.sessions.empty()) {
+        return true;
+    }
+    std::string records;
+    appendRecord(records, REMOVE_TURNS, SemanticSource::SESSION_TURN, "");
+    return appendLocked(s, records);
+}
+
+size_t SemanticIndex::turnCount(const std::string& session_id) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!refreshLocked(s)) {
+        return 0;
+    }
+    auto it = s.sessions.find(session_id);
+    if (it == s.sessions.end()) {
+        return 0;
+    }
+    // Turns up to the first one missing
+    auto missing = std::find(it->second.begin(), it->second.end(), NO_DOCUMENT);
+    return static_cast<size_t>(missing - it->second.begin());
+}
+
+size_t SemanticIndex::size(std::optional<SemanticSource> source) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!refreshLocked(s)) {
+        return 0;
+    }
+    if (!source) {
+        return s.live_nodes + s.live_turns;
+    }
+    return *source == SemanticSource::MEMORY_NODE ? s.live_nodes : s.live_turns;
+}
+
+std::vector<SemanticHit> SemanticIndex::search(std::string_view text, size_t limit, float min_similarity) {
+    Embedding query = embed(text);
+    if (query.scale == 0.0f || limit == 0) {
+        return {};
+    }
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!refreshLocked(s)) {
+        return {};
+    }
+
+    std::vector<std::pair<float, uint32_t>> candidates;
+    auto consider = [&](uint32_t doc) {
+        const Document& document = s.docs[doc];
+        if (!document.live) {
+            return;
+        }
+        float similarity =
+            static_cast<float>(dotValues(query.values.data(), valuesOf(s, doc))) * query.scale * document.scale;
+        if (similarity >= min_similarity) {
+            candidates.emplace_back(similarity, doc);
+        }
+    };
+    if (s.lists.empty()) {
+        for (uint32_t doc = 0; doc < s.docs.size(); ++doc) {
+            consider(doc);
+        }
+    } else {
+        // Only the lists whose centroids are nearest the query
+        std::vector<std::pair<float, size_t>> nearest;
+        nearest.reserve(s.lists.size());
+        for (size_t c = 0; c < s.lists.size(); ++c) {
+            nearest.emplace_back(dotCentroid(s.centroids.data() + c * DIMENSIONS, query.values.data()), c);
+        }
+        size_t probes = std::min(IVF_PROBES, nearest.size());
+        std::partial_sort(nearest.begin(), nearest.begin() + probes, nearest.end(),
+                          [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (size_t p = 0; p < probes; ++p) {
+            for (uint32_t doc : s.lists[nearest[p].second]) {
+                consider(doc);
+            }
+        }
+    }
+
+    size_t count = std::min(limit, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+    std::vector<SemanticHit> hits;
+    hits.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const Document& document = s.docs[candidates[i].second];
+        SemanticHit hit;
+        hit.id = document.id;
+        hit.source = document.source;
+        hit.turn = document.turn;
+        hit.importance = document.importance;
+        hit.similarity = candidates[i].first;
+        hits.push_back(std::move(hit));
+    }
+    return hits;
+}
+
+} // namespace llm
+} // namespace clion
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "clion/common.h"
+
+namespace clion {
+namespace llm {
+
+enum class SemanticSource : uint8_t {
+    MEMORY_NODE = 1,
+    SESSION_TURN = 2
+};
+
+struct SemanticHit {
+    std::string id;                            ///< Memory node id, or the turn's session id
+    SemanticSource source = SemanticSource::MEMORY_NODE;
+    size_t turn = 0;                           ///< Entry index in the session, for turns
+    int importance = 0;                        ///< Memory node importance, 0-100
+    float similarity = 0.0f;                   ///< Cosine similarity of the embeddings
+};
+
+// Nearest-neighbour index over memory nodes and session turns, for finding
+// text related to a prompt without it sharing exact keywords. Runs locally on
+// the CPU: text is embedded by feature hashing (words, word pairs and the
+// character trigrams of each word, with signs, into DIMENSIONS buckets), so
+// there is no model to load and nothing leaves the machine. Vectors are
+// unit length and stored as int8 with a scale each.
+//
+// Search is IVF-flat: once the index holds IVF_MIN_VECTORS vectors they are
+// clustered with k-means into about sqrt(n) lists, and a query scans only
+// the lists of its IVF_PROBES nearest centroids. Smaller indexes are scanned
+// whole. Lists are rebuilt in memory whenever the index has doubled or
+// halved since they were built.
+//
+// Kept in semantic_index.log, an append-only log of added and removed
+// vectors that is rewritten once superseded records make up most of it.
+// Other processes pick up appended records on their next call.
+class SemanticIndex {
+public:
+    static constexpr size_t DIMENSIONS = 256;
+    static constexpr size_t IVF_MIN_VECTORS = 2048;
+    static constexpr size_t IVF_PROBES = 8;
+
+    struct Embedding {
+        std::array<int8_t, DIMENSIONS> values{};
+        float scale = 0.0f;                    ///< values * scale is the unit vector; 0 for text with no words
+    };
+
+    static Embedding embed(std::string_view text);
+    static float similarity(const Embedding& a, const Embedding& b);
+
+    // Loads or refreshes the index in `directory`. False if it has none yet
+    static bool open(const std::string& directory);
+    // Starts an empty index
+    static bool clear();
+
+    // Adds or replaces a memory node; unchanged nodes are not rewritten
+    static bool addMemoryNode(const std::string& node_id, std::string_view text, int importance);
+    static bool removeMemoryNode(const std::string& node_id);
+    // Importance of an indexed memory node; nullopt if it is not indexed
+    static std::optional<int> memoryNodeImportance(const std::string& node_id);
+
+    // Adds the session's turns the index does not have yet. Turns already
+    // indexed whose content changed are indexed again.
+    static bool indexSession(const std::string& session_id, const std::vector<std::string_view>& contents);
+    // One appended turn; `turn` is its entry index
+    static bool addTurn(const std::string& session_id, size_t turn, std::string_view content);
+    static bool removeSession(const std::string& session_id);
+    // Drops every session turn, keeping memory nodes; for rebuilding the turns
+    static bool removeAllTurns();
+    // Turns indexed for the session
+    static size_t turnCount(const std::string& session_id);
+
+    static size_t size(std::optional<SemanticSource> source = std::nullopt);
+
+    // Nearest first, at most `limit`, none below `min_similarity`
+    static std::vector<SemanticHit> search(std::string_view text, size_t limit, float min_similarity = 0.0f);
+};
+
+} // namespace llm
+} // namespace clion
@@ -1,8 +1,16 @@
 #include "session.h"
+#include "session_cache.h"
+#include "session_catalog.h"
+#include "session_index.h"
+#include "session_format.h"
 #include "clion/session_checkpoint.h"
 #include "clion/memory_manager.h"
 #include "clion/common.h"
+#include "../utils/compression.h"
+#include "../utils/file_lock.h"
 #include "../utils/file_utils.h"
+#include "../utils/group_commit.h"
+#include "../utils/token_counter.h"
 #include <nlohmann/json.hpp>
 #include <filesystem>
 #include <fstream>
@@ -10,7 +18,20 @@
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <functional>
 #include <regex>
+#include <set>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using json = nlohmann::json;
 
@@ -42,6 +63,394 @@ namespace {
         return std::filesystem::path(getSessionDirectory()) / (session_id + ".json");
     }
     
+    // Compression dictionaries are shared by all sessions in the directory
+    void useSessionDictionaries() {
+        utils::Compression::useDictionaryDirectory(
+            (std::filesystem::path(getSessionDirectory()) / "dictionaries").string());
+    }
+    
+    // Whole file as stored, compressed or not
+    std::optional<std::string> readSessionFile(const std::string& file_path) {
+        std::ifstream file(file_path, std::ios::binary);
+        if (!file.is_open()) {
+            return std::nullopt;
+        }
+        std::string data;
+        std::error_code ec;
+        auto size = std::filesystem::file_size(file_path, ec);
+        if (!ec) {
+            data.resize(static_cast<size_t>(size));
+            file.read(data.data(), static_cast<std::streamsize>(data.size()));
+            data.resize(static_cast<size_t>(file.gcount()));
+        }
+        return data;
+    }
+    
+    // Entries added since the session file was last written, one JSON record
+    // per line after a header naming the session file version it extends
+    std::string getJournalPath(const std::string& session_id) {
+        return std::filesystem::path(getSessionDirectory()) / (session_id + ".journal");
+    }
+    
+    // Sessions share a fixed set of lock files by hash, so the directory does
+    // not collect one per session and deleting a session never removes a
+    // lock another process is waiting on
+    constexpr uint64_t SESSION_LOCK_STRIPES = 64;
+
+    std::string getSessionLockPath(const std::string& session_id) {
+        uint64_t hash = 0xcbf29ce484222325ULL;  // FNV-1a, the same in every process
+        for (unsigned char c : session_id) {
+            hash = (hash ^ c) * 0x100000001b3ULL;
+        }
+        return std::filesystem::path(getSessionDirectory()) / "locks" /
+               (std::to_string(hash % SESSION_LOCK_STRIPES) + ".lock");
+    }
+
+    // Loads share a session; saves, appends and deletes take it alone
+    utils::FileLock lockSession(const std::string& session_id, utils::FileLock::Mode mode) {
+        return utils::FileLock(getSessionLockPath(session_id), mode);
+    }
+
+    // A journal is compacted into the session file once it outgrows it, so
+    // rewrites stay proportional to what was appended since the last one
+    constexpr uintmax_t MIN_COMPACTION_BYTES = 64 * 1024;
+    
+    // fdatasync after every append; CLION_SESSION_SYNC=1 turns it on
+    std::atomic<bool>& syncAppends() {
+        static std::atomic<bool> enabled([] {
+            const char* value = std::getenv("CLION_SESSION_SYNC");
+            return value && std::string(value) == "1";
+        }());
+        return enabled;
+    }
+    
+    // Format new session files are written in; JSON unless
+    // CLION_SESSION_FORMAT=binary opts in to the binary format
+    std::atomic<SessionFormat>& storageFormat() {
+        static std::atomic<SessionFormat> format([] {
+            const char* value = std::getenv("CLION_SESSION_FORMAT");
+            return value && std::string(value) == "binary" ? SessionFormat::BINARY : SessionFormat::JSON;
+        }());
+        return format;
+    }
+    
+    // SessionWriteBatch scopes open on this thread; nested scopes share the
+    // outermost one's id, under which their changes wait in the cache
+    struct BatchScope {
+        int depth = 0;
+        SessionCache::BatchId id = 0;
+        bool discarded = false;
+    };
+
+    BatchScope& currentBatch() {
+        thread_local BatchScope scope;
+        return scope;
+    }
+
+    SessionCache::BatchId nextBatchId() {
+        static std::atomic<SessionCache::BatchId> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Whether this thread's last flushSessions() found a session changed by
+    // another process
+    bool& flushConflicted() {
+        thread_local bool conflicted = false;
+        return conflicted;
+    }
+    
+    std::optional<SessionStamp> getFileStamp(const std::string& file_path) {
+        std::error_code ec;
+        SessionStamp stamp;
+#ifdef _WIN32
+        stamp.file_size = std::filesystem::file_size(file_path, ec);
+        if (ec) {
+            return std::nullopt;
+        }
+#else
+        struct stat info;
+        if (::stat(file_path.c_str(), &info) != 0) {
+            return std::nullopt;
+        }
+        stamp.file_size = static_cast<uintmax_t>(info.st_size);
+        stamp.file_id = static_cast<uint64_t>(info.st_ino);
+#endif
+        auto modified = std::filesystem::last_write_time(file_path, ec);
+        if (ec) {
+            return std::nullopt;
+        }
+        stamp.modified_ns = static_cast<int64_t>(modified.time_since_epoch().count());
+        return stamp;
+    }
+    
+    // Appends only touch the journal; they grow it, so the combined size changes
+    SessionStamp combineStamps(SessionStamp base_stamp, const std::optional<SessionStamp>& journal_stamp) {
+        if (journal_stamp) {
+            base_stamp.file_size += journal_stamp->file_size;
+            base_stamp.modified_ns = std::max(base_stamp.modified_ns, journal_stamp->modified_ns);
+        }
+        return base_stamp;
+    }
+    
+    json entryToJson(const HistoryEntry& entry) {
+        json entry_json;
+        entry_json["role"] = entry.role;
+        entry_json["content"] = entry.content;
+        entry_json["timestamp"] = entry.timestamp;
+        if (entry.token_count > 0) {
+            entry_json["tokens"] = entry.token_count;
+        }
+        return entry_json;
+    }
+    
+    HistoryEntry entryFromJson(const json& entry_json) {
+        HistoryEntry entry;
+        entry.role = entry_json["role"].get<std::string>();
+        entry.content = entry_json["content"].get<std::string>();
+        entry.timestamp = entry_json["timestamp"].get<std::string>();
+        entry.token_count = entry_json.value("tokens", size_t(0));
+        return entry;
+    }
+    
+    // Header line of a journal; nullopt if the journal is missing or unreadable
+    std::optional<json> readJournalHeader(std::istream& file) {
+        std::string line;
+        if (!std::getline(file, line)) {
+            return std::nullopt;
+        }
+        try {
+            json header = json::parse(line);
+            if (header.value("journal", 0) != 1) {
+                return std::nullopt;
+            }
+            return header;
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+    
+    // A crash between writing the session file and resetting its journal
+    // leaves a journal whose entries are already in the session file; it no
+    // longer matches the file's version and is ignored
+    bool journalExtends(const json& header, const SessionStamp& base_stamp) {
+        return header.value("base_size", uintmax_t(0)) == base_stamp.file_size &&
+               header.value("base_modified_ns", int64_t(0)) == base_stamp.modified_ns &&
+               header.value("base_file_id", base_stamp.file_id) == base_stamp.file_id;
+    }
+    
+#ifndef _WIN32
+    bool writeAll(int fd, const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            written += static_cast<size_t>(n);
+        }
+        return true;
+    }
+#endif
+    
+    // Creates or truncates `path` with `data`; `durable` flushes it before returning
+    bool writeNewFile(const std::string& path, const std::string& data, bool durable) {
+#ifdef _WIN32
+        (void)durable;
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        file.close();
+        return file.good();
+#else
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = writeAll(fd, data);
+        if (ok && durable) {
+            ok = utils::GroupCommit::sync(fd);
+        }
+        return ::close(fd) == 0 && ok;
+#endif
+    }
+    
+    // Makes renames and new files in the session directory durable
+    bool syncSessionDirectory() {
+#ifdef _WIN32
+        return true;
+#else
+        int fd = ::open(getSessionDirectory().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = utils::GroupCommit::sync(fd);
+        ::close(fd);
+        return ok;
+#endif
+    }
+    
+    // Starts an empty journal on top of the session file just written
+    bool resetJournal(const std::string& session_id, size_t base_entries) {
+        auto base_stamp = getFileStamp(getSessionFilePath(session_id));
+        if (!base_stamp) {
+            return false;
+        }
+        json header;
+        header["journal"] = 1;
+        header["base_size"] = base_stamp->file_size;
+        header["base_modified_ns"] = base_stamp->modified_ns;
+        header["base_file_id"] = base_stamp->file_id;
+        header["base_entries"] = base_entries;
+    
+        // A new file rather than a truncated one: ext4 flushes files that are
+        // truncated and rewritten when they are closed. Without a journal the
+        // next append falls back to a full save, so the gap is safe. Never
+        // flushed on its own: the first durable append flushes the header
+        // with it, and a lost header only costs that append a full save.
+        std::string journal_path = getJournalPath(session_id);
+        std::error_code ec;
+        std::filesystem::remove(journal_path, ec);
+        return writeNewFile(journal_path, header.dump() + "\n", false);
+    }
+    
+    // Journal appended to, held open until the append is flushed. The flush
+    // comes after the session's lock is released, so appends made to the
+    // journal meanwhile can share it.
+    class PendingFlush {
+    public:
+        PendingFlush() = default;
+        ~PendingFlush() { release(); }
+        PendingFlush(const PendingFlush&) = delete;
+        PendingFlush& operator=(const PendingFlush&) = delete;
+
+        void hold(int fd) {
+            release();
+            fd_ = fd;
+        }
+        // True when nothing is held
+        bool flush() {
+            if (fd_ < 0) {
+                return true;
+            }
+            bool ok = utils::GroupCommit::sync(fd_);
+            release();
+            return ok;
+        }
+
+    private:
+        void release() {
+#ifndef _WIN32
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+#endif
+            fd_ = -1;
+        }
+
+        int fd_ = -1;
+    };
+    
+    // One write of one record, so a turn costs O(entry) whatever the session
+    // size. With syncing on, `pending` is left holding the journal to flush.
+    bool appendToJournal(const std::string& journal_path, std::string record, PendingFlush& pending) {
+#ifdef _WIN32
+        (void)pending;
+        std::ofstream file(journal_path, std::ios::binary | std::ios::app);
+        file.write(record.data(), static_cast<std::streamsize>(record.size()));
+        file.flush();
+        return file.good();
+#else
+        int fd = ::open(journal_path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        // A record torn by a crash has no newline; start on a fresh line so
+        // only the torn record is lost
+        struct stat info;
+        char last = '\n';
+        if (::fstat(fd, &info) == 0 && info.st_size > 0 &&
+            ::pread(fd, &last, 1, info.st_size - 1) == 1 && last != '\n') {
+            record.insert(record.begin(), '\n');
+        }
+    
+        if (!writeAll(fd, record)) {
+            ::close(fd);
+            return false;
+        }
+        if (syncAppends().load(std::memory_order_relaxed)) {
+            pending.hold(fd);
+        } else {
+            ::close(fd);
+        }
+        return true;
+#endif
+    }
+    
+    // Applies the journal's records to a session loaded from its file, which
+    // holds `base_entries` entries
+    void replayJournal(const std::string& session_id, Session& session, size_t base_entries) {
+        std::ifstream file(getJournalPath(session_id), std::ios::binary);
+        if (!file.is_open()) {
+            return;
+        }
+        auto header = readJournalHeader(file);
+        auto base_stamp = getFileStamp(getSessionFilePath(session_id));
+        if (!header || !base_stamp || !journalExtends(*header, *base_stamp) ||
+            header->value("base_entries", size_t(0)) != base_entries) {
+            return;
+        }
+    
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            try {
+                json record = json::parse(line);
+                HistoryEntry entry = entryFromJson(record);
+                std::string encoding = record.value("encoding", "");
+                if (record.contains("model")) {
+                    session.metadata["model"] = record["model"].get<std::string>();
+                }
+                if (session.token_encoding.empty()) {
+                    session.token_encoding = encoding;
+                } else if (encoding != session.token_encoding) {
+                    entry.token_count = 0;  // Recounted by updateTokenCounts
+                }
+                session.total_tokens += entry.token_count;
+                session.updated_at = entry.timestamp;
+                session.entries.push_back(std::move(entry));
+            } catch (const std::exception&) {
+                // Torn record from a crash mid-append
+            }
+        }
+    }
+    
+    std::string getPayloadCachePath(const std::string& session_id, const std::string& format) {
+        return std::filesystem::path(getSessionDirectory()) / (session_id + "." + format + ".msgcache");
+    }
+    
+    std::string getSummaryPath(const std::string& session_id) {
+        return std::filesystem::path(getSessionDirectory()) / (session_id + ".summary");
+    }
+    
+    // Reads the timestamps getCurrentTimestamp() writes; nullopt for others
+    std::optional<std::chrono::system_clock::time_point> parseTimestamp(const std::string& timestamp) {
+        int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+        if (std::sscanf(timestamp.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d",
+                        &year, &month, &day, &hour, &minute, &second) != 6) {
+            return std::nullopt;
+        }
+        std::chrono::year_month_day date{std::chrono::year(year), std::chrono::month(month), std::chrono::day(day)};
+        if (!date.ok()) {
+            return std::nullopt;
+        }
+        return std::chrono::sys_days(date) + std::chrono::hours(hour) + std::chrono::minutes(minute) +
+               std::chrono::seconds(second);
+    }
+    
     // Generate current timestamp in ISO 8601 format
     std::string getCurrentTimestamp() {
         auto now = std::chrono::system_clock::now();
@@ -55,6 +464,197 @@ namespace {
         return ss.str();
     }
     
+    // Model the session's turns were last sent to; its tokenizer counts them
+    std::string sessionModel(const Session& session) {
+        auto it = session.metadata.find("model");
+        return it != session.metadata.end() ? it->second : "";
+    }
+    
+    // Counts tokens of entries that have no count for the session model's
+    // tokenizer and refreshes total_tokens. Returns true if anything changed.
+    bool updateTokenCounts(Session& session) {
+        std::string model = sessionModel(session);
+        std::string encoding = utils::TokenCounter::getTokenizerName(model);
+        bool changed = false;
+        if (session.token_encoding != encoding) {
+            for (auto& entry : session.entries) {
+                entry.token_count = 0;
+            }
+            session.token_encoding = encoding;
+            changed = true;
+        }
+
+        size_t total = 0;
+        for (auto& entry : session.entries) {
+            if (entry.token_count == 0 && !entry.content.empty()) {
+                entry.token_count = static_cast<size_t>(
+                    utils::TokenCounter::countTokensForModel(entry.content, model));
+                changed = true;
+            }
+            total += entry.token_count;
+        }
+        if (session.total_tokens != total) {
+            session.total_tokens = total;
+            changed = true;
+        }
+        return changed;
+    }
+
+    CatalogEntry makeCatalogEntry(const Session& session, uintmax_t size_bytes) {
+        CatalogEntry entry;
+        entry.id = session.id;
+        entry.name = session.name;
+        entry.description = session.description;
+        entry.tags.assign(session.tags.begin(), session.tags.end());
+        std::sort(entry.tags.begin(), entry.tags.end());
+        entry.parent_session_id = session.parent_session_id;
+        entry.created_at = session.created_at;
+        entry.updated_at = session.updated_at;
+        entry.entry_count = session.entries.size();
+        entry.total_tokens = session.total_tokens;
+        entry.size_bytes = size_bytes;
+        return entry;
+    }
+    
+    // Opens the catalog, building it from the session files the first time
+    void openCatalog() {
+        if (!SessionCatalog::open(getSessionDirectory())) {
+            SessionManager::rebuildCatalog();
+        }
+    }
+    
+    // Called with the session locked, so a missing catalog is left for the
+    // next openCatalog() to build rather than built from sessions that may be
+    // locked by a process waiting on this one
+    void updateCatalog(const Session& session) {
+        if (SessionCatalog::open(getSessionDirectory())) {
+            SessionCatalog::put(makeCatalogEntry(session, SessionManager::getSessionSize(session.id)));
+        }
+    }
+    
+    // Opens the search indexes, building them from the session files the first time
+    void openSearchIndex() {
+        if (!SessionIndex::open(getSessionDirectory())) {
+            SessionManager::rebuildSearchIndex();
+        }
+        if (!SemanticIndex::open(getSessionDirectory())) {
+            SessionManager::rebuildSemanticIndex();
+        }
+    }
+    
+    void updateSearchIndex(const Session& session) {
+        std::vector<std::string_view> contents;
+        contents.reserve(session.entries.size());
+        for (const auto& entry : session.entries) {
+            contents.push_back(entry.content);
+        }
+        // Same as updateCatalog()
+        if (SessionIndex::open(getSessionDirectory())) {
+            SessionIndex::indexSession(session.id, contents);
+        }
+        if (SemanticIndex::open(getSessionDirectory())) {
+            SemanticIndex::indexSession(session.id, contents);
+        }
+    }
+    
+    // One entry appended as `turn`, called with the session locked. Turns
+    // missing before it, e.g. from before the vector index existed, are
+    // indexed from the whole session instead.
+    void addSemanticTurn(const std::string& session_id, size_t turn, const std::string& content) {
+        if (!SemanticIndex::open(getSessionDirectory())) {
+            return;
+        }
+        if (SemanticIndex::turnCount(session_id) == turn) {
+            SemanticIndex::addTurn(session_id, turn, content);
+        } else if (auto session_opt = SessionManager::loadSession(session_id)) {
+            updateSearchIndex(*session_opt);
+        }
+    }
+    
+    // Calls `visit` with each entry's content until it returns false. Binary
+    // session files are read in place rather than loaded. False if the
+    // session cannot be read.
+    bool visitContents(const std::string& session_id, const std::function<bool(std::string_view)>& visit) {
+        SessionView view;
+        if (!SessionCache::isDirty(session_id, currentBatch().id) && SessionManager::openSessionView(session_id, view)) {
+            std::string buffer;
+            for (size_t i = 0; i < view.entryCount(); ++i) {
+                auto content = view.content(i, buffer);
+                if (!content) {
+                    return false;
+                }
+                if (!visit(*content)) {
+                    break;
+                }
+            }
+            return true;
+        }
+        auto session_opt = SessionManager::loadSession(session_id);
+        if (!session_opt) {
+            return false;
+        }
+        for (const auto& entry : session_opt->entries) {
+            if (!visit(entry.content)) {
+                break;
+            }
+        }
+        return true;
+    }
+    
+    // Whether each phrase's words appear in a row in one of the session's entries
+    bool containsPhrases(const std::string& session_id, const std::vector<std::vector<std::string>>& phrases) {
+        std::vector<std::string> terms;
+        std::vector<bool> found(phrases.size(), false);
+        size_t remaining = phrases.size();
+        bool read = visitContents(session_id, [&](std::string_view content) {
+            terms.clear();
+            SessionIndex::forEachTerm(content, [&](std::string_view term) {
+                terms.emplace_back(term);
+            });
+            for (size_t i = 0; i < phrases.size(); ++i) {
+                if (!found[i] && std::search(terms.begin(), terms.end(),
+                                             phrases[i].begin(), phrases[i].end()) != terms.end()) {
+                    found[i] = true;
+                    remaining--;
+                }
+            }
+            return remaining > 0;
+        });
+        return read && remaining == 0;
+    }
+    
+    // Index hits for `query`; phrases are checked against the sessions
+    // themselves, so only their candidates are read
+    std::vector<SearchHit> searchIndex(const SearchQuery& query, size_t limit) {
+        openSearchIndex();
+        auto hits = SessionIndex::search(query, query.phrases.empty() ? limit : 0);
+        if (query.phrases.empty()) {
+            return hits;
+        }
+        std::vector<SearchHit> verified;
+        for (auto& hit : hits) {
+            if (limit > 0 && verified.size() == limit) {
+                break;
+            }
+            if (containsPhrases(hit.session_id, query.phrases)) {
+                verified.push_back(std::move(hit));
+            }
+        }
+        return verified;
+    }
+    
+    // The words of `text` as one query that must match as a phrase
+    SearchQuery phraseQuery(const std::string& text) {
+        SearchQuery query;
+        SessionIndex::forEachTerm(text, [&](std::string_view term) {
+            query.terms.emplace_back(term);
+        });
+        if (query.terms.size() > 1) {
+            query.phrases.push_back(query.terms);
+        }
+        return query;
+    }
+    
     // Generate random string for session ID
     std::string generateRandomString(size_t length) {
         const std::string chars = "abcdefghijklmnopqrstuvwxyz0123456789";
@@ -69,184 +669,357 @@ namespace {
         }
         return result;
     }
-}
+    
+    // Writes a new file beside `path` and renames it over the old one, so a
+    // crash leaves one version or the other, never a mix of both
+    bool replaceFile(const std::string& path, const std::string& data, bool durable) {
+        std::string temp_path = path + "." + generateRandomString(8) + ".tmp";
+        std::error_code ec;
+        if (!writeNewFile(temp_path, data, durable)) {
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+        std::filesystem::rename(temp_path, path, ec);
+        if (ec) {
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+        return true;
+    }
 
-bool SessionManager::saveSession(const Session& session) {
-    try {
-        // Convert session to JSON
+    // The JSON form of a session, without compression
+    std::string sessionToJson(const Session& session) {
         json j;
         j["id"] = session.id;
         j["created_at"] = session.created_at;
         j["updated_at"] = session.updated_at;
-
+    
         // Enhanced session fields
         j["name"] = session.name;
         j["description"] = session.description;
         j["parent_session_id"] = session.parent_session_id;
         j["total_tokens"] = session.total_tokens;
+        j["token_encoding"] = session.token_encoding;
         j["is_compressed"] = session.is_compressed;
         j["last_checkpoint_id"] = session.last_checkpoint_id;
-
+    
         // Convert entries to JSON array
         json entries_json = json::array();
         for (const auto& entry : session.entries) {
-            json entry_json;
-            entry_json["role"] = entry.role;
-            entry_json["content"] = entry.content;
-            entry_json["timestamp"] = entry.timestamp;
-            entries_json.push_back(entry_json);
+            entries_json.push_back(entryToJson(entry));
         }
         j["entries"] = entries_json;
-
+    
         // Convert child session IDs to JSON array
         json child_ids_json = json::array();
         for (const auto& child_id : session.child_session_ids) {
             child_ids_json.push_back(child_id);
         }
         j["child_session_ids"] = child_ids_json;
-
+    
         // Convert tags to JSON array
         json tags_json = json::array();
         for (const auto& tag : session.tags) {
             tags_json.push_back(tag);
         }
         j["tags"] = tags_json;
-
+    
         // Convert checkpoint IDs to JSON array
         json checkpoint_ids_json = json::array();
         for (const auto& checkpoint_id : session.checkpoint_ids) {
             checkpoint_ids_json.push_back(checkpoint_id);
         }
         j["checkpoint_ids"] = checkpoint_ids_json;
-
+    
         // Convert memory node IDs to JSON array
         json memory_node_ids_json = json::array();
         for (const auto& memory_node_id : session.memory_node_ids) {
             memory_node_ids_json.push_back(memory_node_id);
         }
         j["memory_node_ids"] = memory_node_ids_json;
-
+    
         // Add metadata
         json metadata_json;
         for (const auto& [key, value] : session.metadata) {
             metadata_json[key] = value;
         }
         j["metadata"] = metadata_json;
-
-        // Write to file
-        std::string file_path = getSessionFilePath(session.id);
-        std::ofstream file(file_path);
-        if (!file.is_open()) {
-            return false;
-        }
-
-        file << j.dump(2); // Pretty print with 2 spaces indentation
-        return file.good();
-
-    } catch (const std::exception&) {
-        return false;
+    
+        return j.dump();
     }
-}
-
-std::optional<Session> SessionManager::loadSession(const std::string& session_id) {
-    try {
-        std::string file_path = getSessionFilePath(session_id);
-
-        // Check if file exists
-        if (!std::filesystem::exists(file_path)) {
-            return std::nullopt;
-        }
-
-        // Read and parse JSON
-        std::ifstream file(file_path);
-        if (!file.is_open()) {
-            return std::nullopt;
-        }
-
-        json j;
-        file >> j;
-
+    
+    // Throws on malformed JSON
+    Session sessionFromJson(const std::string& data) {
+        json j = json::parse(data);
+    
         // Convert JSON to Session
         Session session;
         session.id = j["id"].get<std::string>();
         session.created_at = j["created_at"].get<std::string>();
         session.updated_at = j["updated_at"].get<std::string>();
-
+    
         // Parse enhanced fields (with defaults for backward compatibility)
         session.name = j.value("name", "");
         session.description = j.value("description", "");
         session.parent_session_id = j.value("parent_session_id", "");
         session.total_tokens = j.value("total_tokens", size_t(0));
+        session.token_encoding = j.value("token_encoding", "");
         session.is_compressed = j.value("is_compressed", false);
         session.last_checkpoint_id = j.value("last_checkpoint_id", "");
-
+    
         // Parse entries
         if (j.contains("entries") && j["entries"].is_array()) {
             for (const auto& entry_json : j["entries"]) {
-                HistoryEntry entry;
-                entry.role = entry_json["role"].get<std::string>();
-                entry.content = entry_json["content"].get<std::string>();
-                entry.timestamp = entry_json["timestamp"].get<std::string>();
-                session.entries.push_back(entry);
+                session.entries.push_back(entryFromJson(entry_json));
             }
         }
-
+    
         // Parse child session IDs
         if (j.contains("child_session_ids") && j["child_session_ids"].is_array()) {
             for (const auto& child_id_json : j["child_session_ids"]) {
                 session.child_session_ids.push_back(child_id_json.get<std::string>());
             }
         }
-
+    
         // Parse tags
         if (j.contains("tags") && j["tags"].is_array()) {
             for (const auto& tag_json : j["tags"]) {
                 session.tags.insert(tag_json.get<std::string>());
             }
         }
-
+    
         // Parse checkpoint IDs
         if (j.contains("checkpoint_ids") && j["checkpoint_ids"].is_array()) {
             for (const auto& checkpoint_id_json : j["checkpoint_ids"]) {
                 session.checkpoint_ids.push_back(checkpoint_id_json.get<std::string>());
             }
         }
-
+    
         // Parse memory node IDs
         if (j.contains("memory_node_ids") && j["memory_node_ids"].is_array()) {
             for (const auto& memory_node_id_json : j["memory_node_ids"]) {
                 session.memory_node_ids.push_back(memory_node_id_json.get<std::string>());
             }
         }
-
+    
         // Parse metadata
         if (j.contains("metadata") && j["metadata"].is_object()) {
             for (auto& [key, value] : j["metadata"].items()) {
                 session.metadata[key] = value.get<std::string>();
             }
         }
-
+    
         return session;
-
-    } catch (const std::exception&) {
-        return std::nullopt;
     }
-}
 
-std::string SessionManager::createSessionId() {
-    // Generate session ID with timestamp and random component
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    
-    std::stringstream ss;
-    ss << "session_";
-    ss << std::put_time(std::gmtime(&time_t), "%Y%m%d_%H%M%S");
-    ss << "_" << generateRandomString(8);
-    
-    return ss.str();
-}
+    // Writes the session file and starts a new journal on it; the caller
+    // holds the session's lock exclusively
+    bool writeSessionLocked(const Session& session) {
+        try {
+            // JSON unless binary was asked for; compression is per entry in
+            // binary files, so they stay readable in place
+            std::string data;
+            bool compress = session.is_compressed && utils::Compression::isAvailable();
+            if (compress) {
+                useSessionDictionaries();
+            }
+            if (storageFormat().load(std::memory_order_relaxed) == SessionFormat::BINARY) {
+                data = BinarySessionFormat::encode(session, compress);
+            } else {
+                data = sessionToJson(session);
+                if (compress) {
+                    data = utils::Compression::compress(data);
+                }
+            }
 
-std::string SessionManager::createNewSession() {
+            // With syncing on, the new file and the rename are on disk before
+            // this returns
+            bool durable = syncAppends().load(std::memory_order_relaxed);
+            if (!replaceFile(getSessionFilePath(session.id), data, durable)) {
+                return false;
+            }
+
+            // The session file now holds every entry
+            if (!resetJournal(session.id, session.entries.size())) {
+                return false;
+            }
+            if (durable && !syncSessionDirectory()) {
+                return false;
+            }
+            // Under the lock, so the catalog and index see this session's
+            // writes in the order they were made
+            updateCatalog(session);
+            updateSearchIndex(session);
+            if (auto stamp = SessionManager::getSessionStamp(session.id)) {
+                SessionCache::put(session, *stamp);
+            }
+            return true;
+
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // loadSession(), also giving the stamp of the files the session was read
+    // from when `stamp_out` is set
+    std::optional<Session> loadStampedSession(const std::string& session_id, SessionStamp* stamp_out) {
+        try {
+            // A cached copy is returned only while the files still have its stamp
+            auto stamp = SessionManager::getSessionStamp(session_id);
+            if (auto cached = SessionCache::get(session_id, stamp, currentBatch().id)) {
+                if (stamp_out && stamp) {
+                    *stamp_out = *stamp;
+                }
+                return cached;
+            }
+
+            // Stamped again under the lock, so the stamp matches the file and
+            // journal read; no writer can replace either meanwhile
+            auto lock = lockSession(session_id, utils::FileLock::Mode::SHARED);
+            stamp = SessionManager::getSessionStamp(session_id);
+            if (!stamp) {
+                return std::nullopt;
+            }
+
+            // Binary files are read in place; JSON is read, decompressed if
+            // needed and parsed
+            std::string file_path = getSessionFilePath(session_id);
+            Session session;
+            SessionView view;
+            if (view.open(file_path)) {
+                useSessionDictionaries();
+                auto materialized = view.materialize();
+                if (!materialized) {
+                    return std::nullopt;
+                }
+                session = std::move(*materialized);
+            } else {
+                auto data = readSessionFile(file_path);
+                if (!data) {
+                    return std::nullopt;
+                }
+                if (utils::Compression::isCompressed(*data)) {
+                    useSessionDictionaries();
+                    data = utils::Compression::decompress(*data);
+                    if (!data) {
+                        return std::nullopt;
+                    }
+                }
+                session = sessionFromJson(*data);
+            }
+
+            // Entries added since the file was written
+            replayJournal(session_id, session, session.entries.size());
+
+            SessionCache::put(session, *stamp);
+            if (stamp_out) {
+                *stamp_out = *stamp;
+            }
+            return session;
+
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+
+    // Attempts at a change before it is made holding the session's lock
+    constexpr int MAX_WRITE_ATTEMPTS = 3;
+
+    // Loads the session, applies `change` and writes the result, without
+    // holding the session's lock while `change` runs: the result is written
+    // only if the files still have the version it was loaded from, and
+    // otherwise `change` is applied again to the newer version. The last
+    // attempt holds the lock throughout, so a busy session cannot starve a
+    // change. `change` returns false to leave the session as it is. `append`
+    // gets the versions the write went between.
+    bool updateSession(const std::string& session_id, const std::function<bool(Session&)>& change,
+                       std::optional<SessionAppend>* append = nullptr) {
+        if (currentBatch().depth > 0) {
+            auto session_opt = SessionManager::loadSession(session_id);
+            return session_opt && (!change(*session_opt) || SessionManager::saveSession(*session_opt));
+        }
+
+        openCatalog();
+        openSearchIndex();
+        for (int attempt = 1;; ++attempt) {
+            std::optional<utils::FileLock> held;
+            if (attempt == MAX_WRITE_ATTEMPTS) {
+                held.emplace(getSessionLockPath(session_id), utils::FileLock::Mode::EXCLUSIVE);
+            }
+            SessionStamp stamp;
+            auto session_opt = loadStampedSession(session_id, &stamp);
+            if (!session_opt) {
+                return false;
+            }
+            if (!change(*session_opt)) {
+                return true;
+            }
+
+            auto lock = lockSession(session_id, utils::FileLock::Mode::EXCLUSIVE);
+            if (SessionManager::getSessionStamp(session_id) != stamp) {
+                continue;  // Another process wrote it since it was loaded
+            }
+            if (!writeSessionLocked(*session_opt)) {
+                return false;
+            }
+            if (append) {
+                if (auto written = SessionManager::getSessionStamp(session_id)) {
+                    *append = SessionAppend{stamp, *written};
+                }
+            }
+            return true;
+        }
+    }
+
+    // Runs an operation that changes sessions inside `batch`, again while
+    // the batch fails on another process's change to one of its sessions
+    bool commitWithRetry(const std::function<bool(SessionWriteBatch& batch)>& operation) {
+        for (int attempt = 1;; ++attempt) {
+            SessionWriteBatch batch;
+            bool ok = operation(batch);
+            if (!ok) {
+                batch.discard();  // Keep none of what it changed before failing
+            }
+            if (ok || !batch.conflicted() || attempt == MAX_WRITE_ATTEMPTS) {
+                return ok;
+            }
+        }
+    }
+}
+
+bool SessionManager::saveSession(const Session& session) {
+    // Written when the batch commits
+    if (currentBatch().depth > 0) {
+        SessionCache::markDirty(session, currentBatch().id);
+        return true;
+    }
+
+    // Opened first: building either reads the sessions, some of which other
+    // writers may hold while waiting for this one
+    openCatalog();
+    openSearchIndex();
+    auto lock = lockSession(session.id, utils::FileLock::Mode::EXCLUSIVE);
+    return writeSessionLocked(session);
+}
+
+std::optional<Session> SessionManager::loadSession(const std::string& session_id) {
+    return loadStampedSession(session_id, nullptr);
+}
+
+std::string SessionManager::createSessionId() {
+    // Generate session ID with timestamp and random component
+    auto now = std::chrono::system_clock::now();
+    auto time_t = std::chrono::system_clock::to_time_t(now);
+    
+    std::stringstream ss;
+    ss << "session_";
+    ss << std::put_time(std::gmtime(&time_t), "%Y%m%d_%H%M%S");
+    ss << "_" << generateRandomString(8);
+    
+    return ss.str();
+}
+
+std::string SessionManager::createNewSession() {
     std::string session_id = createSessionId();
     std::string timestamp = getCurrentTimestamp();
     
@@ -254,6 +1027,7 @@ std::string SessionManager::createNewSession() {
     session.id = session_id;
     session.created_at = timestamp;
     session.updated_at = timestamp;
+    session.is_compressed = utils::Compression::isAvailable();
     
     if (saveSession(session)) {
         return session_id;
@@ -264,50 +1038,259 @@ std::string SessionManager::createNewSession() {
 
 bool SessionManager::addEntryToSession(const std::string& session_id,
                                       const std::string& role,
-                                      const std::string& content) {
-    auto session_opt = loadSession(session_id);
-    if (!session_opt) {
-        return false;
+                                      const std::string& content,
+                                      const std::string& model,
+                                      std::optional<SessionAppend>* append) {
+    if (append) {
+        append->reset();
     }
-    
     HistoryEntry entry;
     entry.role = role;
     entry.content = content;
     entry.timestamp = getCurrentTimestamp();
     
-    session_opt->entries.push_back(entry);
-    session_opt->updated_at = entry.timestamp;
+    // A session with unwritten changes takes the full path, or writing them
+    // back would drop the appended entry
+    if (!SessionCache::isDirty(session_id, currentBatch().id)) {
+        // Opened first: building either from the files after the append
+        // would already count this entry
+        openCatalog();
+        openSearchIndex();
     
-    return saveSession(*session_opt);
+        // Appends to one session take turns, so each sees the journal the
+        // last one left and none lands in a journal a save is replacing;
+        // other sessions' appends go ahead
+        std::optional<utils::FileLock> lock;
+        lock.emplace(getSessionLockPath(session_id), utils::FileLock::Mode::EXCLUSIVE);
+        auto base_stamp = getFileStamp(getSessionFilePath(session_id));
+        if (!base_stamp) {
+            return false;
+        }
+    
+        // Append to the journal while it extends the current session file
+        // and is not due for compaction
+        std::string journal_path = getJournalPath(session_id);
+        auto journal_stamp = getFileStamp(journal_path);
+        if (journal_stamp && journal_stamp->file_size <= std::max(MIN_COMPACTION_BYTES, base_stamp->file_size)) {
+            std::ifstream journal(journal_path, std::ios::binary);
+            auto header = readJournalHeader(journal);
+            if (header && journalExtends(*header, *base_stamp)) {
+                entry.token_count = static_cast<size_t>(
+                    utils::TokenCounter::countTokensForModel(entry.content, model));
+                json record = entryToJson(entry);
+                record["encoding"] = utils::TokenCounter::getTokenizerName(model);
+                if (!model.empty()) {
+                    record["model"] = model;
+                }
+    
+                SessionStamp stamp = combineStamps(*base_stamp, journal_stamp);
+                PendingFlush pending;
+                if (!appendToJournal(journal_path, record.dump() + "\n", pending)) {
+                    return false;
+                }
+    
+                // The cached copy gets the entry as replayJournal() would add it
+                if (auto new_stamp = getSessionStamp(session_id)) {
+                    if (append) {
+                        *append = SessionAppend{stamp, *new_stamp};
+                    }
+                    SessionCache::update(session_id, stamp, *new_stamp, [&](Session& session) {
+                        HistoryEntry cached_entry = entry;
+                        std::string encoding = record["encoding"].get<std::string>();
+                        if (!model.empty()) {
+                            session.metadata["model"] = model;
+                        }
+                        if (session.token_encoding.empty()) {
+                            session.token_encoding = encoding;
+                        } else if (encoding != session.token_encoding) {
+                            cached_entry.token_count = 0;
+                        }
+                        session.total_tokens += cached_entry.token_count;
+                        session.updated_at = cached_entry.timestamp;
+                        session.entries.push_back(std::move(cached_entry));
+                    });
+                }
+    
+                // Refreshed under the lock, so the catalog entry counts the
+                // entries other processes appended before this one
+                std::optional<CatalogEntry> catalog_entry;
+                if (SessionCatalog::open(getSessionDirectory())) {
+                    catalog_entry = SessionCatalog::find(session_id);
+                }
+                if (!catalog_entry || !SessionIndex::contains(session_id)) {
+                    auto session_opt = loadSession(session_id);
+                    if (session_opt) {
+                        updateCatalog(*session_opt);
+                        updateSearchIndex(*session_opt);
+                    }
+                } else {
+                    SessionIndex::addEntry(session_id, entry.content);
+                    addSemanticTurn(session_id, catalog_entry->entry_count, entry.content);
+                    catalog_entry->entry_count++;
+                    catalog_entry->total_tokens += entry.token_count;
+                    catalog_entry->updated_at = entry.timestamp;
+                    catalog_entry->size_bytes = getSessionSize(session_id);
+                    SessionCatalog::put(*catalog_entry);
+                }
+    
+                // A compaction meanwhile writes the entry into the session
+                // file, which it flushes itself
+                lock.reset();
+                return pending.flush();
+            }
+        }
+    }
+    
+    // Full rewrite, which folds the journal into the session file
+    return updateSession(session_id, [&](Session& session) {
+        session.entries.push_back(entry);
+        session.updated_at = entry.timestamp;
+        if (!model.empty()) {
+            session.metadata["model"] = model;
+        }
+        updateTokenCounts(session);
+        return true;
+    }, append);
 }
 
 std::vector<std::string> SessionManager::listSessions() {
-    std::vector<std::string> sessions;
-    
+    openCatalog();
+    return SessionCatalog::select();
+}
+
+bool SessionManager::rebuildCatalog() {
+    std::vector<CatalogEntry> entries;
     try {
         std::string session_dir = getSessionDirectory();
-        
+        SessionCatalog::open(session_dir);
+
         for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
             if (entry.is_regular_file() && entry.path().extension() == ".json") {
                 std::string filename = entry.path().filename().string();
-                // Remove .json extension
-                sessions.push_back(filename.substr(0, filename.length() - 5));
+                std::string session_id = filename.substr(0, filename.length() - 5);
+
+                auto session_opt = loadSession(session_id);
+                if (!session_opt) continue;
+
+                updateTokenCounts(*session_opt);
+                entries.push_back(makeCatalogEntry(*session_opt, getSessionSize(session_id)));
             }
         }
-        
-        // Sort by session ID (which includes timestamp)
-        std::sort(sessions.rbegin(), sessions.rend());
-        
+
     } catch (const std::exception&) {
-        // Return empty list on error
+        return false;
     }
-    
-    return sessions;
+
+    return SessionCatalog::rebuild(entries);
+}
+
+bool SessionManager::rebuildSearchIndex() {
+    try {
+        std::string session_dir = getSessionDirectory();
+        SessionIndex::open(session_dir);
+        if (!SessionIndex::clear()) {
+            return false;
+        }
+
+        for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".json") {
+                std::string filename = entry.path().filename().string();
+                std::string session_id = filename.substr(0, filename.length() - 5);
+
+                // Binary files are indexed in place, without loading them
+                SessionView view;
+                std::optional<Session> session_opt;
+                std::deque<std::string> buffers;    // Decompressed entries
+                std::vector<std::string_view> contents;
+                if (!SessionCache::isDirty(session_id, currentBatch().id) && openSessionView(session_id, view)) {
+                    for (size_t i = 0; i < view.entryCount(); ++i) {
+                        buffers.emplace_back();
+                        if (auto content = view.content(i, buffers.back())) {
+                            contents.push_back(*content);
+                        }
+                    }
+                } else if ((session_opt = loadSession(session_id))) {
+                    for (const auto& history_entry : session_opt->entries) {
+                        contents.push_back(history_entry.content);
+                    }
+                } else {
+                    continue;
+                }
+                SessionIndex::indexSession(session_id, contents);
+            }
+        }
+
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    // One segment rather than a log of every session
+    return SessionIndex::merge();
+}
+
+bool SessionManager::rebuildSemanticIndex() {
+    try {
+        std::string session_dir = getSessionDirectory();
+        if (!SemanticIndex::open(session_dir) && !SemanticIndex::clear()) {
+            return false;
+        }
+        if (!SemanticIndex::removeAllTurns()) {
+            return false;
+        }
+        std::unordered_set<std::string> indexed_nodes;
+
+        for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".json") {
+                std::string filename = entry.path().filename().string();
+                std::string session_id = filename.substr(0, filename.length() - 5);
+
+                std::deque<std::string> buffers;
+                bool read = visitContents(session_id, [&](std::string_view content) {
+                    buffers.emplace_back(content);
+                    return true;
+                });
+                if (!read) {
+                    continue;
+                }
+                std::vector<std::string_view> contents(buffers.begin(), buffers.end());
+                SemanticIndex::indexSession(session_id, contents);
+
+                // Backfills memory nodes made before the vector index existed
+                // or outside SessionManager
+                for (const auto& node_id : clion::llm::MemoryManager::getSessionMemoryNodes(session_id)) {
+                    if (indexed_nodes.insert(node_id).second) {
+                        indexMemoryNode(node_id);
+                    }
+                }
+            }
+        }
+
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
 }
 
 bool SessionManager::deleteSession(const std::string& session_id) {
     try {
         std::string file_path = getSessionFilePath(session_id);
+        openCatalog();
+        openSearchIndex();
+        auto lock = lockSession(session_id, utils::FileLock::Mode::EXCLUSIVE);
+
+        // Drop the journal, summary and any serialized history caches kept beside the session
+        std::error_code ec;
+        std::filesystem::remove(getJournalPath(session_id), ec);
+        std::filesystem::remove(getSummaryPath(session_id), ec);
+        for (const char* format : {"openai", "gemini"}) {
+            std::filesystem::remove(getPayloadCachePath(session_id, format), ec);
+        }
+
+        SessionCache::erase(session_id);
+        SessionCatalog::remove(session_id);
+        SessionIndex::remove(session_id);
+        SemanticIndex::removeSession(session_id);
+
         return std::filesystem::remove(file_path);
     } catch (const std::exception&) {
         return false;
@@ -319,6 +1302,192 @@ bool SessionManager::sessionExists(const std::string& session_id) {
     return std::filesystem::exists(file_path);
 }
 
+std::optional<SessionStamp> SessionManager::getSessionStamp(const std::string& session_id) {
+    auto stamp = getFileStamp(getSessionFilePath(session_id));
+    if (!stamp) {
+        return std::nullopt;
+    }
+    return combineStamps(*stamp, getFileStamp(getJournalPath(session_id)));
+}
+
+bool SessionManager::compactSession(const std::string& session_id) {
+    return updateSession(session_id, [](Session&) { return true; });
+}
+
+void SessionManager::setSyncOnAppend(bool enabled) {
+    syncAppends().store(enabled, std::memory_order_relaxed);
+}
+
+void SessionManager::setStorageFormat(SessionFormat format) {
+    storageFormat().store(format, std::memory_order_relaxed);
+}
+
+bool SessionManager::openSessionView(const std::string& session_id, SessionView& view) {
+    try {
+        // The mapping keeps the file it opened after a save replaces it
+        auto lock = lockSession(session_id, utils::FileLock::Mode::SHARED);
+        if (!view.open(getSessionFilePath(session_id))) {
+            return false;
+        }
+        useSessionDictionaries();
+        Session tail = view.header();
+        replayJournal(session_id, tail, view.entryCount());
+        if (!tail.entries.empty()) {
+            view.append(std::move(tail));
+        }
+        return true;
+
+    } catch (const std::exception&) {
+        view.close();
+        return false;
+    }
+}
+
+bool SessionManager::exportSession(const std::string& session_id, const std::string& path) {
+    auto session_opt = loadSession(session_id);
+    if (!session_opt) {
+        return false;
+    }
+    try {
+        return writeNewFile(path, sessionToJson(*session_opt), false);
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+std::optional<std::string> SessionManager::importSession(const std::string& path) {
+    try {
+        auto data = readSessionFile(path);
+        if (!data) {
+            return std::nullopt;
+        }
+
+        std::optional<Session> session_opt;
+        SessionView view;
+        if (view.open(std::string_view(*data))) {
+            useSessionDictionaries();
+            session_opt = view.materialize();
+        } else {
+            if (utils::Compression::isCompressed(*data)) {
+                useSessionDictionaries();
+                data = utils::Compression::decompress(*data);
+                if (!data) {
+                    return std::nullopt;
+                }
+            }
+            session_opt = sessionFromJson(*data);
+        }
+        // The id names the files, so it must stay inside the session directory
+        if (!session_opt || session_opt->id.empty() || session_opt->id.find_first_of("/\\") != std::string::npos ||
+            session_opt->id[0] == '.' || !saveSession(*session_opt)) {
+            return std::nullopt;
+        }
+        return session_opt->id;
+
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+bool SessionManager::loadPayloadCache(const std::string& session_id,
+                                      const std::string& format,
+                                      SessionPayloadCache& cache) {
+    try {
+        std::ifstream file(getPayloadCachePath(session_id, format), std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        // First line is a JSON header, the serialized messages follow verbatim
+        std::string header_line;
+        if (!std::getline(file, header_line)) {
+            return false;
+        }
+        json header = json::parse(header_line);
+        if (header.value("version", 0) != 2 || header.value("format", "") != format) {
+            return false;
+        }
+
+        size_t length = header.value("bytes", size_t(0));
+        std::string messages(length, '\0');
+        if (length > 0 && !file.read(messages.data(), static_cast<std::streamsize>(length))) {
+            return false;  // Truncated cache file
+        }
+
+        cache.session_id = session_id;
+        cache.format = format;
+        cache.stamp.file_size = header.value("file_size", uintmax_t(0));
+        cache.stamp.modified_ns = header.value("modified_ns", int64_t(0));
+        cache.stamp.file_id = header.value("file_id", uint64_t(0));
+        cache.entry_count = header.value("entries", size_t(0));
+        cache.summarized_entries = header.value("summarized", size_t(0));
+        cache.tokens = header.value("tokens", 0);
+        cache.messages = std::move(messages);
+        return true;
+
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool SessionManager::savePayloadCache(const SessionPayloadCache& cache) {
+    try {
+        json header;
+        header["version"] = 2;
+        header["format"] = cache.format;
+        header["file_size"] = cache.stamp.file_size;
+        header["modified_ns"] = cache.stamp.modified_ns;
+        header["file_id"] = cache.stamp.file_id;
+        header["entries"] = cache.entry_count;
+        header["summarized"] = cache.summarized_entries;
+        header["tokens"] = cache.tokens;
+        header["bytes"] = cache.messages.size();
+
+        // Replaced whole, so a process reading it while another writes it
+        // sees one version or the other
+        std::string data = header.dump() + "\n";
+        data += cache.messages;
+        return replaceFile(getPayloadCachePath(cache.session_id, cache.format), data, false);
+
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool SessionManager::loadHistorySummary(const std::string& session_id, HistorySummary& summary) {
+    try {
+        std::ifstream file(getSummaryPath(session_id));
+        if (!file.is_open()) {
+            return false;
+        }
+        json record = json::parse(file);
+        if (record.value("version", 0) != 1) {
+            return false;
+        }
+        summary.entries = record.value("entries", size_t(0));
+        summary.hash = record.value("hash", uint64_t(0));
+        summary.text = record.value("text", "");
+        return true;
+
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool SessionManager::saveHistorySummary(const std::string& session_id, const HistorySummary& summary) {
+    try {
+        json record;
+        record["version"] = 1;
+        record["entries"] = summary.entries;
+        record["hash"] = summary.hash;
+        record["text"] = summary.text;
+        return replaceFile(getSummaryPath(session_id), record.dump(), false);
+
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
 // Enhanced session management implementations
 
 std::string SessionManager::createNewSessionWithMetadata(const std::string& name,
@@ -337,7 +1506,7 @@ std::string SessionManager::createNewSessionWithMetadata(const std::string& name
     session.tags = tags;
     session.parent_session_id = parent_id;
     session.total_tokens = 0;
-    session.is_compressed = false;
+    session.is_compressed = utils::Compression::isAvailable();
 
     if (saveSession(session)) {
         // Update parent-child relationships if parent specified
@@ -354,117 +1523,76 @@ bool SessionManager::updateSessionMetadata(const std::string& session_id,
                                          const std::string& name,
                                          const std::string& description,
                                          const std::unordered_set<std::string>& tags) {
-    auto session_opt = loadSession(session_id);
-    if (!session_opt) {
-        return false;
-    }
-
-    Session& session = *session_opt;
-
-    if (!name.empty()) {
-        session.name = name;
-    }
-
-    if (!description.empty()) {
-        session.description = description;
-    }
+    return updateSession(session_id, [&](Session& session) {
+        if (!name.empty()) {
+            session.name = name;
+        }
 
-    if (!tags.empty()) {
-        session.tags.insert(tags.begin(), tags.end());
-    }
+        if (!description.empty()) {
+            session.description = description;
+        }
 
-    session.updated_at = getCurrentTimestamp();
+        if (!tags.empty()) {
+            session.tags.insert(tags.begin(), tags.end());
+        }
 
-    return saveSession(session);
+        session.updated_at = getCurrentTimestamp();
+        return true;
+    });
 }
 
 bool SessionManager::addTagsToSession(const std::string& session_id,
                                     const std::unordered_set<std::string>& tags) {
-    auto session_opt = loadSession(session_id);
-    if (!session_opt) {
-        return false;
-    }
-
-    Session& session = *session_opt;
-    session.tags.insert(tags.begin(), tags.end());
-    session.updated_at = getCurrentTimestamp();
-
-    return saveSession(session);
+    return updateSession(session_id, [&](Session& session) {
+        session.tags.insert(tags.begin(), tags.end());
+        session.updated_at = getCurrentTimestamp();
+        return true;
+    });
 }
 
 bool SessionManager::removeTagsFromSession(const std::string& session_id,
                                          const std::unordered_set<std::string>& tags) {
-    auto session_opt = loadSession(session_id);
-    if (!session_opt) {
-        return false;
-    }
-
-    Session& session = *session_opt;
-    for (const auto& tag : tags) {
-        session.tags.erase(tag);
-    }
-    session.updated_at = getCurrentTimestamp();
-
-    return saveSession(session);
-}
-
-std::optional<Session> SessionManager::getSessionWithMetadata(const std::string& session_id) {
-    return loadSession(session_id);
-}
-
-std::vector<std::string> SessionManager::findSessionsByTag(const std::string& tag) {
-    std::vector<std::string> matching_sessions;
-
-    try {
-        std::string session_dir = getSessionDirectory();
-
-        for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".json") {
-                std::string filename = entry.path().filename().string();
-                std::string session_id = filename.substr(0, filename.length() - 5);
-
-                auto session_opt = loadSession(session_id);
-                if (session_opt && session_opt->tags.find(tag) != session_opt->tags.end()) {
-                    matching_sessions.push_back(session_id);
-                }
-            }
+    return updateSession(session_id, [&](Session& session) {
+        for (const auto& tag : tags) {
+            session.tags.erase(tag);
         }
+        session.updated_at = getCurrentTimestamp();
+        return true;
+    });
+}
 
-    } catch (const std::exception&) {
-        // Return empty list on error
-    }
+std::optional<Session> SessionManager::getSessionWithMetadata(const std::string& session_id) {
+    return loadSession(session_id);
+}
 
-    return matching_sessions;
+std::vector<std::string> SessionManager::findSessionsByTag(const std::string& tag) {
+    openCatalog();
+    return SessionCatalog::select([&](const CatalogEntry& entry) {
+        return std::binary_search(entry.tags.begin(), entry.tags.end(), tag);
+    });
 }
 
 std::vector<std::string> SessionManager::findSessionsByName(const std::string& name_pattern) {
-    std::vector<std::string> matching_sessions;
     std::regex pattern_regex(name_pattern, std::regex_constants::icase);
 
-    try {
-        std::string session_dir = getSessionDirectory();
+    openCatalog();
+    return SessionCatalog::select([&](const CatalogEntry& entry) {
+        return std::regex_search(entry.name, pattern_regex);
+    });
+}
 
-        for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".json") {
-                std::string filename = entry.path().filename().string();
-                std::string session_id = filename.substr(0, filename.length() - 5);
+std::vector<std::string> SessionManager::findSessionsByContent(const std::string& content_pattern) {
+    std::vector<std::string> matching_sessions;
 
-                auto session_opt = loadSession(session_id);
-                if (session_opt && std::regex_search(session_opt->name, pattern_regex)) {
-                    matching_sessions.push_back(session_id);
-                }
-            }
+    // Plain words go through the index
+    SearchQuery query = phraseQuery(content_pattern);
+    if (!query.terms.empty() && content_pattern.find_first_of(".^$|()[]{}*+?\\") == std::string::npos) {
+        for (auto& hit : searchIndex(query, 0)) {
+            matching_sessions.push_back(std::move(hit.session_id));
         }
-
-    } catch (const std::exception&) {
-        // Return empty list on error
+        return matching_sessions;
     }
 
-    return matching_sessions;
-}
-
-std::vector<std::string> SessionManager::findSessionsByContent(const std::string& content_pattern) {
-    std::vector<std::string> matching_sessions;
     std::regex pattern_regex(content_pattern, std::regex_constants::icase);
 
     try {
@@ -475,16 +1603,11 @@ std::vector<std::string> SessionManager::findSessionsByContent(const std::string
                 std::string filename = entry.path().filename().string();
                 std::string session_id = filename.substr(0, filename.length() - 5);
 
-                auto session_opt = loadSession(session_id);
-                if (!session_opt) continue;
-
                 bool found = false;
-                for (const auto& entry : session_opt->entries) {
-                    if (std::regex_search(entry.content, pattern_regex)) {
-                        found = true;
-                        break;
-                    }
-                }
+                visitContents(session_id, [&](std::string_view content) {
+                    found = std::regex_search(content.begin(), content.end(), pattern_regex);
+                    return !found;
+                });
 
                 if (found) {
                     matching_sessions.push_back(session_id);
@@ -499,6 +1622,14 @@ std::vector<std::string> SessionManager::findSessionsByContent(const std::string
     return matching_sessions;
 }
 
+std::vector<SearchHit> SessionManager::searchSessionContent(const std::string& query, size_t limit) {
+    try {
+        return searchIndex(SessionIndex::parseQuery(query), limit);
+    } catch (const std::exception&) {
+        return {};
+    }
+}
+
 std::vector<std::string> SessionManager::getChildSessions(const std::string& parent_id) {
     auto session_opt = loadSession(parent_id);
     if (!session_opt) {
@@ -510,10 +1641,18 @@ std::vector<std::string> SessionManager::getChildSessions(const std::string& par
 
 std::vector<std::string> SessionManager::getSessionHierarchy(const std::string& session_id) {
     std::vector<std::string> hierarchy;
+    std::unordered_set<std::string> seen;
     std::string current_id = session_id;
 
-    while (!current_id.empty()) {
+    // Parents come from the catalog, or the cache for changes not yet written
+    openCatalog();
+    while (!current_id.empty() && seen.insert(current_id).second) {
         hierarchy.push_back(current_id);
+        auto entry = SessionCache::isDirty(current_id, currentBatch().id) ? std::nullopt : SessionCatalog::find(current_id);
+        if (entry) {
+            current_id = entry->parent_session_id;
+            continue;
+        }
         auto session_opt = loadSession(current_id);
         if (!session_opt) break;
         current_id = session_opt->parent_session_id;
@@ -524,88 +1663,106 @@ std::vector<std::string> SessionManager::getSessionHierarchy(const std::string&
 }
 
 bool SessionManager::setParentSession(const std::string& session_id, const std::string& parent_id) {
-    auto session_opt = loadSession(session_id);
-    if (!session_opt) {
-        return false;
-    }
-
-    auto parent_opt = loadSession(parent_id);
-    if (!parent_opt) {
-        return false;
-    }
+    // Each session is written once, even when the old and new parent are the same
+    return commitWithRetry([&](SessionWriteBatch& batch) {
+        auto session_opt = loadSession(session_id);
+        if (!session_opt || !loadSession(parent_id)) {
+            return false;
+        }
 
-    Session& session = *session_opt;
-    Session& parent = *parent_opt;
+        Session& session = *session_opt;
+        if (session.parent_session_id == parent_id) {
+            auto siblings = getChildSessions(parent_id);
+            if (std::find(siblings.begin(), siblings.end(), session_id) != siblings.end()) {
+                return true; // Already a child
+            }
+        }
 
-    // Remove from old parent's child list
-    if (!session.parent_session_id.empty()) {
-        auto old_parent_opt = loadSession(session.parent_session_id);
-        if (old_parent_opt) {
-            auto& child_ids = old_parent_opt->child_session_ids;
-            child_ids.erase(std::remove(child_ids.begin(), child_ids.end(), session_id), child_ids.end());
-            saveSession(*old_parent_opt);
+        // Remove from old parent's child list
+        if (!session.parent_session_id.empty()) {
+            auto old_parent_opt = loadSession(session.parent_session_id);
+            if (old_parent_opt) {
+                auto& child_ids = old_parent_opt->child_session_ids;
+                child_ids.erase(std::remove(child_ids.begin(), child_ids.end(), session_id), child_ids.end());
+                saveSession(*old_parent_opt);
+            }
         }
-    }
 
-    // Update session's parent
-    session.parent_session_id = parent_id;
-    session.updated_at = getCurrentTimestamp();
+        // Update session's parent
+        session.parent_session_id = parent_id;
+        session.updated_at = getCurrentTimestamp();
+        saveSession(session);
 
-    // Add to new parent's child list
-    parent.child_session_ids.push_back(session_id);
-    parent.updated_at = getCurrentTimestamp();
+        // Add to new parent's child list; loaded after the change above, which may have been to it
+        auto parent_opt = loadSession(parent_id);
+        if (!parent_opt) {
+            return false;
+        }
+        Session& parent = *parent_opt;
+        parent.child_session_ids.push_back(session_id);
+        parent.updated_at = getCurrentTimestamp();
+        saveSession(parent);
 
-    return saveSession(session) && saveSession(parent);
+        return batch.commit();
+    });
 }
 
 bool SessionManager::addChildSession(const std::string& parent_id, const std::string& child_id) {
-    auto parent_opt = loadSession(parent_id);
-    auto child_opt = loadSession(child_id);
+    return commitWithRetry([&](SessionWriteBatch& batch) {
+        auto parent_opt = loadSession(parent_id);
+        auto child_opt = loadSession(child_id);
 
-    if (!parent_opt || !child_opt) {
-        return false;
-    }
+        if (!parent_opt || !child_opt) {
+            return false;
+        }
 
-    Session& parent = *parent_opt;
-    Session& child = *child_opt;
+        Session& parent = *parent_opt;
+        Session& child = *child_opt;
 
-    // Check if already a child
-    auto it = std::find(parent.child_session_ids.begin(), parent.child_session_ids.end(), child_id);
-    if (it != parent.child_session_ids.end()) {
-        return true; // Already a child
-    }
+        // Check if already a child
+        auto it = std::find(parent.child_session_ids.begin(), parent.child_session_ids.end(), child_id);
+        if (it != parent.child_session_ids.end()) {
+            return true; // Already a child
+        }
 
-    parent.child_session_ids.push_back(child_id);
-    parent.updated_at = getCurrentTimestamp();
+        parent.child_session_ids.push_back(child_id);
+        parent.updated_at = getCurrentTimestamp();
 
-    child.parent_session_id = parent_id;
-    child.updated_at = getCurrentTimestamp();
+        child.parent_session_id = parent_id;
+        child.updated_at = getCurrentTimestamp();
 
-    return saveSession(parent) && saveSession(child);
+        saveSession(parent);
+        saveSession(child);
+        return batch.commit();
+    });
 }
 
 bool SessionManager::removeChildSession(const std::string& parent_id, const std::string& child_id) {
-    auto parent_opt = loadSession(parent_id);
-    auto child_opt = loadSession(child_id);
+    return commitWithRetry([&](SessionWriteBatch& batch) {
+        auto parent_opt = loadSession(parent_id);
+        auto child_opt = loadSession(child_id);
 
-    if (!parent_opt || !child_opt) {
-        return false;
-    }
+        if (!parent_opt || !child_opt) {
+            return false;
+        }
 
-    Session& parent = *parent_opt;
-    Session& child = *child_opt;
+        Session& parent = *parent_opt;
+        Session& child = *child_opt;
 
-    // Remove from parent's child list
-    auto& child_ids = parent.child_session_ids;
-    child_ids.erase(std::remove(child_ids.begin(), child_ids.end(), child_id), child_ids.end());
+        // Remove from parent's child list
+        auto& child_ids = parent.child_session_ids;
+        child_ids.erase(std::remove(child_ids.begin(), child_ids.end(), child_id), child_ids.end());
 
-    parent.updated_at = getCurrentTimestamp();
+        parent.updated_at = getCurrentTimestamp();
 
-    // Remove child's parent reference
-    child.parent_session_id.clear();
-    child.updated_at = getCurrentTimestamp();
+        // Remove child's parent reference
+        child.parent_session_id.clear();
+        child.updated_at = getCurrentTimestamp();
 
-    return saveSession(parent) && saveSession(child);
+        saveSession(parent);
+        saveSession(child);
+        return batch.commit();
+    });
 }
 
 std::string SessionManager::createCheckpoint(const std::string& session_id,
@@ -621,11 +1778,12 @@ std::string SessionManager::createCheckpoint(const std::string& session_id,
 
     if (!checkpoint_id.empty()) {
         // Associate checkpoint with session
-        Session& session = *session_opt;
-        session.checkpoint_ids.push_back(checkpoint_id);
-        session.last_checkpoint_id = checkpoint_id;
-        session.updated_at = getCurrentTimestamp();
-        saveSession(session);
+        updateSession(session_id, [&](Session& session) {
+            session.checkpoint_ids.push_back(checkpoint_id);
+            session.last_checkpoint_id = checkpoint_id;
+            session.updated_at = getCurrentTimestamp();
+            return true;
+        });
     }
 
     return checkpoint_id;
@@ -643,14 +1801,12 @@ bool SessionManager::deleteSessionCheckpoints(const std::string& session_id) {
     size_t deleted_count = clion::llm::SessionCheckpointManager::deleteSessionCheckpoints(session_id);
 
     // Remove checkpoint associations from session
-    auto session_opt = loadSession(session_id);
-    if (session_opt) {
-        Session& session = *session_opt;
+    updateSession(session_id, [](Session& session) {
         session.checkpoint_ids.clear();
         session.last_checkpoint_id.clear();
         session.updated_at = getCurrentTimestamp();
-        saveSession(session);
-    }
+        return true;
+    });
 
     return deleted_count > 0;
 }
@@ -668,10 +1824,12 @@ std::string SessionManager::createMemoryFromSession(const std::string& session_i
 
     if (!memory_id.empty()) {
         // Associate memory with session
-        Session& session = *session_opt;
-        session.memory_node_ids.push_back(memory_id);
-        session.updated_at = getCurrentTimestamp();
-        saveSession(session);
+        updateSession(session_id, [&](Session& session) {
+            session.memory_node_ids.push_back(memory_id);
+            session.updated_at = getCurrentTimestamp();
+            return true;
+        });
+        indexMemoryNode(memory_id);
     }
 
     return memory_id;
@@ -687,18 +1845,17 @@ bool SessionManager::associateMemoryWithSession(const std::string& session_id,
 
     if (success) {
         // Update session's memory associations
-        auto session_opt = loadSession(session_id);
-        if (session_opt) {
-            Session& session = *session_opt;
-
+        updateSession(session_id, [&](Session& session) {
             // Check if already associated
             auto it = std::find(session.memory_node_ids.begin(), session.memory_node_ids.end(), memory_node_id);
-            if (it == session.memory_node_ids.end()) {
-                session.memory_node_ids.push_back(memory_node_id);
-                session.updated_at = getCurrentTimestamp();
-                saveSession(session);
+            if (it != session.memory_node_ids.end()) {
+                return false;
             }
-        }
+            session.memory_node_ids.push_back(memory_node_id);
+            session.updated_at = getCurrentTimestamp();
+            return true;
+        });
+        indexMemoryNode(memory_node_id);
     }
 
     return success;
@@ -708,39 +1865,52 @@ std::vector<std::string> SessionManager::getSessionMemoryNodes(const std::string
     return clion::llm::MemoryManager::getSessionMemoryNodes(session_id);
 }
 
-bool SessionManager::compressSession(const std::string& session_id) {
-    auto session_opt = loadSession(session_id);
-    if (!session_opt) {
-        return false;
-    }
-
-    Session& session = *session_opt;
-    session.is_compressed = true;
-    session.updated_at = getCurrentTimestamp();
-
-    return saveSession(session);
+std::vector<SemanticHit> SessionManager::searchSimilar(const std::string& text, size_t limit,
+                                                       float min_similarity) {
+    openSearchIndex();
+    return SemanticIndex::search(text, limit, min_similarity);
 }
 
-bool SessionManager::decompressSession(const std::string& session_id) {
-    auto session_opt = loadSession(session_id);
-    if (!session_opt) {
+bool SessionManager::indexMemoryNode(const std::string& memory_node_id) {
+    try {
+        openSearchIndex();
+        auto node_opt = clion::llm::MemoryManager::getMemoryNode(memory_node_id);
+        if (!node_opt) {
+            SemanticIndex::removeMemoryNode(memory_node_id);
+            return false;
+        }
+
+        // Everything a keyword search would have matched against
+        const auto& node = *node_opt;
+        std::string text = node.name + "\n" + node.description + "\n";
+        for (const auto& tag : node.tags) {
+            text += tag + " ";
+        }
+        text += "\n" + node.content;
+        return SemanticIndex::addMemoryNode(memory_node_id, text, node.importance_score);
+    } catch (const std::exception&) {
         return false;
     }
+}
 
-    Session& session = *session_opt;
-    session.is_compressed = false;
-    session.updated_at = getCurrentTimestamp();
+bool SessionManager::compressSession(const std::string& session_id) {
+    // Storage only: the session reads the same, so it keeps its updated_at
+    return updateSession(session_id, [](Session& session) {
+        session.is_compressed = true;
+        return true;
+    });
+}
 
-    return saveSession(session);
+bool SessionManager::decompressSession(const std::string& session_id) {
+    return updateSession(session_id, [](Session& session) {
+        session.is_compressed = false;
+        return true;
+    });
 }
 
 size_t SessionManager::getSessionSize(const std::string& session_id) {
-    std::string file_path = getSessionFilePath(session_id);
-    if (!std::filesystem::exists(file_path)) {
-        return 0;
-    }
-
-    return std::filesystem::file_size(file_path);
+    auto stamp = getSessionStamp(session_id);
+    return stamp ? static_cast<size_t>(stamp->file_size) : 0;
 }
 
 size_t SessionManager::getSessionTokenCount(const std::string& session_id) {
@@ -749,17 +1919,49 @@ size_t SessionManager::getSessionTokenCount(const std::string& session_id) {
         return 0;
     }
 
-    if (session_opt->total_tokens > 0) {
-        return session_opt->total_tokens;
-    }
+    // Entries counted when they were added keep their stored counts; only
+    // older or differently tokenized entries are counted here
+    updateTokenCounts(*session_opt);
+    return session_opt->total_tokens;
+}
 
-    // Calculate token count if not cached
-    size_t total_tokens = 0;
-    for (const auto& entry : session_opt->entries) {
-        total_tokens += entry.content.length() / 4; // Rough estimation
+bool SessionManager::trainCompressionDictionary(size_t max_samples) {
+    // zstd needs many samples; the start of each JSON session carries the
+    // structure shared between sessions, and binary files compress entries
+    // one by one, so each entry is a sample
+    constexpr size_t MAX_SAMPLE_BYTES = 64 * 1024;
+    std::vector<std::string> samples;
+    for (const auto& session_id : listSessions()) {
+        if (samples.size() >= max_samples) {
+            break;
+        }
+        SessionView view;
+        if (openSessionView(session_id, view)) {
+            std::string buffer;
+            for (size_t i = 0; i < view.entryCount() && samples.size() < max_samples; ++i) {
+                auto content = view.content(i, buffer);
+                if (content && !content->empty()) {
+                    samples.emplace_back(content->substr(0, MAX_SAMPLE_BYTES));
+                }
+            }
+            continue;
+        }
+        auto data = readSessionFile(getSessionFilePath(session_id));
+        if (data && utils::Compression::isCompressed(*data)) {
+            useSessionDictionaries();
+            data = utils::Compression::decompress(*data);
+        }
+        if (data && !data->empty()) {
+            data->resize(std::min(data->size(), MAX_SAMPLE_BYTES));
+            samples.push_back(std::move(*data));
+        }
+    }
+    if (samples.size() < 8) {
+        return false;
     }
 
-    return total_tokens;
+    useSessionDictionaries();
+    return utils::Compression::trainDictionary(samples).has_value();
 }
 
 size_t SessionManager::cleanupOldSessions(size_t max_age_days) {
@@ -768,48 +1970,132 @@ size_t SessionManager::cleanupOldSessions(size_t max_age_days) {
     try {
         std::string session_dir = getSessionDirectory();
 
-        for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".json") {
-                auto file_time = entry.last_write_time();
-                auto now = std::filesystem::file_time_type::clock::now();
-                auto age = std::chrono::duration_cast<std::chrono::hours>(now - file_time);
+        for (const auto& session_id : listSessionFiles()) {
+            auto info = getSessionFileInfo(session_id);
+            if (info && info->age() > std::chrono::hours(24 * max_age_days) && deleteSession(session_id)) {
+                cleaned_count++;
+            }
+        }
 
-                if (age.count() > static_cast<long>(max_age_days * 24)) {
-                    std::string filename = entry.path().filename().string();
-                    std::string session_id = filename.substr(0, filename.length() - 5);
+    } catch (const std::exception&) {
+        // Continue on error
+    }
 
-                    if (deleteSession(session_id)) {
-                        cleaned_count++;
-                    }
+    removeStaleTempFiles();
+    return cleaned_count;
+}
+
+size_t SessionManager::removeStaleTempFiles() {
+    size_t removed_count = 0;
+    try {
+        for (const auto& entry : std::filesystem::directory_iterator(getSessionDirectory())) {
+            if (entry.is_regular_file() && entry.path().extension() == ".tmp") {
+                // A write still in progress renames its file within moments
+                std::error_code ec;
+                auto age = std::filesystem::file_time_type::clock::now() - entry.last_write_time();
+                if (age > std::chrono::hours(1) && std::filesystem::remove(entry.path(), ec)) {
+                    removed_count++;
                 }
             }
         }
+    } catch (const std::exception&) {
+        // Continue on error
+    }
+    return removed_count;
+}
+
+bool SessionManager::mergeSearchIndex() {
+    openSearchIndex();
+    return !SessionIndex::hasPendingChanges() || SessionIndex::merge();
+}
+
+std::chrono::system_clock::duration SessionFileInfo::age() const {
+    if (updated_at) {
+        return std::chrono::system_clock::now() - *updated_at;
+    }
+    return std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::filesystem::file_time_type::clock::now() - last_write);
+}
 
+std::vector<std::string> SessionManager::listSessionFiles() {
+    std::vector<std::string> session_ids;
+    try {
+        for (const auto& entry : std::filesystem::directory_iterator(getSessionDirectory())) {
+            if (entry.is_regular_file() && entry.path().extension() == ".json") {
+                session_ids.push_back(entry.path().stem().string());
+            }
+        }
     } catch (const std::exception&) {
         // Continue on error
     }
+    return session_ids;
+}
 
-    return cleaned_count;
+std::optional<SessionFileInfo> SessionManager::getSessionFileInfo(const std::string& session_id) {
+    try {
+        std::string file_path = getSessionFilePath(session_id);
+        std::error_code ec;
+        SessionFileInfo info;
+        info.file_size = std::filesystem::file_size(file_path, ec);
+        if (ec) {
+            return std::nullopt;
+        }
+        info.last_write = std::filesystem::last_write_time(file_path, ec);
+        if (SessionCatalog::open(getSessionDirectory())) {
+            if (auto entry = SessionCatalog::find(session_id)) {
+                info.updated_at = parseTimestamp(entry->updated_at);
+            }
+        }
+
+        std::string journal_path = getJournalPath(session_id);
+        uintmax_t journal_size = std::filesystem::file_size(journal_path, ec);
+        if (!ec) {
+            auto journal_time = std::filesystem::last_write_time(journal_path, ec);
+            if (!ec && journal_time > info.last_write) {
+                info.last_write = journal_time;
+            }
+            // Entries follow the header line
+            std::ifstream journal(journal_path, std::ios::binary);
+            std::string header;
+            if (std::getline(journal, header) && journal_size > header.size() + 1) {
+                info.journal_bytes = journal_size - header.size() - 1;
+            }
+        }
+
+        SessionView view;
+        if (view.open(file_path)) {
+            info.compressed = view.header().is_compressed;
+        } else {
+            // JSON sessions are compressed as a whole
+            char magic[4] = {};
+            std::ifstream file(file_path, std::ios::binary);
+            file.read(magic, sizeof(magic));
+            info.compressed = utils::Compression::isCompressed(
+                std::string_view(magic, static_cast<size_t>(file.gcount())));
+        }
+        return info;
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+std::string SessionManager::getStorageDirectory() {
+    return getSessionDirectory();
 }
 
 std::unordered_map<std::string, std::string> SessionManager::getSessionStats() {
     std::unordered_map<std::string, std::string> stats;
 
     try {
-        std::string session_dir = getSessionDirectory();
         size_t total_sessions = 0;
         size_t total_size = 0;
         size_t total_tokens = 0;
 
-        for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".json") {
-                total_sessions++;
-                total_size += entry.file_size();
-
-                std::string filename = entry.path().filename().string();
-                std::string session_id = filename.substr(0, filename.length() - 5);
-                total_tokens += getSessionTokenCount(session_id);
-            }
+        openCatalog();
+        for (const auto& entry : SessionCatalog::entries()) {
+            total_sessions++;
+            total_size += static_cast<size_t>(entry.size_bytes);
+            total_tokens += entry.total_tokens;
         }
 
         stats["total_sessions"] = std::to_string(total_sessions);
@@ -845,47 +2131,40 @@ bool SessionManager::validateSessionIntegrity(const std::string& session_id) {
 
 std::vector<std::string> SessionManager::searchSessions(const std::string& query,
                                                       const std::unordered_set<std::string>& tags,
-                                                      const std::string& /* date_from */,
-                                                      const std::string& /* date_to */) {
+                                                      const std::string& date_from,
+                                                      const std::string& date_to) {
     std::vector<std::string> results;
 
-    try {
-        std::string session_dir = getSessionDirectory();
-
-        for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".json") {
-                std::string filename = entry.path().filename().string();
-                std::string session_id = filename.substr(0, filename.length() - 5);
-
-                auto session_opt = loadSession(session_id);
-                if (!session_opt) continue;
-
-                // Check tag filter
-                if (!tags.empty()) {
-                    bool has_all_tags = true;
-                    for (const auto& required_tag : tags) {
-                        if (session_opt->tags.find(required_tag) == session_opt->tags.end()) {
-                            has_all_tags = false;
-                            break;
-                        }
-                    }
-                    if (!has_all_tags) continue;
-                }
-
-                // Search in name, description, and content
-                std::string search_text = session_opt->name + " " + session_opt->description;
-                for (const auto& entry : session_opt->entries) {
-                    search_text += " " + entry.content;
-                }
+    std::string query_lower = query;
+    std::transform(query_lower.begin(), query_lower.end(), query_lower.begin(), ::tolower);
+    auto contains_query = [&](std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+        return text.find(query_lower) != std::string::npos;
+    };
 
-                std::string query_lower = query;
-                std::string search_text_lower = search_text;
-                std::transform(query_lower.begin(), query_lower.end(), query_lower.begin(), ::tolower);
-                std::transform(search_text_lower.begin(), search_text_lower.end(), search_text_lower.begin(), ::tolower);
+    try {
+        // Content matches come from the index, as the query's words in a row
+        std::unordered_set<std::string> content_matches;
+        SearchQuery content_query = phraseQuery(query);
+        if (!content_query.terms.empty()) {
+            for (auto& hit : searchIndex(content_query, 0)) {
+                content_matches.insert(std::move(hit.session_id));
+            }
+        }
 
-                if (search_text_lower.find(query_lower) != std::string::npos) {
-                    results.push_back(session_id);
-                }
+        openCatalog();
+        for (const auto& entry : SessionCatalog::entries()) {
+            // Tag and date filters come from the catalog
+            bool has_all_tags = std::all_of(tags.begin(), tags.end(), [&](const std::string& tag) {
+                return std::binary_search(entry.tags.begin(), entry.tags.end(), tag);
+            });
+            if (!has_all_tags) continue;
+            if (!date_from.empty() && entry.created_at < date_from) continue;
+            if (!date_to.empty() && entry.created_at.compare(0, date_to.size(), date_to) > 0) continue;
+
+            // Search in name and description, then content
+            if (contains_query(entry.name + " " + entry.description) || content_matches.count(entry.id)) {
+                results.push_back(entry.id);
             }
         }
 
@@ -898,90 +2177,112 @@ std::vector<std::string> SessionManager::searchSessions(const std::string& query
 
 std::vector<std::string> SessionManager::getSessionsByDateRange(const std::string& from_date,
                                                              const std::string& to_date) {
-    std::vector<std::string> results;
-
-    try {
-        std::string session_dir = getSessionDirectory();
+    openCatalog();
+    return SessionCatalog::select([&](const CatalogEntry& entry) {
+        // Simple date comparison (would need proper date parsing in real implementation)
+        return entry.created_at >= from_date && entry.created_at <= to_date;
+    });
+}
 
-        for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".json") {
-                std::string filename = entry.path().filename().string();
-                std::string session_id = filename.substr(0, filename.length() - 5);
+std::vector<std::string> SessionManager::getSessionsBySize(size_t min_size, size_t max_size) {
+    openCatalog();
+    return SessionCatalog::select([&](const CatalogEntry& entry) {
+        return (min_size == 0 || entry.size_bytes >= min_size) &&
+               (max_size == 0 || entry.size_bytes <= max_size);
+    });
+}
 
-                auto session_opt = loadSession(session_id);
-                if (!session_opt) continue;
+std::vector<std::string> SessionManager::getRecentlyModifiedSessions(size_t limit) {
+    openCatalog();
+    auto entries = SessionCatalog::entries();
 
-                // Simple date comparison (would need proper date parsing in real implementation)
-                if (session_opt->created_at >= from_date && session_opt->created_at <= to_date) {
-                    results.push_back(session_id);
-                }
-            }
-        }
+    // Sort by last update (newest first)
+    size_t count = std::min(limit, entries.size());
+    std::partial_sort(entries.begin(), entries.begin() + count, entries.end(),
+                      [](const CatalogEntry& a, const CatalogEntry& b) {
+                          return a.updated_at > b.updated_at;
+                      });
 
-    } catch (const std::exception&) {
-        // Return empty results on error
+    std::vector<std::string> results;
+    for (size_t i = 0; i < count; ++i) {
+        results.push_back(entries[i].id);
     }
-
     return results;
 }
 
-std::vector<std::string> SessionManager::getSessionsBySize(size_t min_size, size_t max_size) {
-    std::vector<std::string> results;
-
-    try {
-        std::string session_dir = getSessionDirectory();
-
-        for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".json") {
-                size_t file_size = entry.file_size();
-                std::string filename = entry.path().filename().string();
-                std::string session_id = filename.substr(0, filename.length() - 5);
+bool SessionManager::flushSessions() {
+    auto dirty = SessionCache::takeDirty(currentBatch().id);
+    flushConflicted() = false;
+    if (dirty.empty()) {
+        return true;
+    }
 
-                if ((min_size == 0 || file_size >= min_size) &&
-                    (max_size == 0 || file_size <= max_size)) {
-                    results.push_back(session_id);
-                }
-            }
+    // Every session locked before any is checked or written, in one order
+    // so processes flushing overlapping sessions cannot deadlock; another
+    // process's change to any of them since it was loaded writes none
+    openCatalog();
+    openSearchIndex();
+    std::set<std::string> lock_paths;
+    for (const auto& changed : dirty) {
+        lock_paths.insert(getSessionLockPath(changed.session.id));
+    }
+    std::deque<utils::FileLock> locks;
+    for (const auto& path : lock_paths) {
+        locks.emplace_back(path, utils::FileLock::Mode::EXCLUSIVE);
+    }
+    for (const auto& changed : dirty) {
+        if (changed.base && getSessionStamp(changed.session.id) != *changed.base) {
+            flushConflicted() = true;
+            return false;
         }
-
-    } catch (const std::exception&) {
-        // Return empty results on error
     }
 
-    return results;
+    bool ok = true;
+    for (const auto& changed : dirty) {
+        ok = writeSessionLocked(changed.session) && ok;
+    }
+    return ok;
 }
 
-std::vector<std::string> SessionManager::getRecentlyModifiedSessions(size_t limit) {
-    std::vector<std::pair<std::string, std::string>> sessions_by_time;
-
-    try {
-        std::string session_dir = getSessionDirectory();
-
-        for (const auto& entry : std::filesystem::directory_iterator(session_dir)) {
-            if (entry.is_regular_file() && entry.path().extension() == ".json") {
-                std::string filename = entry.path().filename().string();
-                std::string session_id = filename.substr(0, filename.length() - 5);
-
-                sessions_by_time.emplace_back(session_id, entry.path().filename().string());
-            }
-        }
-
-        // Sort by modification time (newest first)
-        std::sort(sessions_by_time.begin(), sessions_by_time.end(),
-                  [](const auto& a, const auto& b) {
-                      return a.second > b.second;
-                  });
+SessionWriteBatch::SessionWriteBatch() {
+    BatchScope& scope = currentBatch();
+    if (scope.depth++ == 0) {
+        scope.id = nextBatchId();
+    }
+}
 
-        std::vector<std::string> results;
-        for (size_t i = 0; i < std::min(limit, sessions_by_time.size()); ++i) {
-            results.push_back(sessions_by_time[i].first);
-        }
+SessionWriteBatch::~SessionWriteBatch() {
+    commit();
+}
 
-        return results;
+bool SessionWriteBatch::commit() {
+    if (committed_) {
+        return true;
+    }
+    committed_ = true;
+    BatchScope& scope = currentBatch();
+    // Nested batches leave the writing to the outermost
+    if (--scope.depth > 0) {
+        return !scope.discarded;
+    }
+    bool ok = false;
+    if (scope.discarded) {
+        SessionCache::takeDirty(scope.id);
+    } else {
+        ok = SessionManager::flushSessions();
+        conflicted_ = flushConflicted();
+    }
+    scope.id = 0;
+    scope.discarded = false;
+    return ok;
+}
 
-    } catch (const std::exception&) {
-        return {};
+void SessionWriteBatch::discard() {
+    if (committed_) {
+        return;
     }
+    currentBatch().discarded = true;
+    commit();
 }
 
 } // namespace llm
@@ -2,9 +2,15 @@
 
 #include <string>
 #include <vector>
+#include <chrono>
 #include <unordered_set>
 #include <unordered_map>
+#include <optional>
+#include <cstdint>
+#include <filesystem>
 #include "clion/common.h"
+#include "session_index.h"
+#include "semantic_index.h"
 
 namespace clion {
 namespace llm {
@@ -13,6 +19,7 @@ struct HistoryEntry {
     std::string role;
     std::string content;
     std::string timestamp;
+    size_t token_count = 0;                    ///< Tokens in content under Session::token_encoding; 0 if not counted
 };
 
 struct Session {
@@ -30,11 +37,81 @@ struct Session {
     std::unordered_map<std::string, std::string> metadata; ///< Additional metadata
     std::vector<std::string> checkpoint_ids;   ///< Associated checkpoint IDs
     std::vector<std::string> memory_node_ids;  ///< Associated memory node IDs
-    size_t total_tokens;                       ///< Total token count for the session
-    bool is_compressed;                        ///< Whether session data is compressed
+    size_t total_tokens = 0;                   ///< Total token count for the session
+    std::string token_encoding;                ///< Tokenizer the entry token counts were made with
+    bool is_compressed = false;                ///< Whether the session file is stored zstd-compressed
     std::string last_checkpoint_id;            ///< Most recent checkpoint ID
 };
 
+// How session files are written; either is read
+enum class SessionFormat {
+    JSON,                                      ///< Optionally zstd-compressed as a whole
+    BINARY                                     ///< Read in place, see BinarySessionFormat
+};
+
+class SessionView;
+
+// Identifies one on-disk version of a session file
+struct SessionStamp {
+    uintmax_t file_size = 0;
+    int64_t modified_ns = 0;                   ///< Last write time, in filesystem clock ticks
+    uint64_t file_id = 0;                      ///< Inode; each write makes a new file, so two writes
+                                               ///< within one clock tick still differ. 0 where unknown
+
+    bool operator==(const SessionStamp& other) const {
+        return file_size == other.file_size && modified_ns == other.modified_ns && file_id == other.file_id;
+    }
+    bool operator!=(const SessionStamp& other) const { return !(*this == other); }
+};
+
+// Versions of a session's files on either side of one added entry. A copy
+// made from `before` plus the entry matches `after`; a copy stamped other
+// than `before` misses some other writer's change.
+struct SessionAppend {
+    SessionStamp before;
+    SessionStamp after;
+};
+
+// A session's files as they are on disk, read without loading the session or
+// taking its lock; for housekeeping, which rechecks under the lock
+struct SessionFileInfo {
+    uintmax_t file_size = 0;
+    uintmax_t journal_bytes = 0;               ///< Entries appended since the file was written
+    std::filesystem::file_time_type last_write;///< Newer of the session file and its journal
+    // Last change to the session's content, from the catalog; rewrites such
+    // as compression keep it. nullopt for sessions the catalog lacks.
+    std::optional<std::chrono::system_clock::time_point> updated_at;
+    bool compressed = false;
+
+    // Since the content last changed: from updated_at, else from last_write
+    std::chrono::system_clock::duration age() const;
+};
+
+// Serialized request messages for a session's history, cached so each turn
+// only serializes the new entries. Valid while the session stamp matches.
+struct SessionPayloadCache {
+    std::string session_id;
+    std::string format;                        ///< Provider wire format, e.g. "openai" or "gemini"
+    SessionStamp stamp;                        ///< Session file version the messages reflect
+    size_t entry_count = 0;                    ///< History entries covered by messages
+    size_t summarized_entries = 0;             ///< Oldest entries sent as a summary rather than verbatim
+    int tokens = 0;                            ///< Tokens in messages
+    std::string messages;                      ///< Comma-separated message objects, no brackets
+};
+
+// Condensed form of a session's oldest entries, sent in their place once the
+// history outgrows its token budget (see HistoryCompactor)
+struct HistorySummary {
+    size_t entries = 0;                        ///< Oldest history entries it stands in for
+    uint64_t hash = 0;                         ///< Of those entries, to tell if they changed since
+    std::string text;                          ///< One line per condensed entry
+};
+
+// Several processes may share the session directory. Each session has a
+// reader-writer file lock: loads share it, saves and appends take it alone,
+// and other sessions are not held up. Changes to a loaded session are only
+// written if no other process wrote the session since it was loaded; the
+// operation is then redone on the newer version.
 class SessionManager {
 public:
     // Core session operations
@@ -44,12 +121,51 @@ public:
 
     // Session management utilities
     static std::string createNewSession();
+    // `model` is the model the turn was sent to or came from; the session's
+    // token counts use its tokenizer. `append`, when given, is set to the
+    // file versions the entry went between, or nullopt inside a
+    // SessionWriteBatch, where nothing is written yet.
     static bool addEntryToSession(const std::string& session_id,
                                   const std::string& role,
-                                  const std::string& content);
+                                  const std::string& content,
+                                  const std::string& model = "",
+                                  std::optional<SessionAppend>* append = nullptr);
+    // Newest first, from the session catalog
     static std::vector<std::string> listSessions();
     static bool deleteSession(const std::string& session_id);
     static bool sessionExists(const std::string& session_id);
+    // Covers the session file and its journal
+    static std::optional<SessionStamp> getSessionStamp(const std::string& session_id);
+
+    // addEntryToSession appends to <id>.journal instead of rewriting the
+    // session; compaction folds the journal back into <id>.json
+    static bool compactSession(const std::string& session_id);
+    // Format of session files written from now on (default JSON; also
+    // CLION_SESSION_FORMAT=binary). Files are converted when next saved.
+    static void setStorageFormat(SessionFormat format);
+    // Opens a binary session file without loading it, turns still in the
+    // journal included but not changes waiting in a SessionWriteBatch; false
+    // for JSON files, which loadSession() reads
+    static bool openSessionView(const std::string& session_id, SessionView& view);
+    // Writes the session as plain JSON to `path`, for tools and older versions
+    static bool exportSession(const std::string& session_id, const std::string& path);
+    // Stores a session file in any format under its own id, replacing a
+    // session with that id. Returns the id.
+    static std::optional<std::string> importSession(const std::string& path);
+
+    // Flush each appended entry and each saved session to disk before
+    // returning (also CLION_SESSION_SYNC=1); off by default. Concurrent
+    // writers share flushes through utils::GroupCommit.
+    static void setSyncOnAppend(bool enabled);
+
+    // Serialized history cache, stored next to the session as <id>.<format>.msgcache
+    static bool loadPayloadCache(const std::string& session_id,
+                                 const std::string& format,
+                                 SessionPayloadCache& cache);
+    static bool savePayloadCache(const SessionPayloadCache& cache);
+    // Summary of the oldest entries, stored as <id>.summary
+    static bool loadHistorySummary(const std::string& session_id, HistorySummary& summary);
+    static bool saveHistorySummary(const std::string& session_id, const HistorySummary& summary);
 
     // Enhanced session management features
     static std::string createNewSessionWithMetadata(const std::string& name,
@@ -74,8 +190,14 @@ public:
 
     static std::vector<std::string> findSessionsByName(const std::string& name_pattern);
 
+    // Patterns without regex syntax are looked up in the search index and
+    // match whole words (case-insensitive); others scan every session
     static std::vector<std::string> findSessionsByContent(const std::string& content_pattern);
 
+    // Sessions whose history contains every word of `query`, best match
+    // first; "quoted phrases" must appear with their words adjacent
+    static std::vector<SearchHit> searchSessionContent(const std::string& query, size_t limit = 20);
+
     static std::vector<std::string> getChildSessions(const std::string& parent_id);
 
     static std::vector<std::string> getSessionHierarchy(const std::string& session_id);
@@ -107,7 +229,16 @@ public:
 
     static std::vector<std::string> getSessionMemoryNodes(const std::string& session_id);
 
+    // Memory nodes and session turns nearest to `text` in meaning, from the
+    // local vector index (see SemanticIndex)
+    static std::vector<SemanticHit> searchSimilar(const std::string& text, size_t limit = 20,
+                                                  float min_similarity = 0.0f);
+    // Adds or refreshes a memory node in the vector index, or drops it if
+    // the node no longer exists
+    static bool indexMemoryNode(const std::string& memory_node_id);
+
     // Session compression and optimization
+    // Change how the session is stored, keeping its updated_at
     static bool compressSession(const std::string& session_id);
 
     static bool decompressSession(const std::string& session_id);
@@ -116,8 +247,32 @@ public:
 
     static size_t getSessionTokenCount(const std::string& session_id);
 
+    // Trains a zstd dictionary on up to `max_samples` stored sessions; later
+    // compressed saves use it. Sessions compressed earlier stay readable.
+    static bool trainCompressionDictionary(size_t max_samples = 1000);
+
     // Session cleanup and maintenance
+    // Recreates the catalog from the session files (it is kept up to date
+    // on every write; this repairs it after files were copied in by hand)
+    static bool rebuildCatalog();
+    // Recreates the search index from the session files
+    static bool rebuildSearchIndex();
+    // Recreates the session turns in the vector index and refreshes the
+    // memory nodes the sessions refer to; other memory nodes are kept, as
+    // they are not stored with the sessions
+    static bool rebuildSemanticIndex();
+
     static size_t cleanupOldSessions(size_t max_age_days = 30);
+    // Removes temporary files left behind by writes that did not finish
+    static size_t removeStaleTempFiles();
+    // Folds the search index's log of recent changes into its segment, if it has any
+    static bool mergeSearchIndex();
+
+    // Ids of every session file in the directory, whether or not the catalog has it
+    static std::vector<std::string> listSessionFiles();
+    static std::optional<SessionFileInfo> getSessionFileInfo(const std::string& session_id);
+    // Where sessions, their journals and the shared catalog and index are kept
+    static std::string getStorageDirectory();
 
     static std::unordered_map<std::string, std::string> getSessionStats();
 
@@ -136,6 +291,37 @@ public:
                                                     size_t max_size = 0);
 
     static std::vector<std::string> getRecentlyModifiedSessions(size_t limit = 10);
+
+    // Writes the sessions changed inside this thread's SessionWriteBatch. Writes
+    // none and returns false if another process wrote one of them since it
+    // was loaded (see SessionWriteBatch::conflicted).
+    static bool flushSessions();
+};
+
+// While one is open on this thread, saveSession() only marks the session
+// dirty in the session cache, and loads on this thread see the change; other
+// threads see the sessions as written. Each changed session is written once
+// when the outermost batch commits or goes out of scope.
+class SessionWriteBatch {
+public:
+    SessionWriteBatch();
+    ~SessionWriteBatch();
+    SessionWriteBatch(const SessionWriteBatch&) = delete;
+    SessionWriteBatch& operator=(const SessionWriteBatch&) = delete;
+
+    // Ends the batch; false if writing a session failed or another process
+    // changed one of them first
+    bool commit();
+    // Ends the batch without writing anything changed in it, or in the
+    // batches it is nested in
+    void discard();
+    // Whether commit() failed because of another process's change, so the
+    // operation can be redone on the sessions as they are now
+    bool conflicted() const { return conflicted_; }
+
+private:
+    bool committed_ = false;
+    bool conflicted_ = false;
 };
 
 } // namespace llm
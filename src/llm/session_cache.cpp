@@ -0,0 +1,239 @@
+#include "session_cache.h"
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace clion {
+namespace llm {
+
+namespace {
+    constexpr size_t DEFAULT_CAPACITY_BYTES = 64 * 1024 * 1024;
+
+    struct CachedSession {
+        Session session;
+        SessionStamp stamp;
+        size_t bytes = 0;
+    };
+
+    struct DirtyCopy {
+        Session session;
+        std::optional<SessionStamp> base;
+        size_t bytes = 0;
+        uint64_t order = 0;             // When it was first changed
+    };
+
+    struct SessionCacheState {
+        std::mutex mutex;
+        std::list<CachedSession> sessions;  // Clean, most recently used first
+        std::unordered_map<std::string, std::list<CachedSession>::iterator> by_id;
+        std::unordered_map<SessionCache::BatchId, std::unordered_map<std::string, DirtyCopy>> dirty;
+        size_t capacity = DEFAULT_CAPACITY_BYTES;
+        size_t bytes = 0;                   // Dirty copies included
+        size_t hits = 0;
+        size_t misses = 0;
+        uint64_t next_dirty_order = 0;
+    };
+
+    SessionCacheState& state() {
+        static SessionCacheState instance;
+        return instance;
+    }
+
+    size_t estimateBytes(const Session& session) {
+        size_t bytes = sizeof(Session) + session.id.size() + session.name.size() + session.description.size();
+        for (const auto& entry : session.entries) {
+            bytes += sizeof(HistoryEntry) + entry.role.size() + entry.content.size() + entry.timestamp.size();
+        }
+        return bytes;
+    }
+
+    void eraseLocked(SessionCacheState& s, std::list<CachedSession>::iterator it) {
+        s.bytes -= it->bytes;
+        s.by_id.erase(it->session.id);
+        s.sessions.erase(it);
+    }
+
+    // Drops clean sessions from the least recently used end
+    void evictLocked(SessionCacheState& s) {
+        while (s.bytes > s.capacity && !s.sessions.empty()) {
+            eraseLocked(s, std::prev(s.sessions.end()));
+        }
+    }
+
+    // Inserts or replaces the session at the front
+    CachedSession& storeLocked(SessionCacheState& s, const Session& session) {
+        auto found = s.by_id.find(session.id);
+        if (found != s.by_id.end()) {
+            s.sessions.splice(s.sessions.begin(), s.sessions, found->second);
+            s.bytes -= found->second->bytes;
+            found->second->session = session;
+        } else {
+            s.sessions.push_front(CachedSession{session, {}, 0});
+            s.by_id[session.id] = s.sessions.begin();
+        }
+        CachedSession& cached = s.sessions.front();
+        cached.bytes = estimateBytes(session);
+        s.bytes += cached.bytes;
+        return cached;
+    }
+}
+
+std::optional<Session> SessionCache::get(const std::string& session_id, const std::optional<SessionStamp>& stamp,
+                                         BatchId batch) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (batch != 0) {
+        auto owned = s.dirty.find(batch);
+        if (owned != s.dirty.end()) {
+            auto copy = owned->second.find(session_id);
+            if (copy != owned->second.end()) {
+                s.hits++;
+                return copy->second.session;
+            }
+        }
+    }
+    auto found = s.by_id.find(session_id);
+    if (found == s.by_id.end() || !stamp || found->second->stamp != *stamp) {
+        s.misses++;
+        return std::nullopt;
+    }
+    s.hits++;
+    s.sessions.splice(s.sessions.begin(), s.sessions, found->second);
+    return found->second->session;
+}
+
+void SessionCache::put(const Session& session, const SessionStamp& stamp) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    CachedSession& cached = storeLocked(s, session);
+    cached.stamp = stamp;
+    evictLocked(s);
+}
+
+bool SessionCache::update(const std::string& session_id, const SessionStamp& stamp,
+                          const SessionStamp& new_stamp, const std::function<void(Session&)>& change) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto found = s.by_id.find(session_id);
+    if (found == s.by_id.end()) {
+        return false;
+    }
+    auto it = found->second;
+    if (it->stamp != stamp) {
+        // A version the files no longer have
+        eraseLocked(s, it);
+        return false;
+    }
+    change(it->session);
+    it->stamp = new_stamp;
+    s.bytes -= it->bytes;
+    it->bytes = estimateBytes(it->session);
+    s.bytes += it->bytes;
+    s.sessions.splice(s.sessions.begin(), s.sessions, it);
+    evictLocked(s);
+    return true;
+}
+
+void SessionCache::markDirty(const Session& session, BatchId batch) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto& owned = s.dirty[batch];
+    auto [copy, inserted] = owned.try_emplace(session.id);
+    if (inserted) {
+        auto found = s.by_id.find(session.id);
+        if (found != s.by_id.end()) {
+            copy->second.base = found->second->stamp;
+        }
+        copy->second.order = s.next_dirty_order++;
+    } else {
+        s.bytes -= copy->second.bytes;
+    }
+    copy->second.session = session;
+    copy->second.bytes = estimateBytes(session);
+    s.bytes += copy->second.bytes;
+    evictLocked(s);
+}
+
+bool SessionCache::isDirty(const std::string& session_id, BatchId batch) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto owned = s.dirty.find(batch);
+    return owned != s.dirty.end() && owned->second.count(session_id) > 0;
+}
+
+std::vector<DirtySession> SessionCache::takeDirty(BatchId batch) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    std::vector<DirtySession> sessions;
+    auto owned = s.dirty.find(batch);
+    if (owned == s.dirty.end()) {
+        return sessions;
+    }
+    std::vector<DirtyCopy*> copies;
+    for (auto& [id, copy] : owned->second) {
+        copies.push_back(&copy);
+    }
+    std::sort(copies.begin(), copies.end(),
+              [](const DirtyCopy* a, const DirtyCopy* b) { return a->order < b->order; });
+
+    sessions.reserve(copies.size());
+    for (DirtyCopy* copy : copies) {
+        s.bytes -= copy->bytes;
+        sessions.push_back(DirtySession{std::move(copy->session), copy->base});
+    }
+    s.dirty.erase(owned);
+    return sessions;
+}
+
+void SessionCache::erase(const std::string& session_id) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto found = s.by_id.find(session_id);
+    if (found != s.by_id.end()) {
+        eraseLocked(s, found->second);
+    }
+    for (auto& [batch, owned] : s.dirty) {
+        auto copy = owned.find(session_id);
+        if (copy != owned.end()) {
+            s.bytes -= copy->second.bytes;
+            owned.erase(copy);
+        }
+    }
+}
+
+void SessionCache::clear() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.sessions.clear();
+    s.by_id.clear();
+    s.dirty.clear();
+    s.bytes = 0;
+    s.hits = 0;
+    s.misses = 0;
+}
+
+void SessionCache::setCapacity(size_t max_bytes) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.capacity = max_bytes;
+    evictLocked(s);
+}
+
+SessionCacheStats SessionCache::getStats() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    SessionCacheStats stats;
+    stats.hits = s.hits;
+    stats.misses = s.misses;
+    for (const auto& [batch, owned] : s.dirty) {
+        stats.dirty += owned.size();
+    }
+    stats.entries = s.sessions.size() + stats.dirty;
+    stats.bytes = s.bytes;
+    return stats;
+}
+
+} // namespace llm
+} // namespace clion
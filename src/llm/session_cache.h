@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include "clion/common.h"
+#include "session.h"
+
+namespace clion {
+namespace llm {
+
+struct SessionCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t entries = 0;
+    size_t bytes = 0;                          ///< Approximate, history text included
+    size_t dirty = 0;
+};
+
+// A session changed in a SessionWriteBatch and not written yet
+struct DirtySession {
+    Session session;
+    std::optional<SessionStamp> base;          ///< Stamp of the files it was loaded from; nullopt if unknown
+};
+
+// Recently used sessions kept in memory, so loading a session again, walking
+// a hierarchy or adding turns does not reparse its file. Each session carries
+// the stamp of the files it was read from or written to and is only returned
+// while they still have it, so sessions changed by another process are
+// reloaded. Dirty sessions hold changes not written yet (see
+// SessionWriteBatch). They belong to the batch that made them, are returned
+// only to it whatever the files' stamp and are never evicted; other batches
+// and callers outside any batch see the clean copy.
+class SessionCache {
+public:
+    // Identifies one outermost SessionWriteBatch; 0 is no batch
+    using BatchId = uint64_t;
+
+    // The dirty copy held for `batch`, or the cached session if it is clean
+    // and current as of `stamp`
+    static std::optional<Session> get(const std::string& session_id, const std::optional<SessionStamp>& stamp,
+                                      BatchId batch = 0);
+    // Caches a session as read from or written to files with `stamp`
+    static void put(const Session& session, const SessionStamp& stamp);
+    // Applies `change` to the cached session if it is clean and current as of
+    // `stamp`, then gives it `new_stamp`; e.g. a turn appended to the journal
+    static bool update(const std::string& session_id, const SessionStamp& stamp,
+                       const SessionStamp& new_stamp, const std::function<void(Session&)>& change);
+
+    // Holds `session` as changed by `batch`; a session cached clean gives its
+    // stamp as the base the change was made on
+    static void markDirty(const Session& session, BatchId batch);
+    static bool isDirty(const std::string& session_id, BatchId batch);
+    // Removes the sessions dirty in `batch` and returns them, in the order
+    // they were first changed
+    static std::vector<DirtySession> takeDirty(BatchId batch);
+
+    static void erase(const std::string& session_id);
+    static void clear();
+
+    // Clean sessions are evicted, least recently used first, beyond this
+    static void setCapacity(size_t max_bytes);
+    static SessionCacheStats getStats();
+};
+
+} // namespace llm
+} // namespace clion
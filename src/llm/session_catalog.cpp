@@ -0,0 +1,352 @@
+#include "session_catalog.h"
+#include "../utils/file_lock.h"
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string_view>
+
+namespace clion {
+namespace llm {
+
+namespace {
+    constexpr const char HEADER_PREFIX[] = "#clion-catalog\t1\t";
+    // Superseded lines allowed beyond one per live entry before a rewrite
+    constexpr size_t COMPACTION_SLACK = 256;
+
+    struct CatalogState {
+        std::mutex mutex;
+        std::string directory;
+        std::map<std::string, CatalogEntry, std::greater<>> entries;  // Newest id first
+        std::string generation;         // Changes whenever the file is rewritten
+        uintmax_t loaded_bytes = 0;     // File prefix already applied
+        int64_t loaded_modified = 0;
+        size_t file_lines = 0;          // Superseded lines included
+    };
+
+    CatalogState& state() {
+        static CatalogState instance;
+        return instance;
+    }
+
+    std::filesystem::path catalogPath(const CatalogState& s) {
+        return std::filesystem::path(s.directory) / "catalog.tsv";
+    }
+
+    // Held while changing the file, so no process appends to a catalog
+    // another is replacing; reading needs no lock
+    utils::FileLock lockCatalogFile(const CatalogState& s) {
+        return utils::FileLock((std::filesystem::path(s.directory) / "catalog.lock").string(),
+                               utils::FileLock::Mode::EXCLUSIVE);
+    }
+
+    int64_t modifiedTime(const std::filesystem::path& path, std::error_code& ec) {
+        return static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    }
+
+    std::string newGeneration() {
+        std::random_device rd;
+        return std::to_string(rd()) + std::to_string(rd());
+    }
+
+    // Tabs and newlines separate fields and lines; commas separate tags
+    void appendEscaped(std::string& out, std::string_view text) {
+        for (char c : text) {
+            switch (c) {
+                case '\\': out += "\\\\"; break;
+                case '\t': out += "\\t"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case ',': out += "\\,"; break;
+                default: out += c; break;
+            }
+        }
+    }
+
+    std::string unescape(std::string_view text) {
+        if (text.find('\\') == std::string_view::npos) {
+            return std::string(text);
+        }
+        std::string out;
+        out.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] != '\\' || i + 1 == text.size()) {
+                out += text[i];
+                continue;
+            }
+            char c = text[++i];
+            out += c == 't' ? '\t' : c == 'n' ? '\n' : c == 'r' ? '\r' : c;
+        }
+        return out;
+    }
+
+    std::vector<std::string> splitTags(std::string_view field) {
+        std::vector<std::string> tags;
+        size_t start = 0;
+        for (size_t i = 0; i <= field.size(); ++i) {
+            if (i < field.size() && field[i] == '\\') {
+                ++i;
+            } else if (i == field.size() || field[i] == ',') {
+                if (i > start) {
+                    tags.push_back(unescape(field.substr(start, i - start)));
+                }
+                start = i + 1;
+            }
+        }
+        return tags;
+    }
+
+    void applyLine(CatalogState& s, std::string_view line) {
+        if (line.compare(0, 2, "-\t") == 0) {
+            s.entries.erase(unescape(line.substr(2)));
+        } else if (auto entry = SessionCatalog::fromLine(line)) {
+            s.entries[entry->id] = std::move(*entry);
+        }
+    }
+
+    void clearLocked(CatalogState& s) {
+        s.entries.clear();
+        s.generation.clear();
+        s.loaded_bytes = 0;
+        s.loaded_modified = 0;
+        s.file_lines = 0;
+    }
+
+    // Applies whatever was appended since the last read, or reloads the file
+    // if it was rewritten. False if there is no catalog file.
+    bool refreshLocked(CatalogState& s) {
+        std::error_code ec;
+        auto path = catalogPath(s);
+        uintmax_t size = std::filesystem::file_size(path, ec);
+        if (ec) {
+            clearLocked(s);
+            return false;
+        }
+        int64_t modified = modifiedTime(path, ec);
+        if (size == s.loaded_bytes && modified == s.loaded_modified) {
+            return true;
+        }
+
+        std::ifstream file(path, std::ios::binary);
+        std::string header;
+        if (!std::getline(file, header) || header.compare(0, sizeof(HEADER_PREFIX) - 1, HEADER_PREFIX) != 0) {
+            clearLocked(s);
+            return false;
+        }
+        std::string generation = header.substr(sizeof(HEADER_PREFIX) - 1);
+        if (generation != s.generation || size < s.loaded_bytes) {
+            clearLocked(s);
+            s.generation = generation;
+            s.loaded_bytes = header.size() + 1;
+        }
+
+        // Only whole lines; a line still being appended is read next time
+        std::string data(static_cast<size_t>(size - std::min(size, s.loaded_bytes)), '\0');
+        file.seekg(static_cast<std::streamoff>(s.loaded_bytes));
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        data.resize(static_cast<size_t>(file.gcount()));
+        size_t start = 0;
+        for (size_t end = data.find('\n'); end != std::string::npos; end = data.find('\n', start)) {
+            std::string_view line(data.data() + start, end - start);
+            start = end + 1;
+            if (!line.empty() && line[0] != '#') {
+                s.file_lines++;
+                applyLine(s, line);
+            }
+        }
+        s.loaded_bytes += start;
+        s.loaded_modified = modified;
+        return true;
+    }
+
+    // Writes the live entries to a new file and renames it over the catalog
+    bool rewriteLocked(CatalogState& s) {
+        std::error_code ec;
+        std::filesystem::create_directories(s.directory, ec);
+        auto path = catalogPath(s);
+        auto temp_path = path;
+        temp_path += ".tmp";
+
+        std::string generation = newGeneration();
+        std::string data = HEADER_PREFIX + generation + "\n";
+        for (const auto& [id, entry] : s.entries) {
+            data += SessionCatalog::toLine(entry);
+            data += '\n';
+        }
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!file.good()) {
+                return false;
+            }
+        }
+        std::filesystem::rename(temp_path, path, ec);
+        if (ec) {
+            return false;
+        }
+        s.generation = generation;
+        s.loaded_bytes = data.size();
+        s.loaded_modified = modifiedTime(path, ec);
+        s.file_lines = s.entries.size();
+        return true;
+    }
+
+    // Applies `line` and appends it, or rewrites the file if it is missing
+    // or mostly superseded lines
+    bool appendLocked(CatalogState& s, const std::string& line) {
+        bool exists = refreshLocked(s);
+        applyLine(s, line);
+        if (!exists || s.file_lines + 1 > 2 * s.entries.size() + COMPACTION_SLACK) {
+            return rewriteLocked(s);
+        }
+        {
+            std::ofstream file(catalogPath(s), std::ios::binary | std::ios::app);
+            file.write(line.data(), static_cast<std::streamsize>(line.size()));
+            file.put('\n');
+            if (!file.good()) {
+                return false;
+            }
+        }
+        // Picks up this line along with any other process's appends
+        refreshLocked(s);
+        return true;
+    }
+}
+
+bool SessionCatalog::open(const std::string& directory) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.directory != directory) {
+        clearLocked(s);
+        s.directory = directory;
+    }
+    return refreshLocked(s);
+}
+
+bool SessionCatalog::put(const CatalogEntry& entry) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockCatalogFile(s);
+    return appendLocked(s, toLine(entry));
+}
+
+bool SessionCatalog::remove(const std::string& session_id) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockCatalogFile(s);
+    std::string line = "-\t";
+    appendEscaped(line, session_id);
+    return appendLocked(s, line);
+}
+
+std::optional<CatalogEntry> SessionCatalog::find(const std::string& session_id) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.entries.find(session_id);
+    if (it == s.entries.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::vector<CatalogEntry> SessionCatalog::entries() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    std::vector<CatalogEntry> result;
+    result.reserve(s.entries.size());
+    for (const auto& [id, entry] : s.entries) {
+        result.push_back(entry);
+    }
+    return result;
+}
+
+std::vector<std::string> SessionCatalog::select(const std::function<bool(const CatalogEntry&)>& predicate) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    std::vector<std::string> ids;
+    for (const auto& [id, entry] : s.entries) {
+        if (!predicate || predicate(entry)) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+bool SessionCatalog::rebuild(const std::vector<CatalogEntry>& entries) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockCatalogFile(s);
+    s.entries.clear();
+    for (const auto& entry : entries) {
+        s.entries[entry.id] = entry;
+    }
+    return rewriteLocked(s);
+}
+
+std::string SessionCatalog::toLine(const CatalogEntry& entry) {
+    std::string line = "+";
+    for (const std::string* field : {&entry.id, &entry.created_at, &entry.updated_at, &entry.name,
+                                     &entry.description, &entry.parent_session_id}) {
+        line += '\t';
+        appendEscaped(line, *field);
+    }
+    line += '\t';
+    for (size_t i = 0; i < entry.tags.size(); ++i) {
+        if (i > 0) {
+            line += ',';
+        }
+        appendEscaped(line, entry.tags[i]);
+    }
+    for (uintmax_t number : {uintmax_t(entry.entry_count), uintmax_t(entry.total_tokens), entry.size_bytes}) {
+        line += '\t';
+        line += std::to_string(number);
+    }
+    return line;
+}
+
+std::optional<CatalogEntry> SessionCatalog::fromLine(std::string_view line) {
+    // "+", six text fields, tags, three numbers
+    constexpr size_t FIELD_COUNT = 11;
+    if (line.compare(0, 2, "+\t") != 0 ||
+        static_cast<size_t>(std::count(line.begin(), line.end(), '\t')) != FIELD_COUNT - 1) {
+        return std::nullopt;
+    }
+    std::string_view fields[FIELD_COUNT];
+    size_t start = 0;
+    for (size_t i = 0; i < FIELD_COUNT; ++i) {
+        size_t tab = std::min(line.find('\t', start), line.size());
+        fields[i] = line.substr(start, tab - start);
+        start = tab + 1;
+    }
+
+    CatalogEntry entry;
+    entry.id = unescape(fields[1]);
+    entry.created_at = unescape(fields[2]);
+    entry.updated_at = unescape(fields[3]);
+    entry.name = unescape(fields[4]);
+    entry.description = unescape(fields[5]);
+    entry.parent_session_id = unescape(fields[6]);
+    entry.tags = splitTags(fields[7]);
+    uintmax_t numbers[3];
+    for (size_t i = 0; i < 3; ++i) {
+        std::string_view text = fields[8 + i];
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), numbers[i]);
+        if (text.empty() || ec != std::errc() || end != text.data() + text.size()) {
+            return std::nullopt;
+        }
+    }
+    entry.entry_count = static_cast<size_t>(numbers[0]);
+    entry.total_tokens = static_cast<size_t>(numbers[1]);
+    entry.size_bytes = numbers[2];
+    if (entry.id.empty()) {
+        return std::nullopt;
+    }
+    return entry;
+}
+
+} // namespace llm
+} // namespace clion
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "clion/common.h"
+
+namespace clion {
+namespace llm {
+
+// A session's metadata without its history
+struct CatalogEntry {
+    std::string id;
+    std::string name;
+    std::string description;
+    std::vector<std::string> tags;             ///< Sorted
+    std::string parent_session_id;
+    std::string created_at;
+    std::string updated_at;
+    size_t entry_count = 0;
+    size_t total_tokens = 0;
+    uintmax_t size_bytes = 0;                  ///< Session file plus journal
+};
+
+// Index of every session's metadata, so listing and metadata filters read
+// one small file instead of loading each session. Stored as catalog.tsv in
+// the session directory with one line per change; the latest line for an id
+// wins and the file is rewritten once superseded lines dominate. Changes made
+// by other processes are picked up by reading only what they appended.
+class SessionCatalog {
+public:
+    // Loads or refreshes the catalog in `directory`. False if the directory
+    // has no catalog yet; it is then empty until rebuild().
+    static bool open(const std::string& directory);
+
+    static bool put(const CatalogEntry& entry);
+    static bool remove(const std::string& session_id);
+    static std::optional<CatalogEntry> find(const std::string& session_id);
+    // Sorted by id, newest first (ids start with the creation time)
+    static std::vector<CatalogEntry> entries();
+    // Ids of the entries matching `predicate` (all if empty), in the same order
+    static std::vector<std::string> select(const std::function<bool(const CatalogEntry&)>& predicate = {});
+
+    // Replaces the whole catalog, e.g. after scanning the session files
+    static bool rebuild(const std::vector<CatalogEntry>& entries);
+
+    static std::string toLine(const CatalogEntry& entry);
+    static std::optional<CatalogEntry> fromLine(std::string_view line);
+};
+
+} // namespace llm
+} // namespace clion
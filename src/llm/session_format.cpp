@@ -0,0 +1,360 @@
+#include "session_format.h"
+#include "../utils/compression.h"
+#include <algorithm>
+#include <cstring>
+
+namespace clion {
+namespace llm {
+
+namespace {
+    constexpr char SESSION_MAGIC[8] = {'C', 'L', 'S', 'E', 'S', 'S', '0', '1'};
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+    // Smaller content rarely shrinks enough to pay for decompressing it
+    constexpr size_t MIN_COMPRESSED_CONTENT = 512;
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t byte_order;            // BYTE_ORDER_MARK as the writer stored it
+        uint32_t reserved;
+        uint64_t entry_count;
+        uint64_t fields_offset;         // Session fields other than the entries
+        uint64_t fields_size;
+        uint64_t table_offset;          // entry_count EntryRecords
+    };
+
+    struct EntryRecord {
+        uint64_t offset;                // Role, timestamp, then content
+        uint64_t token_count;
+        uint32_t role_size;
+        uint32_t timestamp_size;
+        uint32_t content_size;          // As stored
+        uint32_t content_raw_size;      // Before compression; 0 if stored as is
+    };
+
+    template <typename T>
+    T readValue(const char* at) {
+        T value;
+        std::memcpy(&value, at, sizeof(T));
+        return value;
+    }
+
+    EntryRecord readEntry(const char* table, size_t index) {
+        return readValue<EntryRecord>(table + index * sizeof(EntryRecord));
+    }
+
+    template <typename T>
+    void appendValue(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // Session fields as length-prefixed strings and fixed-size numbers
+    class FieldWriter {
+    public:
+        explicit FieldWriter(std::string& out) : out_(out) {}
+
+        void string(std::string_view value) {
+            appendValue(out_, static_cast<uint32_t>(value.size()));
+            out_.append(value);
+        }
+        void number(uint64_t value) { appendValue(out_, value); }
+        template <typename Container>
+        void strings(const Container& values) {
+            appendValue(out_, static_cast<uint32_t>(values.size()));
+            for (const auto& value : values) {
+                string(value);
+            }
+        }
+
+    private:
+        std::string& out_;
+    };
+
+    class FieldReader {
+    public:
+        FieldReader(const char* at, size_t size) : at_(at), end_(at + size) {}
+
+        bool ok() const { return ok_; }
+        std::string string() {
+            uint32_t size = count();
+            if (!ok_ || static_cast<size_t>(end_ - at_) < size) {
+                ok_ = false;
+                return {};
+            }
+            std::string value(at_, size);
+            at_ += size;
+            return value;
+        }
+        uint64_t number() {
+            if (static_cast<size_t>(end_ - at_) < sizeof(uint64_t)) {
+                ok_ = false;
+                return 0;
+            }
+            uint64_t value = readValue<uint64_t>(at_);
+            at_ += sizeof(uint64_t);
+            return value;
+        }
+        uint32_t count() {
+            if (static_cast<size_t>(end_ - at_) < sizeof(uint32_t)) {
+                ok_ = false;
+                return 0;
+            }
+            uint32_t value = readValue<uint32_t>(at_);
+            at_ += sizeof(uint32_t);
+            return value;
+        }
+
+    private:
+        const char* at_;
+        const char* end_;
+        bool ok_ = true;
+    };
+
+    void writeFields(std::string& out, const Session& session) {
+        FieldWriter writer(out);
+        writer.string(session.id);
+        writer.string(session.created_at);
+        writer.string(session.updated_at);
+        writer.string(session.name);
+        writer.string(session.description);
+        writer.string(session.parent_session_id);
+        writer.string(session.token_encoding);
+        writer.string(session.last_checkpoint_id);
+        writer.number(session.total_tokens);
+        writer.number(session.is_compressed ? 1 : 0);
+        writer.strings(session.child_session_ids);
+        writer.strings(session.tags);
+        writer.strings(session.checkpoint_ids);
+        writer.strings(session.memory_node_ids);
+        appendValue(out, static_cast<uint32_t>(session.metadata.size()));
+        for (const auto& [key, value] : session.metadata) {
+            writer.string(key);
+            writer.string(value);
+        }
+    }
+
+    bool readFields(const char* at, size_t size, Session& session) {
+        FieldReader reader(at, size);
+        session.id = reader.string();
+        session.created_at = reader.string();
+        session.updated_at = reader.string();
+        session.name = reader.string();
+        session.description = reader.string();
+        session.parent_session_id = reader.string();
+        session.token_encoding = reader.string();
+        session.last_checkpoint_id = reader.string();
+        session.total_tokens = static_cast<size_t>(reader.number());
+        session.is_compressed = reader.number() != 0;
+        for (uint32_t n = reader.count(); reader.ok() && n > 0; --n) {
+            session.child_session_ids.push_back(reader.string());
+        }
+        for (uint32_t n = reader.count(); reader.ok() && n > 0; --n) {
+            session.tags.insert(reader.string());
+        }
+        for (uint32_t n = reader.count(); reader.ok() && n > 0; --n) {
+            session.checkpoint_ids.push_back(reader.string());
+        }
+        for (uint32_t n = reader.count(); reader.ok() && n > 0; --n) {
+            session.memory_node_ids.push_back(reader.string());
+        }
+        for (uint32_t n = reader.count(); reader.ok() && n > 0; --n) {
+            std::string key = reader.string();
+            session.metadata[key] = reader.string();
+        }
+        return reader.ok();
+    }
+}
+
+bool BinarySessionFormat::matches(std::string_view data) {
+    return data.size() >= sizeof(SESSION_MAGIC) &&
+           std::memcmp(data.data(), SESSION_MAGIC, sizeof(SESSION_MAGIC)) == 0;
+}
+
+std::string BinarySessionFormat::encode(const Session& session, bool compress_content) {
+    std::string out(sizeof(FileHeader), '\0');
+
+    FileHeader header{};
+    std::memcpy(header.magic, SESSION_MAGIC, sizeof(SESSION_MAGIC));
+    header.byte_order = BYTE_ORDER_MARK;
+    header.entry_count = session.entries.size();
+    header.fields_offset = out.size();
+    writeFields(out, session);
+    header.fields_size = out.size() - header.fields_offset;
+
+    std::vector<char> table(session.entries.size() * sizeof(EntryRecord));
+    std::string compressed;
+    for (size_t i = 0; i < session.entries.size(); ++i) {
+        const HistoryEntry& entry = session.entries[i];
+        std::string_view content = entry.content;
+        uint32_t raw_size = 0;
+        if (compress_content && content.size() >= MIN_COMPRESSED_CONTENT) {
+            compressed = utils::Compression::compress(content);
+            if (utils::Compression::isCompressed(compressed) && compressed.size() < content.size()) {
+                raw_size = static_cast<uint32_t>(content.size());
+                content = compressed;
+            }
+        }
+
+        EntryRecord record{};
+        record.offset = out.size();
+        record.token_count = entry.token_count;
+        record.role_size = static_cast<uint32_t>(entry.role.size());
+        record.timestamp_size = static_cast<uint32_t>(entry.timestamp.size());
+        record.content_size = static_cast<uint32_t>(content.size());
+        record.content_raw_size = raw_size;
+        std::memcpy(table.data() + i * sizeof(record), &record, sizeof(record));
+
+        out += entry.role;
+        out += entry.timestamp;
+        out.append(content);
+    }
+
+    header.table_offset = out.size();
+    out.append(table.data(), table.size());
+    std::memcpy(out.data(), &header, sizeof(header));
+    return out;
+}
+
+bool SessionView::open(const std::string& path) {
+    close();
+    if (!file_.open(path) || !BinarySessionFormat::matches(file_.view())) {
+        file_.close();
+        return false;
+    }
+    data_ = file_.view();
+    if (!parse()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool SessionView::open(std::string_view data) {
+    close();
+    if (!BinarySessionFormat::matches(data)) {
+        return false;
+    }
+    data_ = data;
+    if (!parse()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SessionView::close() {
+    file_.close();
+    data_ = {};
+    header_ = Session{};
+    stored_count_ = 0;
+    table_ = nullptr;
+    appended_.clear();
+}
+
+// Checks every bound once, so the accessors can trust the table
+bool SessionView::parse() {
+    if (data_.size() < sizeof(FileHeader)) {
+        return false;
+    }
+    auto header = readValue<FileHeader>(data_.data());
+    uint64_t size = data_.size();
+    if (header.byte_order != BYTE_ORDER_MARK || header.fields_offset > size ||
+        header.fields_size > size - header.fields_offset || header.table_offset > size ||
+        header.entry_count > (size - header.table_offset) / sizeof(EntryRecord)) {
+        return false;
+    }
+    if (!readFields(data_.data() + header.fields_offset, static_cast<size_t>(header.fields_size), header_)) {
+        return false;
+    }
+
+    stored_count_ = static_cast<size_t>(header.entry_count);
+    table_ = data_.data() + header.table_offset;
+    for (size_t i = 0; i < stored_count_; ++i) {
+        EntryRecord entry = readEntry(table_, i);
+        uint64_t bytes = uint64_t(entry.role_size) + entry.timestamp_size + entry.content_size;
+        if (entry.offset > header.table_offset || bytes > header.table_offset - entry.offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view SessionView::role(size_t index) const {
+    if (index >= stored_count_) {
+        return appended_[index - stored_count_].role;
+    }
+    EntryRecord entry = readEntry(table_, index);
+    return data_.substr(entry.offset, entry.role_size);
+}
+
+std::string_view SessionView::timestamp(size_t index) const {
+    if (index >= stored_count_) {
+        return appended_[index - stored_count_].timestamp;
+    }
+    EntryRecord entry = readEntry(table_, index);
+    return data_.substr(entry.offset + entry.role_size, entry.timestamp_size);
+}
+
+size_t SessionView::tokenCount(size_t index) const {
+    if (index >= stored_count_) {
+        return appended_[index - stored_count_].token_count;
+    }
+    return static_cast<size_t>(readEntry(table_, index).token_count);
+}
+
+std::optional<std::string_view> SessionView::content(size_t index, std::string& buffer) const {
+    if (index >= stored_count_) {
+        return std::string_view(appended_[index - stored_count_].content);
+    }
+    EntryRecord entry = readEntry(table_, index);
+    std::string_view stored = data_.substr(entry.offset + entry.role_size + entry.timestamp_size, entry.content_size);
+    if (entry.content_raw_size == 0) {
+        return stored;
+    }
+    auto decompressed = utils::Compression::decompress(stored);
+    if (!decompressed || decompressed->size() != entry.content_raw_size) {
+        return std::nullopt;
+    }
+    buffer = std::move(*decompressed);
+    return std::string_view(buffer);
+}
+
+std::optional<HistoryEntry> SessionView::entry(size_t index) const {
+    if (index >= stored_count_) {
+        return appended_[index - stored_count_];
+    }
+    std::string buffer;
+    auto text = content(index, buffer);
+    if (!text) {
+        return std::nullopt;
+    }
+    HistoryEntry history_entry;
+    history_entry.role = role(index);
+    history_entry.timestamp = timestamp(index);
+    history_entry.content = buffer.empty() ? std::string(*text) : std::move(buffer);
+    history_entry.token_count = tokenCount(index);
+    return history_entry;
+}
+
+std::optional<Session> SessionView::materialize() const {
+    Session session = header_;
+    session.entries.reserve(entryCount());
+    for (size_t i = 0; i < entryCount(); ++i) {
+        auto history_entry = entry(i);
+        if (!history_entry) {
+            return std::nullopt;
+        }
+        session.entries.push_back(std::move(*history_entry));
+    }
+    return session;
+}
+
+void SessionView::append(Session tail) {
+    for (auto& history_entry : tail.entries) {
+        appended_.push_back(std::move(history_entry));
+    }
+    tail.entries.clear();
+    header_ = std::move(tail);
+}
+
+} // namespace llm
+} // namespace clion
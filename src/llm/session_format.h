@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "clion/common.h"
+#include "session.h"
+#include "../utils/mapped_file.h"
+
+namespace clion {
+namespace llm {
+
+// Binary session files: a header, the session's other fields, each entry's
+// role, timestamp and content back to back, then a table of fixed-size
+// records giving each entry's offset and sizes. Entries are read in place,
+// so nothing is parsed and no content is copied until it is asked for.
+// Content over a few hundred bytes may be zstd-compressed entry by entry,
+// which keeps the rest of the file readable in place. Written in native
+// byte order; other machines read the JSON export.
+class BinarySessionFormat {
+public:
+    static bool matches(std::string_view data);
+    // `compress_content` compresses larger entries with the active dictionary
+    static std::string encode(const Session& session, bool compress_content);
+};
+
+// Read access to one binary session file without loading it
+class SessionView {
+public:
+    // False if `path` cannot be read or is not a valid binary session file
+    bool open(const std::string& path);
+    // Same over bytes in memory, which must outlive the view
+    bool open(std::string_view data);
+    void close();
+    bool isOpen() const { return !data_.empty(); }
+
+    // Every field but the entries
+    const Session& header() const { return header_; }
+    size_t entryCount() const { return stored_count_ + appended_.size(); }
+
+    std::string_view role(size_t index) const;
+    std::string_view timestamp(size_t index) const;
+    size_t tokenCount(size_t index) const;
+    // In place unless the entry is stored compressed; then it is decompressed
+    // into `buffer`. nullopt if that fails, e.g. a missing dictionary.
+    std::optional<std::string_view> content(size_t index, std::string& buffer) const;
+
+    std::optional<HistoryEntry> entry(size_t index) const;
+    std::optional<Session> materialize() const;
+
+    // Takes `tail`'s fields as the header and adds its entries after the
+    // stored ones (entries from the session's journal)
+    void append(Session tail);
+
+private:
+    bool parse();
+
+    utils::MappedFile file_;
+    std::string_view data_;
+    Session header_;
+    size_t stored_count_ = 0;
+    const char* table_ = nullptr;
+    std::vector<HistoryEntry> appended_;
+};
+
+} // namespace llm
+} // namespace clion
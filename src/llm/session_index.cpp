@@ -0,0 +1,730 @@
+#include "session_index.h"
+#include "../utils/file_lock.h"
+#include "../utils/mapped_file.h"
+#include "../utils/token_cache.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
+namespace clion {
+namespace llm {
+
+namespace {
+    constexpr char SEGMENT_MAGIC[8] = {'C', 'L', 'S', 'I', 'D', 'X', '0', '1'};
+    constexpr const char LOG_PREFIX[] = "#clion-search-log\t1\t";
+    // Log postings allowed before a merge: half the segment's, at least this
+    constexpr size_t MIN_MERGE_POSTINGS = 64 * 1024;
+    // BM25 parameters
+    constexpr double K1 = 1.2;
+    constexpr double B = 0.75;
+    constexpr uint32_t NO_DOCUMENT = UINT32_MAX;
+
+    // Segment layout, native byte order: header, document table, term table
+    // (sorted by term), postings (grouped by term, sorted by document),
+    // string pool (session ids and terms)
+    struct SegmentHeader {
+        char magic[8];
+        uint64_t generation;            // 0: no segment
+        uint64_t doc_count;
+        uint64_t term_count;
+        uint64_t posting_count;
+        uint64_t docs_offset;
+        uint64_t terms_offset;
+        uint64_t postings_offset;
+        uint64_t strings_offset;
+        uint64_t strings_size;
+    };
+
+    struct DocRecord {
+        uint64_t content_hash;
+        uint64_t length;                // Terms in the document
+        uint32_t entries;
+        uint32_t id_offset;
+        uint32_t id_length;
+        uint32_t reserved;
+    };
+
+    struct TermRecord {
+        uint64_t first_posting;
+        uint64_t posting_count;
+        uint32_t text_offset;
+        uint32_t text_length;
+    };
+
+    struct Posting {
+        uint32_t doc;
+        uint32_t tf;
+    };
+
+    // Records are copied out of the mapping, which guarantees no alignment
+    template <typename T>
+    T readRecord(const char* base, uint64_t index) {
+        T value;
+        std::memcpy(&value, base + index * sizeof(T), sizeof(T));
+        return value;
+    }
+
+    struct IndexState {
+        std::mutex mutex;
+        std::string directory;
+        bool loaded = false;
+        utils::MappedFile segment;
+        SegmentHeader header{};
+
+        // Per document key: the segment's documents first, then documents
+        // the log started
+        std::vector<std::string> ids;
+        std::vector<uint64_t> lengths;
+        std::vector<uint64_t> hashes;
+        std::vector<uint32_t> entries;
+        std::vector<uint8_t> dead;      // Removed or replaced
+        std::unordered_map<std::string, uint32_t> live;  // Session id -> key
+        uint64_t total_length = 0;      // Over live documents
+
+        std::unordered_map<std::string, std::vector<Posting>> log_postings;  // Keys, not segment docs
+        size_t log_posting_count = 0;
+        uintmax_t log_bytes = 0;        // Log prefix already applied
+        int64_t log_modified = 0;
+    };
+
+    IndexState& state() {
+        static IndexState instance;
+        return instance;
+    }
+
+    std::filesystem::path segmentPath(const IndexState& s) {
+        return std::filesystem::path(s.directory) / "search_index.seg";
+    }
+
+    std::filesystem::path logPath(const IndexState& s) {
+        return std::filesystem::path(s.directory) / "search_index.log";
+    }
+
+    // Held while appending to the log or merging, so no process appends to
+    // a log another is replacing; searching needs no lock
+    utils::FileLock lockIndexFiles(const IndexState& s) {
+        return utils::FileLock((std::filesystem::path(s.directory) / "search_index.lock").string(),
+                               utils::FileLock::Mode::EXCLUSIVE);
+    }
+
+    int64_t modifiedTime(const std::filesystem::path& path, std::error_code& ec) {
+        return static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    }
+
+    uint64_t combineHash(uint64_t hash, uint64_t entry_hash) {
+        return (hash ^ entry_hash) * 0x9E3779B97F4A7C15ULL + 1;
+    }
+
+    std::string hexGeneration(uint64_t generation) {
+        char buffer[17];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), generation, 16);
+        return std::string(buffer, result.ptr);
+    }
+
+    template <typename T>
+    bool parseNumber(std::string_view text, T& value, int base = 10) {
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+        return !text.empty() && ec == std::errc() && end == text.data() + text.size();
+    }
+
+    void resetDocumentsLocked(IndexState& s) {
+        s.segment.close();
+        s.header = SegmentHeader{};
+        s.ids.clear();
+        s.lengths.clear();
+        s.hashes.clear();
+        s.entries.clear();
+        s.dead.clear();
+        s.live.clear();
+        s.total_length = 0;
+        s.log_postings.clear();
+        s.log_posting_count = 0;
+        s.log_bytes = 0;
+        s.log_modified = 0;
+        s.loaded = false;
+    }
+
+    std::string_view segmentString(const IndexState& s, uint32_t offset, uint32_t length) {
+        if (uint64_t(offset) + length > s.header.strings_size) {
+            return {};
+        }
+        return std::string_view(s.segment.data() + s.header.strings_offset + offset, length);
+    }
+
+    // Maps the segment and loads its document table; false if it is missing,
+    // truncated or not the expected generation
+    bool loadSegmentLocked(IndexState& s, uint64_t generation) {
+        resetDocumentsLocked(s);
+        if (generation == 0) {
+            return true;
+        }
+        if (!s.segment.open(segmentPath(s).string()) || s.segment.size() < sizeof(SegmentHeader)) {
+            return false;
+        }
+        SegmentHeader header = readRecord<SegmentHeader>(s.segment.data(), 0);
+        uint64_t size = s.segment.size();
+        if (std::memcmp(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0 ||
+            header.generation != generation ||
+            header.docs_offset + header.doc_count * sizeof(DocRecord) > size ||
+            header.terms_offset + header.term_count * sizeof(TermRecord) > size ||
+            header.postings_offset + header.posting_count * sizeof(Posting) > size ||
+            header.strings_offset + header.strings_size > size) {
+            s.segment.close();
+            return false;
+        }
+        s.header = header;
+
+        const char* docs = s.segment.data() + header.docs_offset;
+        for (uint64_t i = 0; i < header.doc_count; ++i) {
+            DocRecord doc = readRecord<DocRecord>(docs, i);
+            std::string id(segmentString(s, doc.id_offset, doc.id_length));
+            s.live[id] = static_cast<uint32_t>(i);
+            s.ids.push_back(std::move(id));
+            s.lengths.push_back(doc.length);
+            s.hashes.push_back(doc.content_hash);
+            s.entries.push_back(doc.entries);
+            s.dead.push_back(0);
+            s.total_length += doc.length;
+        }
+        return true;
+    }
+
+    void removeDocumentLocked(IndexState& s, const std::string& session_id) {
+        auto it = s.live.find(session_id);
+        if (it != s.live.end()) {
+            s.dead[it->second] = 1;
+            s.total_length -= s.lengths[it->second];
+            s.live.erase(it);
+        }
+    }
+
+    // "+\t<id>\t<entry hash>\t<length>\t<term>\t<tf>..." adds an entry;
+    // "-\t<id>" drops the session's document
+    void applyLine(IndexState& s, std::string_view line) {
+        std::vector<std::string_view> fields;
+        size_t start = 0;
+        while (start <= line.size()) {
+            size_t tab = std::min(line.find('\t', start), line.size());
+            fields.push_back(line.substr(start, tab - start));
+            start = tab + 1;
+        }
+        if (fields.size() == 2 && fields[0] == "-") {
+            removeDocumentLocked(s, std::string(fields[1]));
+            return;
+        }
+        uint64_t entry_hash = 0;
+        uint64_t length = 0;
+        if (fields.size() < 4 || fields.size() % 2 != 0 || fields[0] != "+" ||
+            !parseNumber(fields[2], entry_hash, 16) || !parseNumber(fields[3], length)) {
+            return;  // Torn or unknown line
+        }
+
+        std::string session_id(fields[1]);
+        auto it = s.live.find(session_id);
+        uint32_t key;
+        if (it != s.live.end()) {
+            key = it->second;
+        } else {
+            key = static_cast<uint32_t>(s.ids.size());
+            s.ids.push_back(session_id);
+            s.lengths.push_back(0);
+            s.hashes.push_back(0);
+            s.entries.push_back(0);
+            s.dead.push_back(0);
+            s.live[session_id] = key;
+        }
+        s.lengths[key] += length;
+        s.hashes[key] = combineHash(s.hashes[key], entry_hash);
+        s.entries[key]++;
+        s.total_length += length;
+
+        for (size_t i = 4; i + 1 < fields.size(); i += 2) {
+            uint32_t tf = 0;
+            if (!parseNumber(fields[i + 1], tf)) {
+                continue;
+            }
+            auto& postings = s.log_postings[std::string(fields[i])];
+            // A session's entries usually arrive together; keep one posting
+            if (!postings.empty() && postings.back().doc == key) {
+                postings.back().tf += tf;
+            } else {
+                postings.push_back({key, tf});
+                s.log_posting_count++;
+            }
+        }
+    }
+
+    bool writeLogLocked(IndexState& s, uint64_t generation) {
+        auto path = logPath(s);
+        auto temp_path = path;
+        temp_path += ".tmp";
+        std::string header = LOG_PREFIX + hexGeneration(generation) + "\n";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            file << header;
+            if (!file.good()) {
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp_path, path, ec);
+        if (ec) {
+            return false;
+        }
+        s.log_bytes = header.size();
+        s.log_modified = modifiedTime(path, ec);
+        return true;
+    }
+
+    // Applies what was appended to the log since the last read, or reloads
+    // everything after a merge. False if there is no usable index.
+    bool refreshLocked(IndexState& s) {
+        std::error_code ec;
+        auto path = logPath(s);
+        uintmax_t size = std::filesystem::file_size(path, ec);
+        if (ec) {
+            resetDocumentsLocked(s);
+            return false;
+        }
+        int64_t modified = modifiedTime(path, ec);
+        if (s.loaded && size == s.log_bytes && modified == s.log_modified) {
+            return true;
+        }
+
+        std::ifstream file(path, std::ios::binary);
+        std::string header;
+        uint64_t generation = 0;
+        if (!std::getline(file, header) || header.compare(0, sizeof(LOG_PREFIX) - 1, LOG_PREFIX) != 0 ||
+            !parseNumber(std::string_view(header).substr(sizeof(LOG_PREFIX) - 1), generation, 16)) {
+            resetDocumentsLocked(s);
+            return false;
+        }
+        if (!s.loaded || generation != s.header.generation || size < s.log_bytes) {
+            if (!loadSegmentLocked(s, generation)) {
+                // A merge that stopped between writing the segment and
+                // starting its log: the old log's changes are in the segment
+                SegmentHeader found{};
+                std::ifstream segment(segmentPath(s), std::ios::binary);
+                if (!segment.read(reinterpret_cast<char*>(&found), sizeof(found)) ||
+                    !loadSegmentLocked(s, found.generation) || !writeLogLocked(s, found.generation)) {
+                    resetDocumentsLocked(s);
+                    return false;
+                }
+                s.loaded = true;
+                return true;
+            }
+            s.log_bytes = header.size() + 1;
+            s.loaded = true;
+        }
+
+        // Only whole lines; a line still being appended is read next time
+        std::string data(static_cast<size_t>(size - std::min(size, s.log_bytes)), '\0');
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(s.log_bytes));
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        data.resize(static_cast<size_t>(file.gcount()));
+        size_t start = 0;
+        for (size_t end = data.find('\n'); end != std::string::npos; end = data.find('\n', start)) {
+            applyLine(s, std::string_view(data.data() + start, end - start));
+            start = end + 1;
+        }
+        s.log_bytes += start;
+        s.log_modified = modified;
+        return true;
+    }
+
+    // Calls `callback` with every posting of `term`, segment and log, as keys
+    template <typename Callback>
+    void forEachPosting(const IndexState& s, const std::string& term, Callback&& callback) {
+        if (s.header.generation != 0) {
+            const char* terms = s.segment.data() + s.header.terms_offset;
+            uint64_t low = 0;
+            uint64_t high = s.header.term_count;
+            while (low < high) {
+                uint64_t mid = low + (high - low) / 2;
+                TermRecord record = readRecord<TermRecord>(terms, mid);
+                int order = segmentString(s, record.text_offset, record.text_length).compare(term);
+                if (order < 0) {
+                    low = mid + 1;
+                } else if (order > 0) {
+                    high = mid;
+                } else {
+                    if (record.first_posting + record.posting_count <= s.header.posting_count) {
+                        const char* postings = s.segment.data() + s.header.postings_offset;
+                        for (uint64_t i = 0; i < record.posting_count; ++i) {
+                            callback(readRecord<Posting>(postings, record.first_posting + i));
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+        auto it = s.log_postings.find(term);
+        if (it != s.log_postings.end()) {
+            for (const auto& posting : it->second) {
+                callback(posting);
+            }
+        }
+    }
+
+    // Writes the live documents as a new segment and starts an empty log
+    bool mergeLocked(IndexState& s) {
+        // New document numbers, in session id order
+        std::vector<uint32_t> keys;
+        keys.reserve(s.live.size());
+        for (const auto& [id, key] : s.live) {
+            keys.push_back(key);
+        }
+        std::sort(keys.begin(), keys.end(), [&](uint32_t a, uint32_t b) { return s.ids[a] < s.ids[b]; });
+        std::vector<uint32_t> renumber(s.ids.size(), NO_DOCUMENT);
+        for (size_t i = 0; i < keys.size(); ++i) {
+            renumber[keys[i]] = static_cast<uint32_t>(i);
+        }
+
+        std::string strings;
+        std::vector<DocRecord> docs;
+        docs.reserve(keys.size());
+        for (uint32_t key : keys) {
+            DocRecord doc{};
+            doc.content_hash = s.hashes[key];
+            doc.length = s.lengths[key];
+            doc.entries = s.entries[key];
+            doc.id_offset = static_cast<uint32_t>(strings.size());
+            doc.id_length = static_cast<uint32_t>(s.ids[key].size());
+            strings += s.ids[key];
+            docs.push_back(doc);
+        }
+
+        // Terms of segment and log, merged in sorted order
+        std::vector<std::string> log_terms;
+        log_terms.reserve(s.log_postings.size());
+        for (const auto& [term, postings] : s.log_postings) {
+            log_terms.push_back(term);
+        }
+        std::sort(log_terms.begin(), log_terms.end());
+
+        std::vector<TermRecord> terms;
+        std::vector<Posting> postings;
+        std::vector<Posting> term_postings;
+        const char* segment_terms = s.segment.data() + s.header.terms_offset;
+        uint64_t segment_index = 0;
+        size_t log_index = 0;
+        while (segment_index < s.header.term_count || log_index < log_terms.size()) {
+            std::string_view segment_term;
+            TermRecord record{};
+            if (segment_index < s.header.term_count) {
+                record = readRecord<TermRecord>(segment_terms, segment_index);
+                segment_term = segmentString(s, record.text_offset, record.text_length);
+            }
+            bool take_segment = segment_index < s.header.term_count &&
+                                (log_index == log_terms.size() || segment_term <= log_terms[log_index]);
+            bool take_log = log_index < log_terms.size() &&
+                            (segment_index == s.header.term_count || log_terms[log_index] <= segment_term);
+            std::string term(take_segment ? segment_term : std::string_view(log_terms[log_index]));
+
+            term_postings.clear();
+            auto add = [&](const Posting& posting) {
+                if (posting.doc < renumber.size() && renumber[posting.doc] != NO_DOCUMENT) {
+                    term_postings.push_back({renumber[posting.doc], posting.tf});
+                }
+            };
+            if (take_segment) {
+                const char* segment_postings = s.segment.data() + s.header.postings_offset;
+                for (uint64_t i = 0; i < record.posting_count && record.first_posting + i < s.header.posting_count; ++i) {
+                    add(readRecord<Posting>(segment_postings, record.first_posting + i));
+                }
+                segment_index++;
+            }
+            if (take_log) {
+                for (const auto& posting : s.log_postings[log_terms[log_index]]) {
+                    add(posting);
+                }
+                log_index++;
+            }
+            if (term_postings.empty()) {
+                continue;
+            }
+
+            std::sort(term_postings.begin(), term_postings.end(),
+                      [](const Posting& a, const Posting& b) { return a.doc < b.doc; });
+            TermRecord out{};
+            out.first_posting = postings.size();
+            out.text_offset = static_cast<uint32_t>(strings.size());
+            out.text_length = static_cast<uint32_t>(term.size());
+            strings += term;
+            for (const auto& posting : term_postings) {
+                if (postings.size() > out.first_posting && postings.back().doc == posting.doc) {
+                    postings.back().tf += posting.tf;
+                } else {
+                    postings.push_back(posting);
+                }
+            }
+            out.posting_count = postings.size() - out.first_posting;
+            terms.push_back(out);
+        }
+
+        std::random_device rd;
+        SegmentHeader header{};
+        std::memcpy(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+        header.generation = ((uint64_t(rd()) << 32) | rd()) | 1;
+        header.doc_count = docs.size();
+        header.term_count = terms.size();
+        header.posting_count = postings.size();
+        header.docs_offset = sizeof(SegmentHeader);
+        header.terms_offset = header.docs_offset + docs.size() * sizeof(DocRecord);
+        header.postings_offset = header.terms_offset + terms.size() * sizeof(TermRecord);
+        header.strings_offset = header.postings_offset + postings.size() * sizeof(Posting);
+        header.strings_size = strings.size();
+
+        auto path = segmentPath(s);
+        auto temp_path = path;
+        temp_path += ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(docs.data()), static_cast<std::streamsize>(docs.size() * sizeof(DocRecord)));
+            file.write(reinterpret_cast<const char*>(terms.data()), static_cast<std::streamsize>(terms.size() * sizeof(TermRecord)));
+            file.write(reinterpret_cast<const char*>(postings.data()), static_cast<std::streamsize>(postings.size() * sizeof(Posting)));
+            file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+            if (!file.good()) {
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp_path, path, ec);
+        if (ec) {
+            return false;
+        }
+
+        // Segment first, then the log that points at it; see refreshLocked
+        if (!loadSegmentLocked(s, header.generation) || !writeLogLocked(s, header.generation)) {
+            resetDocumentsLocked(s);
+            return false;
+        }
+        s.loaded = true;
+        return true;
+    }
+
+    // Appends whole lines to the log and reads them back, which applies them
+    bool appendLocked(IndexState& s, const std::string& lines) {
+        if (!refreshLocked(s)) {
+            return false;
+        }
+        {
+            std::ofstream file(logPath(s), std::ios::binary | std::ios::app);
+            file.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+            if (!file.good()) {
+                return false;
+            }
+        }
+        refreshLocked(s);
+        if (s.log_posting_count > std::max<uint64_t>(MIN_MERGE_POSTINGS, s.header.posting_count / 2)) {
+            return mergeLocked(s);
+        }
+        return true;
+    }
+
+    void appendEntryLine(std::string& lines, const std::string& session_id, std::string_view content) {
+        std::unordered_map<std::string, uint32_t> counts;
+        uint64_t length = 0;
+        SessionIndex::forEachTerm(content, [&](std::string_view term) {
+            counts[std::string(term)]++;
+            length++;
+        });
+        lines += "+\t";
+        lines += session_id;
+        lines += '\t';
+        lines += hexGeneration(utils::TokenCache::hashContent(content));
+        lines += '\t';
+        lines += std::to_string(length);
+        for (const auto& [term, count] : counts) {
+            lines += '\t';
+            lines += term;
+            lines += '\t';
+            lines += std::to_string(count);
+        }
+        lines += '\n';
+    }
+}
+
+bool SessionIndex::open(const std::string& directory) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.directory != directory) {
+        resetDocumentsLocked(s);
+        s.directory = directory;
+    }
+    return refreshLocked(s);
+}
+
+bool SessionIndex::clear() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    resetDocumentsLocked(s);
+    std::error_code ec;
+    std::filesystem::create_directories(s.directory, ec);
+    std::filesystem::remove(segmentPath(s), ec);
+    if (!writeLogLocked(s, 0)) {
+        return false;
+    }
+    s.loaded = true;
+    return true;
+}
+
+bool SessionIndex::addEntry(const std::string& session_id, std::string_view content) {
+    std::string lines;
+    appendEntryLine(lines, session_id, content);
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    return appendLocked(s, lines);
+}
+
+bool SessionIndex::indexSession(const std::string& session_id, const std::vector<std::string_view>& contents) {
+    uint64_t hash = 0;
+    for (const auto& content : contents) {
+        hash = combineHash(hash, utils::TokenCache::hashContent(content));
+    }
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    if (!refreshLocked(s)) {
+        return false;
+    }
+    auto it = s.live.find(session_id);
+    if (it != s.live.end() && s.hashes[it->second] == hash && s.entries[it->second] == contents.size()) {
+        return true;  // e.g. a save that only changed metadata
+    }
+
+    std::string lines = "-\t" + session_id + "\n";
+    for (const auto& content : contents) {
+        appendEntryLine(lines, session_id, content);
+    }
+    return appendLocked(s, lines);
+}
+
+bool SessionIndex::remove(const std::string& session_id) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    if (!refreshLocked(s) || s.live.find(session_id) == s.live.end()) {
+        return false;
+    }
+    return appendLocked(s, "-\t" + session_id + "\n");
+}
+
+bool SessionIndex::contains(const std::string& session_id) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return refreshLocked(s) && s.live.find(session_id) != s.live.end();
+}
+
+bool SessionIndex::merge() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto file_lock = lockIndexFiles(s);
+    return refreshLocked(s) && mergeLocked(s);
+}
+
+bool SessionIndex::hasPendingChanges() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    // Documents the log added, replaced or removed, or postings it added
+    return refreshLocked(s) && (s.log_posting_count > 0 || s.live.size() != s.ids.size());
+}
+
+std::vector<SearchHit> SessionIndex::search(const SearchQuery& query, size_t limit) {
+    std::vector<std::string> terms = query.terms;
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (terms.empty() || !refreshLocked(s) || s.live.empty()) {
+        return {};
+    }
+
+    // Term frequency per live document, for each term
+    std::vector<std::unordered_map<uint32_t, uint32_t>> matches(terms.size());
+    for (size_t i = 0; i < terms.size(); ++i) {
+        forEachPosting(s, terms[i], [&](const Posting& posting) {
+            if (posting.doc < s.dead.size() && !s.dead[posting.doc]) {
+                matches[i][posting.doc] += posting.tf;
+            }
+        });
+        if (matches[i].empty()) {
+            return {};  // Every term is required
+        }
+    }
+    std::sort(matches.begin(), matches.end(),
+              [](const auto& a, const auto& b) { return a.size() < b.size(); });
+
+    const double documents = static_cast<double>(s.live.size());
+    const double average_length = std::max(1.0, static_cast<double>(s.total_length) / documents);
+    std::vector<double> idf;
+    for (const auto& term_matches : matches) {
+        double df = static_cast<double>(term_matches.size());
+        idf.push_back(std::log(1.0 + (documents - df + 0.5) / (df + 0.5)));
+    }
+
+    std::vector<SearchHit> hits;
+    for (const auto& [key, first_tf] : matches[0]) {
+        double length_norm = K1 * (1.0 - B + B * static_cast<double>(s.lengths[key]) / average_length);
+        double score = 0.0;
+        bool all_terms = true;
+        for (size_t i = 0; i < matches.size() && all_terms; ++i) {
+            auto it = matches[i].find(key);
+            if (it == matches[i].end()) {
+                all_terms = false;
+                break;
+            }
+            double tf = static_cast<double>(it->second);
+            score += idf[i] * tf * (K1 + 1.0) / (tf + length_norm);
+        }
+        if (all_terms) {
+            hits.push_back({s.ids[key], score});
+        }
+    }
+
+    std::sort(hits.begin(), hits.end(), [](const SearchHit& a, const SearchHit& b) {
+        return a.score != b.score ? a.score > b.score : a.session_id > b.session_id;
+    });
+    if (limit > 0 && hits.size() > limit) {
+        hits.resize(limit);
+    }
+    return hits;
+}
+
+SearchQuery SessionIndex::parseQuery(std::string_view text) {
+    SearchQuery query;
+    bool in_phrase = false;
+    size_t start = 0;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i < text.size() && text[i] != '"') {
+            continue;
+        }
+        std::vector<std::string> words;
+        forEachTerm(text.substr(start, i - start), [&](std::string_view term) {
+            words.emplace_back(term);
+        });
+        query.terms.insert(query.terms.end(), words.begin(), words.end());
+        if (in_phrase && words.size() > 1) {
+            query.phrases.push_back(std::move(words));
+        }
+        in_phrase = !in_phrase;
+        start = i + 1;
+    }
+    return query;
+}
+
+} // namespace llm
+} // namespace clion
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "clion/common.h"
+
+namespace clion {
+namespace llm {
+
+struct SearchHit {
+    std::string session_id;
+    double score = 0.0;                        ///< BM25; higher is better
+};
+
+struct SearchQuery {
+    std::vector<std::string> terms;            ///< Every query word, phrase words included
+    std::vector<std::vector<std::string>> phrases;  ///< Quoted word sequences
+};
+
+// Inverted index over session history: word -> sessions containing it, with
+// term frequencies for BM25 ranking. One document per session.
+//
+// On disk it is an immutable segment (search_index.seg, memory-mapped, term
+// table binary-searched at query time) plus an append-only log of changes
+// since the segment was written (search_index.log). Appending a turn adds
+// one log line; the log is merged into a new segment once it grows to half
+// the segment's size.
+class SessionIndex {
+public:
+    // Loads or refreshes the index in `directory`. False if it has none yet
+    static bool open(const std::string& directory);
+    // Starts an empty index; fill it with indexSession() and merge()
+    static bool clear();
+
+    // Adds one history entry to the session's document
+    static bool addEntry(const std::string& session_id, std::string_view content);
+    // Replaces the session's document, unless it already holds exactly these entries
+    static bool indexSession(const std::string& session_id, const std::vector<std::string_view>& contents);
+    static bool remove(const std::string& session_id);
+    static bool contains(const std::string& session_id);
+    // Folds the log into a new segment
+    static bool merge();
+    // True if the log holds changes a merge would fold in
+    static bool hasPendingChanges();
+
+    // Sessions containing every query term, best first; all of them when
+    // limit is 0. Phrases are matched as their words only; callers that
+    // need them adjacent check the candidates' text.
+    static std::vector<SearchHit> search(const SearchQuery& query, size_t limit = 0);
+
+    // Words and "quoted phrases"
+    static SearchQuery parseQuery(std::string_view text);
+
+    // Index terms in `text`, in order: runs of ASCII letters, digits, '_' or
+    // non-ASCII bytes, lowercased. Longer than MAX_TERM_LENGTH are skipped.
+    template <typename Callback>
+    static void forEachTerm(std::string_view text, Callback&& callback) {
+        char term[MAX_TERM_LENGTH];
+        size_t length = 0;
+        bool too_long = false;
+        for (size_t i = 0; i <= text.size(); ++i) {
+            unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+            bool word = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                        c == '_' || c >= 0x80;
+            if (word) {
+                if (length < MAX_TERM_LENGTH) {
+                    term[length++] = static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+                } else {
+                    too_long = true;
+                }
+            } else if (length > 0) {
+                if (!too_long) {
+                    callback(std::string_view(term, length));
+                }
+                length = 0;
+                too_long = false;
+            }
+        }
+    }
+
+    static constexpr size_t MAX_TERM_LENGTH = 64;
+};
+
+} // namespace llm
+} // namespace clion
@@ -0,0 +1,321 @@
+#include "session_maintenance.h"
+#include "session.h"
+#include "../utils/compression.h"
+#include "../utils/file_lock.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace clion {
+namespace llm {
+
+namespace {
+    // Unused I/O budget carried into a burst later, at most
+    constexpr auto MAX_BUDGET_CREDIT = std::chrono::seconds(1);
+    // Longest sleep before checking for stop() again
+    constexpr auto THROTTLE_SLICE = std::chrono::milliseconds(100);
+
+    // Idle CPU and I/O priority for the calling thread only, so an
+    // interactive process keeps its own priority
+    void lowerThreadPriority() {
+#ifdef __linux__
+        // Linux schedules threads as processes: both calls take a thread id
+        pid_t thread_id = static_cast<pid_t>(::syscall(SYS_gettid));
+        ::setpriority(PRIO_PROCESS, static_cast<id_t>(thread_id), 19);
+#ifdef SYS_ioprio_set
+        // No libc wrapper; the idle class only gets the disk when nothing else wants it
+        constexpr int IOPRIO_WHO_PROCESS = 1;
+        constexpr int IOPRIO_CLASS_IDLE = 3;
+        constexpr int IOPRIO_CLASS_SHIFT = 13;
+        ::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, thread_id, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+#endif
+#elif defined(__APPLE__)
+        // Throttles both CPU and I/O
+        ::setpriority(PRIO_DARWIN_THREAD, 0, PRIO_DARWIN_BG);
+#endif
+    }
+
+    std::filesystem::path getLastPassPath() {
+        return std::filesystem::path(SessionManager::getStorageDirectory()) / "maintenance.stamp";
+    }
+
+    void writeLastPass() {
+        auto path = getLastPassPath();
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        // Only the maintainer writes it, so one temporary name will do
+        std::string temp_path = path.string() + ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::trunc);
+            file << seconds << '\n';
+            if (!file.good()) {
+                return;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp_path, path, ec);
+    }
+
+    // True if the catalog lists a session without a file, or misses one that
+    // loads; rebuilding reads every session, so only then
+    bool catalogNeedsRebuild() {
+        std::vector<std::string> files = SessionManager::listSessionFiles();
+        std::vector<std::string> cataloged = SessionManager::listSessions();
+        std::sort(files.begin(), files.end());
+        std::sort(cataloged.begin(), cataloged.end());
+
+        std::vector<std::string> stale;
+        std::set_difference(cataloged.begin(), cataloged.end(), files.begin(), files.end(),
+                            std::back_inserter(stale));
+        if (!stale.empty()) {
+            return true;
+        }
+        std::vector<std::string> missing;
+        std::set_difference(files.begin(), files.end(), cataloged.begin(), cataloged.end(),
+                            std::back_inserter(missing));
+        return std::any_of(missing.begin(), missing.end(), [](const std::string& session_id) {
+            return SessionManager::loadSession(session_id).has_value();
+        });
+    }
+}
+
+SessionMaintenance::SessionMaintenance(const MaintenanceOptions& options) : options_(options) {
+    worker_ = std::thread(&SessionMaintenance::run, this);
+}
+
+SessionMaintenance::~SessionMaintenance() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        pass_requested_ = false;
+    }
+    work_available_.notify_all();
+    resumed_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void SessionMaintenance::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!busy_ && !pass_requested_) {
+        pass_requested_ = true;
+        cancelled_ = false;
+        work_available_.notify_one();
+    }
+}
+
+bool SessionMaintenance::startIfDue(std::chrono::hours interval) {
+    auto last = lastCompletedPass();
+    if (last && std::chrono::system_clock::now() - *last < interval) {
+        return false;
+    }
+    start();
+    return true;
+}
+
+void SessionMaintenance::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pass_requested_ = false;
+        cancelled_ = true;
+    }
+    resumed_.notify_all();
+}
+
+void SessionMaintenance::pause() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    paused_ = true;
+}
+
+void SessionMaintenance::resume() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        paused_ = false;
+    }
+    resumed_.notify_all();
+}
+
+bool SessionMaintenance::waitIdle(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return idle_.wait_for(lock, timeout, [this]() { return !busy_ && !pass_requested_; });
+}
+
+void SessionMaintenance::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return !busy_ && !pass_requested_; });
+}
+
+MaintenanceStats SessionMaintenance::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::optional<std::chrono::system_clock::time_point> SessionMaintenance::lastCompletedPass() {
+    std::ifstream file(getLastPassPath());
+    long long seconds = 0;
+    if (!(file >> seconds)) {
+        return std::nullopt;
+    }
+    return std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+}
+
+void SessionMaintenance::run() {
+    lowerThreadPriority();
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_available_.wait(lock, [this]() { return pass_requested_ || stopping_; });
+            if (stopping_) {
+                break;
+            }
+            pass_requested_ = false;
+            busy_ = true;
+            stats_ = MaintenanceStats{};
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        runPass();
+        record([&](MaintenanceStats& stats) {
+            stats.elapsed_ms =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        });
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_ = false;
+        }
+        idle_.notify_all();
+    }
+    idle_.notify_all();
+}
+
+void SessionMaintenance::runPass() {
+    // One process maintains the directory; the others leave it to that one
+    auto lock_path = std::filesystem::path(SessionManager::getStorageDirectory()) / "locks" / "maintenance.lock";
+    utils::FileLock maintainer(lock_path.string(), utils::FileLock::Mode::EXCLUSIVE, false);
+    if (maintainer.isHeldElsewhere()) {
+        return;
+    }
+    budget_start_ = std::chrono::steady_clock::now();
+    budget_bytes_ = 0;
+
+    // Before compressing, so the sessions compressed below use it
+    if (options_.train_dictionary && checkpoint()) {
+        SessionManager::trainCompressionDictionary();
+    }
+
+    const bool compress = options_.compress && utils::Compression::isAvailable();
+    const auto max_age = std::chrono::hours(24 * options_.max_age_days);
+    const auto idle = std::chrono::minutes(options_.idle_minutes);
+    for (const auto& session_id : SessionManager::listSessionFiles()) {
+        if (!checkpoint()) {
+            return;
+        }
+        auto info = SessionManager::getSessionFileInfo(session_id);
+        if (!info) {
+            continue;  // Deleted since the listing
+        }
+        record([](MaintenanceStats& stats) { stats.sessions_checked++; });
+
+        // Rewrites below keep updated_at, so they do not make a session look recent
+        auto age = info->age();
+        // Rewrites read the session and journal and write them back
+        uintmax_t rewrite_bytes = 2 * (info->file_size + info->journal_bytes);
+        bool ok = true;
+        if (options_.max_age_days > 0 && age > max_age) {
+            ok = SessionManager::deleteSession(session_id);
+            record([&](MaintenanceStats& stats) { ok ? stats.sessions_deleted++ : stats.failures++; });
+            rewrite_bytes = 0;
+        } else if (age < idle) {
+            continue;  // In use; a later pass gets to it
+        } else if (compress && !info->compressed) {
+            // Folds the journal in too
+            ok = SessionManager::compressSession(session_id);
+            record([&](MaintenanceStats& stats) { ok ? stats.sessions_compressed++ : stats.failures++; });
+        } else if (info->journal_bytes > 0) {
+            ok = SessionManager::compactSession(session_id);
+            record([&](MaintenanceStats& stats) { ok ? stats.sessions_compacted++ : stats.failures++; });
+        } else {
+            continue;
+        }
+        if (!throttle(rewrite_bytes)) {
+            return;
+        }
+    }
+
+    size_t temp_files = SessionManager::removeStaleTempFiles();
+    record([&](MaintenanceStats& stats) { stats.temp_files_removed = temp_files; });
+
+    if (!checkpoint()) {
+        return;
+    }
+    if (catalogNeedsRebuild()) {
+        bool rebuilt = SessionManager::rebuildCatalog();
+        record([&](MaintenanceStats& stats) {
+            stats.catalog_rebuilt = rebuilt;
+            stats.failures += rebuilt ? 0 : 1;
+        });
+    }
+
+    if (!checkpoint()) {
+        return;
+    }
+    bool merged = SessionManager::mergeSearchIndex();
+    record([&](MaintenanceStats& stats) {
+        stats.failures += merged ? 0 : 1;
+        stats.completed = true;
+    });
+    writeLastPass();
+}
+
+bool SessionMaintenance::checkpoint() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    resumed_.wait(lock, [this]() { return !paused_ || cancelled_ || stopping_; });
+    return !cancelled_ && !stopping_;
+}
+
+bool SessionMaintenance::throttle(uintmax_t bytes) {
+    record([&](MaintenanceStats& stats) { stats.bytes_processed += bytes; });
+    if (options_.io_bytes_per_second == 0) {
+        return checkpoint();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    budget_bytes_ += bytes;
+    auto due = budget_start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(budget_bytes_) / options_.io_bytes_per_second));
+    if (due + MAX_BUDGET_CREDIT < now) {
+        // Time spent paused or idle is not saved up for one long burst
+        budget_start_ = now - MAX_BUDGET_CREDIT;
+        budget_bytes_ = 0;
+        return checkpoint();
+    }
+
+    while (now < due && !cancelled_ && !stopping_) {
+        auto slice = std::min<std::chrono::steady_clock::duration>(due - now, THROTTLE_SLICE);
+        std::this_thread::sleep_for(slice);
+        auto slept = std::chrono::steady_clock::now() - now;
+        record([&](MaintenanceStats& stats) {
+            stats.throttled_ms += std::chrono::duration<double, std::milli>(slept).count();
+        });
+        now += slept;
+    }
+    return checkpoint();
+}
+
+void SessionMaintenance::record(const std::function<void(MaintenanceStats&)>& update) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    update(stats_);
+}
+
+} // namespace llm
+} // namespace clion
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include "clion/common.h"
+
+namespace clion {
+namespace llm {
+
+struct MaintenanceOptions {
+    size_t max_age_days = 30;                  ///< Delete sessions untouched this long; 0 keeps them
+    size_t idle_minutes = 10;                  ///< Sessions written more recently are left for a later pass
+    size_t io_bytes_per_second = 4 << 20;      ///< Session bytes read and written per second; 0 for no limit
+    bool compress = true;                      ///< Compress sessions stored uncompressed
+    bool train_dictionary = false;             ///< Retrain the compression dictionary first
+};
+
+struct MaintenanceStats {
+    size_t sessions_checked = 0;
+    size_t sessions_deleted = 0;
+    size_t sessions_compacted = 0;             ///< Journal folded into the session file
+    size_t sessions_compressed = 0;
+    size_t temp_files_removed = 0;
+    size_t failures = 0;                       ///< Steps that failed; the next pass retries them
+    bool catalog_rebuilt = false;
+    uintmax_t bytes_processed = 0;
+    double throttled_ms = 0.0;                 ///< Waiting on the I/O rate limit
+    double elapsed_ms = 0.0;
+    bool completed = false;                    ///< False if stopped, or another process was maintaining
+};
+
+// Session housekeeping as low-priority background work: deletes sessions
+// past their age, folds journals into idle sessions, compresses sessions
+// stored plain, removes stale temporary files, repairs the catalog and
+// merges the search index. A pass runs on its own thread at idle CPU and I/O
+// priority, one session at a time within an I/O budget, and each step holds
+// only that session's lock, so foreground commands in this or any other
+// process wait at most for one step. One process maintains the directory at
+// a time; the others skip their pass.
+class SessionMaintenance {
+public:
+    explicit SessionMaintenance(const MaintenanceOptions& options = {});
+    // Stops a running pass after its current step
+    ~SessionMaintenance();
+
+    SessionMaintenance(const SessionMaintenance&) = delete;
+    SessionMaintenance& operator=(const SessionMaintenance&) = delete;
+
+    // Starts a pass unless one is running
+    void start();
+    // Starts a pass if none completed, in any process, within `interval`;
+    // true if it did
+    bool startIfDue(std::chrono::hours interval);
+    // Ends the running pass after its current step
+    void stop();
+
+    // Holds the pass before its next step until resume(), e.g. while a
+    // foreground request runs
+    void pause();
+    void resume();
+
+    // Blocks until no pass is running, or at most `timeout`; true if none is
+    bool waitIdle(std::chrono::milliseconds timeout);
+    void waitIdle();
+
+    // Of the running pass, or the last one
+    MaintenanceStats getStats() const;
+
+    // When a pass last completed in any process; nullopt if none has
+    static std::optional<std::chrono::system_clock::time_point> lastCompletedPass();
+
+private:
+    MaintenanceOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable idle_;
+    std::condition_variable resumed_;
+    bool pass_requested_ = false;
+    bool busy_ = false;
+    bool paused_ = false;
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> stopping_{false};
+    MaintenanceStats stats_;
+    std::thread worker_;
+
+    // I/O budget of the running pass; worker thread only
+    std::chrono::steady_clock::time_point budget_start_;
+    uintmax_t budget_bytes_ = 0;
+
+    void run();
+    void runPass();
+    // Waits out a pause; false if the pass should end
+    bool checkpoint();
+    // Sleeps until `bytes` more fit the I/O budget; false if the pass should end
+    bool throttle(uintmax_t bytes);
+    void record(const std::function<void(MaintenanceStats&)>& update);
+};
+
+} // namespace llm
+} // namespace clion
@@ -0,0 +1,236 @@
+#include "telemetry.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+using json = nlohmann::json;
+
+namespace clion {
+namespace llm {
+
+namespace {
+    struct TelemetryState {
+        std::mutex mutex;
+        bool enabled = false;
+        std::string output;
+        std::ofstream file;
+        double pending_context_build_ms = 0.0;
+        size_t requests = 0;
+        size_t failures = 0;
+        std::vector<RequestTiming> history;
+    };
+
+    // Keeps snapshots bounded in long-running sessions
+    constexpr size_t MAX_HISTORY = 4096;
+
+    TelemetryState& state() {
+        static TelemetryState instance;
+        return instance;
+    }
+
+    std::string getCurrentTimestamp() {
+        auto now = std::chrono::system_clock::now();
+        auto time_t = std::chrono::system_clock::to_time_t(now);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now.time_since_epoch()) % 1000;
+
+        std::stringstream ss;
+        ss << std::put_time(std::gmtime(&time_t), "%Y-%m-%dT%H:%M:%S");
+        ss << '.' << std::setfill('0') << std::setw(3) << ms.count() << 'Z';
+        return ss.str();
+    }
+
+    double percentile(std::vector<double>& values, double fraction) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        size_t index = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+    // Phase name and accessor, in the order phases happen during a request
+    const std::vector<std::pair<const char*, double RequestTiming::*>>& phaseFields() {
+        static const std::vector<std::pair<const char*, double RequestTiming::*>> fields = {
+            {"context_build", &RequestTiming::context_build_ms},
+            {"tokenize", &RequestTiming::tokenize_ms},
+            {"serialize", &RequestTiming::serialize_ms},
+            {"dns", &RequestTiming::dns_ms},
+            {"connect", &RequestTiming::connect_ms},
+            {"tls", &RequestTiming::tls_ms},
+            {"ttfb", &RequestTiming::ttfb_ms},
+            {"transfer", &RequestTiming::transfer_ms},
+            {"parse", &RequestTiming::parse_ms},
+            {"total", &RequestTiming::total_ms}
+        };
+        return fields;
+    }
+}
+
+void Telemetry::enable(const std::string& output) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.enabled = true;
+    s.output = output;
+    s.file.close();
+    if (!output.empty() && output != "-") {
+        s.file.open(output, std::ios::app);
+        if (!s.file.is_open()) {
+            std::cerr << "Warning: cannot open telemetry output " << output << std::endl;
+        }
+    }
+}
+
+void Telemetry::disable() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.enabled = false;
+    s.file.close();
+}
+
+bool Telemetry::isEnabled() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.enabled;
+}
+
+void Telemetry::configureFromEnvironment() {
+    const char* output = std::getenv("CLION_TELEMETRY");
+    if (output != nullptr && *output != '\0') {
+        // "1" just turns collection on; anything else names the output
+        enable(std::string(output) == "1" ? "-" : output);
+    }
+}
+
+void Telemetry::recordContextBuild(double milliseconds) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.enabled) {
+        s.pending_context_build_ms += milliseconds;
+    }
+}
+
+double Telemetry::takePendingContextBuild() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    double pending = s.pending_context_build_ms;
+    s.pending_context_build_ms = 0.0;
+    return pending;
+}
+
+void Telemetry::record(const RequestTiming& timing) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.enabled) {
+        return;
+    }
+
+    RequestTiming stamped = timing;
+    if (stamped.timestamp.empty()) {
+        stamped.timestamp = getCurrentTimestamp();
+    }
+
+    s.requests++;
+    if (!stamped.success) {
+        s.failures++;
+    }
+    if (s.history.size() >= MAX_HISTORY) {
+        s.history.erase(s.history.begin(), s.history.begin() + MAX_HISTORY / 2);
+    }
+    s.history.push_back(stamped);
+
+    if (s.output == "-") {
+        std::cerr << toJsonLine(stamped) << std::endl;
+    } else if (s.file.is_open()) {
+        s.file << toJsonLine(stamped) << '\n';
+        s.file.flush();
+    }
+}
+
+TelemetrySnapshot Telemetry::getSnapshot() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    TelemetrySnapshot snapshot;
+    snapshot.requests = s.requests;
+    snapshot.failures = s.failures;
+
+    std::vector<double> values;
+    values.reserve(s.history.size());
+    for (const auto& [name, field] : phaseFields()) {
+        PhaseStats stats;
+        stats.phase = name;
+        values.clear();
+        for (const auto& timing : s.history) {
+            double value = timing.*field;
+            values.push_back(value);
+            stats.total_ms += value;
+            stats.max_ms = std::max(stats.max_ms, value);
+        }
+        stats.count = values.size();
+        stats.p50_ms = percentile(values, 0.50);
+        stats.p95_ms = percentile(values, 0.95);
+        snapshot.phases.push_back(stats);
+    }
+    return snapshot;
+}
+
+std::string Telemetry::getSnapshotJson() {
+    TelemetrySnapshot snapshot = getSnapshot();
+
+    json j;
+    j["requests"] = snapshot.requests;
+    j["failures"] = snapshot.failures;
+    json phases = json::object();
+    for (const auto& stats : snapshot.phases) {
+        phases[stats.phase] = {
+            {"count", stats.count},
+            {"total_ms", stats.total_ms},
+            {"mean_ms", stats.count > 0 ? stats.total_ms / stats.count : 0.0},
+            {"max_ms", stats.max_ms},
+            {"p50_ms", stats.p50_ms},
+            {"p95_ms", stats.p95_ms}
+        };
+    }
+    j["phases"] = phases;
+    return j.dump();
+}
+
+void Telemetry::reset() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.requests = 0;
+    s.failures = 0;
+    s.pending_context_build_ms = 0.0;
+    s.history.clear();
+}
+
+std::string Telemetry::toJsonLine(const RequestTiming& timing) {
+    json j;
+    j["timestamp"] = timing.timestamp;
+    j["provider"] = timing.provider;
+    j["model"] = timing.model;
+    j["success"] = timing.success;
+    j["http_status"] = timing.http_status;
+    j["request_bytes"] = timing.request_bytes;
+    j["response_bytes"] = timing.response_bytes;
+    j["prompt_tokens"] = timing.prompt_tokens;
+    j["completion_tokens"] = timing.completion_tokens;
+    j["cached_tokens"] = timing.cached_tokens;
+
+    json phases = json::object();
+    for (const auto& [name, field] : phaseFields()) {
+        phases[name] = timing.*field;
+    }
+    j["phases_ms"] = phases;
+    return j.dump();
+}
+
+} // namespace llm
+} // namespace clion
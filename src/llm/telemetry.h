@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "clion/common.h"
+
+namespace clion {
+namespace llm {
+
+// Timings for one LLM request. Network phases come from libcurl and are
+// disjoint, so they add up to the transfer total; all values in milliseconds.
+struct RequestTiming {
+    std::string timestamp;
+    std::string provider;
+    std::string model;
+    bool success = false;
+    int http_status = 0;
+    size_t request_bytes = 0;
+    size_t response_bytes = 0;
+    int prompt_tokens = 0;
+    int completion_tokens = 0;
+    int cached_tokens = 0;
+
+    double context_build_ms = 0.0;  ///< ContextBuilder work done for this prompt
+    double tokenize_ms = 0.0;       ///< Pre-flight token and cost analysis
+    double serialize_ms = 0.0;      ///< Payload construction
+    double dns_ms = 0.0;
+    double connect_ms = 0.0;
+    double tls_ms = 0.0;
+    double ttfb_ms = 0.0;           ///< Request sent until first response byte
+    double transfer_ms = 0.0;       ///< First until last response byte
+    double parse_ms = 0.0;          ///< Response parsing
+    double total_ms = 0.0;          ///< Wall time of the whole request
+};
+
+struct PhaseStats {
+    std::string phase;
+    size_t count = 0;
+    double total_ms = 0.0;
+    double max_ms = 0.0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+};
+
+struct TelemetrySnapshot {
+    size_t requests = 0;
+    size_t failures = 0;
+    std::vector<PhaseStats> phases;
+};
+
+// Process-wide request telemetry. Disabled by default; when enabled every
+// request is aggregated for snapshots and, if an output is set, appended to it
+// as one JSON object per line.
+class Telemetry {
+public:
+    // `output` is a file path, "-" for stderr, or empty for snapshots only
+    static void enable(const std::string& output = "");
+    static void disable();
+    static bool isEnabled();
+
+    // Enables telemetry when CLION_TELEMETRY is set; its value is the output
+    static void configureFromEnvironment();
+
+    // Context building happens before the request exists, so its time is held
+    // until the next request is recorded
+    static void recordContextBuild(double milliseconds);
+    static double takePendingContextBuild();
+
+    static void record(const RequestTiming& timing);
+
+    static TelemetrySnapshot getSnapshot();
+    static std::string getSnapshotJson();
+    static void reset();
+
+    static std::string toJsonLine(const RequestTiming& timing);
+};
+
+} // namespace llm
+} // namespace clion
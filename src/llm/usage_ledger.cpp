@@ -0,0 +1,384 @@
+#include "usage_ledger.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+namespace clion {
+namespace llm {
+
+namespace {
+    struct LedgerState {
+        std::mutex mutex;
+        bool enabled = true;
+        std::string path;           // Empty until first use: default path
+        std::string open_path;
+        std::ofstream file;
+    };
+
+    LedgerState& state() {
+        static LedgerState instance;
+        return instance;
+    }
+
+    std::string getDefaultPath() {
+        const char* home_dir = std::getenv("HOME");
+        if (!home_dir) {
+            home_dir = std::getenv("USERPROFILE"); // Windows fallback
+        }
+        if (!home_dir) {
+            return "";
+        }
+        return (std::filesystem::path(home_dir) / ".clion" / "usage.jsonl").string();
+    }
+
+    std::string getCurrentTimestamp() {
+        auto now = std::chrono::system_clock::now();
+        auto time_t = std::chrono::system_clock::to_time_t(now);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now.time_since_epoch()) % 1000;
+
+        std::stringstream ss;
+        ss << std::put_time(std::gmtime(&time_t), "%Y-%m-%dT%H:%M:%S");
+        ss << '.' << std::setfill('0') << std::setw(3) << ms.count() << 'Z';
+        return ss.str();
+    }
+
+    std::string resolvedPathLocked(const LedgerState& s) {
+        return s.path.empty() ? getDefaultPath() : s.path;
+    }
+
+    // Lines start with the timestamp, so date and substring filters can
+    // reject most lines of a large ledger without parsing them
+    constexpr const char TIMESTAMP_PREFIX[] = "{\"timestamp\":\"";
+    constexpr size_t TIMESTAMP_OFFSET = sizeof(TIMESTAMP_PREFIX) - 1;
+
+    // Filter values as toJsonLine() writes them, quotes and backslashes
+    // escaped, for finding them in raw lines. Values the serializer rejects
+    // are left out and only checked after parsing.
+    std::vector<std::string> escapedFilters(const UsageQuery& query) {
+        std::vector<std::string> filters;
+        for (const std::string* value : {&query.session_id, &query.model, &query.project}) {
+            if (value->empty()) {
+                continue;
+            }
+            try {
+                std::string quoted = nlohmann::json(*value).dump();
+                filters.push_back(quoted.substr(1, quoted.size() - 2));
+            } catch (const std::exception&) {
+                // Invalid UTF-8
+            }
+        }
+        return filters;
+    }
+
+    bool mayMatch(const std::string& line, const UsageQuery& query,
+                  const std::vector<std::string>& escaped_filters) {
+        if (!query.since.empty() && line.compare(0, TIMESTAMP_OFFSET, TIMESTAMP_PREFIX) == 0 &&
+            line.compare(TIMESTAMP_OFFSET, query.since.size(), query.since) < 0) {
+            return false;
+        }
+        for (const std::string& filter : escaped_filters) {
+            if (line.find(filter) == std::string::npos) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool matches(const UsageRecord& record, const UsageQuery& query) {
+        return (query.session_id.empty() || record.session_id == query.session_id) &&
+               (query.model.empty() || record.model == query.model) &&
+               (query.project.empty() || record.project == query.project) &&
+               (query.since.empty() || record.timestamp.compare(0, query.since.size(), query.since) >= 0);
+    }
+
+    std::string groupKey(const UsageRecord& record, const std::string& group_by) {
+        if (group_by == "session") {
+            return record.session_id.empty() ? "(none)" : record.session_id;
+        }
+        if (group_by == "day") {
+            return record.timestamp.substr(0, 10);
+        }
+        if (group_by == "project") {
+            return record.project;
+        }
+        return record.model;
+    }
+
+    // Fast path for the lines record() writes: one flat object of strings
+    // without escapes, numbers and booleans. Anything else returns false and
+    // goes through the full JSON parser.
+    bool parseFlatLine(std::string_view line, UsageRecord& record) {
+        size_t pos = 0;
+        auto skip = [&](char expected) {
+            if (pos < line.size() && line[pos] == expected) {
+                pos++;
+                return true;
+            }
+            return false;
+        };
+        auto readString = [&](std::string_view& out) {
+            if (!skip('"')) {
+                return false;
+            }
+            size_t end = line.find('"', pos);
+            if (end == std::string_view::npos) {
+                return false;
+            }
+            out = line.substr(pos, end - pos);
+            pos = end + 1;
+            return out.find('\\') == std::string_view::npos;
+        };
+
+        if (!skip('{')) {
+            return false;
+        }
+        bool closed = skip('}');
+        while (!closed) {
+            std::string_view key;
+            if (!readString(key) || !skip(':')) {
+                return false;
+            }
+            std::string_view text;
+            bool is_string = pos < line.size() && line[pos] == '"';
+            if (is_string) {
+                if (!readString(text)) {
+                    return false;
+                }
+            } else {
+                size_t end = line.find_first_of(",}", pos);
+                if (end == std::string_view::npos) {
+                    return false;
+                }
+                text = line.substr(pos, end - pos);
+                pos = end;
+            }
+
+            if (is_string) {
+                if (key == "timestamp") record.timestamp = text;
+                else if (key == "session_id") record.session_id = text;
+                else if (key == "project") record.project = text;
+                else if (key == "provider") record.provider = text;
+                else if (key == "model") record.model = text;
+            } else if (key == "success") {
+                record.success = text == "true";
+            } else {
+                // Integer and floating-point fields alike
+                std::string number(text);
+                char* end = nullptr;
+                double value = std::strtod(number.c_str(), &end);
+                if (end != number.c_str() + number.size()) {
+                    return false;
+                }
+                int count = static_cast<int>(value);
+                if (key == "estimated_input_tokens") record.estimated_input_tokens = count;
+                else if (key == "estimated_output_tokens") record.estimated_output_tokens = count;
+                else if (key == "prompt_tokens") record.prompt_tokens = count;
+                else if (key == "completion_tokens") record.completion_tokens = count;
+                else if (key == "cached_tokens") record.cached_tokens = count;
+                else if (key == "estimated_cost") record.estimated_cost = value;
+                else if (key == "actual_cost") record.actual_cost = value;
+                else if (key == "latency_ms") record.latency_ms = value;
+            }
+
+            if (skip('}')) {
+                closed = true;
+            } else if (!skip(',')) {
+                return false;
+            }
+        }
+        return pos == line.size();
+    }
+
+    template <typename Callback>
+    void forEachRecord(const std::string& path, const UsageQuery& query, Callback&& callback) {
+        std::ifstream file(path);
+        std::vector<std::string> escaped_filters = escapedFilters(query);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || !mayMatch(line, query, escaped_filters)) {
+                continue;
+            }
+            auto record = UsageLedger::fromJsonLine(line);
+            if (record && matches(*record, query)) {
+                callback(*record);
+            }
+        }
+    }
+}
+
+void UsageLedger::configureFromEnvironment() {
+    const char* value = std::getenv("CLION_USAGE_LEDGER");
+    if (!value || !*value) {
+        return;
+    }
+    std::string setting = value;
+    if (setting == "off" || setting == "0" || setting == "false") {
+        setEnabled(false);
+    } else {
+        setPath(setting);
+    }
+}
+
+void UsageLedger::setEnabled(bool enabled) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.enabled = enabled;
+}
+
+bool UsageLedger::isEnabled() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.enabled;
+}
+
+void UsageLedger::setPath(const std::string& path) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.path = path;
+}
+
+std::string UsageLedger::getPath() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return resolvedPathLocked(s);
+}
+
+bool UsageLedger::record(const UsageRecord& record) {
+    UsageRecord stamped = record;
+    if (stamped.timestamp.empty()) {
+        stamped.timestamp = getCurrentTimestamp();
+    }
+    if (stamped.project.empty()) {
+        std::error_code ec;
+        stamped.project = std::filesystem::current_path(ec).string();
+    }
+    std::string line = toJsonLine(stamped);
+    line += '\n';
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.enabled) {
+        return false;
+    }
+    std::string path = resolvedPathLocked(s);
+    if (path.empty()) {
+        return false;
+    }
+    if (!s.file.is_open() || s.open_path != path) {
+        s.file.close();
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+        // Append mode, so concurrent processes add whole lines
+        s.file.open(path, std::ios::app | std::ios::binary);
+        s.open_path = path;
+    }
+    if (!s.file.is_open()) {
+        return false;
+    }
+    s.file.write(line.data(), static_cast<std::streamsize>(line.size()));
+    s.file.flush();
+    return s.file.good();
+}
+
+std::vector<UsageRecord> UsageLedger::load(const UsageQuery& query) {
+    std::vector<UsageRecord> records;
+    forEachRecord(getPath(), query, [&](const UsageRecord& record) {
+        records.push_back(record);
+    });
+    return records;
+}
+
+std::vector<UsageSummary> UsageLedger::summarize(const UsageQuery& query) {
+    std::unordered_map<std::string, UsageSummary> groups;
+    forEachRecord(getPath(), query, [&](const UsageRecord& record) {
+        std::string key = groupKey(record, query.group_by);
+        UsageSummary& summary = groups[key];
+        summary.key = key;
+        summary.requests++;
+        if (!record.success) {
+            summary.failures++;
+        }
+        summary.estimated_input_tokens += record.estimated_input_tokens;
+        summary.prompt_tokens += record.prompt_tokens;
+        summary.completion_tokens += record.completion_tokens;
+        summary.cached_tokens += record.cached_tokens;
+        summary.estimated_cost += record.estimated_cost;
+        summary.actual_cost += record.actual_cost;
+        summary.total_latency_ms += record.latency_ms;
+        summary.max_latency_ms = std::max(summary.max_latency_ms, record.latency_ms);
+    });
+
+    std::vector<UsageSummary> summaries;
+    summaries.reserve(groups.size());
+    for (auto& [key, summary] : groups) {
+        summaries.push_back(std::move(summary));
+    }
+    std::sort(summaries.begin(), summaries.end(), [&](const UsageSummary& a, const UsageSummary& b) {
+        if (query.group_by == "day") {
+            return a.key < b.key;
+        }
+        return a.actual_cost != b.actual_cost ? a.actual_cost > b.actual_cost : a.key < b.key;
+    });
+    return summaries;
+}
+
+std::string UsageLedger::toJsonLine(const UsageRecord& record) {
+    // ordered_json keeps the timestamp first; see mayMatch
+    nlohmann::ordered_json j;
+    j["timestamp"] = record.timestamp;
+    j["session_id"] = record.session_id;
+    j["project"] = record.project;
+    j["provider"] = record.provider;
+    j["model"] = record.model;
+    j["success"] = record.success;
+    j["estimated_input_tokens"] = record.estimated_input_tokens;
+    j["estimated_output_tokens"] = record.estimated_output_tokens;
+    j["prompt_tokens"] = record.prompt_tokens;
+    j["completion_tokens"] = record.completion_tokens;
+    j["cached_tokens"] = record.cached_tokens;
+    j["estimated_cost"] = record.estimated_cost;
+    j["actual_cost"] = record.actual_cost;
+    j["latency_ms"] = record.latency_ms;
+    return j.dump();
+}
+
+std::optional<UsageRecord> UsageLedger::fromJsonLine(const std::string& line) {
+    UsageRecord record;
+    if (parseFlatLine(line, record)) {
+        return record;
+    }
+    try {
+        auto j = nlohmann::json::parse(line);
+        UsageRecord record;
+        record.timestamp = j.value("timestamp", "");
+        record.session_id = j.value("session_id", "");
+        record.project = j.value("project", "");
+        record.provider = j.value("provider", "");
+        record.model = j.value("model", "");
+        record.success = j.value("success", false);
+        record.estimated_input_tokens = j.value("estimated_input_tokens", 0);
+        record.estimated_output_tokens = j.value("estimated_output_tokens", 0);
+        record.prompt_tokens = j.value("prompt_tokens", 0);
+        record.completion_tokens = j.value("completion_tokens", 0);
+        record.cached_tokens = j.value("cached_tokens", 0);
+        record.estimated_cost = j.value("estimated_cost", 0.0);
+        record.actual_cost = j.value("actual_cost", 0.0);
+        record.latency_ms = j.value("latency_ms", 0.0);
+        return record;
+    } catch (const std::exception&) {
+        // A partially written last line after a crash
+        return std::nullopt;
+    }
+}
+
+} // namespace llm
+} // namespace clion
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "clion/common.h"
+
+namespace clion {
+namespace llm {
+
+// One LLM request: what was estimated before sending next to what the
+// provider reported back
+struct UsageRecord {
+    std::string timestamp;
+    std::string session_id;         ///< Empty for requests without a session
+    std::string project;            ///< Working directory of the process
+    std::string provider;
+    std::string model;
+    bool success = false;
+    int estimated_input_tokens = 0;
+    int estimated_output_tokens = 0;
+    int prompt_tokens = 0;          ///< As reported by the provider
+    int completion_tokens = 0;
+    int cached_tokens = 0;
+    double estimated_cost = 0.0;
+    double actual_cost = 0.0;       ///< Pricing applied to the reported tokens
+    double latency_ms = 0.0;
+};
+
+struct UsageSummary {
+    std::string key;                ///< Session, model, day or project
+    size_t requests = 0;
+    size_t failures = 0;
+    int64_t estimated_input_tokens = 0;
+    int64_t prompt_tokens = 0;
+    int64_t completion_tokens = 0;
+    int64_t cached_tokens = 0;
+    double estimated_cost = 0.0;
+    double actual_cost = 0.0;
+    double total_latency_ms = 0.0;
+    double max_latency_ms = 0.0;
+
+    // Share of prompt tokens served from the provider's cache
+    double cachedTokenFraction() const {
+        return prompt_tokens > 0 ? static_cast<double>(cached_tokens) / prompt_tokens : 0.0;
+    }
+};
+
+struct UsageQuery {
+    std::string group_by = "model";  ///< "session", "model", "day" or "project"
+    std::string session_id;          ///< Filters; empty matches everything
+    std::string model;
+    std::string project;
+    std::string since;               ///< YYYY-MM-DD, inclusive
+};
+
+// Append-only request ledger, one JSON object per line in
+// ~/.clion/usage.jsonl. Enabled by default; CLION_USAGE_LEDGER set to "off"
+// disables it and any other value is used as the ledger path.
+class UsageLedger {
+public:
+    static void configureFromEnvironment();
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+    static void setPath(const std::string& path);
+    static std::string getPath();
+
+    static bool record(const UsageRecord& record);
+
+    // Records matching the query's filters, oldest first
+    static std::vector<UsageRecord> load(const UsageQuery& query);
+    // Totals per group, largest actual cost first
+    static std::vector<UsageSummary> summarize(const UsageQuery& query);
+
+    static std::string toJsonLine(const UsageRecord& record);
+    static std::optional<UsageRecord> fromJsonLine(const std::string& line);
+};
+
+} // namespace llm
+} // namespace clion
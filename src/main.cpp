@@ -1,7 +1,13 @@
 #include <iostream>
 #include <memory>
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <sstream>
+#include <thread>
 #include "cli/cli_parser.h"
 #include "cli/interaction.h"
+#include "cli/interrupt_handler.h"
 #include "ui/ui_manager.h"
 #include "compiler/command_executor.h"
 #include "compiler/enhanced_command_executor.h"
@@ -16,6 +22,10 @@
 #include "llm/llm_client.h"
 #include "llm/prompts.h"
 #include "llm/context_builder.h"
+#include "llm/context_prefetcher.h"
+#include "llm/session_maintenance.h"
+#include "llm/telemetry.h"
+#include "llm/usage_ledger.h"
 #include "nlohmann/json.hpp"
 
 // Global configuration
@@ -69,6 +79,7 @@ int main(int argc, char** argv) {
         config.model = g_clion_config.api_model;
         config.max_tokens = g_clion_config.max_tokens;
         config.temperature = g_clion_config.temperature;
+        config.history_token_budget = g_clion_config.history_token_budget;
         llm_client.initialize(config);
     }
 
@@ -83,6 +94,14 @@ int main(int argc, char** argv) {
         }
         
         const auto& options = parser.getOptions();
+
+        // Request telemetry: --telemetry takes precedence over CLION_TELEMETRY
+        if (!options.telemetry_output.empty()) {
+            clion::llm::Telemetry::enable(options.telemetry_output);
+        } else {
+            clion::llm::Telemetry::configureFromEnvironment();
+        }
+        clion::llm::UsageLedger::configureFromEnvironment();
         
         // Handle help and version flags first
         if (options.help) {
@@ -246,19 +265,60 @@ int main(int argc, char** argv) {
             if (llm_client.isInitialized()) {
                 if (options.generate_interactive) {
                     clion::cli::InteractionHandler::showInfo("Entering interactive generation mode. Type 'exit' or 'quit' to end.");
+                    // Index the project and warm files the conversation mentions
+                    // while the user reads the answer and types the next prompt
+                    clion::llm::ContextPrefetcher prefetcher;
+                    prefetcher.warmProject();
+                    // Session housekeeping, if due, while the user is typing;
+                    // held while a request is in flight. The idle pass never
+                    // deletes sessions; that is left to `clion maintain`
+                    clion::llm::MaintenanceOptions idle_maintenance_options;
+                    idle_maintenance_options.max_age_days = 0;
+                    clion::llm::SessionMaintenance maintenance(idle_maintenance_options);
+                    maintenance.startIfDue(std::chrono::hours(24));
                     std::string user_input;
                     while (true) {
                         user_input = clion::cli::InteractionHandler::getUserInput("> ");
                         if (user_input == "exit" || user_input == "quit") {
                             break;
                         }
+                        maintenance.pause();
                         std::string enhanced_prompt = clion::llm::ContextBuilder::buildContext(user_input);
-                        auto llm_response = llm_client.sendRequest(enhanced_prompt);
+
+                        // Run the request in the background so Ctrl-C cancels just
+                        // this request instead of exiting the session
+                        clion::llm::CancellationToken cancel_token;
+                        clion::llm::LLMResponse llm_response;
+                        {
+                            clion::cli::ScopedInterruptCapture interrupt_capture;
+                            auto pending = llm_client.sendRequestAsync(enhanced_prompt, "", -1.0f, cancel_token);
+                            while (pending.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+                                if (clion::cli::InterruptHandler::consumeInterrupt() && !cancel_token.isCancelled()) {
+                                    clion::cli::InteractionHandler::showWarning("Cancelling request...");
+                                    cancel_token.cancel();
+                                }
+                            }
+                            llm_response = pending.get();
+                        }
+
                         if (llm_response.success) {
                             std::cout << llm_response.content << std::endl;
+                            prefetcher.prefetch(user_input + "\n" + llm_response.content);
+                        } else if (llm_response.cancelled) {
+                            clion::cli::InteractionHandler::showInfo("Request cancelled.");
                         } else {
                             std::cerr << "Error: " << llm_response.error_message << std::endl;
                         }
+                        maintenance.resume();
+                    }
+
+                    const auto& cache_stats = llm_client.getCacheStats();
+                    if (cache_stats.requests > 0) {
+                        std::ostringstream cache_summary;
+                        cache_summary << "Prompt cache: " << cache_stats.cache_hits << " of " << cache_stats.requests
+                                      << " requests hit, " << std::fixed << std::setprecision(1)
+                                      << cache_stats.cachedTokenFraction() * 100.0 << "% of prompt tokens cached";
+                        clion::cli::InteractionHandler::showInfo(cache_summary.str());
                     }
                 } else {
                     std::string context_files;
@@ -327,6 +387,8 @@ int main(int argc, char** argv) {
             }
             std::string original_content = *original_content_opt;
 
+            const std::string system_instruction = buildSystemInstructions(g_clion_config);
+
             const int MAX_ITERATIONS = 3;
             int iteration = 0;
             bool review_complete = false;
@@ -335,21 +397,21 @@ int main(int argc, char** argv) {
                 iteration++;
                 clion::cli::InteractionHandler::showInfo("Review iteration " + std::to_string(iteration) + "/" + std::to_string(MAX_ITERATIONS));
 
-                // Build review prompt
-                std::string system_instruction = buildSystemInstructions(g_clion_config);
-
+                // Build review prompt. The system instruction and file context come
+                // first and stay byte-identical across iterations so providers can
+                // serve them from their prompt cache; per-iteration notes go last.
                 std::string base_prompt = "Please analyze this C++ code and provide specific improvement suggestions.\n";
                 base_prompt += "Focus on: code quality, best practices, performance, maintainability, and potential bugs.\n\n";
 
+                std::string enhanced_prompt = clion::llm::ContextBuilder::buildContext(base_prompt + "@file " + options.file_path);
+
                 if (iteration > 1) {
-                    base_prompt += "Previous review iteration " + std::to_string(iteration - 1) + " completed.\n";
+                    enhanced_prompt += "\n\nPrevious review iteration " + std::to_string(iteration - 1) + " completed.\n";
                 }
 
-                std::string enhanced_prompt = clion::llm::ContextBuilder::buildContext(base_prompt + "@file " + options.file_path);
-
                 clion::cli::InteractionHandler::showInfo("Analyzing code with AI...");
 
-                auto llm_response = llm_client.sendRequest(enhanced_prompt);
+                auto llm_response = llm_client.sendRequest(enhanced_prompt, system_instruction);
 
                 if (!llm_response.success) {
                     clion::cli::InteractionHandler::showError("Failed to get AI review: " + llm_response.error_message);
@@ -487,6 +549,8 @@ int main(int argc, char** argv) {
                 return 1;
             }
 
+            const std::string system_instruction = buildSystemInstructions(g_clion_config);
+
             const int MAX_ITERATIONS = 5;
             int iteration = 0;
             bool build_successful = false;
@@ -509,8 +573,6 @@ int main(int argc, char** argv) {
                 // Generate enhanced context for LLM
                 std::string context = "Error Details:\n" + result.stdout_output + "\n";
 
-                std::string system_instruction = buildSystemInstructions(g_clion_config);
-
                 std::string prompt = "The following command failed. Please provide a fix.\n\n" + context +
                                    "Please provide a targeted fix. Only modify the necessary code.\n\n" +
                                    "Iteration: " + std::to_string(iteration) + "/" + std::to_string(MAX_ITERATIONS) + "\n\n";
@@ -706,6 +768,120 @@ int main(int argc, char** argv) {
             
             return 0;
         }
+        else if (options.command == "usage") {
+            clion::llm::UsageQuery query;
+            query.group_by = options.usage_group_by;
+            query.session_id = options.usage_session;
+            query.model = options.usage_model;
+            query.project = options.usage_project == "." ? current_path.string() : options.usage_project;
+            query.since = options.usage_since;
+            auto summaries = clion::llm::UsageLedger::summarize(query);
+
+            if (options.usage_json) {
+                nlohmann::json out = nlohmann::json::array();
+                for (const auto& summary : summaries) {
+                    out.push_back({{"key", summary.key},
+                                   {"requests", summary.requests},
+                                   {"failures", summary.failures},
+                                   {"estimated_input_tokens", summary.estimated_input_tokens},
+                                   {"prompt_tokens", summary.prompt_tokens},
+                                   {"completion_tokens", summary.completion_tokens},
+                                   {"cached_tokens", summary.cached_tokens},
+                                   {"cached_token_fraction", summary.cachedTokenFraction()},
+                                   {"estimated_cost", summary.estimated_cost},
+                                   {"actual_cost", summary.actual_cost},
+                                   {"avg_latency_ms", summary.requests ? summary.total_latency_ms / summary.requests : 0.0},
+                                   {"max_latency_ms", summary.max_latency_ms}});
+                }
+                std::cout << out.dump(2) << std::endl;
+                return 0;
+            }
+
+            if (summaries.empty()) {
+                std::cout << "No recorded requests in " << clion::llm::UsageLedger::getPath() << std::endl;
+                return 0;
+            }
+            std::cout << std::left << std::setw(28) << options.usage_group_by << std::right
+                      << std::setw(8) << "reqs" << std::setw(8) << "failed"
+                      << std::setw(12) << "est. in" << std::setw(12) << "actual in"
+                      << std::setw(12) << "out" << std::setw(12) << "cached" << std::setw(10) << "cached %"
+                      << std::setw(12) << "est. $" << std::setw(12) << "actual $"
+                      << std::setw(10) << "avg ms" << std::endl;
+            for (const auto& summary : summaries) {
+                std::cout << std::left << std::setw(28) << summary.key.substr(0, 27) << std::right
+                          << std::setw(8) << summary.requests << std::setw(8) << summary.failures
+                          << std::setw(12) << summary.estimated_input_tokens << std::setw(12) << summary.prompt_tokens
+                          << std::setw(12) << summary.completion_tokens << std::setw(12) << summary.cached_tokens
+                          << std::fixed << std::setprecision(1)
+                          << std::setw(10) << summary.cachedTokenFraction() * 100.0
+                          << std::setprecision(4)
+                          << std::setw(12) << summary.estimated_cost << std::setw(12) << summary.actual_cost
+                          << std::setprecision(0)
+                          << std::setw(10) << (summary.requests ? summary.total_latency_ms / summary.requests : 0.0)
+                          << std::endl;
+            }
+            return 0;
+        }
+        else if (options.command == "maintain") {
+            clion::llm::MaintenanceOptions maintenance_options;
+            maintenance_options.max_age_days = options.maintain_max_age_days;
+            maintenance_options.io_bytes_per_second = static_cast<size_t>(options.maintain_rate_mb * 1024 * 1024);
+            maintenance_options.compress = !options.maintain_no_compress;
+            maintenance_options.train_dictionary = options.maintain_train_dictionary;
+            clion::llm::SessionMaintenance maintenance(maintenance_options);
+
+            // Passes run at idle priority on the maintenance thread; Ctrl-C
+            // ends the current one after its step
+            clion::cli::ScopedInterruptCapture interrupt_capture;
+            const auto interval = std::chrono::hours(options.maintain_interval_hours);
+            bool interrupted = false;
+            bool pass_started = true;
+            maintenance.start();
+            while (true) {
+                if (pass_started) {
+                    while (!maintenance.waitIdle(std::chrono::milliseconds(100))) {
+                        if (clion::cli::InterruptHandler::consumeInterrupt()) {
+                            maintenance.stop();
+                            interrupted = true;
+                        }
+                    }
+
+                    auto stats = maintenance.getStats();
+                    if (stats.completed) {
+                        std::ostringstream summary;
+                        summary << "Checked " << stats.sessions_checked << " sessions: "
+                                << stats.sessions_deleted << " deleted, " << stats.sessions_compacted << " compacted, "
+                                << stats.sessions_compressed << " compressed, " << stats.temp_files_removed
+                                << " temporary files removed" << (stats.catalog_rebuilt ? ", catalog rebuilt" : "")
+                                << std::fixed << std::setprecision(1) << " ("
+                                << stats.bytes_processed / (1024.0 * 1024.0) << " MB in "
+                                << stats.elapsed_ms / 1000.0 << " s)";
+                        clion::cli::InteractionHandler::showSuccess(summary.str());
+                        if (stats.failures > 0) {
+                            clion::cli::InteractionHandler::showWarning(std::to_string(stats.failures) +
+                                                                        " steps failed; the next pass retries them");
+                        }
+                    } else if (interrupted) {
+                        clion::cli::InteractionHandler::showInfo("Maintenance stopped.");
+                    } else if (!options.maintain_daemon) {
+                        clion::cli::InteractionHandler::showInfo("Another process is maintaining the sessions.");
+                    }
+                }
+                if (!options.maintain_daemon || interrupted) {
+                    break;
+                }
+
+                // Checks every minute, so a pass another process completed
+                // meanwhile pushes the next one back
+                auto next_check = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+                while (!interrupted && std::chrono::steady_clock::now() < next_check) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    interrupted = clion::cli::InterruptHandler::consumeInterrupt();
+                }
+                pass_started = !interrupted && maintenance.startIfDue(interval);
+            }
+            return 0;
+        }
         else {
             std::cerr << "Unknown command: " << options.command << std::endl;
             parser.printHelp();
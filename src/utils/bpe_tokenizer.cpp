@@ -0,0 +1,826 @@
+#include "bpe_tokenizer.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <sstream>
+
+namespace clion {
+namespace utils {
+
+namespace {
+    constexpr uint32_t NO_RANK = std::numeric_limits<uint32_t>::max();
+
+    // Pieces up to this length use the quadratic scan, which beats a heap on
+    // the short pieces that make up nearly all real text
+    constexpr size_t SMALL_PIECE = 128;
+
+    // Byte classes for the pre-tokenizer
+    enum : uint8_t {
+        CLASS_OTHER = 0,
+        CLASS_LETTER = 1,
+        CLASS_DIGIT = 2,
+        CLASS_SPACE = 4,
+        CLASS_NEWLINE = 8
+    };
+
+    constexpr std::array<uint8_t, 256> buildClassTable() {
+        std::array<uint8_t, 256> table{};
+        for (int c = 0; c < 128; ++c) {
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+                table[c] = CLASS_LETTER;
+            } else if (c >= '0' && c <= '9') {
+                table[c] = CLASS_DIGIT;
+            } else if (c == ' ' || c == '\t' || c == '\v' || c == '\f') {
+                table[c] = CLASS_SPACE;
+            } else if (c == '\r' || c == '\n') {
+                table[c] = CLASS_SPACE | CLASS_NEWLINE;
+            }
+        }
+        return table;
+    }
+
+    constexpr std::array<uint8_t, 256> ASCII_CLASS = buildClassTable();
+
+    // Letter case for o200k's pre-tokenizer, which splits words where the
+    // case changes. CASE_UPPER marks characters in [\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}],
+    // CASE_LOWER those in [\p{Ll}\p{Lm}\p{Lo}\p{M}]; caseless letters and
+    // combining marks are in both.
+    enum : uint8_t {
+        CASE_UPPER = 1,
+        CASE_LOWER = 2
+    };
+
+    // Cased scripts with simple layouts are recognised: Latin-1, Latin
+    // Extended-A, Greek and Cyrillic. Other letters count as caseless.
+    uint8_t caseOfCodePoint(uint32_t cp) {
+        if (cp < 0x80) {
+            if (cp >= 'A' && cp <= 'Z') return CASE_UPPER;
+            if (cp >= 'a' && cp <= 'z') return CASE_LOWER;
+            return 0;
+        }
+        if (cp >= 0x300 && cp <= 0x36F) {
+            return CASE_UPPER | CASE_LOWER;             // Combining marks
+        }
+        if (cp >= 0xC0 && cp <= 0xFF && cp != 0xD7 && cp != 0xF7) {
+            return cp <= 0xDE ? CASE_UPPER : CASE_LOWER;
+        }
+        if (cp >= 0x100 && cp <= 0x17F) {
+            // Pairs alternate upper/lower, shifted by one between U+0139 and U+0148
+            // and from U+0179; U+0138, U+0149 and U+017F have no pair
+            if (cp == 0x138 || cp == 0x149 || cp == 0x17F) return CASE_LOWER;
+            if (cp == 0x178) return CASE_UPPER;
+            bool odd_upper = (cp >= 0x139 && cp <= 0x148) || cp >= 0x179;
+            return ((cp & 1) != 0) == odd_upper ? CASE_UPPER : CASE_LOWER;
+        }
+        if ((cp >= 0x391 && cp <= 0x3A9) || (cp >= 0x400 && cp <= 0x42F)) {
+            return CASE_UPPER;
+        }
+        if ((cp >= 0x3AC && cp <= 0x3CE) || (cp >= 0x430 && cp <= 0x45F)) {
+            return CASE_LOWER;
+        }
+        return CASE_UPPER | CASE_LOWER;
+    }
+
+    // Coarse Unicode classes: the common spaces, digits, punctuation, symbol
+    // and emoji blocks are recognised; everything else counts as a letter
+    uint8_t classOfCodePoint(uint32_t cp) {
+        if (cp == 0x85 || cp == 0xA0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200A) ||
+            cp == 0x2028 || cp == 0x2029 || cp == 0x202F || cp == 0x205F || cp == 0x3000) {
+            return CLASS_SPACE;
+        }
+        if (cp == 0xB2 || cp == 0xB3 || cp == 0xB9 || (cp >= 0xBC && cp <= 0xBE) ||
+            (cp >= 0x660 && cp <= 0x669) || (cp >= 0xFF10 && cp <= 0xFF19)) {
+            return CLASS_DIGIT;
+        }
+        if ((cp >= 0xA1 && cp <= 0xBF && cp != 0xAA && cp != 0xB5 && cp != 0xBA) ||
+            cp == 0xD7 || cp == 0xF7 ||
+            (cp >= 0x300 && cp <= 0x36F) ||                 // Combining marks
+            (cp >= 0x200B && cp <= 0x206F) ||               // General punctuation
+            (cp >= 0x20A0 && cp <= 0x20FF) ||               // Currency, combining symbols
+            (cp >= 0x2190 && cp <= 0x2BFF) ||               // Arrows, math, box drawing, dingbats
+            (cp >= 0x3001 && cp <= 0x303F) ||               // CJK punctuation
+            (cp >= 0xFE00 && cp <= 0xFE0F) ||               // Variation selectors
+            (cp >= 0xFE30 && cp <= 0xFE4F) ||
+            (cp >= 0xFF01 && cp <= 0xFF0F) || (cp >= 0xFF1A && cp <= 0xFF20) ||
+            (cp >= 0x1F000 && cp <= 0x1FAFF)) {             // Emoji and pictographs
+            return CLASS_OTHER;
+        }
+        return CLASS_LETTER;
+    }
+
+    // Class of the character at `pos`; sets `length` to its size in bytes.
+    // Malformed UTF-8 is taken one byte at a time as a letter.
+    inline uint8_t classAt(std::string_view text, size_t pos, size_t& length) {
+        unsigned char lead = static_cast<unsigned char>(text[pos]);
+        if (lead < 0x80) {
+            length = 1;
+            return ASCII_CLASS[lead];
+        }
+
+        size_t extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+        if (extra == 0 || lead >= 0xF8 || pos + extra >= text.size()) {
+            length = 1;
+            return CLASS_LETTER;
+        }
+        uint32_t cp = lead & (0x3F >> extra);
+        for (size_t k = 1; k <= extra; ++k) {
+            unsigned char continuation = static_cast<unsigned char>(text[pos + k]);
+            if ((continuation & 0xC0) != 0x80) {
+                length = 1;
+                return CLASS_LETTER;
+            }
+            cp = (cp << 6) | (continuation & 0x3F);
+        }
+        length = extra + 1;
+        return classOfCodePoint(cp);
+    }
+
+    // Case bits of the character at `pos`, which classAt() found to be a
+    // letter or other character `length` bytes long
+    inline uint8_t caseAt(std::string_view text, size_t pos, size_t length, uint8_t cls) {
+        if (cls & CLASS_LETTER) {
+            if (length == 1) {
+                // ASCII, or a malformed byte taken as a caseless letter
+                return static_cast<unsigned char>(text[pos]) < 0x80
+                    ? caseOfCodePoint(static_cast<unsigned char>(text[pos]))
+                    : CASE_UPPER | CASE_LOWER;
+            }
+        } else if (cls != CLASS_OTHER || length == 1) {
+            return 0;
+        }
+        uint32_t cp = static_cast<unsigned char>(text[pos]) & (0x3F >> (length - 1));
+        for (size_t k = 1; k < length; ++k) {
+            cp = (cp << 6) | (static_cast<unsigned char>(text[pos + k]) & 0x3F);
+        }
+        uint8_t letter_case = caseOfCodePoint(cp);
+        // Of the characters classed as other, only combining marks have a case
+        return (cls & CLASS_LETTER) || (cp >= 0x300 && cp <= 0x36F) ? letter_case : 0;
+    }
+
+    // Per-thread memo of how pieces were merged, keyed by tokenizer instance
+    constexpr size_t PIECE_CACHE_SIZE = 4096;
+    constexpr size_t MAX_CACHED_PIECE = 30;
+    constexpr size_t MAX_CACHED_TOKENS = 8;
+
+    struct PieceCacheEntry {
+        uint64_t owner = 0;
+        uint8_t length = 0;
+        uint8_t token_count = 0;
+        char bytes[MAX_CACHED_PIECE];
+        uint32_t tokens[MAX_CACHED_TOKENS];
+    };
+
+    std::atomic<uint64_t> next_cache_id{1};
+
+    // Tokens are short, so hash eight bytes at a time with a multiply-xorshift
+    inline size_t hashBytes(std::string_view bytes) {
+        uint64_t hash = 0x9E3779B97F4A7C15ULL ^ bytes.size();
+        size_t i = 0;
+        for (; i + 8 <= bytes.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes.data() + i, 8);
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+            hash ^= hash >> 32;
+        }
+        if (i < bytes.size()) {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes.data() + i, bytes.size() - i);
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+            hash ^= hash >> 32;
+        }
+        return static_cast<size_t>(hash * 0xC4CEB9FE1A85EC53ULL >> 16);
+    }
+
+    // Length of a contraction ('s, 'd, 'm, 't, 'll, 've, 're) at `pos`, or 0
+    size_t contractionLength(std::string_view text, size_t pos) {
+        if (pos + 1 >= text.size()) {
+            return 0;
+        }
+        char a = static_cast<char>(std::tolower(static_cast<unsigned char>(text[pos + 1])));
+        if (a == 's' || a == 'd' || a == 'm' || a == 't') {
+            return 2;
+        }
+        if (pos + 2 >= text.size()) {
+            return 0;
+        }
+        char b = static_cast<char>(std::tolower(static_cast<unsigned char>(text[pos + 2])));
+        if ((a == 'l' && b == 'l') || (a == 'v' && b == 'e') || (a == 'r' && b == 'e')) {
+            return 3;
+        }
+        return 0;
+    }
+
+    bool decodeBase64(std::string_view input, std::string& out) {
+        static const std::array<int8_t, 256> table = [] {
+            std::array<int8_t, 256> t{};
+            t.fill(-1);
+            const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            for (int i = 0; i < 64; ++i) {
+                t[static_cast<unsigned char>(alphabet[i])] = static_cast<int8_t>(i);
+            }
+            return t;
+        }();
+
+        uint32_t buffer = 0;
+        int bits = 0;
+        for (char c : input) {
+            if (c == '=') {
+                break;
+            }
+            int8_t value = table[static_cast<unsigned char>(c)];
+            if (value < 0) {
+                return false;
+            }
+            buffer = (buffer << 6) | static_cast<uint32_t>(value);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out.push_back(static_cast<char>((buffer >> bits) & 0xFF));
+            }
+        }
+        return true;
+    }
+}
+
+bool BpeTokenizer::loadFromFile(const std::string& file_path) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string content = buffer.str();
+
+    struct Entry {
+        size_t offset;
+        size_t length;
+        uint32_t rank;
+    };
+    std::vector<Entry> entries;
+    std::string token_bytes;
+    token_bytes.reserve(content.size() / 2);
+
+    size_t line_start = 0;
+    while (line_start < content.size()) {
+        size_t line_end = content.find('\n', line_start);
+        if (line_end == std::string::npos) {
+            line_end = content.size();
+        }
+        std::string_view line(content.data() + line_start, line_end - line_start);
+        line_start = line_end + 1;
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        size_t space = line.find(' ');
+        if (space == std::string_view::npos) {
+            return false;
+        }
+
+        size_t offset = token_bytes.size();
+        if (!decodeBase64(line.substr(0, space), token_bytes)) {
+            return false;
+        }
+        char* rank_end = nullptr;
+        std::string rank_text(line.substr(space + 1));
+        unsigned long rank = std::strtoul(rank_text.c_str(), &rank_end, 10);
+        if (rank_end == rank_text.c_str() || rank >= NO_RANK) {
+            return false;
+        }
+        entries.push_back({offset, token_bytes.size() - offset, static_cast<uint32_t>(rank)});
+    }
+    if (entries.empty()) {
+        return false;
+    }
+
+    size_t capacity = 16;
+    while (capacity < entries.size() * 2) {
+        capacity <<= 1;
+    }
+    token_bytes_ = std::move(token_bytes);
+    slots_.assign(capacity, Slot());
+    slot_mask_ = capacity - 1;
+    vocabulary_size_ = 0;
+    for (const auto& entry : entries) {
+        if (entry.length == 0) {
+            continue;
+        }
+        std::string_view bytes(token_bytes_.data() + entry.offset, entry.length);
+        size_t index = hashBytes(bytes) & slot_mask_;
+        while (slots_[index].length != 0 &&
+               std::string_view(token_bytes_.data() + slots_[index].offset, slots_[index].length) != bytes) {
+            index = (index + 1) & slot_mask_;
+        }
+        if (slots_[index].length == 0) {
+            vocabulary_size_++;
+        }
+        slots_[index] = {static_cast<uint32_t>(entry.offset), static_cast<uint32_t>(entry.length), entry.rank};
+    }
+    name_ = std::filesystem::path(file_path).stem().string();
+    split_o200k_ = name_.rfind("o200k", 0) == 0;
+    cache_id_ = next_cache_id++;
+    return true;
+}
+
+uint32_t BpeTokenizer::rankOf(std::string_view bytes) const {
+    size_t index = hashBytes(bytes) & slot_mask_;
+    while (true) {
+        const Slot& slot = slots_[index];
+        if (slot.length == 0) {
+            return NO_RANK;
+        }
+        if (slot.length == bytes.size() &&
+            std::memcmp(token_bytes_.data() + slot.offset, bytes.data(), bytes.size()) == 0) {
+            return slot.rank;
+        }
+        index = (index + 1) & slot_mask_;
+    }
+}
+
+template <typename Emit>
+void BpeTokenizer::splitPieces(std::string_view text, Emit&& emit) {
+    const size_t n = text.size();
+    size_t i = 0;
+    size_t length = 0;
+
+    while (i < n) {
+        const size_t start = i;
+        const uint8_t cls = classAt(text, i, length);
+
+        // Contractions
+        if (text[i] == '\'') {
+            size_t contraction = contractionLength(text, i);
+            if (contraction > 0) {
+                emit(text.substr(start, contraction));
+                i += contraction;
+                continue;
+            }
+        }
+
+        // Letters, optionally led by one character that is not a letter,
+        // digit or newline (" word", "_name", "(call")
+        size_t after = i + length;
+        size_t next_length = 0;
+        if ((cls & CLASS_LETTER) ||
+            (!(cls & (CLASS_DIGIT | CLASS_NEWLINE)) && after < n &&
+             (classAt(text, after, next_length) & CLASS_LETTER))) {
+            i = after;
+            while (i < n && (classAt(text, i, length) & CLASS_LETTER)) {
+                i += length;
+            }
+            emit(text.substr(start, i - start));
+            continue;
+        }
+
+        // Numbers in groups of up to three digits
+        if (cls & CLASS_DIGIT) {
+            i = after;
+            for (int digits = 1; digits < 3 && i < n && (classAt(text, i, length) & CLASS_DIGIT); ++digits) {
+                i += length;
+            }
+            emit(text.substr(start, i - start));
+            continue;
+        }
+
+        // Punctuation runs with an optional leading space and trailing newlines
+        size_t p = i;
+        if (text[p] == ' ' && after < n && classAt(text, after, next_length) == CLASS_OTHER) {
+            p = after;
+        }
+        if (classAt(text, p, length) == CLASS_OTHER) {
+            while (p < n && classAt(text, p, length) == CLASS_OTHER) {
+                p += length;
+            }
+            while (p < n && (text[p] == '\r' || text[p] == '\n')) {
+                ++p;
+            }
+            emit(text.substr(start, p - start));
+            i = p;
+            continue;
+        }
+
+        // Whitespace: up to the last newline in the run if it has one,
+        // otherwise all of it except the last character, which is left to
+        // lead the following piece
+        size_t end = i;
+        size_t last_start = i;
+        size_t last_newline = std::string_view::npos;
+        while (end < n) {
+            uint8_t space_cls = classAt(text, end, length);
+            if (!(space_cls & CLASS_SPACE)) {
+                break;
+            }
+            if (space_cls & CLASS_NEWLINE) {
+                last_newline = end;
+            }
+            last_start = end;
+            end += length;
+        }
+        if (last_newline != std::string_view::npos) {
+            end = last_newline + 1;
+        } else if (end < n && last_start > start) {
+            end = last_start;
+        }
+        emit(text.substr(start, end - start));
+        i = end;
+    }
+}
+
+template <typename Emit>
+void BpeTokenizer::splitPiecesO200k(std::string_view text, Emit&& emit) {
+    const size_t n = text.size();
+    size_t length = 0;
+
+    // End of the case-delimited word body starting at `pos`, or npos.
+    // `upper_first` picks [upper]+[lower]* over [upper]*[lower]+.
+    auto wordEnd = [&](size_t pos, bool upper_first) -> size_t {
+        size_t len = 0;
+        size_t upper_end = pos;
+        size_t last_lower = std::string_view::npos;    // Last character of the upper run also in [lower]
+        while (upper_end < n) {
+            uint8_t cls = classAt(text, upper_end, len);
+            uint8_t letter_case = caseAt(text, upper_end, len, cls);
+            if (!(letter_case & CASE_UPPER)) {
+                break;
+            }
+            if (letter_case & CASE_LOWER) {
+                last_lower = upper_end;
+            }
+            upper_end += len;
+        }
+        auto lowerRunEnd = [&](size_t p) {
+            while (p < n) {
+                uint8_t cls = classAt(text, p, len);
+                if (!(caseAt(text, p, len, cls) & CASE_LOWER)) {
+                    break;
+                }
+                p += len;
+            }
+            return p;
+        };
+
+        if (upper_first) {
+            return upper_end > pos ? lowerRunEnd(upper_end) : std::string_view::npos;
+        }
+        // [upper]* gives back characters until [lower]+ can start
+        size_t lower_end = lowerRunEnd(upper_end);
+        if (lower_end > upper_end) {
+            return lower_end;
+        }
+        return last_lower != std::string_view::npos ? lowerRunEnd(last_lower) : std::string_view::npos;
+    };
+
+    size_t i = 0;
+    while (i < n) {
+        const size_t start = i;
+        const uint8_t cls = classAt(text, i, length);
+        const size_t after = i + length;
+
+        // Words, optionally led by one character that is not a letter, digit
+        // or newline, with a trailing contraction: "Hello", " world", "don't",
+        // "getHTTP" + "Response"
+        const bool can_lead = !(cls & (CLASS_LETTER | CLASS_DIGIT | CLASS_NEWLINE)) && after < n;
+        size_t word_end = std::string_view::npos;
+        for (bool upper_first : {false, true}) {
+            if (can_lead) {
+                word_end = wordEnd(after, upper_first);
+            }
+            if (word_end == std::string_view::npos) {
+                word_end = wordEnd(i, upper_first);
+            }
+            if (word_end != std::string_view::npos) {
+                break;
+            }
+        }
+        if (word_end != std::string_view::npos) {
+            if (word_end < n && text[word_end] == '\'') {
+                word_end += contractionLength(text, word_end);
+            }
+            emit(text.substr(start, word_end - start));
+            i = word_end;
+            continue;
+        }
+
+        // Numbers in groups of up to three digits
+        if (cls & CLASS_DIGIT) {
+            i = after;
+            for (int digits = 1; digits < 3 && i < n && (classAt(text, i, length) & CLASS_DIGIT); ++digits) {
+                i += length;
+            }
+            emit(text.substr(start, i - start));
+            continue;
+        }
+
+        // Punctuation runs with an optional leading space, then any newlines
+        // and slashes
+        size_t p = i;
+        size_t next_length = 0;
+        if (text[p] == ' ' && after < n && classAt(text, after, next_length) == CLASS_OTHER) {
+            p = after;
+        }
+        if (classAt(text, p, length) == CLASS_OTHER) {
+            while (p < n && classAt(text, p, length) == CLASS_OTHER) {
+                p += length;
+            }
+            while (p < n && (text[p] == '\r' || text[p] == '\n' || text[p] == '/')) {
+                ++p;
+            }
+            emit(text.substr(start, p - start));
+            i = p;
+            continue;
+        }
+
+        // Whitespace, as for cl100k
+        size_t end = i;
+        size_t last_start = i;
+        size_t last_newline = std::string_view::npos;
+        while (end < n) {
+            uint8_t space_cls = classAt(text, end, length);
+            if (!(space_cls & CLASS_SPACE)) {
+                break;
+            }
+            if (space_cls & CLASS_NEWLINE) {
+                last_newline = end;
+            }
+            last_start = end;
+            end += length;
+        }
+        if (last_newline != std::string_view::npos) {
+            end = last_newline + 1;
+        } else if (end < n && last_start > start) {
+            end = last_start;
+        }
+        emit(text.substr(start, end - start));
+        i = end;
+    }
+}
+
+template <typename Emit>
+void BpeTokenizer::forEachPiece(std::string_view text, Emit&& emit) const {
+    if (split_o200k_) {
+        splitPiecesO200k(text, std::forward<Emit>(emit));
+    } else {
+        splitPieces(text, std::forward<Emit>(emit));
+    }
+}
+
+template <typename Emit>
+void BpeTokenizer::mergePiece(std::string_view piece, Emit&& emit) const {
+    const size_t n = piece.size();
+
+    if (n <= SMALL_PIECE) {
+        // parts[i] = (start of part i, rank of merging part i with part i + 1)
+        thread_local std::vector<std::pair<size_t, uint32_t>> parts;
+        parts.clear();
+        for (size_t i = 0; i + 1 < n; ++i) {
+            parts.emplace_back(i, rankOf(piece.substr(i, 2)));
+        }
+        parts.emplace_back(n - 1, NO_RANK);
+        parts.emplace_back(n, NO_RANK);
+
+        // Rank of part i merged with the two parts after it, as it will be
+        // once part i + 1 is removed
+        auto rankAfterMerge = [&](size_t i) {
+            if (i + 3 < parts.size()) {
+                return rankOf(piece.substr(parts[i].first, parts[i + 3].first - parts[i].first));
+            }
+            return NO_RANK;
+        };
+
+        while (parts.size() > 2) {
+            size_t best = 0;
+            uint32_t best_rank = NO_RANK;
+            for (size_t i = 0; i + 1 < parts.size(); ++i) {
+                if (parts[i].second < best_rank) {
+                    best_rank = parts[i].second;
+                    best = i;
+                }
+            }
+            if (best_rank == NO_RANK) {
+                break;
+            }
+            if (best > 0) {
+                parts[best - 1].second = rankAfterMerge(best - 1);
+            }
+            parts[best].second = rankAfterMerge(best);
+            parts.erase(parts.begin() + best + 1);
+        }
+
+        for (size_t i = 0; i + 1 < parts.size(); ++i) {
+            emit(parts[i].first, parts[i + 1].first);
+        }
+        return;
+    }
+
+    // Long pieces (minified code, long runs of symbols): a heap of candidate
+    // merges over a linked list of parts keeps this O(n log n). Parts are
+    // identified by their start offset; stale heap entries are skipped.
+    std::vector<size_t> next(n), prev(n);
+    std::vector<uint32_t> pair_rank(n, NO_RANK);
+    std::vector<bool> alive(n, true);
+    for (size_t i = 0; i < n; ++i) {
+        next[i] = i + 1;
+        prev[i] = i > 0 ? i - 1 : n;
+    }
+
+    auto rankWithNext = [&](size_t i) {
+        size_t j = next[i];
+        if (j >= n) {
+            return NO_RANK;
+        }
+        return rankOf(piece.substr(i, next[j] - i));
+    };
+
+    using Candidate = std::pair<uint32_t, size_t>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+    for (size_t i = 0; i + 1 < n; ++i) {
+        pair_rank[i] = rankWithNext(i);
+        if (pair_rank[i] != NO_RANK) {
+            heap.emplace(pair_rank[i], i);
+        }
+    }
+
+    while (!heap.empty()) {
+        auto [rank, i] = heap.top();
+        heap.pop();
+        if (!alive[i] || pair_rank[i] != rank) {
+            continue;
+        }
+
+        size_t j = next[i];
+        alive[j] = false;
+        next[i] = next[j];
+        if (next[j] < n) {
+            prev[next[j]] = i;
+        }
+
+        pair_rank[i] = rankWithNext(i);
+        if (pair_rank[i] != NO_RANK) {
+            heap.emplace(pair_rank[i], i);
+        }
+        if (prev[i] < n) {
+            size_t p = prev[i];
+            pair_rank[p] = rankWithNext(p);
+            if (pair_rank[p] != NO_RANK) {
+                heap.emplace(pair_rank[p], p);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < n; i = next[i]) {
+        emit(i, next[i]);
+    }
+}
+
+template <typename Emit>
+void BpeTokenizer::encodePiece(std::string_view piece, Emit&& emit) const {
+    uint32_t rank = rankOf(piece);
+    if (rank != NO_RANK) {
+        emit(rank);
+        return;
+    }
+
+    // Identifiers and words repeat a lot, so remember how pieces that needed
+    // merging were split
+    thread_local std::vector<PieceCacheEntry> cache;
+    PieceCacheEntry* entry = nullptr;
+    if (piece.size() <= MAX_CACHED_PIECE) {
+        if (cache.empty()) {
+            cache.resize(PIECE_CACHE_SIZE);
+        }
+        entry = &cache[hashBytes(piece) & (PIECE_CACHE_SIZE - 1)];
+        if (entry->owner == cache_id_ && entry->length == piece.size() &&
+            std::memcmp(entry->bytes, piece.data(), piece.size()) == 0) {
+            for (uint8_t i = 0; i < entry->token_count; ++i) {
+                emit(entry->tokens[i]);
+            }
+            return;
+        }
+    }
+
+    size_t produced = 0;
+    bool cacheable = entry != nullptr;
+    mergePiece(piece, [&](size_t begin, size_t end) {
+        uint32_t token = rankOf(piece.substr(begin, end - begin));
+        if (produced < MAX_CACHED_TOKENS && cacheable) {
+            entry->tokens[produced] = token;
+        } else {
+            cacheable = false;
+        }
+        ++produced;
+        emit(token);
+    });
+
+    if (cacheable) {
+        entry->owner = cache_id_;
+        entry->length = static_cast<uint8_t>(piece.size());
+        entry->token_count = static_cast<uint8_t>(produced);
+        std::memcpy(entry->bytes, piece.data(), piece.size());
+    } else if (entry != nullptr) {
+        entry->owner = 0;
+    }
+}
+
+std::vector<uint32_t> BpeTokenizer::encode(std::string_view text) const {
+    std::vector<uint32_t> tokens;
+    tokens.reserve(text.size() / 4 + 1);
+    forEachPiece(text, [&](std::string_view piece) {
+        encodePiece(piece, [&](uint32_t token) { tokens.push_back(token); });
+    });
+    return tokens;
+}
+
+size_t BpeTokenizer::countTokens(std::string_view text) const {
+    size_t count = 0;
+    forEachPiece(text, [&](std::string_view piece) {
+        if (piece.size() == 1) {
+            ++count;
+            return;
+        }
+        encodePiece(piece, [&](uint32_t) { ++count; });
+    });
+    return count;
+}
+
+std::vector<std::string> BpeTokenizer::getSearchDirectories() {
+    std::vector<std::string> directories;
+    if (const char* dir = std::getenv("CLION_TOKENIZER_DIR")) {
+        if (*dir != '\0') {
+            directories.push_back(dir);
+        }
+    }
+    const char* home_dir = std::getenv("HOME");
+    if (!home_dir) {
+        home_dir = std::getenv("USERPROFILE"); // Windows fallback
+    }
+    if (home_dir) {
+        directories.push_back((std::filesystem::path(home_dir) / ".clion" / "tokenizers").string());
+    }
+    return directories;
+}
+
+std::shared_ptr<const BpeTokenizer> BpeTokenizer::forEncoding(const std::string& encoding) {
+    static std::mutex mutex;
+    // Missing encodings are remembered too, so the disk is probed once
+    static std::unordered_map<std::string, std::shared_ptr<const BpeTokenizer>> loaded;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = loaded.find(encoding);
+    if (it != loaded.end()) {
+        return it->second;
+    }
+
+    std::shared_ptr<const BpeTokenizer> result;
+    for (const auto& directory : getSearchDirectories()) {
+        std::filesystem::path file_path = std::filesystem::path(directory) / (encoding + ".tiktoken");
+        std::error_code ec;
+        if (!std::filesystem::exists(file_path, ec)) {
+            continue;
+        }
+        auto tokenizer = std::make_shared<BpeTokenizer>();
+        if (tokenizer->loadFromFile(file_path.string())) {
+            result = tokenizer;
+            break;
+        }
+    }
+    loaded[encoding] = result;
+    return result;
+}
+
+std::string BpeTokenizer::encodingForModel(const std::string& model) {
+    std::string name = model;
+    size_t slash = name.rfind('/');
+    if (slash != std::string::npos) {
+        name = name.substr(slash + 1); // "openai/gpt-4o-mini" -> "gpt-4o-mini"
+    }
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    auto startsWith = [&name](const char* prefix) {
+        return name.rfind(prefix, 0) == 0;
+    };
+
+    if (startsWith("gpt-4o") || startsWith("chatgpt-4o") || startsWith("gpt-4.1") ||
+        startsWith("gpt-4.5") || startsWith("gpt-5") || startsWith("o1") ||
+        startsWith("o3") || startsWith("o4")) {
+        return "o200k_base";
+    }
+    if (startsWith("gpt-4") || startsWith("gpt-3.5") || startsWith("text-embedding-")) {
+        return "cl100k_base";
+    }
+    return "";
+}
+
+} // namespace utils
+} // namespace clion
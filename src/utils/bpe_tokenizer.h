@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "clion/common.h"
+
+namespace clion {
+namespace utils {
+
+// Byte-pair-encoding tokenizer for tiktoken-style rank files (cl100k_base,
+// o200k_base, ...): one "<base64 token bytes> <rank>" pair per line.
+//
+// Text is first split into pieces the way the encoding's pre-tokenizer does,
+// then each piece is merged by lowest rank. cl100k splits off contractions,
+// letter runs with one leading character, 1-3 digit groups, punctuation runs
+// and whitespace. o200k (any rank file named o200k*) also splits words where
+// the letter case changes, keeps contractions on their word and ends
+// punctuation runs with slashes. Non-ASCII characters are classified
+// coarsely, and case is known for Latin, Greek and Cyrillic only, so counts
+// are exact for text in those scripts.
+class BpeTokenizer {
+public:
+    bool loadFromFile(const std::string& file_path);
+    bool isLoaded() const { return vocabulary_size_ > 0; }
+    const std::string& getName() const { return name_; }
+    // Name qualified by pre-tokenizer revision, for keying stored counts:
+    // o200k counts made before it had its own pre-tokenizer were cl100k-split
+    std::string getCountingId() const { return split_o200k_ ? name_ + "@2" : name_; }
+    size_t getVocabularySize() const { return vocabulary_size_; }
+
+    std::vector<uint32_t> encode(std::string_view text) const;
+    size_t countTokens(std::string_view text) const;
+
+    // Shared tokenizer for an encoding name, loaded on first use from
+    // CLION_TOKENIZER_DIR or ~/.clion/tokenizers/<name>.tiktoken. Returns
+    // nullptr when no rank file is installed.
+    static std::shared_ptr<const BpeTokenizer> forEncoding(const std::string& encoding);
+
+    // Native encoding of a model ("o200k_base", "cl100k_base"), or an empty
+    // string for models whose tokenizer is not published in this format
+    static std::string encodingForModel(const std::string& model);
+
+    static std::vector<std::string> getSearchDirectories();
+
+private:
+    // Open-addressing table of token bytes -> rank; lookups dominate
+    // tokenization time, so slots are flat and point into token_bytes_
+    struct Slot {
+        uint32_t offset = 0;
+        uint32_t length = 0;    // 0 marks an empty slot
+        uint32_t rank = 0;
+    };
+
+    std::string name_;
+    std::string token_bytes_;   // All token bytes, back to back
+    std::vector<Slot> slots_;
+    size_t slot_mask_ = 0;
+    size_t vocabulary_size_ = 0;
+    uint64_t cache_id_ = 0;     // Distinguishes instances in the piece cache
+    bool split_o200k_ = false;  // Pre-tokenize with o200k's pattern rather than cl100k's
+
+    uint32_t rankOf(std::string_view bytes) const;
+
+    // Calls emit(rank) for each token of `piece`
+    template <typename Emit>
+    void encodePiece(std::string_view piece, Emit&& emit) const;
+
+    // Calls emit(start, end) for each token of `piece`, left to right
+    template <typename Emit>
+    void mergePiece(std::string_view piece, Emit&& emit) const;
+
+    // Calls emit(piece) for each pre-tokenized piece of `text`
+    template <typename Emit>
+    void forEachPiece(std::string_view text, Emit&& emit) const;
+    template <typename Emit>
+    static void splitPieces(std::string_view text, Emit&& emit);
+    template <typename Emit>
+    static void splitPiecesO200k(std::string_view text, Emit&& emit);
+};
+
+} // namespace utils
+} // namespace clion
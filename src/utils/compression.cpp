@@ -0,0 +1,285 @@
+#include "compression.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#ifdef CLION_HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace clion {
+namespace utils {
+
+namespace {
+    // zstd frame magic number, little-endian on disk
+    constexpr unsigned char ZSTD_MAGIC[4] = {0x28, 0xB5, 0x2F, 0xFD};
+
+#ifdef CLION_HAVE_ZSTD
+    struct Dictionary {
+        uint32_t id = 0;
+        std::string bytes;
+        ZSTD_CDict* cdict = nullptr;     // Built for DEFAULT_LEVEL
+        ZSTD_DDict* ddict = nullptr;
+
+        ~Dictionary() {
+            ZSTD_freeCDict(cdict);
+            ZSTD_freeDDict(ddict);
+        }
+    };
+
+    struct CompressionState {
+        std::mutex mutex;
+        std::string directory;
+        std::unordered_map<uint32_t, std::shared_ptr<const Dictionary>> dictionaries;
+        std::shared_ptr<const Dictionary> active;
+    };
+
+    CompressionState& state() {
+        static CompressionState instance;
+        return instance;
+    }
+
+    std::shared_ptr<const Dictionary> makeDictionary(std::string bytes) {
+        uint32_t id = ZDICT_getDictID(bytes.data(), bytes.size());
+        if (id == 0) {
+            return nullptr;  // Not a zstd dictionary
+        }
+        auto dictionary = std::make_shared<Dictionary>();
+        dictionary->id = id;
+        dictionary->bytes = std::move(bytes);
+        dictionary->cdict = ZSTD_createCDict(dictionary->bytes.data(), dictionary->bytes.size(),
+                                             Compression::DEFAULT_LEVEL);
+        dictionary->ddict = ZSTD_createDDict(dictionary->bytes.data(), dictionary->bytes.size());
+        if (!dictionary->cdict || !dictionary->ddict) {
+            return nullptr;
+        }
+        return dictionary;
+    }
+
+    // Compression contexts are reused per thread; creating one allocates
+    // several hundred KB
+    ZSTD_CCtx* threadCompressionContext() {
+        thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        return context.get();
+    }
+
+    ZSTD_DCtx* threadDecompressionContext() {
+        thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+        return context.get();
+    }
+
+    // Frames written without the content size in the header (e.g. by
+    // streaming tools) are decompressed incrementally
+    std::optional<std::string> decompressStream(std::string_view data, const ZSTD_DDict* ddict) {
+        ZSTD_DCtx* context = threadDecompressionContext();
+        ZSTD_DCtx_reset(context, ZSTD_reset_session_only);
+        ZSTD_DCtx_refDDict(context, ddict);
+
+        std::string output;
+        std::string buffer(ZSTD_DStreamOutSize(), '\0');
+        ZSTD_inBuffer input = {data.data(), data.size(), 0};
+        size_t result = 1;
+        while (input.pos < input.size) {
+            ZSTD_outBuffer out = {buffer.data(), buffer.size(), 0};
+            result = ZSTD_decompressStream(context, &out, &input);
+            if (ZSTD_isError(result)) {
+                return std::nullopt;
+            }
+            output.append(buffer.data(), out.pos);
+            if (result == 0 && input.pos < input.size) {
+                break;  // Trailing bytes after the frame
+            }
+        }
+        ZSTD_DCtx_refDDict(context, nullptr);
+        if (result != 0) {
+            return std::nullopt;  // Truncated frame
+        }
+        return output;
+    }
+#endif
+}
+
+bool Compression::isAvailable() {
+#ifdef CLION_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Compression::isCompressed(std::string_view data) {
+    return data.size() >= sizeof(ZSTD_MAGIC) && std::memcmp(data.data(), ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0;
+}
+
+std::string Compression::compress(std::string_view data, int level) {
+#ifdef CLION_HAVE_ZSTD
+    std::shared_ptr<const Dictionary> dictionary;
+    {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        dictionary = s.active;
+    }
+
+    std::string output(ZSTD_compressBound(data.size()), '\0');
+    ZSTD_CCtx* context = threadCompressionContext();
+    size_t size;
+    if (dictionary && level == DEFAULT_LEVEL) {
+        size = ZSTD_compress_usingCDict(context, output.data(), output.size(),
+                                        data.data(), data.size(), dictionary->cdict);
+    } else if (dictionary) {
+        size = ZSTD_compress_usingDict(context, output.data(), output.size(), data.data(), data.size(),
+                                       dictionary->bytes.data(), dictionary->bytes.size(), level);
+    } else {
+        size = ZSTD_compressCCtx(context, output.data(), output.size(), data.data(), data.size(), level);
+    }
+    if (ZSTD_isError(size)) {
+        return std::string(data);
+    }
+    output.resize(size);
+    return output;
+#else
+    (void)level;
+    return std::string(data);
+#endif
+}
+
+std::optional<std::string> Compression::decompress(std::string_view data) {
+#ifdef CLION_HAVE_ZSTD
+    if (!isCompressed(data)) {
+        return std::nullopt;
+    }
+
+    std::shared_ptr<const Dictionary> dictionary;
+    uint32_t dictionary_id = ZSTD_getDictID_fromFrame(data.data(), data.size());
+    if (dictionary_id != 0) {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.dictionaries.find(dictionary_id);
+        if (it == s.dictionaries.end()) {
+            return std::nullopt;
+        }
+        dictionary = it->second;
+    }
+    const ZSTD_DDict* ddict = dictionary ? dictionary->ddict : nullptr;
+
+    unsigned long long content_size = ZSTD_getFrameContentSize(data.data(), data.size());
+    if (content_size == ZSTD_CONTENTSIZE_ERROR) {
+        return std::nullopt;
+    }
+    if (content_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+        return decompressStream(data, ddict);
+    }
+
+    std::string output(static_cast<size_t>(content_size), '\0');
+    ZSTD_DCtx* context = threadDecompressionContext();
+    size_t size = ddict ?
+        ZSTD_decompress_usingDDict(context, output.data(), output.size(), data.data(), data.size(), ddict) :
+        ZSTD_decompressDCtx(context, output.data(), output.size(), data.data(), data.size());
+    if (ZSTD_isError(size) || size != output.size()) {
+        return std::nullopt;
+    }
+    return output;
+#else
+    (void)data;
+    return std::nullopt;
+#endif
+}
+
+void Compression::useDictionaryDirectory(const std::string& directory) {
+#ifdef CLION_HAVE_ZSTD
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.directory == directory) {
+        return;
+    }
+    s.directory = directory;
+    s.dictionaries.clear();
+    s.active.reset();
+
+    std::error_code ec;
+    std::filesystem::file_time_type newest{};
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".zdict") {
+            continue;
+        }
+        std::ifstream file(entry.path(), std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        auto dictionary = makeDictionary(buffer.str());
+        if (!dictionary) {
+            continue;
+        }
+        s.dictionaries[dictionary->id] = dictionary;
+        auto modified = entry.last_write_time(ec);
+        if (!s.active || modified > newest) {
+            s.active = dictionary;
+            newest = modified;
+        }
+    }
+#else
+    (void)directory;
+#endif
+}
+
+std::optional<uint32_t> Compression::trainDictionary(const std::vector<std::string>& samples,
+                                                     size_t dictionary_size) {
+#ifdef CLION_HAVE_ZSTD
+    std::string joined;
+    std::vector<size_t> sizes;
+    sizes.reserve(samples.size());
+    for (const auto& sample : samples) {
+        joined += sample;
+        sizes.push_back(sample.size());
+    }
+
+    std::string bytes(dictionary_size, '\0');
+    size_t size = ZDICT_trainFromBuffer(bytes.data(), bytes.size(), joined.data(), sizes.data(),
+                                        static_cast<unsigned>(sizes.size()));
+    if (ZDICT_isError(size)) {
+        return std::nullopt;
+    }
+    bytes.resize(size);
+    auto dictionary = makeDictionary(bytes);
+    if (!dictionary) {
+        return std::nullopt;
+    }
+
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.directory.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(s.directory, ec);
+        auto path = std::filesystem::path(s.directory) / (std::to_string(dictionary->id) + ".zdict");
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!file.good()) {
+            return std::nullopt;
+        }
+    }
+    s.dictionaries[dictionary->id] = dictionary;
+    s.active = dictionary;
+    return dictionary->id;
+#else
+    (void)samples;
+    (void)dictionary_size;
+    return std::nullopt;
+#endif
+}
+
+uint32_t Compression::getActiveDictionaryId() {
+#ifdef CLION_HAVE_ZSTD
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.active ? s.active->id : 0;
+#else
+    return 0;
+#endif
+}
+
+} // namespace utils
+} // namespace clion
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "clion/common.h"
+
+namespace clion {
+namespace utils {
+
+// zstd compression for stored data. Compressed data is a zstd frame, which
+// starts with a magic number, so readers tell it apart from plain text.
+//
+// Frames may be compressed with a dictionary trained on earlier data, which
+// matters for the many small, similar files sessions produce. Dictionaries
+// are kept as <id>.zdict in a directory; a frame records the id of the
+// dictionary it needs, so retraining never makes older data unreadable.
+//
+// Without zstd (CLION_HAVE_ZSTD undefined) compress() returns its input and
+// compressed data cannot be read.
+class Compression {
+public:
+    static constexpr int DEFAULT_LEVEL = 3;
+
+    static bool isAvailable();
+    static bool isCompressed(std::string_view data);
+
+    // Uses the active dictionary, if any
+    static std::string compress(std::string_view data, int level = DEFAULT_LEVEL);
+    // nullopt if the data is corrupt or needs a dictionary that is not installed
+    static std::optional<std::string> decompress(std::string_view data);
+
+    // Loads the dictionaries in `directory` (once per directory); the most
+    // recently written one becomes active for compression
+    static void useDictionaryDirectory(const std::string& directory);
+    // Trains a dictionary on `samples`, saves it in the dictionary directory
+    // and makes it active. Returns its id, or nullopt if training failed.
+    static std::optional<uint32_t> trainDictionary(const std::vector<std::string>& samples,
+                                                   size_t dictionary_size = 112 * 1024);
+    // 0 when compressing without a dictionary
+    static uint32_t getActiveDictionaryId();
+};
+
+} // namespace utils
+} // namespace clion
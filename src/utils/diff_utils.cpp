@@ -1,4 +1,5 @@
 #include "diff_utils.h"
+#include "text_kernels.h"
 #include "clion/common.h"
 #include <sstream>
 #include <algorithm>
@@ -247,13 +248,10 @@ void DiffUtils::displayDiff(const std::string& diff) {
 
 std::vector<std::string> DiffUtils::splitIntoLines(const std::string& text) {
     std::vector<std::string> lines;
-    std::stringstream stream(text);
-    std::string line;
-    
-    while (std::getline(stream, line)) {
-        lines.push_back(line);
-    }
-    
+    lines.reserve(TextKernels::countByte(text, '\n') + 1);
+    TextKernels::forEachLine(text, [&lines](std::string_view line) {
+        lines.emplace_back(line);
+    });
     return lines;
 }
 
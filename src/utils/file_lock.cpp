@@ -0,0 +1,99 @@
+#include "file_lock.h"
+#include <cerrno>
+#include <filesystem>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace clion {
+namespace utils {
+
+namespace {
+#ifndef _WIN32
+    // One descriptor per lock file and thread. flock() locks belong to the
+    // open file, so a second descriptor would block on the first.
+    struct Hold {
+        int fd = -1;
+        int shared = 0;
+        int exclusive = 0;
+    };
+
+    std::unordered_map<std::string, Hold>& holds() {
+        thread_local std::unordered_map<std::string, Hold> instance;
+        return instance;
+    }
+
+    bool lockFile(int fd, int operation) {
+        while (::flock(fd, operation) != 0) {
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int openLockFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (fd < 0 && errno == ENOENT) {
+            std::error_code ec;
+            std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+            fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        }
+        return fd;
+    }
+#endif
+}
+
+FileLock::FileLock(const std::string& path, Mode mode, bool wait) : path_(path), mode_(mode) {
+#ifndef _WIN32
+    int operation = (mode_ == Mode::EXCLUSIVE ? LOCK_EX : LOCK_SH) | (wait ? 0 : LOCK_NB);
+    auto& held = holds();
+    auto found = held.find(path_);
+    if (found == held.end()) {
+        int fd = openLockFile(path_);
+        if (fd < 0) {
+            return;
+        }
+        if (!lockFile(fd, operation)) {
+            held_elsewhere_ = errno == EWOULDBLOCK;
+            ::close(fd);
+            return;
+        }
+        found = held.emplace(path_, Hold{fd, 0, 0}).first;
+    } else if (mode_ == Mode::EXCLUSIVE && found->second.exclusive == 0 &&
+               !lockFile(found->second.fd, operation)) {
+        held_elsewhere_ = errno == EWOULDBLOCK;
+        return;
+    }
+    (mode_ == Mode::EXCLUSIVE ? found->second.exclusive : found->second.shared)++;
+    locked_ = true;
+#endif
+}
+
+FileLock::~FileLock() {
+#ifndef _WIN32
+    if (!locked_) {
+        return;
+    }
+    auto& held = holds();
+    auto found = held.find(path_);
+    if (found == held.end()) {
+        return;
+    }
+    Hold& hold = found->second;
+    (mode_ == Mode::EXCLUSIVE ? hold.exclusive : hold.shared)--;
+    if (hold.shared == 0 && hold.exclusive == 0) {
+        ::close(hold.fd);  // Releases the lock
+        held.erase(found);
+    } else if (hold.exclusive == 0 && mode_ == Mode::EXCLUSIVE) {
+        lockFile(hold.fd, LOCK_SH);
+    }
+#endif
+}
+
+} // namespace utils
+} // namespace clion
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include "clion/common.h"
+
+namespace clion {
+namespace utils {
+
+// Advisory reader-writer lock on a lock file, honoured by every process that
+// takes it: any number of shared holders, or one exclusive holder. Threads
+// exclude each other the same way. A thread may take a lock it already holds
+// again without blocking; taking it exclusively while holding it shared
+// converts the lock, which another holder may take in between. The kernel
+// drops the lock when its holder exits, so a crashed process never leaves one
+// behind. Where locking is unavailable, or the lock file cannot be opened,
+// nothing is locked and the caller carries on.
+class FileLock {
+public:
+    enum class Mode { SHARED, EXCLUSIVE };
+
+    // Blocks until the lock is held; creates `path` and its directory if needed.
+    // With `wait` false it gives up at once if another holder has the lock.
+    FileLock(const std::string& path, Mode mode, bool wait = true);
+    // Released on the thread that took it
+    ~FileLock();
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    bool isLocked() const { return locked_; }
+    // Not locked because another holder had it and `wait` was false
+    bool isHeldElsewhere() const { return held_elsewhere_; }
+
+private:
+    std::string path_;
+    Mode mode_;
+    bool locked_ = false;
+    bool held_elsewhere_ = false;
+};
+
+} // namespace utils
+} // namespace clion
@@ -0,0 +1,131 @@
+#include "group_commit.h"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace clion {
+namespace utils {
+
+namespace {
+    // Flush rounds of one file. A round that starts after a caller arrived
+    // covers everything it wrote; one that was already running may not.
+    struct FileGroup {
+        bool syncing = false;
+        uint64_t started = 0;
+        uint64_t finished = 0;
+        bool last_ok = true;
+        size_t callers = 0;
+    };
+
+    struct FileKey {
+        uint64_t device;
+        uint64_t inode;
+
+        bool operator==(const FileKey& other) const {
+            return device == other.device && inode == other.inode;
+        }
+    };
+
+    struct FileKeyHash {
+        size_t operator()(const FileKey& key) const {
+            return std::hash<uint64_t>()(key.inode * 31 + key.device);
+        }
+    };
+
+    struct GroupCommitState {
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::unordered_map<FileKey, FileGroup, FileKeyHash> files;
+        bool grouping = true;
+        GroupCommitStats stats;
+    };
+
+    GroupCommitState& state() {
+        static GroupCommitState instance;
+        return instance;
+    }
+
+#ifndef _WIN32
+    bool syncFile(int fd, bool is_directory) {
+        // Directories need fsync; fdatasync skips metadata a file's data does not need
+        return (is_directory ? ::fsync(fd) : ::fdatasync(fd)) == 0;
+    }
+#endif
+}
+
+bool GroupCommit::sync(int fd) {
+#ifdef _WIN32
+    (void)fd;
+    return true;
+#else
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        return false;
+    }
+    bool is_directory = S_ISDIR(info.st_mode);
+
+    auto& s = state();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    s.stats.requests++;
+    if (!s.grouping) {
+        s.stats.syncs++;
+        lock.unlock();
+        return syncFile(fd, is_directory);
+    }
+
+    // Different files flush side by side; callers of the same file share rounds
+    FileKey key{static_cast<uint64_t>(info.st_dev), static_cast<uint64_t>(info.st_ino)};
+    FileGroup& group = s.files[key];
+    group.callers++;
+    uint64_t needed = group.started + 1;
+    while (group.finished < needed) {
+        if (group.syncing) {
+            s.finished.wait(lock);
+            continue;
+        }
+        group.syncing = true;
+        uint64_t round = ++group.started;
+        s.stats.syncs++;
+        lock.unlock();
+        bool ok = syncFile(fd, is_directory);
+        lock.lock();
+        group.finished = round;
+        group.last_ok = ok;
+        group.syncing = false;
+        s.finished.notify_all();
+    }
+    bool ok = group.last_ok;
+    if (--group.callers == 0) {
+        s.files.erase(key);
+    }
+    return ok;
+#endif
+}
+
+void GroupCommit::setGrouping(bool enabled) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.grouping = enabled;
+}
+
+GroupCommitStats GroupCommit::getStats() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.stats;
+}
+
+void GroupCommit::resetStats() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.stats = GroupCommitStats{};
+}
+
+} // namespace utils
+} // namespace clion
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include "clion/common.h"
+
+namespace clion {
+namespace utils {
+
+struct GroupCommitStats {
+    size_t requests = 0;    // sync() calls
+    size_t syncs = 0;       // fdatasync/fsync calls made for them
+};
+
+// Shares flushes to stable storage between threads that need the same file
+// flushed at the same time: a caller that finds a flush of its file already
+// running waits for it to finish, then one of the waiters flushes once for
+// all of them. Concurrent writers to one journal, or saves renaming files in
+// one directory, pay for a single call between them. Different files are
+// flushed side by side, since the filesystem already merges those.
+class GroupCommit {
+public:
+    // Flushes the file `fd` refers to, directories included. `fd` must stay
+    // open until this returns. Always true where there is nothing to call.
+    static bool sync(int fd);
+
+    // Off: every caller makes its own call (benchmarks)
+    static void setGrouping(bool enabled);
+
+    static GroupCommitStats getStats();
+    static void resetStats();
+};
+
+} // namespace utils
+} // namespace clion
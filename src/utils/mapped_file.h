@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "clion/common.h"
+
+namespace clion {
+namespace utils {
+
+// Read-only view of a whole file. Memory-mapped where supported, so opening
+// a large index costs nothing until its pages are touched; elsewhere the
+// file is read into memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Replaces any file already open; false if `path` cannot be read
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;           ///< data_ is a mapping, not buffer_
+    std::string buffer_;
+};
+
+} // namespace utils
+} // namespace clion
@@ -23,6 +23,9 @@ std::optional<CLionConfig> RulesLoader::loadConfig(const std::filesystem::path&
             if (api["model"]) clion_config.api_model = api["model"].as<std::string>();
             if (api["max_tokens"]) clion_config.max_tokens = api["max_tokens"].as<int>();
             if (api["temperature"]) clion_config.temperature = api["temperature"].as<float>();
+            if (api["history_token_budget"]) {
+                clion_config.history_token_budget = api["history_token_budget"].as<int>();
+            }
         }
 
         // Load rules
@@ -104,6 +107,7 @@ bool RulesLoader::saveConfig(const CLionConfig& config, const std::filesystem::p
         api["model"] = config.api_model;
         api["max_tokens"] = config.max_tokens;
         api["temperature"] = config.temperature;
+        api["history_token_budget"] = config.history_token_budget;
         yaml_config["api"] = api;
 
         // Rules
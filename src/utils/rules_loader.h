@@ -21,6 +21,7 @@ struct CLionConfig {
     std::string api_model = "gemini-pro";
     int max_tokens = 8192;
     float temperature = 0.1f;
+    int history_token_budget = 0;      // 0: derived from the model's context window
     std::vector<std::string> include_patterns;
     std::vector<std::string> exclude_patterns;
     bool respect_gitignore = true;
@@ -0,0 +1,395 @@
+#include "text_kernels.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define CLION_TEXT_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace clion {
+namespace utils {
+
+namespace {
+    struct KernelTable {
+        const char* name;
+        size_t (*count_byte)(const char*, size_t, char);
+        size_t (*find_byte)(const char*, size_t, char);
+        size_t (*skip_whitespace)(const char*, size_t);
+        size_t (*skip_non_whitespace)(const char*, size_t);
+        size_t (*count_punctuation)(const char*, size_t);
+        uint64_t (*whitespace_bits)(const char*);   // One 64-byte block
+    };
+
+    enum : uint8_t {
+        BYTE_SPACE = 1,
+        BYTE_PUNCT = 2
+    };
+
+    constexpr std::array<uint8_t, 256> buildByteTable() {
+        std::array<uint8_t, 256> table{};
+        for (int c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+            table[c] = BYTE_SPACE;
+        }
+        for (int c = 33; c < 127; ++c) {
+            if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))) {
+                table[c] = BYTE_PUNCT;
+            }
+        }
+        return table;
+    }
+
+    constexpr std::array<uint8_t, 256> BYTE_CLASS = buildByteTable();
+
+    inline bool isSpace(char c) {
+        return BYTE_CLASS[static_cast<unsigned char>(c)] & BYTE_SPACE;
+    }
+
+    // Scalar versions; also used for the tails of the vector loops
+
+    size_t countByteScalar(const char* data, size_t size, char byte) {
+        return static_cast<size_t>(std::count(data, data + size, byte));
+    }
+
+    size_t findByteScalar(const char* data, size_t size, char byte) {
+        const void* hit = std::memchr(data, byte, size);
+        return hit ? static_cast<size_t>(static_cast<const char*>(hit) - data) : size;
+    }
+
+    size_t skipWhitespaceScalar(const char* data, size_t size) {
+        size_t i = 0;
+        while (i < size && isSpace(data[i])) ++i;
+        return i;
+    }
+
+    size_t skipNonWhitespaceScalar(const char* data, size_t size) {
+        size_t i = 0;
+        while (i < size && !isSpace(data[i])) ++i;
+        return i;
+    }
+
+    size_t countPunctuationScalar(const char* data, size_t size) {
+        size_t count = 0;
+        for (size_t i = 0; i < size; ++i) {
+            count += (BYTE_CLASS[static_cast<unsigned char>(data[i])] & BYTE_PUNCT) ? 1 : 0;
+        }
+        return count;
+    }
+
+    uint64_t whitespaceBitsScalar(const char* data) {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < 64; ++i) {
+            bits |= static_cast<uint64_t>(isSpace(data[i])) << i;
+        }
+        return bits;
+    }
+
+    constexpr KernelTable SCALAR_KERNELS = {
+        "scalar", countByteScalar, findByteScalar, skipWhitespaceScalar,
+        skipNonWhitespaceScalar, countPunctuationScalar, whitespaceBitsScalar
+    };
+
+#ifdef CLION_TEXT_KERNELS_X86
+    // Bytes in [lo, hi] as 0xFF lanes: unsigned (v - lo) <= (hi - lo)
+    inline __m128i inRange128(__m128i v, char lo, char hi) {
+        __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+        return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(static_cast<char>(hi - lo))), shifted);
+    }
+
+    inline uint32_t whitespaceMask128(__m128i v) {
+        __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(space, inRange128(v, '\t', '\r'))));
+    }
+
+    inline uint32_t punctuationMask128(__m128i v) {
+        __m128i punct = _mm_or_si128(_mm_or_si128(inRange128(v, 33, 47), inRange128(v, 58, 64)),
+                                     _mm_or_si128(inRange128(v, 91, 96), inRange128(v, 123, 126)));
+        return static_cast<uint32_t>(_mm_movemask_epi8(punct));
+    }
+
+    size_t countByteSse2(const char* data, size_t size, char byte) {
+        const __m128i needle = _mm_set1_epi8(byte);
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            count += std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle))));
+        }
+        return count + countByteScalar(data + i, size - i, byte);
+    }
+
+    size_t findByteSse2(const char* data, size_t size, char byte) {
+        const __m128i needle = _mm_set1_epi8(byte);
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+            if (mask != 0) {
+                return i + std::countr_zero(mask);
+            }
+        }
+        return i + findByteScalar(data + i, size - i, byte);
+    }
+
+    size_t skipWhitespaceSse2(const char* data, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            uint32_t other = ~whitespaceMask128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))) & 0xFFFF;
+            if (other != 0) {
+                return i + std::countr_zero(other);
+            }
+        }
+        return i + skipWhitespaceScalar(data + i, size - i);
+    }
+
+    size_t skipNonWhitespaceSse2(const char* data, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            uint32_t space = whitespaceMask128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+            if (space != 0) {
+                return i + std::countr_zero(space);
+            }
+        }
+        return i + skipNonWhitespaceScalar(data + i, size - i);
+    }
+
+    size_t countPunctuationSse2(const char* data, size_t size) {
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            count += std::popcount(punctuationMask128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))));
+        }
+        return count + countPunctuationScalar(data + i, size - i);
+    }
+
+    uint64_t whitespaceBitsSse2(const char* data) {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < 64; i += 16) {
+            bits |= static_cast<uint64_t>(whitespaceMask128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)))) << i;
+        }
+        return bits;
+    }
+
+    constexpr KernelTable SSE2_KERNELS = {
+        "sse2", countByteSse2, findByteSse2, skipWhitespaceSse2,
+        skipNonWhitespaceSse2, countPunctuationSse2, whitespaceBitsSse2
+    };
+
+    // AVX2 versions are compiled for that target only; they run only after
+    // the CPU check in detectKernels(). MSVC compiles AVX2 intrinsics
+    // without a target attribute.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CLION_AVX2
+#else
+#define CLION_AVX2 __attribute__((target("avx2")))
+#endif
+
+    CLION_AVX2 inline __m256i inRange256(__m256i v, char lo, char hi) {
+        __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(static_cast<char>(hi - lo))), shifted);
+    }
+
+    CLION_AVX2 inline uint32_t whitespaceMask256(__m256i v) {
+        __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(space, inRange256(v, '\t', '\r'))));
+    }
+
+    CLION_AVX2 inline uint32_t punctuationMask256(__m256i v) {
+        __m256i punct = _mm256_or_si256(_mm256_or_si256(inRange256(v, 33, 47), inRange256(v, 58, 64)),
+                                        _mm256_or_si256(inRange256(v, 91, 96), inRange256(v, 123, 126)));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(punct));
+    }
+
+    CLION_AVX2 size_t countByteAvx2(const char* data, size_t size, char byte) {
+        const __m256i needle = _mm256_set1_epi8(byte);
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            count += std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle))));
+        }
+        return count + countByteSse2(data + i, size - i, byte);
+    }
+
+    CLION_AVX2 size_t findByteAvx2(const char* data, size_t size, char byte) {
+        const __m256i needle = _mm256_set1_epi8(byte);
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+            if (mask != 0) {
+                return i + std::countr_zero(mask);
+            }
+        }
+        return i + findByteSse2(data + i, size - i, byte);
+    }
+
+    CLION_AVX2 size_t skipWhitespaceAvx2(const char* data, size_t size) {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            uint32_t other = ~whitespaceMask256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+            if (other != 0) {
+                return i + std::countr_zero(other);
+            }
+        }
+        return i + skipWhitespaceSse2(data + i, size - i);
+    }
+
+    CLION_AVX2 size_t skipNonWhitespaceAvx2(const char* data, size_t size) {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            uint32_t space = whitespaceMask256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+            if (space != 0) {
+                return i + std::countr_zero(space);
+            }
+        }
+        return i + skipNonWhitespaceSse2(data + i, size - i);
+    }
+
+    CLION_AVX2 size_t countPunctuationAvx2(const char* data, size_t size) {
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            count += std::popcount(punctuationMask256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i))));
+        }
+        return count + countPunctuationSse2(data + i, size - i);
+    }
+
+    CLION_AVX2 uint64_t whitespaceBitsAvx2(const char* data) {
+        uint64_t low = whitespaceMask256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)));
+        uint64_t high = whitespaceMask256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32)));
+        return low | (high << 32);
+    }
+
+#undef CLION_AVX2
+
+    constexpr KernelTable AVX2_KERNELS = {
+        "avx2", countByteAvx2, findByteAvx2, skipWhitespaceAvx2,
+        skipNonWhitespaceAvx2, countPunctuationAvx2, whitespaceBitsAvx2
+    };
+
+    bool cpuSupportsAvx2() {
+#ifdef _MSC_VER
+        // AVX2 needs the CPU flag and the OS saving YMM state (OSXSAVE, XCR0)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    const KernelTable* detectKernels() {
+#ifdef CLION_TEXT_KERNELS_X86
+        if (cpuSupportsAvx2()) {
+            return &AVX2_KERNELS;
+        }
+        return &SSE2_KERNELS;
+#else
+        return &SCALAR_KERNELS;
+#endif
+    }
+
+    std::atomic<const KernelTable*>& activeKernels() {
+        static std::atomic<const KernelTable*> active{detectKernels()};
+        return active;
+    }
+
+    inline const KernelTable& kernels() {
+        return *activeKernels().load(std::memory_order_relaxed);
+    }
+}
+
+size_t TextKernels::countByte(std::string_view text, char byte) {
+    return kernels().count_byte(text.data(), text.size(), byte);
+}
+
+size_t TextKernels::findByte(std::string_view text, char byte, size_t from) {
+    if (from >= text.size()) {
+        return std::string_view::npos;
+    }
+    size_t offset = kernels().find_byte(text.data() + from, text.size() - from, byte);
+    return from + offset < text.size() ? from + offset : std::string_view::npos;
+}
+
+size_t TextKernels::skipWhitespace(std::string_view text, size_t from) {
+    if (from >= text.size()) {
+        return text.size();
+    }
+    return from + kernels().skip_whitespace(text.data() + from, text.size() - from);
+}
+
+size_t TextKernels::skipNonWhitespace(std::string_view text, size_t from) {
+    if (from >= text.size()) {
+        return text.size();
+    }
+    return from + kernels().skip_non_whitespace(text.data() + from, text.size() - from);
+}
+
+size_t TextKernels::countPunctuation(std::string_view text) {
+    return kernels().count_punctuation(text.data(), text.size());
+}
+
+uint64_t TextKernels::whitespaceBits(const char* data, size_t size) {
+    if (size >= 64) {
+        return kernels().whitespace_bits(data);
+    }
+    // Short tail: pad with non-whitespace and mark the missing bytes as
+    // whitespace so a word running into the end is closed
+    char block[64];
+    std::memset(block, 'x', sizeof(block));
+    std::memcpy(block, data, size);
+    return kernels().whitespace_bits(block) | (~uint64_t(0) << size);
+}
+
+std::vector<std::string_view> TextKernels::splitLines(std::string_view text) {
+    std::vector<std::string_view> lines;
+    lines.reserve(countByte(text, '\n') + 1);
+    forEachLine(text, [&lines](std::string_view line) { lines.push_back(line); });
+    return lines;
+}
+
+const char* TextKernels::getImplementation() {
+    return kernels().name;
+}
+
+bool TextKernels::setImplementation(const std::string& name) {
+    const KernelTable* table = nullptr;
+    if (name == "scalar") {
+        table = &SCALAR_KERNELS;
+    }
+#ifdef CLION_TEXT_KERNELS_X86
+    else if (name == "sse2") {
+        table = &SSE2_KERNELS;
+    } else if (name == "avx2" && cpuSupportsAvx2()) {
+        table = &AVX2_KERNELS;
+    }
+#endif
+    if (table == nullptr) {
+        return false;
+    }
+    activeKernels().store(table, std::memory_order_relaxed);
+    return true;
+}
+
+} // namespace utils
+} // namespace clion
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "clion/common.h"
+
+namespace clion {
+namespace utils {
+
+// Byte-scanning primitives for the text hot paths (line splitting, word
+// splitting, character-class counts). Each has scalar, SSE2 and AVX2 versions;
+// the widest one the CPU supports is picked on first use.
+//
+// Whitespace is the C locale set (space, \t, \n, \v, \f, \r) and punctuation
+// is ASCII ispunct, matching std::istringstream and ::ispunct.
+class TextKernels {
+public:
+    static size_t countByte(std::string_view text, char byte);
+    // Position of the first `byte` at or after `from`, or npos
+    static size_t findByte(std::string_view text, char byte, size_t from = 0);
+    // First position at or after `from` that is not / is whitespace, or text.size()
+    static size_t skipWhitespace(std::string_view text, size_t from);
+    static size_t skipNonWhitespace(std::string_view text, size_t from);
+    static size_t countPunctuation(std::string_view text);
+
+    // Lines as std::getline would produce them: split on '\n', no empty
+    // line after a trailing newline. Views point into `text`.
+    static std::vector<std::string_view> splitLines(std::string_view text);
+
+    template <typename Callback>
+    static void forEachLine(std::string_view text, Callback&& callback) {
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t end = findByte(text, '\n', pos);
+            if (end == std::string_view::npos) {
+                callback(text.substr(pos));
+                return;
+            }
+            callback(text.substr(pos, end - pos));
+            pos = end + 1;
+        }
+    }
+
+    // Whitespace-separated words, as `stream >> word` would read them.
+    // Works on 64-byte blocks: word starts and ends are the 0->1 and 1->0
+    // transitions of the block's non-whitespace bitmask.
+    template <typename Callback>
+    static void forEachWord(std::string_view text, Callback&& callback) {
+        const size_t n = text.size();
+        bool in_word = false;
+        size_t word_start = 0;
+        for (size_t block = 0; block < n; block += 64) {
+            uint64_t word_bits = ~whitespaceBits(text.data() + block, n - block);
+            uint64_t previous = (word_bits << 1) | (in_word ? 1 : 0);
+            uint64_t starts = word_bits & ~previous;
+            uint64_t ends = ~word_bits & previous;
+            while (starts | ends) {
+                if (in_word) {
+                    size_t end = block + std::countr_zero(ends);
+                    ends &= ends - 1;
+                    callback(text.substr(word_start, end - word_start));
+                    in_word = false;
+                } else {
+                    word_start = block + std::countr_zero(starts);
+                    starts &= starts - 1;
+                    in_word = true;
+                }
+            }
+        }
+        if (in_word) {
+            // Text ended exactly on a block boundary inside a word
+            callback(text.substr(word_start));
+        }
+    }
+
+    // Bit i set when data[i] is whitespace, for the first min(size, 64)
+    // bytes; bits past `size` are set
+    static uint64_t whitespaceBits(const char* data, size_t size);
+
+    // "avx2", "sse2" or "scalar"
+    static const char* getImplementation();
+    // Forces an implementation (for benchmarks); false if the CPU lacks it
+    static bool setImplementation(const std::string& name);
+};
+
+} // namespace utils
+} // namespace clion
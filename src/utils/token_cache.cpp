@@ -0,0 +1,309 @@
+#include "token_cache.h"
+#include "bpe_tokenizer.h"
+#include "file_lock.h"
+#include "text_kernels.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace clion {
+namespace utils {
+
+namespace {
+    constexpr size_t CHUNK_SIZE = 16 * 1024;
+    // Bounds memory in long-running processes and the size of the file
+    constexpr size_t MAX_ENTRIES = 1 << 20;
+    constexpr size_t MAX_FILE_BYTES = (1 << 18) * 24;
+    // New counts written per batch
+    constexpr size_t FLUSH_ENTRIES = 256;
+
+    struct TokenCacheState;
+    void flushLocked(TokenCacheState& s);
+
+    struct TokenCacheState {
+        std::mutex mutex;
+        bool loaded = false;
+        bool persistent = true;
+        std::unordered_map<uint64_t, uint32_t> counts;  // Chunk key -> tokens
+        std::vector<std::pair<uint64_t, uint32_t>> pending;  // Not yet on disk
+        size_t hits = 0;
+        size_t misses = 0;
+
+        ~TokenCacheState() {
+            std::lock_guard<std::mutex> lock(mutex);
+            flushLocked(*this);
+        }
+    };
+
+    TokenCacheState& state() {
+        static TokenCacheState instance;
+        return instance;
+    }
+
+    std::string getCachePath() {
+        const char* home_dir = std::getenv("HOME");
+        if (!home_dir) {
+            home_dir = std::getenv("USERPROFILE"); // Windows fallback
+        }
+        if (!home_dir) {
+            return "";
+        }
+        return (std::filesystem::path(home_dir) / ".clion" / "token_counts.tsv").string();
+    }
+
+    std::string getLockPath(const std::string& cache_path) {
+        return cache_path + ".lock";
+    }
+
+    // Exclusive hold on the cache's lock file for one flush. Taken with flock()
+    // directly rather than through FileLock, whose per-thread bookkeeping is
+    // already destroyed when the last batch is written at exit.
+    class FlushLock {
+    public:
+        explicit FlushLock(const std::string& path) {
+#ifndef _WIN32
+            fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+            while (fd_ >= 0 && ::flock(fd_, LOCK_EX) != 0 && errno == EINTR) {
+            }
+#else
+            (void)path;
+#endif
+        }
+        ~FlushLock() {
+#ifndef _WIN32
+            if (fd_ >= 0) {
+                ::close(fd_);  // Releases the lock
+            }
+#endif
+        }
+        FlushLock(const FlushLock&) = delete;
+        FlushLock& operator=(const FlushLock&) = delete;
+
+    private:
+        int fd_ = -1;
+    };
+
+    // One "<key hex>\t<count>" per line
+    void loadLocked(TokenCacheState& s) {
+        s.loaded = true;
+        std::string path = getCachePath();
+        if (path.empty()) {
+            return;
+        }
+        FileLock lock(getLockPath(path), FileLock::Mode::SHARED);
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line) && s.counts.size() < MAX_ENTRIES) {
+            size_t tab = line.find('\t');
+            if (tab == std::string::npos) {
+                continue;
+            }
+            char* end = nullptr;
+            uint64_t key = std::strtoull(line.c_str(), &end, 16);
+            if (end != line.c_str() + tab) {
+                continue;
+            }
+            s.counts[key] = static_cast<uint32_t>(std::strtoul(line.c_str() + tab + 1, nullptr, 10));
+        }
+    }
+
+    void writeEntries(std::ofstream& file, const std::vector<std::pair<uint64_t, uint32_t>>& entries) {
+        char buffer[40];
+        for (const auto& [key, count] : entries) {
+            int length = std::snprintf(buffer, sizeof(buffer), "%016llx\t%u\n",
+                                       static_cast<unsigned long long>(key), count);
+            file.write(buffer, length);
+        }
+    }
+
+    void flushLocked(TokenCacheState& s) {
+        if (!s.persistent || s.pending.empty()) {
+            s.pending.clear();
+            return;
+        }
+        std::string path = getCachePath();
+        if (path.empty()) {
+            s.pending.clear();
+            return;
+        }
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+        // Other processes append too, so the size is checked under the lock
+        FlushLock lock(getLockPath(path));
+        auto size = std::filesystem::file_size(path, ec);
+        if (!ec && size > MAX_FILE_BYTES) {
+            // Too big: start the file over with what this process has seen last
+            std::ofstream file(path, std::ios::trunc | std::ios::binary);
+            writeEntries(file, s.pending);
+        } else {
+            std::ofstream file(path, std::ios::app | std::ios::binary);
+            writeEntries(file, s.pending);
+        }
+        s.pending.clear();
+    }
+
+    // Counts from the cache, or from `count` for those it lacks; `count` runs
+    // outside the lock
+    template <typename Count>
+    size_t countCached(std::vector<std::pair<uint64_t, std::string_view>>& chunks, Count&& count) {
+        auto& s = state();
+        std::vector<uint32_t> counts(chunks.size(), 0);
+        std::vector<bool> cached(chunks.size(), false);
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (!s.loaded && s.persistent) {
+                loadLocked(s);
+            }
+            for (size_t i = 0; i < chunks.size(); ++i) {
+                auto it = s.counts.find(chunks[i].first);
+                if (it != s.counts.end()) {
+                    counts[i] = it->second;
+                    cached[i] = true;
+                    s.hits++;
+                } else {
+                    s.misses++;
+                }
+            }
+        }
+
+        std::vector<std::pair<uint64_t, uint32_t>> fresh;
+        size_t total = 0;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            if (!cached[i]) {
+                counts[i] = static_cast<uint32_t>(count(chunks[i].second));
+                fresh.emplace_back(chunks[i].first, counts[i]);
+            }
+            total += counts[i];
+        }
+
+        if (!fresh.empty()) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (s.counts.size() + fresh.size() > MAX_ENTRIES) {
+                s.counts.clear();
+            }
+            for (const auto& [key, value] : fresh) {
+                s.counts[key] = value;
+            }
+            if (s.persistent) {
+                s.pending.insert(s.pending.end(), fresh.begin(), fresh.end());
+                if (s.pending.size() >= FLUSH_ENTRIES) {
+                    flushLocked(s);
+                }
+            }
+        }
+        return total;
+    }
+
+    // End of the chunk starting at `start`: the first newline after
+    // CHUNK_SIZE bytes that is followed by a non-space character
+    size_t chunkEnd(std::string_view text, size_t start) {
+        size_t pos = start + CHUNK_SIZE;
+        while (pos < text.size()) {
+            size_t newline = TextKernels::findByte(text, '\n', pos);
+            if (newline == std::string_view::npos || newline + 1 >= text.size()) {
+                break;
+            }
+            char next = text[newline + 1];
+            if (next != ' ' && next != '\t' && next != '\n' && next != '\r' && next != '\v' && next != '\f') {
+                return newline + 1;
+            }
+            pos = newline + 1;
+        }
+        return text.size();
+    }
+}
+
+uint64_t TokenCache::hashContent(std::string_view text) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ (text.size() * 0xC2B2AE3D27D4EB4FULL);
+    size_t i = 0;
+    for (; i + 8 <= text.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, text.data() + i, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 29;
+    }
+    if (i < text.size()) {
+        uint64_t word = 0;
+        std::memcpy(&word, text.data() + i, text.size() - i);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 29;
+    }
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    return hash ^ (hash >> 32);
+}
+
+size_t TokenCache::countTokens(std::string_view text, const BpeTokenizer& tokenizer) {
+    if (text.empty()) {
+        return 0;
+    }
+
+    const uint64_t encoding_key = hashContent(tokenizer.getCountingId()) * 0x9E3779B97F4A7C15ULL;
+    std::vector<std::pair<uint64_t, std::string_view>> chunks;
+    for (size_t start = 0; start < text.size();) {
+        size_t end = chunkEnd(text, start);
+        std::string_view chunk = text.substr(start, end - start);
+        chunks.emplace_back(hashContent(chunk) ^ encoding_key, chunk);
+        start = end;
+    }
+    return countCached(chunks, [&](std::string_view chunk) { return tokenizer.countTokens(chunk); });
+}
+
+size_t TokenCache::countTokens(std::string_view text, std::string_view counter_name,
+                               const std::function<size_t(std::string_view)>& count) {
+    if (text.empty()) {
+        return 0;
+    }
+    const uint64_t counter_key = hashContent(counter_name) * 0x9E3779B97F4A7C15ULL;
+    std::vector<std::pair<uint64_t, std::string_view>> chunks{{hashContent(text) ^ counter_key, text}};
+    return countCached(chunks, count);
+}
+
+TokenCacheStats TokenCache::getStats() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    TokenCacheStats stats;
+    stats.hits = s.hits;
+    stats.misses = s.misses;
+    stats.entries = s.counts.size();
+    return stats;
+}
+
+void TokenCache::clear() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.counts.clear();
+    s.hits = 0;
+    s.misses = 0;
+}
+
+void TokenCache::setPersistent(bool persistent) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!persistent) {
+        flushLocked(s);
+    }
+    s.persistent = persistent;
+}
+
+void TokenCache::flush() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    flushLocked(s);
+}
+
+} // namespace utils
+} // namespace clion
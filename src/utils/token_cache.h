@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include "clion/common.h"
+
+namespace clion {
+namespace utils {
+
+class BpeTokenizer;
+
+struct TokenCacheStats {
+    size_t hits = 0;        // Chunks whose count came from the cache
+    size_t misses = 0;      // Chunks that had to be tokenized
+    size_t entries = 0;
+};
+
+// Token counts of text chunks keyed by content hash and encoding, so counting
+// a prompt that repeats files, instructions or history only tokenizes what is
+// new. Text is cut into chunks of about 16 KB at a newline followed by a
+// non-space character; no BPE piece spans such a point, so the sum of chunk
+// counts equals the count of the whole text.
+//
+// Counts are appended to ~/.clion/token_counts.tsv and reloaded on first use.
+// New counts are written in batches, under a lock shared with other clion
+// processes, once enough have accumulated and when the process exits.
+class TokenCache {
+public:
+    static size_t countTokens(std::string_view text, const BpeTokenizer& tokenizer);
+    // For counters whose counts do not add up across chunks, such as the
+    // heuristics: the whole text is one entry, keyed by `counter_name`
+    static size_t countTokens(std::string_view text, std::string_view counter_name,
+                              const std::function<size_t(std::string_view)>& count);
+
+    static TokenCacheStats getStats();
+    static void clear();
+
+    // Turns the on-disk copy off (benchmarks, tests) or back on
+    static void setPersistent(bool persistent);
+    // Writes counts not yet on disk
+    static void flush();
+
+    static uint64_t hashContent(std::string_view text);
+};
+
+} // namespace utils
+} // namespace clion
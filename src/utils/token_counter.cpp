@@ -1,23 +1,380 @@
 #include "token_counter.h"
+#include "bpe_tokenizer.h"
+#include "text_kernels.h"
+#include "token_cache.h"
+#include <nlohmann/json.hpp>
+#include <yaml-cpp/yaml.h>
 #include <algorithm>
+#include <atomic>
 #include <cctype>
-#include <regex>
+#include <array>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <sstream>
 #include <iomanip>
 #include <chrono>
+#include <ctime>
 
 namespace clion {
 namespace utils {
 
-// Static member definitions
-std::map<std::string, ModelPricing> TokenCounter::pricing_database_;
-bool TokenCounter::initialized_ = false;
+namespace {
+    // Byte classes for content-type detection
+    enum : uint8_t {
+        CHAR_WORD = 1,          // [A-Za-z0-9_]
+        CHAR_WORD_START = 2,    // [A-Za-z_]
+        CHAR_UPPER = 4,
+        CHAR_SPACE = 8,
+        CHAR_BRACKET = 16,      // {}();[]
+        CHAR_OPERATOR = 32,     // =+-*/
+        CHAR_SENTENCE_END = 64  // .!?
+    };
+    
+    constexpr std::array<uint8_t, 256> buildCharFlags() {
+        std::array<uint8_t, 256> flags{};
+        for (int c = 'a'; c <= 'z'; ++c) flags[c] = CHAR_WORD | CHAR_WORD_START;
+        for (int c = 'A'; c <= 'Z'; ++c) flags[c] = CHAR_WORD | CHAR_WORD_START | CHAR_UPPER;
+        for (int c = '0'; c <= '9'; ++c) flags[c] = CHAR_WORD;
+        flags['_'] = CHAR_WORD | CHAR_WORD_START;
+        for (char c : {' ', '\t', '\n', '\r', '\v', '\f'}) flags[static_cast<unsigned char>(c)] = CHAR_SPACE;
+        for (char c : {'{', '}', '(', ')', ';', '[', ']'}) flags[static_cast<unsigned char>(c)] = CHAR_BRACKET;
+        for (char c : {'=', '+', '-', '*', '/'}) flags[static_cast<unsigned char>(c)] = CHAR_OPERATOR;
+        for (char c : {'.', '!', '?'}) flags[static_cast<unsigned char>(c)] = CHAR_SENTENCE_END;
+        return flags;
+    }
+    
+    constexpr std::array<uint8_t, 256> CHAR_FLAGS = buildCharFlags();
+    
+    enum : uint8_t {
+        WORD_KEYWORD = 1,
+        WORD_LANGUAGE = 2
+    };
+    
+    struct PricingTable {
+        std::unordered_map<std::string, ModelPricing> models;
+        std::string source_path;        // Models file merged over the built-ins, if any
+        std::filesystem::file_time_type source_mtime{};
+    };
+    
+    struct PricingState {
+        std::mutex mutex;               // Serializes reloads; lookups only load `table`
+        std::shared_ptr<const PricingTable> table;
+        std::string path;               // Set by loadPricingFile
+        bool path_configured = false;
+        std::filesystem::file_time_type failed_mtime{};
+        std::atomic<int64_t> next_check_ms{0};
+        std::atomic<uint64_t> generation{0};   // Bumped whenever `table` is replaced
+        std::unordered_set<std::string> warned_models;
+    };
+    
+    // How often lookups check the models file for changes
+    constexpr int64_t RELOAD_CHECK_INTERVAL_MS = 2000;
+    
+    PricingState& pricingState() {
+        static PricingState instance;
+        return instance;
+    }
+    
+    void addBuiltinPricing(std::unordered_map<std::string, ModelPricing>& models) {
+        auto add = [&](const std::string& name, const std::string& provider, double input_price,
+                       double output_price, int context_window, const std::string& tokenizer = "") {
+            ModelPricing pricing{name, provider, input_price, output_price, context_window};
+            pricing.tokenizer = tokenizer;
+            models[name] = pricing;
+        };
+        
+        // OpenRouter Models
+        add("meta-llama/llama-3.1-8b-instruct:free", "OpenRouter", 0.0, 0.0, 128000);
+        add("meta-llama/llama-3.1-70b-instruct", "OpenRouter", 0.00088, 0.00088, 128000);
+        add("openai/gpt-4o-mini", "OpenRouter", 0.00015, 0.00060, 128000, "o200k_base");
+        add("anthropic/claude-3-haiku", "OpenRouter", 0.00025, 0.00125, 200000);
+        
+        // OpenAI Models
+        add("gpt-3.5-turbo", "OpenAI", 0.0005, 0.0015, 16385, "cl100k_base");
+        add("gpt-4", "OpenAI", 0.03, 0.06, 8192, "cl100k_base");
+        add("gpt-4o-mini", "OpenAI", 0.00015, 0.00060, 128000, "o200k_base");
+        add("gpt-4o", "OpenAI", 0.005, 0.015, 128000, "o200k_base");
+        
+        // Gemini Models
+        add("gemini-pro", "Gemini", 0.00025, 0.0005, 32768);
+        add("gemini-pro-vision", "Gemini", 0.00025, 0.0005, 16384);
+        
+        // Requesty AI Models
+        add("claude-3-haiku", "Requesty AI", 0.00025, 0.00125, 200000);
+        add("claude-3-sonnet", "Requesty AI", 0.003, 0.015, 200000);
+    }
+    
+    // Models file layout (JSON takes the same shape):
+    //   models:
+    //     gpt-4o:
+    //       provider: OpenAI
+    //       input_price: 0.0025      # per 1K tokens
+    //       output_price: 0.01
+    //       context_window: 128000
+    //       max_output_tokens: 16384
+    //       tokenizer: o200k_base
+    // Fields left out keep the built-in value, if the model has one.
+    template <typename Getter>
+    void applyModelFields(ModelPricing& pricing, Getter&& get) {
+        get("provider", pricing.provider);
+        get("input_price", pricing.input_token_price);
+        get("output_price", pricing.output_token_price);
+        get("context_window", pricing.max_context_tokens);
+        get("max_output_tokens", pricing.max_output_tokens);
+        get("currency", pricing.currency);
+        get("tokenizer", pricing.tokenizer);
+    }
+    
+    ModelPricing& entryFor(std::unordered_map<std::string, ModelPricing>& models, const std::string& name) {
+        auto it = models.find(name);
+        if (it == models.end()) {
+            it = models.emplace(name, ModelPricing{name, "Unknown", 0.00001, 0.00001, 4096}).first;
+        }
+        return it->second;
+    }
+    
+    void loadJsonModels(const std::string& path, std::unordered_map<std::string, ModelPricing>& models) {
+        std::ifstream file(path);
+        nlohmann::json root = nlohmann::json::parse(file);
+        const nlohmann::json& entries = root.contains("models") ? root["models"] : root;
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            const nlohmann::json& fields = it.value();
+            applyModelFields(entryFor(models, it.key()), [&](const char* key, auto& field) {
+                if (fields.contains(key)) {
+                    field = fields[key].get<std::decay_t<decltype(field)>>();
+                }
+            });
+        }
+    }
+    
+    void loadYamlModels(const std::string& path, std::unordered_map<std::string, ModelPricing>& models) {
+        YAML::Node root = YAML::LoadFile(path);
+        YAML::Node entries = root["models"] ? root["models"] : root;
+        for (const auto& entry : entries) {
+            const YAML::Node& fields = entry.second;
+            applyModelFields(entryFor(models, entry.first.as<std::string>()), [&](const char* key, auto& field) {
+                if (fields[key]) {
+                    field = fields[key].as<std::decay_t<decltype(field)>>();
+                }
+            });
+        }
+    }
+    
+    // Built-ins merged with the file at `path` (empty for built-ins only);
+    // null if the file cannot be parsed
+    std::unique_ptr<PricingTable> buildPricingTable(const std::string& path) {
+        auto table = std::make_unique<PricingTable>();
+        addBuiltinPricing(table->models);
+        if (path.empty()) {
+            return table;
+        }
+        try {
+            table->source_mtime = std::filesystem::last_write_time(path);
+            std::string extension = std::filesystem::path(path).extension().string();
+            if (extension == ".json") {
+                loadJsonModels(path, table->models);
+            } else {
+                loadYamlModels(path, table->models);
+            }
+            table->source_path = path;
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: cannot load models file " << path << ": " << e.what() << std::endl;
+            return nullptr;
+        }
+        return table;
+    }
+    
+    std::string findPricingPath(const PricingState& s) {
+        if (s.path_configured) {
+            return s.path;
+        }
+        if (const char* env_path = std::getenv("CLION_MODELS_FILE")) {
+            return env_path;
+        }
+        const char* home_dir = std::getenv("HOME");
+        if (!home_dir) {
+            home_dir = std::getenv("USERPROFILE"); // Windows fallback
+        }
+        if (!home_dir) {
+            return "";
+        }
+        std::error_code ec;
+        for (const char* name : {"models.yaml", "models.yml", "models.json"}) {
+            auto path = std::filesystem::path(home_dir) / ".clion" / name;
+            if (std::filesystem::exists(path, ec)) {
+                return path.string();
+            }
+        }
+        return "";
+    }
+    
+    // Millisecond clock for reload checks. The coarse Linux clock is a plain
+    // memory read; steady_clock can cost a system call on some VMs.
+    int64_t monotonicMs() {
+#ifdef CLOCK_MONOTONIC_COARSE
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+#else
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+    
+    void publishPricingTable(PricingState& s, std::shared_ptr<const PricingTable> table) {
+        std::atomic_store(&s.table, std::move(table));
+        s.generation.fetch_add(1, std::memory_order_release);
+    }
+    
+    // The current table, rebuilt when the models file appeared, changed or
+    // went away. Between checks a lookup only compares a generation counter
+    // against its thread's cached table.
+    std::shared_ptr<const PricingTable> currentPricingTable() {
+        auto& s = pricingState();
+        thread_local std::shared_ptr<const PricingTable> cached_table;
+        thread_local uint64_t cached_generation = 0;
+        
+        int64_t now_ms = monotonicMs();
+        uint64_t generation = s.generation.load(std::memory_order_acquire);
+        if (cached_table && cached_generation == generation &&
+            now_ms < s.next_check_ms.load(std::memory_order_relaxed)) {
+            return cached_table;
+        }
+        
+        auto table = std::atomic_load(&s.table);
+        if (table && now_ms < s.next_check_ms.load(std::memory_order_relaxed)) {
+            cached_table = table;
+            cached_generation = generation;
+            return table;
+        }
+        
+        std::lock_guard<std::mutex> lock(s.mutex);
+        table = std::atomic_load(&s.table);
+        if (table && now_ms < s.next_check_ms.load(std::memory_order_relaxed)) {
+            return table;
+        }
+        s.next_check_ms.store(now_ms + RELOAD_CHECK_INTERVAL_MS, std::memory_order_relaxed);
+        
+        std::string path = findPricingPath(s);
+        std::error_code ec;
+        auto mtime = path.empty() ? std::filesystem::file_time_type{} : std::filesystem::last_write_time(path, ec);
+        if (ec) {
+            path.clear();
+        }
+        bool current = table && table->source_path == path && (path.empty() || table->source_mtime == mtime);
+        bool known_bad = table && !path.empty() && mtime == s.failed_mtime;
+        if (current || known_bad) {
+            return table;
+        }
+        
+        std::shared_ptr<const PricingTable> rebuilt = buildPricingTable(path);
+        if (!rebuilt) {
+            // Keep the last good table (or the built-ins) until the file changes
+            s.failed_mtime = mtime;
+            rebuilt = table ? table : buildPricingTable("");
+        }
+        publishPricingTable(s, rebuilt);
+        return rebuilt;
+    }
+    
+    // Exact name, then without an OpenRouter-style "vendor/" prefix, then the
+    // longest known name the model extends ("gpt-4o-2024-08-06" -> "gpt-4o")
+    const ModelPricing* findPricing(const PricingTable& table, const std::string& model) {
+        auto it = table.models.find(model);
+        if (it != table.models.end()) {
+            return &it->second;
+        }
+        std::string_view name = model;
+        size_t slash = name.rfind('/');
+        if (slash != std::string_view::npos) {
+            name.remove_prefix(slash + 1);
+            it = table.models.find(std::string(name));
+            if (it != table.models.end()) {
+                return &it->second;
+            }
+        }
+        
+        const ModelPricing* best = nullptr;
+        size_t best_length = 0;
+        for (const auto& [key, pricing] : table.models) {
+            if (key.size() > best_length && key.size() < name.size() && name.compare(0, key.size(), key) == 0 &&
+                (name[key.size()] == '-' || name[key.size()] == ':' || name[key.size()] == '@')) {
+                best = &pricing;
+                best_length = key.size();
+            }
+        }
+        if (!best && !model.empty()) {
+            auto& s = pricingState();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (s.warned_models.insert(model).second) {
+                std::cerr << "Warning: no pricing data for model '" << model
+                          << "'; using defaults. Add it to ~/.clion/models.yaml" << std::endl;
+            }
+        }
+        return best;
+    }
+    
+    // Exact counts when the model's BPE vocabulary is installed. Providers that
+    // do not publish theirs are estimated with cl100k, which is much closer
+    // than the heuristics.
+    std::shared_ptr<const BpeTokenizer> tokenizerForModel(const std::string& model) {
+        std::shared_ptr<const BpeTokenizer> tokenizer;
+        std::string encoding;
+        if (!model.empty()) {
+            auto table = currentPricingTable();
+            auto it = table->models.find(model);
+            if (it != table->models.end()) {
+                encoding = it->second.tokenizer;
+            }
+        }
+        if (encoding.empty()) {
+            encoding = BpeTokenizer::encodingForModel(model);
+        }
+        if (!encoding.empty()) {
+            tokenizer = BpeTokenizer::forEncoding(encoding);
+        }
+        if (!tokenizer) {
+            tokenizer = BpeTokenizer::forEncoding("cl100k_base");
+        }
+        return tokenizer;
+    }
+    
+    const std::unordered_map<std::string_view, uint8_t> WORD_KINDS = [] {
+        std::unordered_map<std::string_view, uint8_t> kinds;
+        for (const char* word : {"class", "struct", "function", "int", "float", "double", "char", "bool",
+                                 "void", "return", "if", "else", "for", "while", "do", "switch", "case",
+                                 "break", "continue", "include", "import", "namespace", "using",
+                                 "public", "private", "protected"}) {
+            kinds[word] |= WORD_KEYWORD;
+        }
+        for (const char* word : {"the", "and", "or", "but", "in", "on", "at", "to", "for", "of", "with",
+                                 "by", "from", "up", "about", "into", "through", "during", "before",
+                                 "after", "above", "below", "between", "among", "under", "over",
+                                 "is", "Is", "are", "Are", "was", "Was", "were", "Were", "have", "Have",
+                                 "has", "Has", "will", "Will", "would", "Would"}) {
+            kinds[word] |= WORD_LANGUAGE;
+        }
+        return kinds;
+    }();
+}
 
 // Token counting implementation
 int TokenCounter::countTokens(const std::string& text) {
     if (text.empty()) return 0;
     
-    ContentType type = detectContentType(text);
+    // Classify once and reuse the ratio for mixed content
+    double code_ratio = calculateCodeRatio(text);
+    ContentType type = contentTypeForRatio(code_ratio);
+    if (type == ContentType::MIXED) {
+        return countMixedTokens(text, code_ratio);
+    }
     return countTokens(text, type);
 }
 
@@ -34,15 +391,26 @@ int TokenCounter::countTokens(const std::string& text, ContentType content_type)
 }
 
 int TokenCounter::countTokensForModel(const std::string& text, const std::string& model) {
-    // For now, use the standard counting method
-    // In the future, this could be model-specific
-    (void)model; // Mark as unused for now
-    return countTokens(text);
+    if (text.empty()) return 0;
+
+    if (auto tokenizer = tokenizerForModel(model)) {
+        return static_cast<int>(TokenCache::countTokens(text, *tokenizer));
+    }
+    return static_cast<int>(TokenCache::countTokens(text, "heuristic", [&text](std::string_view) {
+        return static_cast<size_t>(countTokens(text));
+    }));
+}
+
+std::string TokenCounter::getTokenizerName(const std::string& model) {
+    auto tokenizer = tokenizerForModel(model);
+    return tokenizer ? tokenizer->getCountingId() : "heuristic";
 }
 
 ContentType TokenCounter::detectContentType(const std::string& text) {
-    double code_ratio = calculateCodeRatio(text);
-    
+    return contentTypeForRatio(calculateCodeRatio(text));
+}
+
+ContentType TokenCounter::contentTypeForRatio(double code_ratio) {
     if (code_ratio > 0.6) {
         return ContentType::CODE;
     } else if (code_ratio < 0.2) {
@@ -55,49 +423,87 @@ ContentType TokenCounter::detectContentType(const std::string& text) {
 double TokenCounter::calculateCodeRatio(const std::string& text) {
     if (text.empty()) return 0.0;
     
-    // Count code indicators
+    // One pass over the text with a byte-class table. Each rule counts what
+    // its regular expression used to match:
+    //   code: keywords, brackets {}();[], comments, "name(...) {" function
+    //         definitions, "name =" style assignments
+    //   language: stop words, sentence endings (". X"), common verbs
+    const size_t n = text.size();
     int code_indicators = 0;
-    int total_indicators = 0;
-    
-    // Code patterns
-    std::vector<std::regex> code_patterns = {
-        std::regex(R"(\b(class|struct|function|int|float|double|char|bool|void|return|if|else|for|while|do|switch|case|break|continue|include|import|namespace|using|public|private|protected)\b)"),
-        std::regex(R"([{}();\[\]])"),
-        std::regex(R"(/\*.*?\*/|//.*?$)"), // Comments
-        std::regex(R"(\b[A-Za-z_][A-Za-z0-9_]*\s*\([^)]*\)\s*\{)"), // Function definitions
-        std::regex(R"(\b[A-Za-z_][A-Za-z0-9_]*\s*[=+\-*/])") // Variable assignments
-    };
+    int lang_indicators = 0;
+    bool open_call = false;   // Inside "name(" awaiting ")" and then "{"
     
-    // Natural language patterns
-    std::vector<std::regex> lang_patterns = {
-        std::regex(R"(\b(the|and|or|but|in|on|at|to|for|of|with|by|from|up|about|into|through|during|before|after|above|below|between|among|under|over|above)\b)"),
-        std::regex(R"([.!?]\s+[A-Z])"), // Sentence endings
-        std::regex(R"(\b[Ii]s\b|\b[aA]re\b|\b[wW]as\b|\b[wW]ere\b|\b[hH]ave\b|\b[hH]as\b|\b[wW]ill\b|\b[wW]ould\b)") // Common verbs
+    auto skipSpaces = [&](size_t pos) {
+        while (pos < n && (CHAR_FLAGS[static_cast<unsigned char>(text[pos])] & CHAR_SPACE)) {
+            ++pos;
+        }
+        return pos;
     };
     
-    for (const auto& pattern : code_patterns) {
-        auto words_begin = std::sregex_iterator(text.begin(), text.end(), pattern);
-        auto words_end = std::sregex_iterator();
-        code_indicators += std::distance(words_begin, words_end);
-    }
-    
-    for (const auto& pattern : lang_patterns) {
-        auto words_begin = std::sregex_iterator(text.begin(), text.end(), pattern);
-        auto words_end = std::sregex_iterator();
-        total_indicators += std::distance(words_begin, words_end);
+    size_t i = 0;
+    while (i < n) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        uint8_t flags = CHAR_FLAGS[c];
+        
+        if (flags & CHAR_WORD) {
+            size_t start = i;
+            while (i < n && (CHAR_FLAGS[static_cast<unsigned char>(text[i])] & CHAR_WORD)) {
+                ++i;
+            }
+            if (!(flags & CHAR_WORD_START)) {
+                continue; // Numbers and words starting with a digit
+            }
+            
+            std::string_view word(text.data() + start, i - start);
+            auto kind = WORD_KINDS.find(word);
+            if (kind != WORD_KINDS.end()) {
+                if (kind->second & WORD_KEYWORD) code_indicators++;
+                if (kind->second & WORD_LANGUAGE) lang_indicators++;
+            }
+            
+            size_t next = skipSpaces(i);
+            if (next < n) {
+                uint8_t next_flags = CHAR_FLAGS[static_cast<unsigned char>(text[next])];
+                if (next_flags & CHAR_OPERATOR) {
+                    code_indicators++;
+                } else if (text[next] == '(') {
+                    open_call = true;
+                }
+            }
+            continue;
+        }
+        
+        if (flags & CHAR_BRACKET) {
+            code_indicators++;
+            if (c == ')' && open_call) {
+                open_call = false;
+                size_t next = skipSpaces(i + 1);
+                if (next < n && text[next] == '{') {
+                    code_indicators++;
+                }
+            }
+        } else if (c == '/' && i + 1 < n && (text[i + 1] == '/' || text[i + 1] == '*')) {
+            // Comment openers; their text is still scanned for words
+            code_indicators++;
+            i += 2;
+            continue;
+        } else if (flags & CHAR_SENTENCE_END) {
+            size_t next = skipSpaces(i + 1);
+            if (next > i + 1 && next < n && (CHAR_FLAGS[static_cast<unsigned char>(text[next])] & CHAR_UPPER)) {
+                lang_indicators++;
+            }
+        }
+        ++i;
     }
     
-    total_indicators += code_indicators;
+    int total_indicators = code_indicators + lang_indicators;
     return total_indicators > 0 ? static_cast<double>(code_indicators) / total_indicators : 0.0;
 }
 
 int TokenCounter::countNaturalLanguageTokens(const std::string& text) {
-    // Improved natural language token counting
-    std::istringstream iss(text);
-    std::string word;
     int token_count = 0;
     
-    while (iss >> word) {
+    TextKernels::forEachWord(text, [&token_count](std::string_view word) {
         // Base token: 1 token per word on average
         token_count++;
         
@@ -105,17 +511,10 @@ int TokenCounter::countNaturalLanguageTokens(const std::string& text) {
         if (word.length() > 8) {
             token_count += word.length() / 4;
         }
-        
-        // Add tokens for punctuation and special chars
-        for (char c : word) {
-            if (std::ispunct(c) && c != '\'') {
-                token_count += 0.25; // Punctuation often groups with words
-            }
-        }
-    }
+    });
     
     // Account for whitespace and formatting
-    token_count += std::count(text.begin(), text.end(), '\n') * 0.1;
+    token_count += TextKernels::countByte(text, '\n') * 0.1;
     
     return static_cast<int>(token_count);
 }
@@ -123,53 +522,38 @@ int TokenCounter::countNaturalLanguageTokens(const std::string& text) {
 int TokenCounter::countCodeTokens(const std::string& text) {
     // More conservative code token counting
     int token_count = 0;
-    std::istringstream iss(text);
-    std::string line;
     
-    while (std::getline(iss, line)) {
-        if (line.empty()) {
-            token_count += 0.1; // Empty lines
-            continue;
-        }
-        
-        // Count operators and punctuation as separate tokens
-        for (char c : line) {
-            if (std::string("{}();,[]").find(c) != std::string::npos) {
-                token_count += 0.5;
-            } else if (std::string("+-*/%=<>!&|^~").find(c) != std::string::npos) {
-                token_count += 0.5;
-            }
-        }
-        
-        // Count words (identifiers, keywords)
-        std::istringstream line_iss(line);
-        std::string word;
-        while (line_iss >> word) {
+    TextKernels::forEachLine(text, [&token_count](std::string_view line) {
+        bool in_comment = false;
+        TextKernels::forEachWord(line, [&](std::string_view word) {
             // Skip comments
-            if (word.find("//") == 0 || word.find("/*") == 0) {
-                break;
+            if (in_comment || word.rfind("//", 0) == 0 || word.rfind("/*", 0) == 0) {
+                in_comment = true;
+                return;
             }
             
-            // Clean word of punctuation
-            word.erase(std::remove_if(word.begin(), word.end(), ::ispunct), word.end());
-            
-            if (!word.empty()) {
+            // Punctuation does not count towards identifier length
+            size_t length = word.length() - TextKernels::countPunctuation(word);
+            if (length > 0) {
                 // Long identifiers get split into multiple tokens
-                if (word.length() > 6) {
-                    token_count += word.length() / 3.0;
+                if (length > 6) {
+                    token_count += length / 3;
                 } else {
-                    token_count += 1.0;
+                    token_count += 1;
                 }
             }
-        }
-    }
+        });
+    });
     
-    return static_cast<int>(token_count);
+    return token_count;
 }
 
 int TokenCounter::countMixedTokens(const std::string& text) {
+    return countMixedTokens(text, calculateCodeRatio(text));
+}
+
+int TokenCounter::countMixedTokens(const std::string& text, double code_ratio) {
     // Weighted average of code and natural language counting
-    double code_ratio = calculateCodeRatio(text);
     int code_tokens = countCodeTokens(text);
     int lang_tokens = countNaturalLanguageTokens(text);
     
@@ -182,147 +566,98 @@ bool TokenCounter::isCodeLike(const std::string& text) {
 
 // Pricing database implementation
 void TokenCounter::initializePricingDatabase() {
-    if (initialized_) return;
-    
-    // OpenRouter Models
-    pricing_database_["meta-llama/llama-3.1-8b-instruct:free"] = {
-        "meta-llama/llama-3.1-8b-instruct:free", "OpenRouter", 0.0, 0.0, 128000
-    };
-    pricing_database_["meta-llama/llama-3.1-70b-instruct"] = {
-        "meta-llama/llama-3.1-70b-instruct", "OpenRouter", 0.00088, 0.00088, 128000
-    };
-    pricing_database_["openai/gpt-4o-mini"] = {
-        "openai/gpt-4o-mini", "OpenRouter", 0.00015, 0.00060, 128000
-    };
-    pricing_database_["anthropic/claude-3-haiku"] = {
-        "anthropic/claude-3-haiku", "OpenRouter", 0.00025, 0.00125, 200000
-    };
-    
-    // OpenAI Models
-    pricing_database_["gpt-3.5-turbo"] = {
-        "gpt-3.5-turbo", "OpenAI", 0.0005, 0.0015, 16385
-    };
-    pricing_database_["gpt-4"] = {
-        "gpt-4", "OpenAI", 0.03, 0.06, 8192
-    };
-    pricing_database_["gpt-4o-mini"] = {
-        "gpt-4o-mini", "OpenAI", 0.00015, 0.00060, 128000
-    };
-    pricing_database_["gpt-4o"] = {
-        "gpt-4o", "OpenAI", 0.005, 0.015, 128000
-    };
-    
-    // Gemini Models
-    pricing_database_["gemini-pro"] = {
-        "gemini-pro", "Gemini", 0.00025, 0.0005, 32768
-    };
-    pricing_database_["gemini-pro-vision"] = {
-        "gemini-pro-vision", "Gemini", 0.00025, 0.0005, 16384
-    };
-    
-    // Requesty AI Models
-    pricing_database_["claude-3-haiku"] = {
-        "claude-3-haiku", "Requesty AI", 0.00025, 0.00125, 200000
-    };
-    pricing_database_["claude-3-sonnet"] = {
-        "claude-3-sonnet", "Requesty AI", 0.003, 0.015, 200000
-    };
-    
-    initialized_ = true;
+    currentPricingTable();
+}
+
+bool TokenCounter::loadPricingFile(const std::string& path) {
+    auto& s = pricingState();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto table = buildPricingTable(path);
+    if (!table) {
+        return false;
+    }
+    s.path = path;
+    s.path_configured = true;
+    publishPricingTable(s, std::move(table));
+    return true;
+}
+
+std::string TokenCounter::getPricingFile() {
+    auto table = currentPricingTable();
+    return table->source_path;
 }
 
 // Cost estimation implementation
 double TokenCounter::estimateCost(int input_tokens, int output_tokens, const std::string& model) {
-    initializePricingDatabase();
-    
-    auto it = pricing_database_.find(model);
-    if (it == pricing_database_.end()) {
-        // Default pricing for unknown models
-        return (input_tokens + output_tokens) * 0.00001;
-    }
-    
-    const ModelPricing& pricing = it->second;
-    double input_cost = (input_tokens / 1000.0) * pricing.input_token_price;
-    double output_cost = (output_tokens / 1000.0) * pricing.output_token_price;
-    
-    return input_cost + output_cost;
+    return estimateInputCost(input_tokens, model) + estimateOutputCost(output_tokens, model);
 }
 
 double TokenCounter::estimateInputCost(int tokens, const std::string& model) {
-    initializePricingDatabase();
-    
-    auto it = pricing_database_.find(model);
-    if (it == pricing_database_.end()) {
+    auto table = currentPricingTable();
+    const ModelPricing* pricing = findPricing(*table, model);
+    if (!pricing) {
         return tokens * 0.00001;
     }
-    
-    return (tokens / 1000.0) * it->second.input_token_price;
+    return (tokens / 1000.0) * pricing->input_token_price;
 }
 
 double TokenCounter::estimateOutputCost(int tokens, const std::string& model) {
-    initializePricingDatabase();
-    
-    auto it = pricing_database_.find(model);
-    if (it == pricing_database_.end()) {
+    auto table = currentPricingTable();
+    const ModelPricing* pricing = findPricing(*table, model);
+    if (!pricing) {
         return tokens * 0.00001;
     }
-    
-    return (tokens / 1000.0) * it->second.output_token_price;
+    return (tokens / 1000.0) * pricing->output_token_price;
 }
 
 // Model information methods
 std::string TokenCounter::getModelProvider(const std::string& model) {
-    initializePricingDatabase();
-    
-    auto it = pricing_database_.find(model);
-    if (it == pricing_database_.end()) {
-        return "Unknown";
-    }
-    
-    return it->second.provider;
+    auto table = currentPricingTable();
+    const ModelPricing* pricing = findPricing(*table, model);
+    return pricing ? pricing->provider : "Unknown";
 }
 
 double TokenCounter::getInputTokenPrice(const std::string& model) {
-    initializePricingDatabase();
-    
-    auto it = pricing_database_.find(model);
-    if (it == pricing_database_.end()) {
-        return 0.00001; // Default price
-    }
-    
-    return it->second.input_token_price;
+    auto table = currentPricingTable();
+    const ModelPricing* pricing = findPricing(*table, model);
+    return pricing ? pricing->input_token_price : 0.00001; // Default price
 }
 
 double TokenCounter::getOutputTokenPrice(const std::string& model) {
-    initializePricingDatabase();
-    
-    auto it = pricing_database_.find(model);
-    if (it == pricing_database_.end()) {
-        return 0.00001; // Default price
-    }
-    
-    return it->second.output_token_price;
+    auto table = currentPricingTable();
+    const ModelPricing* pricing = findPricing(*table, model);
+    return pricing ? pricing->output_token_price : 0.00001; // Default price
 }
 
 ModelPricing TokenCounter::getModelPricing(const std::string& model) {
-    initializePricingDatabase();
-    
-    auto it = pricing_database_.find(model);
-    if (it == pricing_database_.end()) {
+    auto table = currentPricingTable();
+    const ModelPricing* pricing = findPricing(*table, model);
+    if (!pricing) {
         // Return default pricing
         return {model, "Unknown", 0.00001, 0.00001, 4096};
     }
-    
-    return it->second;
+    return *pricing;
+}
+
+int TokenCounter::getContextWindow(const std::string& model) {
+    auto table = currentPricingTable();
+    const ModelPricing* pricing = findPricing(*table, model);
+    return pricing ? pricing->max_context_tokens : 4096;
 }
 
 // Token usage calculation
 TokenUsage TokenCounter::calculateUsage(const std::string& input_text,
                                        const std::string& model,
                                        int estimated_output_tokens) {
+    return calculateUsage(countTokensForModel(input_text, model), model, estimated_output_tokens);
+}
+
+TokenUsage TokenCounter::calculateUsage(int input_tokens,
+                                       const std::string& model,
+                                       int estimated_output_tokens) {
     TokenUsage usage;
     
-    usage.input_tokens = countTokensForModel(input_text, model);
+    usage.input_tokens = input_tokens;
     usage.output_tokens = estimated_output_tokens;
     usage.total_tokens = usage.input_tokens + usage.output_tokens;
     usage.input_cost = estimateInputCost(usage.input_tokens, model);
@@ -341,17 +676,19 @@ TokenUsage TokenCounter::calculateUsage(const std::string& input_text,
 }
 
 bool TokenCounter::isModelSupported(const std::string& model) {
-    initializePricingDatabase();
-    return pricing_database_.find(model) != pricing_database_.end();
+    auto table = currentPricingTable();
+    return findPricing(*table, model) != nullptr;
 }
 
 std::vector<std::string> TokenCounter::getSupportedModels() {
-    initializePricingDatabase();
+    auto table = currentPricingTable();
     
     std::vector<std::string> models;
-    for (const auto& pair : pricing_database_) {
+    models.reserve(table->models.size());
+    for (const auto& pair : table->models) {
         models.push_back(pair.first);
     }
+    std::sort(models.begin(), models.end());
     
     return models;
 }
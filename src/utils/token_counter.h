@@ -1,7 +1,6 @@
 #pragma once
 
 #include <string>
-#include <map>
 #include <vector>
 #include "clion/common.h"
 
@@ -21,6 +20,8 @@ struct ModelPricing {
     double output_token_price;   // Price per 1K output tokens
     int max_context_tokens;
     std::string currency = "USD";
+    int max_output_tokens = 0;   // 0 when unknown
+    std::string tokenizer{};     // BPE encoding; empty to pick one from the model name
 };
 
 struct TokenUsage {
@@ -41,6 +42,11 @@ public:
     static int countTokens(const std::string& text, ContentType content_type);
     static int countTokensForModel(const std::string& text, const std::string& model);
     
+    // Encoding countTokensForModel uses for `model`, qualified by its
+    // pre-tokenizer revision, or "heuristic"; counts stored under another
+    // name must be recounted
+    static std::string getTokenizerName(const std::string& model);
+    
     // Content type detection
     static ContentType detectContentType(const std::string& text);
     
@@ -54,14 +60,23 @@ public:
     static double getInputTokenPrice(const std::string& model);
     static double getOutputTokenPrice(const std::string& model);
     static ModelPricing getModelPricing(const std::string& model);
+    static int getContextWindow(const std::string& model);
     
     // Token usage calculation
     static TokenUsage calculateUsage(const std::string& input_text,
                                    const std::string& model,
                                    int estimated_output_tokens = 0);
+    static TokenUsage calculateUsage(int input_tokens,
+                                   const std::string& model,
+                                   int estimated_output_tokens = 0);
     
-    // Pricing database management
+    // Pricing database management. Built-in entries are extended or
+    // overridden by a models file (YAML or JSON): $CLION_MODELS_FILE, else
+    // ~/.clion/models.yaml or ~/.clion/models.json. The file is re-read when
+    // its modification time changes.
     static void initializePricingDatabase();
+    static bool loadPricingFile(const std::string& path);
+    static std::string getPricingFile();
     static bool isModelSupported(const std::string& model);
     static std::vector<std::string> getSupportedModels();
 
@@ -70,14 +85,12 @@ private:
     static int countNaturalLanguageTokens(const std::string& text);
     static int countCodeTokens(const std::string& text);
     static int countMixedTokens(const std::string& text);
+    static int countMixedTokens(const std::string& text, double code_ratio);
     
     // Content analysis helpers
     static bool isCodeLike(const std::string& text);
     static double calculateCodeRatio(const std::string& text);
-    
-    // Pricing database
-    static std::map<std::string, ModelPricing> pricing_database_;
-    static bool initialized_;
+    static ContentType contentTypeForRatio(double code_ratio);
 };
 
 } // namespace utils
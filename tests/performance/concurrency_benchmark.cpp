@@ -0,0 +1,174 @@
+// Several processes writing one session directory at once: each adds turns
+// through SessionManager, tags the session as it goes (a load, change and
+// save) and every so often compacts it, which rewrites the session file
+// under the other processes' appends. Run with each process on its own
+// session, then with all of them on one. Afterwards every turn and tag must
+// be in the session and its catalog entry must count every turn.
+//
+// Usage: clion_session_concurrency_benchmark [--processes N] [--turns N] [--entry-kb KB]
+//
+// Sessions are written to a temporary HOME and removed afterwards. A lost
+// turn or tag, or a stale catalog entry, exits with status 1.
+
+#include "llm/session.h"
+#include "llm/session_catalog.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using clion::llm::Session;
+using clion::llm::SessionCatalog;
+using clion::llm::SessionManager;
+
+namespace {
+
+struct BenchOptions {
+    size_t processes = 4;
+    size_t turns = 200;
+    size_t entry_kb = 1;
+};
+
+constexpr size_t TURNS_PER_TAG = 10;
+constexpr size_t TURNS_PER_COMPACTION = 50;
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::string tagFor(size_t process, size_t turn) {
+    return "p" + std::to_string(process) + "_t" + std::to_string(turn);
+}
+
+// One process's share of the work; true if every call succeeded
+bool runWorker(size_t process, const std::string& session_id, const BenchOptions& options) {
+    std::string turn(options.entry_kb * 1024, 'x');
+    bool ok = true;
+    for (size_t i = 0; i < options.turns; ++i) {
+        ok = SessionManager::addEntryToSession(session_id, i % 2 ? "assistant" : "user", turn) && ok;
+        if (i % TURNS_PER_TAG == 0) {
+            ok = SessionManager::addTagsToSession(session_id, {tagFor(process, i)}) && ok;
+        }
+        if (i % TURNS_PER_COMPACTION == TURNS_PER_COMPACTION - 1) {
+            ok = SessionManager::compactSession(session_id) && ok;
+        }
+    }
+    return ok;
+}
+
+// Forks one worker per process, each on `ids[process % ids.size()]`, and
+// checks the sessions once they are done
+bool runMode(const std::string& mode, size_t processes, size_t sessions, const BenchOptions& options,
+             const std::string& prefix) {
+    std::vector<std::string> ids;
+    for (size_t i = 0; i < sessions; ++i) {
+        Session session;
+        session.id = prefix + "_" + std::to_string(i);
+        session.created_at = "2026-01-01T00:00:00.000Z";
+        session.updated_at = session.created_at;
+        SessionManager::saveSession(session);
+        ids.push_back(session.id);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<pid_t> children;
+    for (size_t p = 0; p < processes; ++p) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(runWorker(p, ids[p % ids.size()], options) ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+    bool ok = true;
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+    }
+    double total_ms = millisecondsSince(start);
+
+    size_t lost_turns = 0;
+    size_t lost_tags = 0;
+    bool catalog_ok = true;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        size_t expected_turns = 0;
+        std::vector<std::string> expected_tags;
+        for (size_t p = i; p < processes; p += ids.size()) {
+            expected_turns += options.turns;
+            for (size_t t = 0; t < options.turns; t += TURNS_PER_TAG) {
+                expected_tags.push_back(tagFor(p, t));
+            }
+        }
+        auto session = SessionManager::loadSession(ids[i]);
+        size_t found_turns = session ? session->entries.size() : 0;
+        lost_turns += expected_turns - std::min(expected_turns, found_turns);
+        for (const auto& tag : expected_tags) {
+            lost_tags += session && session->tags.count(tag) ? 0 : 1;
+        }
+        SessionManager::listSessions();  // Refreshes the catalog
+        auto catalog_entry = SessionCatalog::find(ids[i]);
+        catalog_ok = catalog_entry && catalog_entry->entry_count == found_turns && catalog_ok;
+    }
+    ok = ok && lost_turns == 0 && lost_tags == 0 && catalog_ok;
+
+    size_t turns = processes * options.turns;
+    std::cout << std::left << std::setw(10) << mode << std::right << std::setw(11) << processes << std::fixed
+              << std::setw(12) << std::setprecision(0) << turns / (total_ms / 1000.0)
+              << std::setw(12) << std::setprecision(3) << total_ms * processes / turns
+              << std::setw(12) << lost_turns << std::setw(12) << lost_tags
+              << std::setw(10) << (catalog_ok ? "ok" : "STALE")
+              << (ok ? "" : "   FAILED") << std::endl;
+    return ok;
+}
+
+bool parseArgs(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+
+        if (arg == "--processes") options.processes = std::max<size_t>(1, std::strtoul(next(), nullptr, 10));
+        else if (arg == "--turns") options.turns = std::max<size_t>(1, std::strtoul(next(), nullptr, 10));
+        else if (arg == "--entry-kb") options.entry_kb = std::max<size_t>(1, std::strtoul(next(), nullptr, 10));
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        return 1;
+    }
+
+    // Keep benchmark sessions out of the user's ~/.clion directory
+    std::filesystem::path bench_home = std::filesystem::temp_directory_path() / "clion_concurrency_benchmark";
+    std::filesystem::remove_all(bench_home);
+    std::filesystem::create_directories(bench_home);
+    setenv("HOME", bench_home.c_str(), 1);
+
+    std::cout << options.turns << " turns of " << options.entry_kb << " KB per process" << std::endl << std::endl;
+    std::cout << std::left << std::setw(10) << "sessions" << std::right << std::setw(11) << "processes"
+              << std::setw(12) << "turns/s" << std::setw(12) << "ms/turn" << std::setw(12) << "lost turns"
+              << std::setw(12) << "lost tags" << std::setw(10) << "catalog" << std::endl;
+
+    bool ok = true;
+    ok = runMode("own", 1, 1, options, "single") && ok;
+    if (options.processes > 1) {
+        ok = runMode("own", options.processes, options.processes, options, "own") && ok;
+        ok = runMode("shared", options.processes, 1, options, "shared") && ok;
+    }
+
+    std::filesystem::remove_all(bench_home);
+    return ok ? 0 : 1;
+}
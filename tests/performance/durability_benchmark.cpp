@@ -0,0 +1,173 @@
+// Sustained turn throughput with durability on: worker threads each add
+// turns to their own session through SessionManager, then save it again a
+// few times, and every journal append and session write is flushed to disk
+// before it returns. Compared with flushing off, and with every flush made
+// on its own instead of shared with concurrent writers of the same file
+// (group commit; saves share the session directory's flush).
+//
+// Usage: clion_durability_benchmark [--threads N] [--turns N] [--entry-kb KB]
+//
+// Sessions are written to a temporary HOME and removed afterwards. Each
+// session is checked for every turn afterwards; a missing one exits with
+// status 1.
+
+#include "llm/session.h"
+#include "utils/group_commit.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using clion::llm::Session;
+using clion::llm::SessionManager;
+using clion::utils::GroupCommit;
+
+namespace {
+
+struct BenchOptions {
+    size_t threads = 8;
+    size_t turns = 200;
+    size_t entry_kb = 1;
+};
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Adds `turns` turns to each of `threads` new sessions, one thread per
+// session, then saves each session turns/10 times; false if a write failed
+// or a turn is missing afterwards
+bool runMode(const std::string& mode, size_t threads, const BenchOptions& options, const std::string& prefix) {
+    std::vector<std::string> ids;
+    for (size_t t = 0; t < threads; ++t) {
+        Session session;
+        session.id = prefix + "_" + std::to_string(t);
+        session.created_at = "2026-01-01T00:00:00.000Z";
+        session.updated_at = session.created_at;
+        SessionManager::saveSession(session);
+        ids.push_back(session.id);
+    }
+
+    std::string turn(options.entry_kb * 1024, 'x');
+    std::vector<int> failed(threads, 0);
+    GroupCommit::resetStats();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (size_t i = 0; i < options.turns; ++i) {
+                if (!SessionManager::addEntryToSession(ids[t], i % 2 ? "assistant" : "user", turn)) {
+                    failed[t] = 1;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double total_ms = millisecondsSince(start);
+    auto stats = GroupCommit::getStats();
+
+    // Whole-session saves, e.g. metadata changes
+    size_t saves = std::max<size_t>(1, options.turns / 10);
+    std::vector<Session> loaded;
+    for (const auto& id : ids) {
+        loaded.push_back(SessionManager::loadSession(id).value_or(Session{}));
+    }
+    GroupCommit::resetStats();
+    start = std::chrono::steady_clock::now();
+    workers.clear();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (size_t i = 0; i < saves; ++i) {
+                loaded[t].name = "save " + std::to_string(i);
+                if (!SessionManager::saveSession(loaded[t])) {
+                    failed[t] = 1;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double save_ms = millisecondsSince(start);
+    auto save_stats = GroupCommit::getStats();
+
+    bool ok = std::none_of(failed.begin(), failed.end(), [](int f) { return f != 0; });
+    for (const auto& id : ids) {
+        auto session = SessionManager::loadSession(id);
+        ok = session && session->entries.size() == options.turns && ok;
+    }
+
+    size_t turns = threads * options.turns;
+    std::cout << std::left << std::setw(12) << mode << std::right << std::setw(8) << threads << std::fixed
+              << std::setw(12) << std::setprecision(0) << turns / (total_ms / 1000.0)
+              << std::setw(12) << std::setprecision(3) << total_ms * threads / turns
+              << std::setw(12) << std::setprecision(2) << static_cast<double>(stats.syncs) / turns
+              << std::setw(12) << std::setprecision(0) << threads * saves / (save_ms / 1000.0)
+              << std::setw(12) << std::setprecision(2) << static_cast<double>(save_stats.syncs) / (threads * saves)
+              << (ok ? "" : "   MISSING TURNS") << std::endl;
+    return ok;
+}
+
+bool parseArgs(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+
+        if (arg == "--threads") options.threads = std::max<size_t>(1, std::strtoul(next(), nullptr, 10));
+        else if (arg == "--turns") options.turns = std::max<size_t>(1, std::strtoul(next(), nullptr, 10));
+        else if (arg == "--entry-kb") options.entry_kb = std::max<size_t>(1, std::strtoul(next(), nullptr, 10));
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        return 1;
+    }
+
+    // Keep benchmark sessions out of the user's ~/.clion directory
+    std::filesystem::path bench_home = std::filesystem::temp_directory_path() / "clion_durability_benchmark";
+    std::filesystem::remove_all(bench_home);
+    std::filesystem::create_directories(bench_home);
+    setenv("HOME", bench_home.c_str(), 1);
+
+    std::cout << options.turns << " turns of " << options.entry_kb << " KB per thread" << std::endl << std::endl;
+    std::cout << std::left << std::setw(12) << "mode" << std::right << std::setw(8) << "threads"
+              << std::setw(12) << "turns/s" << std::setw(12) << "ms/turn" << std::setw(12) << "syncs/turn"
+              << std::setw(12) << "saves/s" << std::setw(12) << "syncs/save" << std::endl;
+
+    bool ok = true;
+    std::vector<size_t> thread_counts = {1};
+    if (options.threads > 1) {
+        thread_counts.push_back(options.threads);
+    }
+    for (size_t threads : thread_counts) {
+        SessionManager::setSyncOnAppend(false);
+        ok = runMode("no sync", threads, options, "off_" + std::to_string(threads)) && ok;
+
+        SessionManager::setSyncOnAppend(true);
+        GroupCommit::setGrouping(false);
+        ok = runMode("sync each", threads, options, "each_" + std::to_string(threads)) && ok;
+
+        GroupCommit::setGrouping(true);
+        ok = runMode("group", threads, options, "group_" + std::to_string(threads)) && ok;
+    }
+    SessionManager::setSyncOnAppend(false);
+
+    std::filesystem::remove_all(bench_home);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,378 @@
+// End-to-end latency benchmark for LLMClient against a local mock server.
+//
+// Usage: clion_llm_benchmark [--iterations N] [--latency MS] [--jitter MS]
+//                            [--chunked] [--chunk-size BYTES] [--error-rate R]
+//                            [--prompt-kb KB] [--response-kb KB] [--turns N]
+//                            [--history-budget TOKENS] [--scenario NAME]
+//                            [--json] [--phases]
+//
+// Client overhead is the client-observed latency minus the time the server
+// spent handling the same request, i.e. everything CLion does locally plus
+// loopback transport. --phases adds the per-phase breakdown collected by
+// Telemetry across all scenarios. session.compact runs the session turns
+// again with the history held to --history-budget tokens.
+
+#include "mock_llm_server.h"
+#include "llm/llm_client.h"
+#include "llm/llm_router.h"
+#include "llm/telemetry.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using clion::bench::MockLLMServer;
+using clion::bench::MockServerOptions;
+using namespace clion::llm;
+
+namespace {
+
+struct BenchOptions {
+    int iterations = 200;
+    int latency_ms = 0;
+    int jitter_ms = 0;
+    bool chunked = false;
+    size_t chunk_size = 512;
+    double error_rate = 0.0;
+    size_t prompt_kb = 4;
+    size_t response_kb = 2;
+    int session_turns = 50;
+    int history_budget = 8000;
+    std::string scenario = "all";
+    bool json_output = false;
+    bool phases = false;
+};
+
+struct ScenarioResult {
+    std::string name;
+    size_t requests = 0;
+    size_t errors = 0;
+    double wall_seconds = 0.0;
+    std::vector<double> latencies_ms;
+    std::vector<double> overheads_ms;
+};
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+double mean(const std::vector<double>& values) {
+    if (values.empty()) return 0.0;
+    return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+std::string makeText(size_t bytes, const std::string& seed) {
+    std::string text;
+    text.reserve(bytes + seed.size());
+    while (text.size() < bytes) {
+        text += seed;
+    }
+    text.resize(bytes);
+    return text;
+}
+
+LLMConfig makeConfig(LLMProvider provider, const std::string& endpoint) {
+    LLMConfig config;
+    config.provider = provider;
+    config.api_key = "mock-key";
+    config.model = provider == LLMProvider::GEMINI ? "gemini-pro" : "gpt-4o-mini";
+    config.custom_endpoint = endpoint;
+    config.show_token_usage = false;
+    config.confirm_over_limit = false;
+    return config;
+}
+
+// Runs `request` `count` times and pairs each client latency with the server's
+// handling time for the requests it issued.
+ScenarioResult runScenario(const std::string& name, MockLLMServer& server, int count,
+                           const std::function<int()>& request) {
+    ScenarioResult result;
+    result.name = name;
+    server.resetStats();
+
+    std::vector<std::pair<size_t, size_t>> server_ranges;  // Server request indices per iteration
+    auto wall_start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < count; ++i) {
+        size_t before = server.requestCount();
+        auto start = std::chrono::steady_clock::now();
+        int errors = request();
+        double elapsed_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+
+        result.latencies_ms.push_back(elapsed_ms);
+        result.errors += static_cast<size_t>(errors);
+        server_ranges.emplace_back(before, server.requestCount());
+    }
+
+    result.wall_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wall_start).count();
+
+    std::vector<double> handling = server.handlingTimesUs();
+    for (size_t i = 0; i < server_ranges.size(); ++i) {
+        double server_ms = 0.0;
+        for (size_t r = server_ranges[i].first; r < server_ranges[i].second && r < handling.size(); ++r) {
+            server_ms += handling[r] / 1000.0;
+        }
+        result.overheads_ms.push_back(std::max(0.0, result.latencies_ms[i] - server_ms));
+        result.requests += server_ranges[i].second - server_ranges[i].first;
+    }
+
+    return result;
+}
+
+void printResult(const ScenarioResult& result) {
+    double throughput = result.wall_seconds > 0.0 ? result.requests / result.wall_seconds : 0.0;
+    std::cout << std::left << std::setw(22) << result.name << std::right << std::fixed
+              << std::setprecision(3)
+              << std::setw(8) << result.requests
+              << std::setw(7) << result.errors
+              << std::setw(10) << throughput
+              << std::setw(10) << percentile(result.latencies_ms, 0.50)
+              << std::setw(10) << percentile(result.latencies_ms, 0.90)
+              << std::setw(10) << percentile(result.latencies_ms, 0.99)
+              << std::setw(10) << mean(result.overheads_ms)
+              << std::setw(10) << percentile(result.overheads_ms, 0.99)
+              << std::endl;
+}
+
+nlohmann::json resultToJson(const ScenarioResult& result) {
+    return {
+        {"scenario", result.name},
+        {"requests", result.requests},
+        {"errors", result.errors},
+        {"throughput_rps", result.wall_seconds > 0.0 ? result.requests / result.wall_seconds : 0.0},
+        {"latency_ms", {
+            {"mean", mean(result.latencies_ms)},
+            {"p50", percentile(result.latencies_ms, 0.50)},
+            {"p90", percentile(result.latencies_ms, 0.90)},
+            {"p99", percentile(result.latencies_ms, 0.99)},
+            {"max", percentile(result.latencies_ms, 1.0)}
+        }},
+        {"client_overhead_ms", {
+            {"mean", mean(result.overheads_ms)},
+            {"p50", percentile(result.overheads_ms, 0.50)},
+            {"p99", percentile(result.overheads_ms, 0.99)}
+        }}
+    };
+}
+
+bool parseArgs(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+
+        if (arg == "--iterations") options.iterations = std::atoi(next());
+        else if (arg == "--latency") options.latency_ms = std::atoi(next());
+        else if (arg == "--jitter") options.jitter_ms = std::atoi(next());
+        else if (arg == "--chunked") options.chunked = true;
+        else if (arg == "--chunk-size") options.chunk_size = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--error-rate") options.error_rate = std::atof(next());
+        else if (arg == "--prompt-kb") options.prompt_kb = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--response-kb") options.response_kb = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--turns") options.session_turns = std::atoi(next());
+        else if (arg == "--history-budget") options.history_budget = std::atoi(next());
+        else if (arg == "--scenario") options.scenario = next();
+        else if (arg == "--json") options.json_output = true;
+        else if (arg == "--phases") options.phases = true;
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        return 1;
+    }
+
+    // Keep benchmark sessions out of the user's ~/.clion directory
+    std::filesystem::path bench_home = std::filesystem::temp_directory_path() / "clion_llm_benchmark";
+    std::filesystem::remove_all(bench_home);
+    std::filesystem::create_directories(bench_home);
+    setenv("HOME", bench_home.c_str(), 1);
+
+    if (options.phases) {
+        Telemetry::enable();
+    }
+
+    MockServerOptions server_options;
+    server_options.latency_ms = options.latency_ms;
+    server_options.latency_jitter_ms = options.jitter_ms;
+    server_options.chunked = options.chunked;
+    server_options.chunk_size = options.chunk_size;
+    server_options.error_rate = options.error_rate;
+    server_options.response_content = makeText(options.response_kb * 1024,
+                                               "The fix is to include <vector> before use. ");
+
+    MockLLMServer server(server_options);
+    if (!server.start()) {
+        std::cerr << "Failed to start mock server" << std::endl;
+        return 1;
+    }
+
+    const std::string prompt = makeText(options.prompt_kb * 1024,
+                                        "Explain why this template fails to compile: std::vector<T> v; ");
+    const std::string system_instruction = makeText(2048, "You are CLion, a C++ assistant. ");
+    auto wants = [&](const std::string& name) {
+        return options.scenario == "all" || options.scenario == name;
+    };
+
+    std::vector<ScenarioResult> results;
+
+    if (wants("openai")) {
+        LLMClient client;
+        client.initialize(makeConfig(LLMProvider::CUSTOM, server.openAIEndpoint()));
+        results.push_back(runScenario("openai.sendRequest", server, options.iterations, [&]() {
+            return client.sendRequest(prompt, system_instruction).success ? 0 : 1;
+        }));
+    }
+
+    if (wants("gemini")) {
+        LLMClient client;
+        client.initialize(makeConfig(LLMProvider::GEMINI, server.geminiEndpoint()));
+        results.push_back(runScenario("gemini.sendRequest", server, options.iterations, [&]() {
+            return client.sendRequest(prompt, system_instruction).success ? 0 : 1;
+        }));
+    }
+
+    if (wants("session")) {
+        LLMClient client;
+        client.initialize(makeConfig(LLMProvider::CUSTOM, server.openAIEndpoint()));
+        client.createNewSession();
+        results.push_back(runScenario("session.turn", server, options.session_turns, [&]() {
+            return client.sendRequestWithSession(prompt, "", system_instruction).success ? 0 : 1;
+        }));
+    }
+
+    if (wants("compact")) {
+        LLMConfig config = makeConfig(LLMProvider::CUSTOM, server.openAIEndpoint());
+        config.history_token_budget = options.history_budget;
+        LLMClient client;
+        client.initialize(config);
+        client.createNewSession();
+        results.push_back(runScenario("session.compact", server, options.session_turns, [&]() {
+            return client.sendRequestWithSession(prompt, "", system_instruction).success ? 0 : 1;
+        }));
+    }
+
+    if (wants("scaffold")) {
+        // Mirrors `clion scaffold`: one structure request, then one request per file
+        const int files_per_project = 5;
+        nlohmann::json structure;
+        for (int i = 0; i < files_per_project; ++i) {
+            structure["src/module_" + std::to_string(i) + ".cpp"] = "Implementation of module " + std::to_string(i);
+        }
+
+        LLMClient client;
+        client.initialize(makeConfig(LLMProvider::CUSTOM, server.openAIEndpoint()));
+        int projects = std::max(1, options.iterations / (files_per_project + 1));
+        results.push_back(runScenario("scaffold.flow", server, projects, [&]() {
+            MockServerOptions structure_options = server_options;
+            structure_options.response_content = structure.dump();
+            server.setOptions(structure_options);
+
+            int errors = 0;
+            auto response = client.sendRequest("Scaffold a CMake project. Prompt: " + prompt);
+            server.setOptions(server_options);
+            if (!response.success) {
+                return 1;
+            }
+
+            auto files = nlohmann::json::parse(response.content);
+            for (auto& [file_path, description] : files.items()) {
+                auto file_response = client.sendRequest("Generate the code for the file '" + file_path +
+                                                        "'. The file's purpose is: " +
+                                                        description.get<std::string>());
+                errors += file_response.success ? 0 : 1;
+            }
+            return errors;
+        }));
+    }
+
+    if (wants("fix")) {
+        // Mirrors one `clion fix` iteration: compiler output plus rules as system instruction
+        const std::string build_output = makeText(options.prompt_kb * 1024,
+            "src/main.cpp:42:13: error: 'vector' was not declared in this scope\n");
+        LLMClient client;
+        client.initialize(makeConfig(LLMProvider::CUSTOM, server.openAIEndpoint()));
+        results.push_back(runScenario("fix.iteration", server, options.iterations, [&]() {
+            std::string fix_prompt = "The following command failed. Please provide a fix.\n\nError Details:\n" +
+                                     build_output + "\nPlease provide a targeted fix.";
+            return client.sendRequest(fix_prompt, system_instruction).success ? 0 : 1;
+        }));
+    }
+
+    if (wants("router")) {
+        // Primary is slow; the hedge to the second provider should cap tail latency
+        MockServerOptions slow_options = server_options;
+        slow_options.latency_ms = options.latency_ms + 200;
+        MockLLMServer slow_server(slow_options);
+        slow_server.start();
+
+        RouterConfig router_config;
+        router_config.providers = {
+            makeConfig(LLMProvider::CUSTOM, slow_server.openAIEndpoint()),
+            makeConfig(LLMProvider::CUSTOM, server.openAIEndpoint())
+        };
+        router_config.hedge_delay_ms = 50;
+        LLMRouter router;
+        router.initialize(router_config);
+        results.push_back(runScenario("router.hedged", server, options.iterations / 4 + 1, [&]() {
+            return router.sendRequest(prompt, system_instruction).success ? 0 : 1;
+        }));
+    }
+
+    server.stop();
+
+    if (options.json_output) {
+        nlohmann::json output = nlohmann::json::array();
+        for (const auto& result : results) {
+            output.push_back(resultToJson(result));
+        }
+        if (options.phases) {
+            output = {{"scenarios", output}, {"telemetry", nlohmann::json::parse(Telemetry::getSnapshotJson())}};
+        }
+        std::cout << output.dump(2) << std::endl;
+    } else {
+        std::cout << std::left << std::setw(22) << "scenario" << std::right
+                  << std::setw(8) << "reqs" << std::setw(7) << "errs"
+                  << std::setw(10) << "req/s" << std::setw(10) << "p50 ms"
+                  << std::setw(10) << "p90 ms" << std::setw(10) << "p99 ms"
+                  << std::setw(10) << "ovh ms" << std::setw(10) << "ovh p99" << std::endl;
+        for (const auto& result : results) {
+            printResult(result);
+        }
+
+        if (options.phases) {
+            TelemetrySnapshot snapshot = Telemetry::getSnapshot();
+            std::cout << std::endl << std::left << std::setw(22) << "phase" << std::right
+                      << std::setw(10) << "mean ms" << std::setw(10) << "p50 ms"
+                      << std::setw(10) << "p95 ms" << std::setw(10) << "max ms" << std::endl;
+            for (const auto& phase : snapshot.phases) {
+                double mean = phase.count > 0 ? phase.total_ms / phase.count : 0.0;
+                std::cout << std::left << std::setw(22) << phase.phase << std::right << std::fixed
+                          << std::setprecision(3) << std::setw(10) << mean << std::setw(10) << phase.p50_ms
+                          << std::setw(10) << phase.p95_ms << std::setw(10) << phase.max_ms << std::endl;
+            }
+        }
+    }
+
+    std::filesystem::remove_all(bench_home);
+    return 0;
+}
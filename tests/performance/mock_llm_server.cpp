@@ -0,0 +1,324 @@
+#include "mock_llm_server.h"
+#include <nlohmann/json.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+using json = nlohmann::json;
+
+namespace clion {
+namespace bench {
+
+namespace {
+    bool sendAll(int fd, const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t sent = ::send(fd, data, length, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                return false;
+            }
+            data += sent;
+            length -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    const char* statusText(int status) {
+        switch (status) {
+            case 200: return "OK";
+            case 400: return "Bad Request";
+            case 429: return "Too Many Requests";
+            case 500: return "Internal Server Error";
+            case 503: return "Service Unavailable";
+            default: return "Error";
+        }
+    }
+
+    // Rough token estimate so usage numbers scale with the payload
+    int estimateTokens(size_t bytes) {
+        return static_cast<int>((bytes + 3) / 4);
+    }
+}
+
+MockLLMServer::MockLLMServer(const MockServerOptions& options)
+    : options_(options), listen_fd_(-1), port_(0), running_(false),
+      request_count_(0), bytes_received_(0) {}
+
+MockLLMServer::~MockLLMServer() {
+    stop();
+}
+
+bool MockLLMServer::start() {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        return false;
+    }
+
+    int reuse = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(options_.port));
+
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listen_fd_, 64) < 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    socklen_t addr_len = sizeof(addr);
+    ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    port_ = ntohs(addr.sin_port);
+
+    running_ = true;
+    accept_thread_ = std::thread(&MockLLMServer::acceptLoop, this);
+    return true;
+}
+
+void MockLLMServer::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    ::shutdown(listen_fd_, SHUT_RDWR);
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+    if (accept_thread_.joinable()) {
+        accept_thread_.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int fd : connection_fds_) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+    for (auto& thread : connection_threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    connection_threads_.clear();
+    connection_fds_.clear();
+}
+
+std::string MockLLMServer::openAIEndpoint() const {
+    return "http://127.0.0.1:" + std::to_string(port_) + "/v1/chat/completions";
+}
+
+std::string MockLLMServer::geminiEndpoint() const {
+    return "http://127.0.0.1:" + std::to_string(port_) + "/v1beta/models/gemini-pro:generateContent";
+}
+
+void MockLLMServer::setOptions(const MockServerOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int port = options_.port;
+    options_ = options;
+    options_.port = port;
+}
+
+MockServerOptions MockLLMServer::getOptions() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return options_;
+}
+
+std::vector<double> MockLLMServer::handlingTimesUs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return handling_times_us_;
+}
+
+void MockLLMServer::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handling_times_us_.clear();
+    request_count_ = 0;
+    bytes_received_ = 0;
+}
+
+void MockLLMServer::acceptLoop() {
+    while (running_) {
+        int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            continue;  // Listen socket closed by stop(), or a transient error
+        }
+
+        int nodelay = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_fds_.push_back(fd);
+        connection_threads_.emplace_back(&MockLLMServer::serveConnection, this, fd);
+    }
+}
+
+void MockLLMServer::serveConnection(int fd) {
+    std::string buffer;
+    char chunk[16384];
+    std::mt19937 rng(static_cast<unsigned>(fd) * 7919u);
+
+    while (running_) {
+        // Read request head
+        size_t header_end;
+        while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                closeConnection(fd);
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        std::string head = buffer.substr(0, header_end);
+        std::string lower_head = head;
+        std::transform(lower_head.begin(), lower_head.end(), lower_head.begin(), ::tolower);
+
+        size_t content_length = 0;
+        size_t cl_pos = lower_head.find("content-length:");
+        if (cl_pos != std::string::npos) {
+            content_length = std::strtoul(head.c_str() + cl_pos + 15, nullptr, 10);
+        }
+        bool expects_continue = lower_head.find("expect: 100-continue") != std::string::npos;
+        if (expects_continue) {
+            const char continue_line[] = "HTTP/1.1 100 Continue\r\n\r\n";
+            sendAll(fd, continue_line, sizeof(continue_line) - 1);
+        }
+
+        // Read request body
+        size_t body_start = header_end + 4;
+        while (buffer.size() < body_start + content_length) {
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                closeConnection(fd);
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+        std::string body = buffer.substr(body_start, content_length);
+        buffer.erase(0, body_start + content_length);
+
+        size_t path_start = head.find(' ') + 1;
+        std::string path = head.substr(path_start, head.find(' ', path_start) - path_start);
+
+        MockServerOptions options = getOptions();
+        request_count_++;
+        bytes_received_ += head.size() + content_length;
+
+        int delay = options.latency_ms;
+        if (options.latency_jitter_ms > 0) {
+            delay += std::uniform_int_distribution<int>(0, options.latency_jitter_ms)(rng);
+        }
+        if (delay > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+        }
+
+        int status = 200;
+        std::string response_body;
+        if (options.error_rate > 0.0 &&
+            std::uniform_real_distribution<double>(0.0, 1.0)(rng) < options.error_rate) {
+            status = options.error_status;
+            response_body = json{{"error", {{"message", "Injected failure"}, {"code", status}}}}.dump();
+        } else {
+            response_body = buildBody(path, body);
+        }
+
+        std::string header = "HTTP/1.1 " + std::to_string(status) + " " + statusText(status) + "\r\n";
+        header += "Content-Type: application/json\r\n";
+        header += "Connection: keep-alive\r\n";
+
+        bool ok;
+        if (options.chunked) {
+            header += "Transfer-Encoding: chunked\r\n\r\n";
+            ok = sendAll(fd, header.data(), header.size());
+            size_t chunk_size = std::max<size_t>(1, options.chunk_size);
+            for (size_t offset = 0; ok && offset < response_body.size(); offset += chunk_size) {
+                size_t length = std::min(chunk_size, response_body.size() - offset);
+                char size_line[32];
+                int size_len = std::snprintf(size_line, sizeof(size_line), "%zx\r\n", length);
+                ok = sendAll(fd, size_line, static_cast<size_t>(size_len)) &&
+                     sendAll(fd, response_body.data() + offset, length) &&
+                     sendAll(fd, "\r\n", 2);
+                if (options.chunk_delay_ms > 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(options.chunk_delay_ms));
+                }
+            }
+            ok = ok && sendAll(fd, "0\r\n\r\n", 5);
+        } else {
+            header += "Content-Length: " + std::to_string(response_body.size()) + "\r\n\r\n";
+            ok = sendAll(fd, header.data(), header.size()) &&
+                 sendAll(fd, response_body.data(), response_body.size());
+        }
+
+        double elapsed_us = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started).count();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            handling_times_us_.push_back(elapsed_us);
+        }
+
+        if (!ok) {
+            break;
+        }
+    }
+
+    closeConnection(fd);
+}
+
+void MockLLMServer::closeConnection(int fd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connection_fds_.erase(std::remove(connection_fds_.begin(), connection_fds_.end(), fd),
+                          connection_fds_.end());
+    ::close(fd);
+}
+
+std::string MockLLMServer::buildBody(const std::string& path, const std::string& request_body) const {
+    MockServerOptions options = getOptions();
+    int prompt_tokens = estimateTokens(request_body.size());
+    int completion_tokens = estimateTokens(options.response_content.size());
+
+    if (path.find(":generateContent") != std::string::npos) {
+        json body = {
+            {"candidates", json::array({
+                {
+                    {"content", {{"role", "model"}, {"parts", json::array({{{"text", options.response_content}}})}}},
+                    {"finishReason", "STOP"}
+                }
+            })},
+            {"usageMetadata", {
+                {"promptTokenCount", prompt_tokens},
+                {"candidatesTokenCount", completion_tokens},
+                {"totalTokenCount", prompt_tokens + completion_tokens}
+            }}
+        };
+        return body.dump();
+    }
+
+    json body = {
+        {"id", "chatcmpl-mock"},
+        {"object", "chat.completion"},
+        {"model", "mock-model"},
+        {"choices", json::array({
+            {
+                {"index", 0},
+                {"message", {{"role", "assistant"}, {"content", options.response_content}}},
+                {"finish_reason", "stop"}
+            }
+        })},
+        {"usage", {
+            {"prompt_tokens", prompt_tokens},
+            {"completion_tokens", completion_tokens},
+            {"total_tokens", prompt_tokens + completion_tokens}
+        }}
+    };
+    return body.dump();
+}
+
+} // namespace bench
+} // namespace clion
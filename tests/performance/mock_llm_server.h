@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace clion {
+namespace bench {
+
+struct MockServerOptions {
+    int port = 0;                       // 0 picks a free port
+    int latency_ms = 0;                 // Delay before the response is sent
+    int latency_jitter_ms = 0;          // Uniform random extra delay
+    bool chunked = false;               // Send the body with Transfer-Encoding: chunked
+    size_t chunk_size = 512;
+    int chunk_delay_ms = 0;             // Delay between chunks
+    double error_rate = 0.0;            // Fraction of requests answered with error_status
+    int error_status = 500;
+    std::string response_content = "Hello from the mock LLM server.";
+};
+
+// Minimal HTTP/1.1 server that answers OpenAI-compatible chat completions and
+// Gemini generateContent requests. Requests whose path contains
+// ":generateContent" get a Gemini-shaped body, everything else gets the
+// OpenAI shape. Connections are kept alive so CURL handle reuse is measured.
+class MockLLMServer {
+public:
+    explicit MockLLMServer(const MockServerOptions& options = {});
+    ~MockLLMServer();
+
+    bool start();
+    void stop();
+
+    int port() const { return port_; }
+    std::string openAIEndpoint() const;
+    std::string geminiEndpoint() const;
+
+    void setOptions(const MockServerOptions& options);
+    MockServerOptions getOptions() const;
+
+    size_t requestCount() const { return request_count_.load(); }
+    size_t bytesReceived() const { return bytes_received_.load(); }
+
+    // Server-side handling time of each request, in microseconds, in arrival order
+    std::vector<double> handlingTimesUs() const;
+    void resetStats();
+
+private:
+    MockServerOptions options_;
+    mutable std::mutex mutex_;
+    int listen_fd_;
+    int port_;
+    std::atomic<bool> running_;
+    std::thread accept_thread_;
+    std::vector<std::thread> connection_threads_;
+    std::vector<int> connection_fds_;
+    std::atomic<size_t> request_count_;
+    std::atomic<size_t> bytes_received_;
+    std::vector<double> handling_times_us_;
+
+    void acceptLoop();
+    void serveConnection(int fd);
+    void closeConnection(int fd);
+    std::string buildBody(const std::string& path, const std::string& request_body) const;
+};
+
+} // namespace bench
+} // namespace clion
@@ -0,0 +1,342 @@
+// Storage benchmark for SessionManager: bytes on disk, save/load time and
+// the time to read every entry's content per session, as JSON and in the
+// binary format, each plain, zstd-compressed, and zstd-compressed with a
+// dictionary trained on the sessions; then the cost of adding one turn to
+// an existing session, which appends to its journal, of listing and
+// filtering sessions from the catalog, of searching their content through
+// the index against a regex scan of every session, of a nearest-neighbour
+// query over every turn in the vector index, and of hierarchy operations
+// with and without the in-memory session cache.
+//
+// Usage: clion_session_benchmark [--sessions N] [--turns N] [--entry-kb KB]
+//
+// Sessions are written to a temporary HOME and removed afterwards. Loads
+// are checked against what was saved; a mismatch exits with status 1.
+
+#include "llm/session.h"
+#include "llm/session_cache.h"
+#include "llm/session_catalog.h"
+#include "llm/session_format.h"
+#include "llm/session_index.h"
+#include "utils/compression.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using clion::llm::HistoryEntry;
+using clion::llm::SemanticIndex;
+using clion::llm::SessionCatalog;
+using clion::llm::SessionIndex;
+using clion::llm::Session;
+using clion::llm::SessionCache;
+using clion::llm::SessionFormat;
+using clion::llm::SessionManager;
+using clion::llm::SessionView;
+using clion::utils::Compression;
+
+namespace {
+
+struct BenchOptions {
+    size_t sessions = 200;
+    size_t turns = 20;
+    size_t entry_kb = 2;
+};
+
+const char* const SNIPPETS[] = {
+    "Can you refactor this function so it does not copy the vector?\n",
+    "std::vector<std::string> lines = TextKernels::splitLines(content);\n",
+    "for (const auto& entry : session.entries) {\n    total += entry.token_count;\n}\n",
+    "The error comes from the missing include; add <optional> to the header.\n",
+    "if (!session_opt) {\n    return false;\n}\n",
+    "Here is the updated implementation with the lock held only around the map lookup:\n",
+    "```cpp\nauto it = cache.find(key);\nif (it != cache.end()) {\n    return it->second;\n}\n```\n",
+    "error: no matching function for call to 'parse(std::string&)'\n",
+    "I also renamed the helper to match the rest of the file and kept the public API unchanged.\n",
+    "    size_t pos = text.find('\\n', start);\n",
+};
+
+std::string makeEntry(std::mt19937& rng, size_t bytes) {
+    std::uniform_int_distribution<size_t> pick(0, std::size(SNIPPETS) - 1);
+    std::uniform_int_distribution<int> number(0, 9999);
+    std::string text;
+    while (text.size() < bytes) {
+        text += SNIPPETS[pick(rng)];
+        // Identifiers and numbers that differ between entries, as real code does
+        text += "// ref " + std::to_string(number(rng)) + "\n";
+    }
+    return text;
+}
+
+std::vector<Session> makeSessions(const BenchOptions& options) {
+    std::mt19937 rng(42);
+    std::vector<Session> sessions;
+    for (size_t i = 0; i < options.sessions; ++i) {
+        Session session;
+        session.id = "bench_session_" + std::to_string(i);
+        session.created_at = "2026-01-01T00:00:00.000Z";
+        session.updated_at = session.created_at;
+        session.name = "Benchmark session " + std::to_string(i);
+        session.tags = {"benchmark", i % 2 ? "odd" : "even"};
+        for (size_t t = 0; t < options.turns; ++t) {
+            HistoryEntry entry;
+            entry.role = t % 2 ? "assistant" : "user";
+            entry.content = makeEntry(rng, options.entry_kb * 1024);
+            entry.timestamp = session.created_at;
+            session.entries.push_back(std::move(entry));
+        }
+        sessions.push_back(std::move(session));
+    }
+    return sessions;
+}
+
+size_t directoryBytes(const std::filesystem::path& directory) {
+    size_t total = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") {
+            total += entry.file_size();
+        }
+    }
+    return total;
+}
+
+// Every mode starts from an empty directory (dictionaries are kept), so
+// saves do not pay for overwriting the previous mode's files
+void removeSessionFiles(const std::filesystem::path& directory) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Reads every entry's content, in place where the file allows it; returns
+// the bytes read
+size_t scanContents(const std::string& session_id) {
+    size_t bytes = 0;
+    SessionView view;
+    if (SessionManager::openSessionView(session_id, view)) {
+        std::string buffer;
+        for (size_t i = 0; i < view.entryCount(); ++i) {
+            if (auto content = view.content(i, buffer)) {
+                bytes += content->size();
+            }
+        }
+        return bytes;
+    }
+    if (auto session = SessionManager::loadSession(session_id)) {
+        for (const auto& entry : session->entries) {
+            bytes += entry.content.size();
+        }
+    }
+    return bytes;
+}
+
+// Saves every session, then loads every session and reads every session's
+// content; false on a mismatch
+bool runMode(const std::string& mode, std::vector<Session>& sessions, SessionFormat format, bool compressed,
+             const std::filesystem::path& session_dir, size_t raw_bytes) {
+    removeSessionFiles(session_dir);
+    SessionManager::setStorageFormat(format);
+    auto start = std::chrono::steady_clock::now();
+    for (auto& session : sessions) {
+        session.is_compressed = compressed;
+        SessionManager::saveSession(session);
+    }
+    double save_ms = millisecondsSince(start);
+
+    bool ok = true;
+    start = std::chrono::steady_clock::now();
+    for (const auto& session : sessions) {
+        auto loaded = SessionManager::loadSession(session.id);
+        if (!loaded || loaded->entries.size() != session.entries.size() ||
+            loaded->entries.back().content != session.entries.back().content) {
+            ok = false;
+        }
+    }
+    double load_ms = millisecondsSince(start);
+
+    size_t scanned = 0;
+    start = std::chrono::steady_clock::now();
+    for (const auto& session : sessions) {
+        scanned += scanContents(session.id);
+    }
+    double scan_ms = millisecondsSince(start);
+    ok = scanned == raw_bytes && ok;
+
+    size_t disk_bytes = directoryBytes(session_dir);
+    std::cout << std::left << std::setw(12) << mode << std::right << std::fixed
+              << std::setw(12) << std::setprecision(2) << disk_bytes / (1024.0 * 1024.0)
+              << std::setw(10) << std::setprecision(2) << static_cast<double>(raw_bytes) / disk_bytes
+              << std::setw(12) << std::setprecision(3) << save_ms / sessions.size()
+              << std::setw(12) << load_ms / sessions.size()
+              << std::setw(12) << scan_ms / sessions.size()
+              << (ok ? "" : "   MISMATCH") << std::endl;
+    return ok;
+}
+
+// Chains up to 100 sessions from `first` on parent to child, then walks the
+// chain from the last one; false if the walk does not find every ancestor
+bool runHierarchy(const std::string& mode, const std::vector<Session>& sessions, size_t first) {
+    first = std::min(first, sessions.size() - 1);
+    size_t count = std::min<size_t>(100, sessions.size() - first);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = first + 1; i < first + count; ++i) {
+        SessionManager::setParentSession(sessions[i].id, sessions[i - 1].id);
+    }
+    double parent_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    size_t depth = SessionManager::getSessionHierarchy(sessions[first + count - 1].id).size();
+    double walk_ms = millisecondsSince(start);
+    std::cout << "hierarchy (" << mode << "): set parent " << parent_ms / std::max<size_t>(1, count - 1)
+              << " ms per call; walk " << depth << " levels: " << walk_ms << " ms" << std::endl;
+    return depth == count;
+}
+
+bool parseArgs(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+
+        if (arg == "--sessions") options.sessions = std::max<size_t>(1, std::strtoul(next(), nullptr, 10));
+        else if (arg == "--turns") options.turns = std::max<size_t>(1, std::strtoul(next(), nullptr, 10));
+        else if (arg == "--entry-kb") options.entry_kb = std::max<size_t>(1, std::strtoul(next(), nullptr, 10));
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        return 1;
+    }
+
+    // Keep benchmark sessions out of the user's ~/.clion directory
+    std::filesystem::path bench_home = std::filesystem::temp_directory_path() / "clion_session_benchmark";
+    std::filesystem::remove_all(bench_home);
+    std::filesystem::create_directories(bench_home);
+    setenv("HOME", bench_home.c_str(), 1);
+    std::filesystem::path session_dir = bench_home / ".clion" / "sessions";
+
+    // Loads are timed reading the files; the cache is turned on for the
+    // hierarchy operations at the end
+    SessionCache::setCapacity(0);
+
+    std::vector<Session> sessions = makeSessions(options);
+    size_t raw_bytes = 0;
+    for (const auto& session : sessions) {
+        for (const auto& entry : session.entries) {
+            raw_bytes += entry.content.size();
+        }
+    }
+    std::cout << sessions.size() << " sessions x " << options.turns << " turns, "
+              << raw_bytes / (1024 * 1024) << " MB of content" << std::endl << std::endl;
+    std::cout << std::left << std::setw(12) << "mode" << std::right
+              << std::setw(12) << "disk MB" << std::setw(10) << "ratio"
+              << std::setw(12) << "save ms" << std::setw(12) << "load ms"
+              << std::setw(12) << "scan ms" << std::endl;
+
+    // Dictionaries are trained on the files of the format they are used with
+    bool ok = true;
+    for (SessionFormat format : {SessionFormat::JSON, SessionFormat::BINARY}) {
+        std::string name = format == SessionFormat::JSON ? "json" : "binary";
+        ok = runMode(name, sessions, format, false, session_dir, raw_bytes) && ok;
+        if (!Compression::isAvailable()) {
+            std::cout << "(built without zstd)" << std::endl;
+            continue;
+        }
+        ok = runMode(name + "+zstd", sessions, format, true, session_dir, raw_bytes) && ok;
+        if (SessionManager::trainCompressionDictionary()) {
+            ok = runMode(name + "+dict", sessions, format, true, session_dir, raw_bytes) && ok;
+        } else {
+            std::cout << "(dictionary training failed; need at least 8 sessions)" << std::endl;
+        }
+    }
+
+    // A turn appends to the journal, so it costs the same whatever the
+    // session size; compaction rewrites are amortized over the appends
+    std::string turn(options.entry_kb * 1024, 'x');
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& session : sessions) {
+        ok = SessionManager::addEntryToSession(session.id, "user", turn) && ok;
+    }
+    std::cout << std::endl << "add entry: " << std::setprecision(3)
+              << millisecondsSince(start) / sessions.size() << " ms per turn" << std::endl;
+
+    // Listing and metadata filters read the catalog; opening another
+    // directory drops the loaded copy, so the first listing reads the file
+    SessionCatalog::open(bench_home.string());
+    start = std::chrono::steady_clock::now();
+    size_t listed = SessionManager::listSessions().size();
+    double cold_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    SessionManager::listSessions();
+    double warm_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    size_t tagged = SessionManager::findSessionsByTag("odd").size();
+    double tag_ms = millisecondsSince(start);
+    ok = listed == sessions.size() && tagged == sessions.size() / 2 && ok;
+    std::cout << "list " << listed << " sessions: " << cold_ms << " ms cold, " << warm_ms
+              << " ms warm; filter by tag: " << tag_ms << " ms" << std::endl;
+
+    // Every session has a few hundred of the 10000 "ref" numbers, so a
+    // number matches a few percent of them; the phrase is checked against
+    // the candidates' text, and the regex has to read every session
+    SessionIndex::open(bench_home.string());
+    start = std::chrono::steady_clock::now();
+    size_t word_hits = SessionManager::searchSessionContent("1234", 0).size();
+    double word_cold_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    SessionManager::searchSessionContent("1234", 0);
+    double word_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    size_t phrase_hits = SessionManager::searchSessionContent("\"ref 1234\"", 0).size();
+    double phrase_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    size_t scan_hits = SessionManager::findSessionsByContent("ref 123[4]").size();
+    double scan_ms = millisecondsSince(start);
+    ok = word_hits > 0 && phrase_hits == scan_hits && ok;
+    std::cout << "search word: " << word_cold_ms << " ms cold, " << word_ms << " ms warm (" << word_hits
+              << " sessions); phrase: " << phrase_ms << " ms (" << phrase_hits << "); regex scan: "
+              << scan_ms << " ms (" << scan_hits << ")" << std::endl;
+
+    // Any turn is as near as another here; this measures the query, over
+    // lists once there are enough turns and over every turn before that
+    start = std::chrono::steady_clock::now();
+    size_t similar_hits = SessionManager::searchSimilar("ref 1234 value", 10).size();
+    double similar_cold_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    SessionManager::searchSimilar("ref 1234 value", 10);
+    double similar_ms = millisecondsSince(start);
+    ok = similar_hits > 0 && ok;
+    std::cout << "similar turns: " << similar_cold_ms << " ms cold, " << similar_ms << " ms warm ("
+              << SemanticIndex::size() << " vectors)" << std::endl;
+
+    // Without the cache every call parses the sessions it touches; either
+    // way a call writes each session it changes once
+    ok = runHierarchy("no cache", sessions, 0) && ok;
+    SessionCache::setCapacity(64 * 1024 * 1024);
+    ok = runHierarchy("cached", sessions, 100) && ok;
+    auto cache_stats = SessionCache::getStats();
+    std::cout << "session cache: " << cache_stats.hits << " hits, " << cache_stats.misses << " misses, "
+              << cache_stats.entries << " sessions" << std::endl;
+
+    std::filesystem::remove_all(bench_home);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+// Microbenchmarks for TextKernels against the std::istringstream code they
+// replaced, for every implementation the CPU supports.
+//
+// Usage: clion_text_kernels_benchmark [--input FILE] [--size-mb N] [--iterations N]
+//
+// Results of each implementation are compared with the stream baseline and a
+// mismatch makes the benchmark exit with status 1.
+
+#include "utils/text_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using clion::utils::TextKernels;
+
+namespace {
+
+struct BenchOptions {
+    std::string input_path;
+    size_t size_mb = 16;
+    int iterations = 5;
+};
+
+const char* SAMPLE_TEXT = R"(// Formats a file for inclusion in the prompt
+std::string ContextBuilder::formatFile(const std::string& path, const ContextOptions& options) {
+    auto content_opt = utils::FileUtils::readFile(path);
+    if (!content_opt) {
+        throw FileException("Cannot read file: " + path);
+    }
+
+	for (size_t i = 0; i < lines.size(); ++i) {   // tab-indented
+        result += std::to_string(i + 1) + " | " + lines[i] + "\n";
+    }
+    return result;
+}
+
+Short prose also shows up in prompts: it's split on whitespace, and words
+longer than eight characters count extra.
+)";
+
+struct Counts {
+    size_t newlines = 0;
+    size_t lines = 0;
+    size_t line_bytes = 0;
+    size_t words = 0;
+    size_t word_bytes = 0;
+    size_t punctuation = 0;
+
+    bool operator==(const Counts& other) const {
+        return newlines == other.newlines && lines == other.lines && line_bytes == other.line_bytes &&
+               words == other.words && word_bytes == other.word_bytes && punctuation == other.punctuation;
+    }
+};
+
+double bestOf(int iterations, const std::function<void()>& work) {
+    double best = 1e9;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+double megabytesPerSecond(size_t bytes, double seconds) {
+    return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+void printRow(const std::string& implementation, const std::string& kernel, size_t bytes, double seconds) {
+    std::cout << std::left << std::setw(10) << implementation << std::setw(18) << kernel
+              << std::right << std::setw(10) << std::fixed << std::setprecision(1)
+              << megabytesPerSecond(bytes, seconds) << " MB/s" << std::endl;
+}
+
+bool parseArgs(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+
+        if (arg == "--input") options.input_path = next();
+        else if (arg == "--size-mb") options.size_mb = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--iterations") options.iterations = std::max(1, std::atoi(next()));
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        return 1;
+    }
+
+    std::string seed = SAMPLE_TEXT;
+    if (!options.input_path.empty()) {
+        std::ifstream file(options.input_path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Cannot read " << options.input_path << std::endl;
+            return 1;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        seed = buffer.str();
+    }
+    std::string text;
+    size_t target = std::max<size_t>(options.size_mb * 1024 * 1024, seed.size());
+    text.reserve(target + seed.size());
+    while (text.size() < target) {
+        text += seed;
+    }
+    std::cout << "Input: " << text.size() / 1024 << " KB, detected implementation: "
+              << TextKernels::getImplementation() << std::endl << std::endl;
+
+    // Baseline: what the hot paths did before
+    Counts expected;
+    double seconds = bestOf(options.iterations, [&]() {
+        expected = Counts();
+        std::istringstream stream(text);
+        std::string line;
+        while (std::getline(stream, line)) {
+            expected.lines++;
+            expected.line_bytes += line.size();
+        }
+    });
+    printRow("stream", "getline", text.size(), seconds);
+
+    seconds = bestOf(options.iterations, [&]() {
+        expected.words = 0;
+        expected.word_bytes = 0;
+        std::istringstream stream(text);
+        std::string word;
+        while (stream >> word) {
+            expected.words++;
+            expected.word_bytes += word.size();
+        }
+    });
+    printRow("stream", "operator>>", text.size(), seconds);
+
+    seconds = bestOf(options.iterations, [&]() {
+        expected.newlines = std::count(text.begin(), text.end(), '\n');
+        expected.punctuation = std::count_if(text.begin(), text.end(),
+                                             [](char c) { return std::ispunct(static_cast<unsigned char>(c)) != 0; });
+    });
+    printRow("std", "count+ispunct", text.size(), seconds);
+    std::cout << std::endl;
+
+    bool all_match = true;
+    for (const char* implementation : {"scalar", "sse2", "avx2"}) {
+        if (!TextKernels::setImplementation(implementation)) {
+            continue;
+        }
+        Counts actual;
+
+        seconds = bestOf(options.iterations, [&]() { actual.newlines = TextKernels::countByte(text, '\n'); });
+        printRow(implementation, "countByte", text.size(), seconds);
+
+        seconds = bestOf(options.iterations, [&]() {
+            actual.lines = 0;
+            actual.line_bytes = 0;
+            TextKernels::forEachLine(text, [&](std::string_view line) {
+                actual.lines++;
+                actual.line_bytes += line.size();
+            });
+        });
+        printRow(implementation, "forEachLine", text.size(), seconds);
+
+        seconds = bestOf(options.iterations, [&]() {
+            actual.words = 0;
+            actual.word_bytes = 0;
+            TextKernels::forEachWord(text, [&](std::string_view word) {
+                actual.words++;
+                actual.word_bytes += word.size();
+            });
+        });
+        printRow(implementation, "forEachWord", text.size(), seconds);
+
+        seconds = bestOf(options.iterations, [&]() { actual.punctuation = TextKernels::countPunctuation(text); });
+        printRow(implementation, "countPunctuation", text.size(), seconds);
+
+        if (!(actual == expected)) {
+            std::cout << "MISMATCH: " << implementation << " results differ from the stream baseline" << std::endl;
+            all_match = false;
+        }
+        std::cout << std::endl;
+    }
+
+    return all_match ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+// Throughput benchmark for token counting.
+//
+// Usage: clion_tokenizer_benchmark [--vocab FILE] [--input FILE] [--size-mb N]
+//                                  [--iterations N] [--heuristic-kb KB]
+//
+// Without --vocab the cl100k_base rank file is looked up the same way
+// TokenCounter does (CLION_TOKENIZER_DIR, then ~/.clion/tokenizers). Without
+// --input a mix of C++ source and prose is repeated up to --size-mb.
+
+#include "utils/bpe_tokenizer.h"
+#include "utils/token_cache.h"
+#include "utils/token_counter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using clion::utils::BpeTokenizer;
+using clion::utils::TokenCache;
+using clion::utils::TokenCounter;
+
+namespace {
+
+struct BenchOptions {
+    std::string vocab_path;
+    std::string input_path;
+    size_t size_mb = 8;
+    int iterations = 5;
+    size_t heuristic_kb = 1024;
+};
+
+const char* SAMPLE_TEXT = R"(Please refactor the session loader so that it doesn't re-read the whole
+file on every turn. It's called from the interactive loop, and we've seen
+latency spikes above 250 ms once a session grows past 1,000 entries.
+
+#include <filesystem>
+#include <vector>
+
+namespace clion {
+namespace llm {
+
+std::optional<Session> SessionManager::loadSession(const std::string& session_id) {
+    std::string session_file = getSessionFilePath(session_id);
+    if (!std::filesystem::exists(session_file)) {
+        return std::nullopt;
+    }
+    for (const auto& entry : session_json["history"]) {
+        session.history.push_back({entry["role"], entry["content"], entry["timestamp"]});
+    }
+    return session;   // NRVO, no copy
+}
+
+} // namespace llm
+} // namespace clion
+
+The answer should explain the trade-offs (memory vs. I/O) in 2-3 sentences.
+)";
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double megabytesPerSecond(size_t bytes, double seconds) {
+    return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+bool parseArgs(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+
+        if (arg == "--vocab") options.vocab_path = next();
+        else if (arg == "--input") options.input_path = next();
+        else if (arg == "--size-mb") options.size_mb = std::strtoul(next(), nullptr, 10);
+        else if (arg == "--iterations") options.iterations = std::max(1, std::atoi(next()));
+        else if (arg == "--heuristic-kb") options.heuristic_kb = std::strtoul(next(), nullptr, 10);
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        return 1;
+    }
+
+    std::string seed = SAMPLE_TEXT;
+    if (!options.input_path.empty()) {
+        std::ifstream file(options.input_path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Cannot read " << options.input_path << std::endl;
+            return 1;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        seed = buffer.str();
+    }
+    std::string text;
+    size_t target = std::max<size_t>(options.size_mb * 1024 * 1024, seed.size());
+    text.reserve(target + seed.size());
+    while (text.size() < target) {
+        text += seed;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Input: " << text.size() / 1024 << " KB" << std::endl;
+
+    std::shared_ptr<const BpeTokenizer> tokenizer;
+    auto load_start = std::chrono::steady_clock::now();
+    if (!options.vocab_path.empty()) {
+        auto loaded = std::make_shared<BpeTokenizer>();
+        if (loaded->loadFromFile(options.vocab_path)) {
+            tokenizer = loaded;
+        }
+    } else {
+        tokenizer = BpeTokenizer::forEncoding("cl100k_base");
+    }
+    double load_seconds = secondsSince(load_start);
+
+    if (tokenizer) {
+        std::cout << "Vocabulary: " << tokenizer->getName() << ", " << tokenizer->getVocabularySize()
+                  << " tokens, loaded in " << load_seconds * 1000.0 << " ms" << std::endl;
+
+        size_t tokens = 0;
+        double best = 1e9;
+        for (int i = 0; i < options.iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            tokens = tokenizer->countTokens(text);
+            best = std::min(best, secondsSince(start));
+        }
+        std::cout << "BPE countTokens: " << tokens << " tokens, "
+                  << megabytesPerSecond(text.size(), best) << " MB/s" << std::endl;
+
+        best = 1e9;
+        for (int i = 0; i < options.iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            tokens = tokenizer->encode(text).size();
+            best = std::min(best, secondsSince(start));
+        }
+        std::cout << "BPE encode:      " << tokens << " tokens, "
+                  << megabytesPerSecond(text.size(), best) << " MB/s" << std::endl;
+
+        // Chunk cache: the first pass fills it, later passes only hash
+        TokenCache::setPersistent(false);
+        TokenCache::clear();
+        size_t whole = tokenizer->countTokens(text);
+        auto start = std::chrono::steady_clock::now();
+        size_t cached = TokenCache::countTokens(text, *tokenizer);
+        double cold = secondsSince(start);
+        best = 1e9;
+        for (int i = 0; i < options.iterations; ++i) {
+            start = std::chrono::steady_clock::now();
+            cached = TokenCache::countTokens(text, *tokenizer);
+            best = std::min(best, secondsSince(start));
+        }
+        auto stats = TokenCache::getStats();
+        std::cout << "Cached count:    " << cached << " tokens, cold " << megabytesPerSecond(text.size(), cold)
+                  << " MB/s, warm " << megabytesPerSecond(text.size(), best) << " MB/s (" << stats.entries
+                  << " chunks)" << std::endl;
+        if (cached != whole) {
+            std::cout << "MISMATCH: chunked count " << cached << " != whole-text count " << whole << std::endl;
+            return 1;
+        }
+    } else {
+        std::cout << "No BPE vocabulary found; pass --vocab or install cl100k_base.tiktoken" << std::endl;
+    }
+
+    // The heuristic counter is much slower, so it runs once on a prefix
+    if (options.heuristic_kb > 0) {
+        std::string prefix = text.substr(0, std::min(text.size(), options.heuristic_kb * 1024));
+        auto start = std::chrono::steady_clock::now();
+        int tokens = TokenCounter::countTokens(prefix);
+        double seconds = secondsSince(start);
+        std::cout << "Heuristic countTokens (" << prefix.size() / 1024 << " KB): " << tokens << " tokens, "
+                  << megabytesPerSecond(prefix.size(), seconds) << " MB/s" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <string>
+
+namespace clion {
+namespace test {
+
+// Points HOME at a fresh directory for the lifetime of the object, so
+// sessions, indexes and ledgers written under ~/.clion stay out of the
+// developer's own. The directory is removed afterwards.
+class TempHome {
+public:
+    TempHome() {
+        std::random_device random;
+        path_ = std::filesystem::temp_directory_path() /
+                ("clion_test_" + std::to_string(random()) + std::to_string(random()));
+        std::filesystem::create_directories(path_);
+        if (const char* previous = std::getenv("HOME")) {
+            previous_ = previous;
+        }
+        setenv("HOME", path_.c_str(), 1);
+    }
+
+    ~TempHome() {
+        if (previous_) {
+            setenv("HOME", previous_->c_str(), 1);
+        } else {
+            unsetenv("HOME");
+        }
+        std::error_code ec;
+        std::filesystem::remove_all(path_, ec);
+    }
+
+    TempHome(const TempHome&) = delete;
+    TempHome& operator=(const TempHome&) = delete;
+
+    const std::filesystem::path& path() const { return path_; }
+    std::filesystem::path sessionDirectory() const { return path_ / ".clion" / "sessions"; }
+
+private:
+    std::filesystem::path path_;
+    std::optional<std::string> previous_;
+};
+
+} // namespace test
+} // namespace clion
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "temp_home.h"
+#include "utils/bpe_tokenizer.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+using clion::utils::BpeTokenizer;
+
+namespace {
+
+std::string base64(const std::string& bytes) {
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (unsigned char c : bytes) {
+        buffer = (buffer << 8) | c;
+        bits += 8;
+        while (bits >= 6) {
+            bits -= 6;
+            out.push_back(alphabet[(buffer >> bits) & 0x3F]);
+        }
+    }
+    if (bits > 0) {
+        out.push_back(alphabet[(buffer << (6 - bits)) & 0x3F]);
+    }
+    while (out.size() % 4 != 0) {
+        out.push_back('=');
+    }
+    return out;
+}
+
+// Every single byte, then `merges` in rank order
+BpeTokenizer loadTokenizer(const std::filesystem::path& directory, const std::string& encoding,
+                           const std::vector<std::string>& merges) {
+    std::filesystem::path path = directory / (encoding + ".tiktoken");
+    std::ofstream file(path);
+    int rank = 0;
+    for (int byte = 0; byte < 256; ++byte) {
+        file << base64(std::string(1, static_cast<char>(byte))) << " " << rank++ << "\n";
+    }
+    for (const auto& merge : merges) {
+        file << base64(merge) << " " << rank++ << "\n";
+    }
+    file.close();
+
+    BpeTokenizer tokenizer;
+    EXPECT_TRUE(tokenizer.loadFromFile(path.string()));
+    return tokenizer;
+}
+
+class BpeTokenizerTest : public ::testing::Test {
+protected:
+    clion::test::TempHome home;
+};
+
+} // namespace
+
+TEST_F(BpeTokenizerTest, MergesByLowestRank) {
+    auto tokenizer = loadTokenizer(home.path(), "cl100k_base", {"ab", "abc"});
+
+    EXPECT_EQ(tokenizer.getVocabularySize(), 258u);
+    EXPECT_EQ(tokenizer.encode("abc"), (std::vector<uint32_t>{257}));
+    EXPECT_EQ(tokenizer.countTokens("abd"), 2u);
+}
+
+TEST_F(BpeTokenizerTest, Cl100kKeepsMixedCaseWordsWhole) {
+    auto tokenizer = loadTokenizer(home.path(), "cl100k_base", {"aB"});
+
+    EXPECT_EQ(tokenizer.countTokens("aB"), 1u);
+}
+
+TEST_F(BpeTokenizerTest, O200kSplitsWordsWhereCaseChanges) {
+    auto tokenizer = loadTokenizer(home.path(), "o200k_base", {"aB"});
+
+    // "a" | "B": the merge never applies across the split
+    EXPECT_EQ(tokenizer.countTokens("aB"), 2u);
+}
+
+TEST_F(BpeTokenizerTest, ContractionsStayOnTheirWordOnlyInO200k) {
+    // "it's" is one piece for o200k, "it" + "'s" for cl100k
+    auto cl100k = loadTokenizer(home.path(), "cl100k_base", {"t'"});
+    auto o200k = loadTokenizer(home.path(), "o200k_base", {"t'"});
+
+    EXPECT_EQ(cl100k.countTokens("it's"), 4u);
+    EXPECT_EQ(o200k.countTokens("it's"), 3u);
+}
+
+TEST_F(BpeTokenizerTest, O200kEndsPunctuationRunsWithSlashes) {
+    auto cl100k = loadTokenizer(home.path(), "cl100k_base", {".\n", ".\n/"});
+    auto o200k = loadTokenizer(home.path(), "o200k_base", {".\n", ".\n/"});
+
+    // A slash after the run's newlines stays with it only for o200k
+    EXPECT_EQ(o200k.countTokens(".\n/"), 1u);
+    EXPECT_EQ(cl100k.countTokens(".\n/"), 2u);
+}
@@ -0,0 +1,31 @@
+#include <gtest/gtest.h>
+#include "cli/interrupt_handler.h"
+#include <csignal>
+
+using clion::cli::InterruptHandler;
+using clion::cli::ScopedInterruptCapture;
+
+TEST(InterruptHandlerTest, NestedCaptureKeepsOuterHandler) {
+    {
+        ScopedInterruptCapture outer;
+        ASSERT_TRUE(InterruptHandler::isInstalled());
+        {
+            ScopedInterruptCapture inner;
+        }
+        EXPECT_TRUE(InterruptHandler::isInstalled());
+    }
+    EXPECT_FALSE(InterruptHandler::isInstalled());
+}
+
+#ifndef _WIN32
+TEST(InterruptHandlerTest, InterruptAfterNestedCaptureIsCaught) {
+    ScopedInterruptCapture outer;
+    {
+        ScopedInterruptCapture inner;
+    }
+    // Would end the test run if the inner capture had restored the default
+    std::raise(SIGINT);
+    EXPECT_TRUE(InterruptHandler::consumeInterrupt());
+    EXPECT_FALSE(InterruptHandler::consumeInterrupt());
+}
+#endif
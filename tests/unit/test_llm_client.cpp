@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "performance/mock_llm_server.h"
+#include "temp_home.h"
+#include "llm/llm_client.h"
+#include "llm/session.h"
+#include <chrono>
+#include <thread>
+
+using clion::bench::MockLLMServer;
+using clion::bench::MockServerOptions;
+using namespace clion::llm;
+
+namespace {
+
+class LLMClientSessionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(server.start());
+        LLMConfig config;
+        config.provider = LLMProvider::CUSTOM;
+        config.api_key = "mock-key";
+        config.model = "gpt-4o-mini";
+        config.custom_endpoint = server.openAIEndpoint();
+        config.timeout_seconds = 10;
+        config.show_token_usage = false;
+        config.confirm_over_limit = false;
+        ASSERT_TRUE(client.initialize(config));
+        session_id = client.createNewSession();
+        ASSERT_FALSE(session_id.empty());
+    }
+
+    size_t entryCount() {
+        auto session = SessionManager::loadSession(session_id);
+        return session ? session->entries.size() : 0;
+    }
+
+    void setServer(int latency_ms, double error_rate) {
+        MockServerOptions options = server.getOptions();
+        options.latency_ms = latency_ms;
+        options.error_rate = error_rate;
+        server.setOptions(options);
+    }
+
+    clion::test::TempHome home;
+    MockLLMServer server;
+    LLMClient client;
+    std::string session_id;
+};
+
+} // namespace
+
+TEST_F(LLMClientSessionTest, SuccessfulRequestSavesBothTurns) {
+    LLMResponse response = client.sendRequestWithSession("hello", session_id);
+
+    ASSERT_TRUE(response.success) << response.error_message;
+    auto session = SessionManager::loadSession(session_id);
+    ASSERT_TRUE(session);
+    ASSERT_EQ(session->entries.size(), 2u);
+    EXPECT_EQ(session->entries[0].role, "user");
+    EXPECT_EQ(session->entries[0].content, "hello");
+    EXPECT_EQ(session->entries[1].role, "assistant");
+}
+
+TEST_F(LLMClientSessionTest, FailedRequestLeavesNoOrphanTurn) {
+    setServer(0, 1.0);
+
+    LLMResponse response = client.sendRequestWithSession("hello", session_id);
+
+    EXPECT_FALSE(response.success);
+    EXPECT_EQ(entryCount(), 0u);
+}
+
+TEST_F(LLMClientSessionTest, CancelledRequestLeavesNoOrphanTurn) {
+    setServer(2000, 0.0);
+    CancellationToken token;
+    std::thread canceller([token]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        token.cancel();
+    });
+
+    LLMResponse response = client.sendRequestWithSession("hello", session_id, "", -1.0f, token);
+    canceller.join();
+
+    EXPECT_FALSE(response.success);
+    EXPECT_TRUE(response.cancelled);
+    EXPECT_EQ(entryCount(), 0u);
+}
+
+TEST_F(LLMClientSessionTest, NextRequestAfterFailureSendsOnlyAnsweredTurns) {
+    setServer(0, 1.0);
+    client.sendRequestWithSession("lost", session_id);
+    setServer(0, 0.0);
+
+    LLMResponse response = client.sendRequestWithSession("kept", session_id);
+
+    ASSERT_TRUE(response.success) << response.error_message;
+    auto session = SessionManager::loadSession(session_id);
+    ASSERT_TRUE(session);
+    ASSERT_EQ(session->entries.size(), 2u);
+    EXPECT_EQ(session->entries[0].content, "kept");
+}
+
+TEST_F(LLMClientSessionTest, EntryAddedByAnotherWriterMidRequestIsNotLost) {
+    ASSERT_TRUE(client.sendRequestWithSession("first", session_id).success);
+
+    // Lands after the history was read but before this client appends its turn
+    setServer(300, 0.0);
+    std::thread other_writer([this]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        SessionManager::addEntryToSession(session_id, "user", "from another writer");
+    });
+    LLMResponse response = client.sendRequestWithSession("second", session_id);
+    other_writer.join();
+    ASSERT_TRUE(response.success) << response.error_message;
+
+    // A cache saved as current must hold the other writer's entry
+    SessionPayloadCache cache;
+    if (SessionManager::loadPayloadCache(session_id, "openai", cache) &&
+        cache.stamp == SessionManager::getSessionStamp(session_id)) {
+        EXPECT_NE(cache.messages.find("from another writer"), std::string::npos);
+    }
+
+    setServer(0, 0.0);
+    ASSERT_TRUE(client.sendRequestWithSession("third", session_id).success);
+    ASSERT_TRUE(SessionManager::loadPayloadCache(session_id, "openai", cache));
+    EXPECT_NE(cache.messages.find("from another writer"), std::string::npos);
+    EXPECT_EQ(entryCount(), 7u);
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "performance/mock_llm_server.h"
+#include "llm/llm_router.h"
+
+using clion::bench::MockLLMServer;
+using clion::bench::MockServerOptions;
+using namespace clion::llm;
+
+namespace {
+
+MockServerOptions serverOptions(const std::string& content, int latency_ms, double error_rate = 0.0) {
+    MockServerOptions options;
+    options.response_content = content;
+    options.latency_ms = latency_ms;
+    options.error_rate = error_rate;
+    return options;
+}
+
+LLMConfig providerConfig(const MockLLMServer& server) {
+    LLMConfig config;
+    config.provider = LLMProvider::CUSTOM;
+    config.api_key = "mock-key";
+    config.model = "gpt-4o-mini";
+    config.custom_endpoint = server.openAIEndpoint();
+    config.timeout_seconds = 10;
+    return config;
+}
+
+class LLMRouterTest : public ::testing::Test {
+protected:
+    LLMResponse send(MockLLMServer& primary, MockLLMServer& backup, int hedge_delay_ms,
+                     bool enable_hedging = true) {
+        RouterConfig config;
+        config.providers = {providerConfig(primary), providerConfig(backup)};
+        config.hedge_delay_ms = hedge_delay_ms;
+        config.enable_hedging = enable_hedging;
+        EXPECT_TRUE(router.initialize(config));
+        return router.sendRequest("ping");
+    }
+
+    LLMRouter router;
+};
+
+} // namespace
+
+TEST_F(LLMRouterTest, FastPrimaryIsNotHedged) {
+    MockLLMServer primary(serverOptions("primary", 0));
+    MockLLMServer backup(serverOptions("backup", 0));
+    ASSERT_TRUE(primary.start());
+    ASSERT_TRUE(backup.start());
+
+    LLMResponse response = send(primary, backup, 2000);
+
+    ASSERT_TRUE(response.success) << response.error_message;
+    EXPECT_EQ(response.content, "primary");
+    EXPECT_EQ(router.getStats().hedged_requests, 0u);
+    EXPECT_EQ(router.getStats().hedge_wins, 0u);
+    EXPECT_EQ(backup.requestCount(), 0u);
+}
+
+TEST_F(LLMRouterTest, SlowPrimaryLosesToHedge) {
+    MockLLMServer primary(serverOptions("primary", 600));
+    MockLLMServer backup(serverOptions("backup", 0));
+    ASSERT_TRUE(primary.start());
+    ASSERT_TRUE(backup.start());
+
+    LLMResponse response = send(primary, backup, 50);
+
+    ASSERT_TRUE(response.success) << response.error_message;
+    EXPECT_EQ(response.content, "backup");
+    EXPECT_EQ(router.getStats().hedged_requests, 1u);
+    EXPECT_EQ(router.getStats().hedge_wins, 1u);
+}
+
+TEST_F(LLMRouterTest, PrimaryFinishingFirstIsNotAHedgeWin) {
+    // Hedged, but the primary still answers well before the backup
+    MockLLMServer primary(serverOptions("primary", 200));
+    MockLLMServer backup(serverOptions("backup", 600));
+    ASSERT_TRUE(primary.start());
+    ASSERT_TRUE(backup.start());
+
+    LLMResponse response = send(primary, backup, 50);
+
+    ASSERT_TRUE(response.success) << response.error_message;
+    EXPECT_EQ(response.content, "primary");
+    EXPECT_EQ(router.getStats().hedged_requests, 1u);
+    EXPECT_EQ(router.getStats().hedge_wins, 0u);
+}
+
+TEST_F(LLMRouterTest, HedgeWaitsForBackupWhenPrimaryFails) {
+    MockLLMServer primary(serverOptions("primary", 200, 1.0));
+    MockLLMServer backup(serverOptions("backup", 600));
+    ASSERT_TRUE(primary.start());
+    ASSERT_TRUE(backup.start());
+
+    LLMResponse response = send(primary, backup, 50);
+
+    ASSERT_TRUE(response.success) << response.error_message;
+    EXPECT_EQ(response.content, "backup");
+    EXPECT_EQ(router.getStats().hedge_wins, 1u);
+}
+
+TEST_F(LLMRouterTest, FailsOverToNextProvider) {
+    MockLLMServer primary(serverOptions("primary", 0, 1.0));
+    MockLLMServer backup(serverOptions("backup", 0));
+    ASSERT_TRUE(primary.start());
+    ASSERT_TRUE(backup.start());
+
+    LLMResponse response = send(primary, backup, 2000, false);
+
+    ASSERT_TRUE(response.success) << response.error_message;
+    EXPECT_EQ(response.content, "backup");
+    EXPECT_EQ(router.getStats().failovers, 1u);
+    EXPECT_EQ(router.getStats().failures, 0u);
+}
+
+TEST_F(LLMRouterTest, ReportsFailureWhenEveryProviderFails) {
+    MockLLMServer primary(serverOptions("primary", 0, 1.0));
+    MockLLMServer backup(serverOptions("backup", 0, 1.0));
+    ASSERT_TRUE(primary.start());
+    ASSERT_TRUE(backup.start());
+
+    LLMResponse response = send(primary, backup, 2000, false);
+
+    EXPECT_FALSE(response.success);
+    EXPECT_FALSE(response.error_message.empty());
+    EXPECT_EQ(router.getStats().failures, 1u);
+}
+
+TEST_F(LLMRouterTest, FailoverCanBeDisabled) {
+    MockLLMServer primary(serverOptions("primary", 0, 1.0));
+    MockLLMServer backup(serverOptions("backup", 0));
+    ASSERT_TRUE(primary.start());
+    ASSERT_TRUE(backup.start());
+
+    RouterConfig config;
+    config.providers = {providerConfig(primary), providerConfig(backup)};
+    config.enable_hedging = false;
+    config.enable_failover = false;
+    ASSERT_TRUE(router.initialize(config));
+    LLMResponse response = router.sendRequest("ping");
+
+    EXPECT_FALSE(response.success);
+    EXPECT_EQ(backup.requestCount(), 0u);
+}
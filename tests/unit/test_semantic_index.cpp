@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include "temp_home.h"
+#include "llm/semantic_index.h"
+#include <string>
+
+using clion::llm::SemanticIndex;
+using clion::llm::SemanticSource;
+
+namespace {
+
+class SemanticIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        directory_ = (home_.path() / "index").string();
+        SemanticIndex::open(directory_);
+        ASSERT_TRUE(SemanticIndex::clear());
+    }
+
+    clion::test::TempHome home_;
+    std::string directory_;
+};
+
+} // namespace
+
+TEST(SemanticEmbeddingTest, RelatedTextIsMoreSimilar) {
+    auto parser = SemanticIndex::embed("parse the json config file");
+    auto related = SemanticIndex::embed("json config parser fails on the file");
+    auto unrelated = SemanticIndex::embed("render the button with a blue border");
+
+    EXPECT_NEAR(SemanticIndex::similarity(parser, parser), 1.0f, 0.02f);
+    EXPECT_GT(SemanticIndex::similarity(parser, related), SemanticIndex::similarity(parser, unrelated));
+    EXPECT_EQ(SemanticIndex::embed("").scale, 0.0f);
+}
+
+TEST_F(SemanticIndexTest, FindsMemoryNodesByMeaning) {
+    ASSERT_TRUE(SemanticIndex::addMemoryNode("node_json", "json config parser and its error handling", 80));
+    ASSERT_TRUE(SemanticIndex::addMemoryNode("node_ui", "button colours and border styles in the ui", 40));
+    EXPECT_EQ(SemanticIndex::size(SemanticSource::MEMORY_NODE), 2u);
+    EXPECT_EQ(SemanticIndex::memoryNodeImportance("node_json"), 80);
+
+    auto hits = SemanticIndex::search("why does the config parser reject this json", 2);
+    ASSERT_FALSE(hits.empty());
+    EXPECT_EQ(hits[0].id, "node_json");
+    EXPECT_EQ(hits[0].source, SemanticSource::MEMORY_NODE);
+    EXPECT_EQ(hits[0].importance, 80);
+}
+
+TEST_F(SemanticIndexTest, ReplacesAndRemovesMemoryNodes) {
+    ASSERT_TRUE(SemanticIndex::addMemoryNode("node", "build system notes", 30));
+    ASSERT_TRUE(SemanticIndex::addMemoryNode("node", "build system notes", 90));
+    EXPECT_EQ(SemanticIndex::size(SemanticSource::MEMORY_NODE), 1u);
+    EXPECT_EQ(SemanticIndex::memoryNodeImportance("node"), 90);
+
+    ASSERT_TRUE(SemanticIndex::removeMemoryNode("node"));
+    EXPECT_FALSE(SemanticIndex::memoryNodeImportance("node"));
+    EXPECT_TRUE(SemanticIndex::search("build system", 5).empty());
+}
+
+TEST_F(SemanticIndexTest, IndexesSessionTurns) {
+    ASSERT_TRUE(SemanticIndex::indexSession("session_a", {"how do I link against zlib", "add it to target_link_libraries"}));
+    ASSERT_TRUE(SemanticIndex::addTurn("session_a", 2, "zlib is found with find_package"));
+    EXPECT_EQ(SemanticIndex::turnCount("session_a"), 3u);
+
+    auto hits = SemanticIndex::search("linking zlib", 1);
+    ASSERT_EQ(hits.size(), 1u);
+    EXPECT_EQ(hits[0].id, "session_a");
+    EXPECT_EQ(hits[0].source, SemanticSource::SESSION_TURN);
+
+    ASSERT_TRUE(SemanticIndex::removeSession("session_a"));
+    EXPECT_EQ(SemanticIndex::turnCount("session_a"), 0u);
+}
+
+TEST_F(SemanticIndexTest, RemovingAllTurnsKeepsMemoryNodes) {
+    ASSERT_TRUE(SemanticIndex::addMemoryNode("node", "release checklist", 50));
+    ASSERT_TRUE(SemanticIndex::indexSession("session_a", {"tag the release"}));
+    ASSERT_TRUE(SemanticIndex::removeAllTurns());
+    EXPECT_EQ(SemanticIndex::size(SemanticSource::SESSION_TURN), 0u);
+    EXPECT_EQ(SemanticIndex::size(SemanticSource::MEMORY_NODE), 1u);
+}
+
+TEST_F(SemanticIndexTest, ReloadsFromItsLog) {
+    ASSERT_TRUE(SemanticIndex::addMemoryNode("node", "deployment runbook", 70));
+    ASSERT_TRUE(SemanticIndex::indexSession("session_a", {"roll back the deployment"}));
+
+    // Another directory, then back: everything comes from the file again
+    SemanticIndex::open((home_.path() / "other").string());
+    ASSERT_TRUE(SemanticIndex::open(directory_));
+    EXPECT_EQ(SemanticIndex::memoryNodeImportance("node"), 70);
+    EXPECT_EQ(SemanticIndex::turnCount("session_a"), 1u);
+}
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include "temp_home.h"
+#include "llm/session.h"
+#include "llm/session_cache.h"
+#include "llm/session_format.h"
+#include "utils/compression.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using clion::llm::BinarySessionFormat;
+using clion::llm::HistoryEntry;
+using clion::llm::Session;
+using clion::llm::SessionCache;
+using clion::llm::SessionFormat;
+using clion::llm::SessionManager;
+using clion::llm::SessionView;
+using clion::utils::Compression;
+
+namespace {
+
+class SessionFormatTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        SessionCache::clear();
+    }
+    void TearDown() override {
+        SessionManager::setStorageFormat(SessionFormat::JSON);
+        SessionCache::clear();
+    }
+
+    std::string readSessionFile(const std::string& session_id) const {
+        std::ifstream file(home_.sessionDirectory() / (session_id + ".json"), std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    clion::test::TempHome home_;
+};
+
+Session sampleSession() {
+    Session session;
+    session.id = "session_sample";
+    session.name = "sample";
+    session.tags = {"parser", "tests"};
+    for (int i = 0; i < 3; ++i) {
+        HistoryEntry entry;
+        entry.role = i % 2 ? "assistant" : "user";
+        entry.content = "entry " + std::to_string(i);
+        entry.timestamp = "2026-01-01T00:00:0" + std::to_string(i) + ".000Z";
+        entry.token_count = 3;
+        session.entries.push_back(entry);
+    }
+    return session;
+}
+
+// Header fields, as laid out at the start of a binary session
+constexpr size_t ENTRY_COUNT_OFFSET = 16;
+constexpr size_t FIELDS_OFFSET_OFFSET = 24;
+constexpr size_t TABLE_OFFSET_OFFSET = 40;
+
+uint64_t readU64(const std::string& data, size_t at) {
+    uint64_t value;
+    std::memcpy(&value, data.data() + at, sizeof(value));
+    return value;
+}
+
+void writeU64(std::string& data, size_t at, uint64_t value) {
+    std::memcpy(data.data() + at, &value, sizeof(value));
+}
+
+} // namespace
+
+TEST(BinarySessionFormatTest, EncodedSessionReadsBack) {
+    std::string data = BinarySessionFormat::encode(sampleSession(), false);
+    SessionView view;
+    ASSERT_TRUE(view.open(std::string_view(data)));
+    EXPECT_EQ(view.header().name, "sample");
+    ASSERT_EQ(view.entryCount(), 3u);
+    std::string buffer;
+    EXPECT_EQ(view.content(2, buffer).value_or(""), "entry 2");
+    EXPECT_EQ(view.role(1), "assistant");
+
+    auto session = view.materialize();
+    ASSERT_TRUE(session);
+    EXPECT_EQ(session->tags.size(), 2u);
+    EXPECT_EQ(session->entries[0].timestamp, "2026-01-01T00:00:00.000Z");
+}
+
+TEST(BinarySessionFormatTest, TruncatedFilesAreRejected) {
+    std::string data = BinarySessionFormat::encode(sampleSession(), false);
+    for (size_t size = 0; size < data.size(); ++size) {
+        std::string truncated = data.substr(0, size);
+        SessionView view;
+        EXPECT_FALSE(view.open(std::string_view(truncated))) << "accepted " << size << " of " << data.size() << " bytes";
+    }
+}
+
+TEST(BinarySessionFormatTest, OutOfRangeHeaderFieldsAreRejected) {
+    const std::string data = BinarySessionFormat::encode(sampleSession(), false);
+
+    std::string too_many = data;
+    writeU64(too_many, ENTRY_COUNT_OFFSET, readU64(data, ENTRY_COUNT_OFFSET) + 1);
+    std::string huge_count = data;
+    writeU64(huge_count, ENTRY_COUNT_OFFSET, UINT64_MAX / 2);
+    std::string fields_past_end = data;
+    writeU64(fields_past_end, FIELDS_OFFSET_OFFSET, data.size() + 1);
+    std::string table_past_end = data;
+    writeU64(table_past_end, TABLE_OFFSET_OFFSET, UINT64_MAX);
+
+    for (const std::string* corrupt : {&too_many, &huge_count, &fields_past_end, &table_past_end}) {
+        SessionView view;
+        EXPECT_FALSE(view.open(std::string_view(*corrupt)));
+    }
+}
+
+TEST(BinarySessionFormatTest, EntriesPointingOutsideTheFileAreRejected) {
+    const std::string data = BinarySessionFormat::encode(sampleSession(), false);
+    const size_t table = static_cast<size_t>(readU64(data, TABLE_OFFSET_OFFSET));
+
+    // First entry record: data offset, then token count and the sizes
+    std::string offset_past_table = data;
+    writeU64(offset_past_table, table, table + 1);
+    std::string content_too_long = data;
+    uint32_t content_size = UINT32_MAX;
+    std::memcpy(content_too_long.data() + table + 24, &content_size, sizeof(content_size));
+
+    for (const std::string* corrupt : {&offset_past_table, &content_too_long}) {
+        SessionView view;
+        EXPECT_FALSE(view.open(std::string_view(*corrupt)));
+    }
+}
+
+TEST_F(SessionFormatTest, SessionsAreWrittenAsJsonByDefault) {
+    std::string id = SessionManager::createNewSession();
+    ASSERT_FALSE(id.empty());
+
+    std::string data = readSessionFile(id);
+    ASSERT_FALSE(data.empty());
+    EXPECT_FALSE(BinarySessionFormat::matches(data));
+    // Builds with zstd store new sessions compressed as a whole
+    if (Compression::isCompressed(data)) {
+        auto decompressed = Compression::decompress(data);
+        ASSERT_TRUE(decompressed);
+        data = *decompressed;
+    }
+    ASSERT_FALSE(data.empty());
+    EXPECT_EQ(data.front(), '{');
+}
+
+TEST_F(SessionFormatTest, BinaryIsWrittenOnlyWhenAskedFor) {
+    SessionManager::setStorageFormat(SessionFormat::BINARY);
+    std::string id = SessionManager::createNewSession();
+    ASSERT_TRUE(SessionManager::addEntryToSession(id, "user", "hello"));
+    EXPECT_TRUE(BinarySessionFormat::matches(readSessionFile(id)));
+
+    // Read back whatever the current setting
+    SessionManager::setStorageFormat(SessionFormat::JSON);
+    SessionCache::clear();
+    auto session = SessionManager::loadSession(id);
+    ASSERT_TRUE(session);
+    ASSERT_EQ(session->entries.size(), 1u);
+    EXPECT_EQ(session->entries[0].content, "hello");
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include "temp_home.h"
+#include "llm/session.h"
+#include "llm/session_cache.h"
+#include "utils/group_commit.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using clion::llm::SessionCache;
+using clion::llm::SessionManager;
+using clion::utils::GroupCommit;
+
+namespace {
+
+class SessionJournalTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        SessionCache::clear();
+    }
+    void TearDown() override {
+        SessionManager::setSyncOnAppend(false);
+        SessionCache::clear();
+    }
+
+    std::filesystem::path journalPath(const std::string& session_id) const {
+        return home_.sessionDirectory() / (session_id + ".journal");
+    }
+
+    // The session as read from its files rather than the cache
+    static std::optional<clion::llm::Session> loadFromDisk(const std::string& session_id) {
+        SessionCache::clear();
+        return SessionManager::loadSession(session_id);
+    }
+
+    clion::test::TempHome home_;
+};
+
+} // namespace
+
+TEST_F(SessionJournalTest, AppendedEntriesAreReplayedInOrder) {
+    std::string id = SessionManager::createNewSession();
+    ASSERT_TRUE(SessionManager::addEntryToSession(id, "user", "first question"));
+    ASSERT_TRUE(SessionManager::addEntryToSession(id, "assistant", "first answer"));
+    ASSERT_TRUE(SessionManager::addEntryToSession(id, "user", "second question"));
+    ASSERT_TRUE(std::filesystem::exists(journalPath(id)));
+
+    auto session = loadFromDisk(id);
+    ASSERT_TRUE(session);
+    ASSERT_EQ(session->entries.size(), 3u);
+    EXPECT_EQ(session->entries[0].content, "first question");
+    EXPECT_EQ(session->entries[1].role, "assistant");
+    EXPECT_EQ(session->entries[2].content, "second question");
+    size_t total = 0;
+    for (const auto& entry : session->entries) {
+        EXPECT_GT(entry.token_count, 0u);
+        total += entry.token_count;
+    }
+    EXPECT_EQ(session->total_tokens, total);
+}
+
+TEST_F(SessionJournalTest, TornRecordIsSkippedAndLaterAppendsLand) {
+    std::string id = SessionManager::createNewSession();
+    ASSERT_TRUE(SessionManager::addEntryToSession(id, "user", "kept"));
+    {
+        // A crash mid-append leaves a record without its newline
+        std::ofstream journal(journalPath(id), std::ios::binary | std::ios::app);
+        journal << "{\"role\":\"user\",\"cont";
+    }
+
+    auto session = loadFromDisk(id);
+    ASSERT_TRUE(session);
+    ASSERT_EQ(session->entries.size(), 1u);
+
+    ASSERT_TRUE(SessionManager::addEntryToSession(id, "assistant", "after the crash"));
+    session = loadFromDisk(id);
+    ASSERT_TRUE(session);
+    ASSERT_EQ(session->entries.size(), 2u);
+    EXPECT_EQ(session->entries[1].content, "after the crash");
+}
+
+TEST_F(SessionJournalTest, JournalOfAnOlderSessionFileIsIgnored) {
+    std::string id = SessionManager::createNewSession();
+    ASSERT_TRUE(SessionManager::addEntryToSession(id, "user", "one"));
+    auto stale = journalPath(id).string() + ".stale";
+    std::filesystem::copy_file(journalPath(id), stale);
+
+    // Folds the journal into the session file, which no longer matches the copy
+    ASSERT_TRUE(SessionManager::compactSession(id));
+    std::filesystem::copy_file(stale, journalPath(id), std::filesystem::copy_options::overwrite_existing);
+
+    auto session = loadFromDisk(id);
+    ASSERT_TRUE(session);
+    ASSERT_EQ(session->entries.size(), 1u);
+    EXPECT_EQ(session->entries[0].content, "one");
+}
+
+TEST_F(SessionJournalTest, CompactionKeepsEveryEntry) {
+    std::string id = SessionManager::createNewSession();
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(SessionManager::addEntryToSession(id, "user", "turn " + std::to_string(i)));
+    }
+    auto journal_size = std::filesystem::file_size(journalPath(id));
+    ASSERT_TRUE(SessionManager::compactSession(id));
+    EXPECT_LT(std::filesystem::file_size(journalPath(id)), journal_size);
+
+    auto session = loadFromDisk(id);
+    ASSERT_TRUE(session);
+    ASSERT_EQ(session->entries.size(), 5u);
+    EXPECT_EQ(session->entries[4].content, "turn 4");
+}
+
+TEST_F(SessionJournalTest, SyncedAppendsFromManyThreadsAllLand) {
+    std::string id = SessionManager::createNewSession();
+    ASSERT_FALSE(id.empty());
+    SessionManager::setSyncOnAppend(true);
+    GroupCommit::resetStats();
+
+    constexpr int threads = 4;
+    constexpr int turns = 25;
+    std::vector<std::thread> workers;
+    std::vector<int> failures(threads, 0);
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < turns; ++i) {
+                std::string text = "thread " + std::to_string(t) + " turn " + std::to_string(i);
+                if (!SessionManager::addEntryToSession(id, "user", text)) {
+                    failures[t]++;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (int failed : failures) {
+        EXPECT_EQ(failed, 0);
+    }
+    auto stats = GroupCommit::getStats();
+    EXPECT_GE(stats.requests, static_cast<size_t>(threads * turns));
+    EXPECT_LE(stats.syncs, stats.requests);
+
+    SessionCache::clear();
+    auto session = SessionManager::loadSession(id);
+    ASSERT_TRUE(session);
+    EXPECT_EQ(session->entries.size(), static_cast<size_t>(threads * turns));
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include "temp_home.h"
+#include "llm/session.h"
+#include "llm/session_cache.h"
+#include <filesystem>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using clion::llm::SessionCache;
+using clion::llm::SessionManager;
+
+namespace {
+
+class SessionLockTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        SessionCache::clear();
+    }
+    void TearDown() override {
+        SessionCache::clear();
+    }
+
+    std::set<std::string> lockFiles() const {
+        std::set<std::string> files;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(home_.sessionDirectory() / "locks", ec)) {
+            files.insert(entry.path().filename().string());
+        }
+        return files;
+    }
+
+    clion::test::TempHome home_;
+};
+
+} // namespace
+
+TEST_F(SessionLockTest, SessionsShareAFixedSetOfLockFiles) {
+    for (int i = 0; i < 200; ++i) {
+        std::string id = SessionManager::createNewSession();
+        ASSERT_FALSE(id.empty());
+        ASSERT_TRUE(SessionManager::addEntryToSession(id, "user", "hello"));
+    }
+    auto files = lockFiles();
+    EXPECT_GT(files.size(), 1u);
+    EXPECT_LE(files.size(), 64u);
+}
+
+TEST_F(SessionLockTest, DeletingASessionKeepsItsLockFile) {
+    std::string id = SessionManager::createNewSession();
+    ASSERT_TRUE(SessionManager::addEntryToSession(id, "user", "hello"));
+    auto before = lockFiles();
+    ASSERT_FALSE(before.empty());
+
+    // Another process may be waiting on the same stripe
+    ASSERT_TRUE(SessionManager::deleteSession(id));
+    EXPECT_EQ(lockFiles(), before);
+}
+
+TEST_F(SessionLockTest, ConcurrentAppendsToManySessionsAllLand) {
+    constexpr int threads = 8;
+    std::vector<std::string> ids;
+    for (int t = 0; t < threads; ++t) {
+        ids.push_back(SessionManager::createNewSession());
+    }
+
+    std::vector<std::thread> workers;
+    std::vector<int> failures(threads, 0);
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < 20; ++i) {
+                if (!SessionManager::addEntryToSession(ids[t], "user", "turn " + std::to_string(i))) {
+                    failures[t]++;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    SessionCache::clear();
+    for (int t = 0; t < threads; ++t) {
+        EXPECT_EQ(failures[t], 0);
+        auto session = SessionManager::loadSession(ids[t]);
+        ASSERT_TRUE(session);
+        EXPECT_EQ(session->entries.size(), 20u);
+    }
+}
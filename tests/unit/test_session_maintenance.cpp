@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include "temp_home.h"
+#include "llm/session.h"
+#include "llm/session_cache.h"
+#include "llm/session_maintenance.h"
+#include "utils/compression.h"
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <string>
+
+using clion::llm::MaintenanceOptions;
+using clion::llm::Session;
+using clion::llm::SessionCache;
+using clion::llm::SessionMaintenance;
+using clion::llm::SessionManager;
+
+namespace {
+
+class SessionMaintenanceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        SessionCache::clear();
+    }
+    void TearDown() override {
+        SessionCache::clear();
+    }
+
+    // A session last changed `age` ago, written now
+    static std::string saveSessionChanged(std::chrono::hours age, bool compressed = false) {
+        std::time_t time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() - age);
+        char timestamp[32];
+        std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S.000Z", std::gmtime(&time));
+
+        Session session;
+        session.id = SessionManager::createSessionId();
+        session.created_at = timestamp;
+        session.updated_at = timestamp;
+        session.is_compressed = compressed;
+        return SessionManager::saveSession(session) ? session.id : "";
+    }
+
+    static void runPass(const MaintenanceOptions& options) {
+        SessionMaintenance maintenance(options);
+        maintenance.start();
+        maintenance.waitIdle();
+    }
+
+    static MaintenanceOptions unthrottled() {
+        MaintenanceOptions options;
+        options.io_bytes_per_second = 0;
+        options.compress = false;
+        return options;
+    }
+
+    clion::test::TempHome home_;
+};
+
+} // namespace
+
+TEST_F(SessionMaintenanceTest, AgeComesFromUpdatedAtNotFileTimes) {
+    std::string old_id = saveSessionChanged(std::chrono::hours(24 * 60));
+    std::string recent_id = saveSessionChanged(std::chrono::hours(1));
+    ASSERT_FALSE(old_id.empty());
+    ASSERT_FALSE(recent_id.empty());
+
+    // Both files were just written
+    runPass(unthrottled());
+    EXPECT_FALSE(SessionManager::sessionExists(old_id));
+    EXPECT_TRUE(SessionManager::sessionExists(recent_id));
+}
+
+TEST_F(SessionMaintenanceTest, CleanupUsesUpdatedAt) {
+    std::string old_id = saveSessionChanged(std::chrono::hours(24 * 60));
+    std::string recent_id = saveSessionChanged(std::chrono::hours(1));
+
+    EXPECT_EQ(SessionManager::cleanupOldSessions(30), 1u);
+    EXPECT_FALSE(SessionManager::sessionExists(old_id));
+    EXPECT_TRUE(SessionManager::sessionExists(recent_id));
+}
+
+TEST_F(SessionMaintenanceTest, CompressingKeepsUpdatedAt) {
+    if (!clion::utils::Compression::isAvailable()) {
+        GTEST_SKIP() << "built without zstd";
+    }
+    std::string id = saveSessionChanged(std::chrono::hours(24 * 20));
+    std::string updated_at = SessionManager::loadSession(id)->updated_at;
+
+    MaintenanceOptions options = unthrottled();
+    options.compress = true;
+    runPass(options);
+
+    SessionCache::clear();
+    auto session = SessionManager::loadSession(id);
+    ASSERT_TRUE(session);
+    EXPECT_TRUE(session->is_compressed);
+    EXPECT_EQ(session->updated_at, updated_at);
+    auto info = SessionManager::getSessionFileInfo(id);
+    ASSERT_TRUE(info);
+    EXPECT_GT(info->age(), std::chrono::hours(24 * 19));
+
+    // Still 20 days old to the next pass, so not deleted and not treated as in use
+    runPass(unthrottled());
+    EXPECT_TRUE(SessionManager::sessionExists(id));
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include "temp_home.h"
+#include "llm/session.h"
+#include "llm/session_cache.h"
+#include <future>
+#include <string>
+
+using clion::llm::Session;
+using clion::llm::SessionCache;
+using clion::llm::SessionManager;
+using clion::llm::SessionWriteBatch;
+
+namespace {
+
+class SessionWriteBatchTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        SessionCache::clear();
+    }
+    void TearDown() override {
+        SessionCache::clear();
+    }
+
+    static bool rename(const std::string& session_id, const std::string& name) {
+        auto session = SessionManager::loadSession(session_id);
+        if (!session) {
+            return false;
+        }
+        session->name = name;
+        return SessionManager::saveSession(*session);
+    }
+
+    // The name as another thread sees it
+    static std::string nameElsewhere(const std::string& session_id) {
+        return std::async(std::launch::async, [&] {
+            auto session = SessionManager::loadSession(session_id);
+            return session ? session->name : std::string("(missing)");
+        }).get();
+    }
+
+    clion::test::TempHome home_;
+};
+
+} // namespace
+
+TEST_F(SessionWriteBatchTest, ChangesAreVisibleOnlyToTheBatchUntilCommitted) {
+    std::string id = SessionManager::createNewSessionWithMetadata("before");
+    ASSERT_FALSE(id.empty());
+
+    SessionWriteBatch batch;
+    ASSERT_TRUE(rename(id, "after"));
+    EXPECT_EQ(SessionManager::loadSession(id)->name, "after");
+    EXPECT_EQ(nameElsewhere(id), "before");
+
+    ASSERT_TRUE(batch.commit());
+    EXPECT_EQ(nameElsewhere(id), "after");
+}
+
+TEST_F(SessionWriteBatchTest, CommitWritesOnlyItsOwnBatch) {
+    std::string first = SessionManager::createNewSessionWithMetadata("first");
+    std::string second = SessionManager::createNewSessionWithMetadata("second");
+
+    std::promise<void> changed;
+    std::promise<void> committed;
+    auto other = std::async(std::launch::async, [&] {
+        SessionWriteBatch batch;
+        rename(first, "first changed");
+        changed.set_value();
+        committed.get_future().wait();
+        return batch.commit();
+    });
+    changed.get_future().wait();
+
+    {
+        SessionWriteBatch batch;
+        ASSERT_TRUE(rename(second, "second changed"));
+        ASSERT_TRUE(batch.commit());
+    }
+    EXPECT_EQ(SessionManager::loadSession(second)->name, "second changed");
+    EXPECT_EQ(SessionManager::loadSession(first)->name, "first");
+
+    committed.set_value();
+    EXPECT_TRUE(other.get());
+    EXPECT_EQ(SessionManager::loadSession(first)->name, "first changed");
+}
+
+TEST_F(SessionWriteBatchTest, DiscardWritesNothing) {
+    std::string id = SessionManager::createNewSessionWithMetadata("kept");
+
+    SessionWriteBatch outer;
+    ASSERT_TRUE(rename(id, "dropped"));
+    {
+        SessionWriteBatch inner;
+        inner.discard();
+    }
+    EXPECT_FALSE(outer.commit());
+    EXPECT_EQ(SessionManager::loadSession(id)->name, "kept");
+    EXPECT_EQ(SessionCache::getStats().dirty, 0u);
+}
+
+TEST_F(SessionWriteBatchTest, FailedHierarchyChangeLeavesSessionsAlone) {
+    std::string parent = SessionManager::createNewSessionWithMetadata("parent");
+    std::string child = SessionManager::createNewSessionWithMetadata("child");
+
+    SessionWriteBatch outer;
+    ASSERT_TRUE(rename(parent, "renamed"));
+    EXPECT_FALSE(SessionManager::setParentSession(child, "session_missing"));
+    EXPECT_FALSE(outer.commit());
+    EXPECT_EQ(SessionManager::loadSession(parent)->name, "parent");
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "temp_home.h"
+#include "utils/token_cache.h"
+#include "utils/token_counter.h"
+#include <fstream>
+#include <string>
+
+using clion::utils::TokenCache;
+
+namespace {
+
+class TokenCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        TokenCache::setPersistent(false);
+        TokenCache::clear();
+    }
+    void TearDown() override {
+        TokenCache::setPersistent(false);
+        TokenCache::clear();
+    }
+};
+
+} // namespace
+
+TEST_F(TokenCacheTest, HeuristicCountsAreCachedByText) {
+    int calls = 0;
+    auto count = [&calls](std::string_view text) {
+        calls++;
+        return text.size();
+    };
+
+    EXPECT_EQ(TokenCache::countTokens("some prompt text", "test", count), 16u);
+    EXPECT_EQ(TokenCache::countTokens("some prompt text", "test", count), 16u);
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(TokenCache::getStats().hits, 1u);
+
+    // Another counter's count of the same text is its own entry
+    TokenCache::countTokens("some prompt text", "other", count);
+    EXPECT_EQ(calls, 2);
+}
+
+TEST_F(TokenCacheTest, CountsWithoutRankFilesGoThroughTheCache) {
+    clion::test::TempHome home;
+    const std::string text = "int main() { return 0; }";
+    int first = clion::utils::TokenCounter::countTokensForModel(text, "no-such-model");
+    size_t misses = TokenCache::getStats().misses;
+
+    EXPECT_EQ(clion::utils::TokenCounter::countTokensForModel(text, "no-such-model"), first);
+    EXPECT_EQ(TokenCache::getStats().misses, misses);
+    EXPECT_GE(TokenCache::getStats().hits, 1u);
+}
+
+TEST_F(TokenCacheTest, NewCountsReachTheFileOnFlush) {
+    clion::test::TempHome home;
+    TokenCache::setPersistent(true);
+    auto path = home.path() / ".clion" / "token_counts.tsv";
+
+    TokenCache::countTokens("flushed text", "test", [](std::string_view) { return size_t(424242); });
+    // Batched, so nothing is written per count
+    EXPECT_FALSE(std::filesystem::exists(path));
+
+    TokenCache::flush();
+    std::ifstream file(path);
+    std::string line;
+    bool found = false;
+    while (std::getline(file, line)) {
+        found = found || line.ends_with("\t424242");
+    }
+    EXPECT_TRUE(found);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "temp_home.h"
+#include "llm/usage_ledger.h"
+#include <string>
+
+using clion::llm::UsageLedger;
+using clion::llm::UsageQuery;
+using clion::llm::UsageRecord;
+
+namespace {
+
+class UsageLedgerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        UsageLedger::setEnabled(true);
+        UsageLedger::setPath((home_.path() / "usage.jsonl").string());
+    }
+    void TearDown() override {
+        UsageLedger::setPath("");
+    }
+
+    static UsageRecord makeRecord(const std::string& model, const std::string& project) {
+        UsageRecord record;
+        record.timestamp = "2026-03-01T10:00:00.000Z";
+        record.model = model;
+        record.project = project;
+        record.provider = "custom";
+        record.success = true;
+        record.prompt_tokens = 100;
+        return record;
+    }
+
+    clion::test::TempHome home_;
+};
+
+} // namespace
+
+TEST_F(UsageLedgerTest, FiltersOnPlainValues) {
+    ASSERT_TRUE(UsageLedger::record(makeRecord("gpt-4o", "/work/a")));
+    ASSERT_TRUE(UsageLedger::record(makeRecord("claude-3", "/work/a")));
+
+    UsageQuery query;
+    query.model = "gpt-4o";
+    auto records = UsageLedger::load(query);
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].model, "gpt-4o");
+}
+
+TEST_F(UsageLedgerTest, FiltersOnValuesThatNeedEscaping) {
+    // Windows paths and quoted names are escaped in the ledger lines
+    ASSERT_TRUE(UsageLedger::record(makeRecord("gpt-4o", "C:\\work\\a")));
+    ASSERT_TRUE(UsageLedger::record(makeRecord("team \"fast\" model", "/work/b")));
+
+    UsageQuery by_project;
+    by_project.project = "C:\\work\\a";
+    auto records = UsageLedger::load(by_project);
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].project, "C:\\work\\a");
+
+    UsageQuery by_model;
+    by_model.model = "team \"fast\" model";
+    records = UsageLedger::load(by_model);
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].project, "/work/b");
+}
+
+TEST_F(UsageLedgerTest, FiltersOnDate) {
+    ASSERT_TRUE(UsageLedger::record(makeRecord("gpt-4o", "/work/a")));
+
+    UsageQuery query;
+    query.since = "2026-03-02";
+    EXPECT_TRUE(UsageLedger::load(query).empty());
+    query.since = "2026-03-01";
+    EXPECT_EQ(UsageLedger::load(query).size(), 1u);
+}